@@ -0,0 +1,454 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "vbios-tables.h"
+#include "wolfvoitool.h"
+#include "vbios.h"
+#include "voi.h"
+#include "reloc.h"
+#include "plan.h"
+#include "sha256.h"
+#include "archive.h"
+
+typedef struct
+{
+	uint32_t Count;
+	VoltageObject **VOs;
+} VOIArchiveVOs;
+
+static bool CollectVOsVisit(VoltageObject *VO, uint8_t *VOData, uint32_t VODataLen, uint16_t Index, void *Ctx)
+{
+	VOIArchiveVOs *List = (VOIArchiveVOs *)Ctx;
+	
+	(void)VOData;
+	(void)VODataLen;
+	(void)Index;
+	
+	List->VOs[List->Count++] = VO;
+	return(true);
+}
+
+static bool CollectVOs(VOIArchiveVOs *List, const VBIOSInfo *Info)
+{
+	List->Count = 0;
+	return(WalkVOTable(Info->Image + Info->VOITblOffset, 0xFF, NULL, CollectVOsVisit, List) >= 0);
+}
+
+// Works out the edits that turn the base into the variant in VarImg,
+// and checks that making them through the relocation engine really
+// does reproduce the variant, byte for byte, before writing them out.
+static bool VOIArchiveAddVariant(FILE *ArchiveFile, const VBIOSInfo *BaseInfo, uint8_t *VarImg, uint8_t *WorkImg, const char *VarName)
+{
+	VBIOSInfo VarInfo, WorkInfo;
+	VOIArchiveVOs BaseVOs, VarVOs;
+	VOIArchiveVariantHdr VarHdr = { 0 };
+	VOEdit Edits[VBIOS_PLAN_MAX_EDITS];
+	uint32_t EditCount = 0;
+	size_t VarSize;
+	VBIOSPlan *Plan = NULL;
+	bool Ret = false;
+	
+	VarSize = ReadVBIOSFile(VarImg, VarName, AMD_VBIOS_MAX_SIZE);
+	
+	if(!VarSize || !VBIOSLocateVOI(&VarInfo, VarImg, VarSize)) return(false);
+	
+	BaseVOs.VOs = (VoltageObject **)malloc(sizeof(VoltageObject *) * VOI_MAX_VOS);
+	VarVOs.VOs = (VoltageObject **)malloc(sizeof(VoltageObject *) * VOI_MAX_VOS);
+	Plan = (VBIOSPlan *)malloc(sizeof(VBIOSPlan));
+	
+	if(!BaseVOs.VOs || !VarVOs.VOs || !Plan)
+	{
+		printf("Out of memory.\n");
+		goto out;
+	}
+	
+	if(!CollectVOs(&BaseVOs, BaseInfo) || !CollectVOs(&VarVOs, &VarInfo))
+	{
+		printf("VOI table of %s is malformed.\n", VarName);
+		goto out;
+	}
+	
+	if(VarVOs.Count < BaseVOs.Count)
+	{
+		printf("%s has fewer VOs than the base ROM.\n", VarName);
+		goto out;
+	}
+	
+	for(uint32_t i = 0; i < VarVOs.Count; ++i)
+	{
+		VoltageObject *VarVO = VarVOs.VOs[i];
+		
+		if((i < BaseVOs.Count) && (BaseVOs.VOs[i]->VOSize == VarVO->VOSize) && !memcmp(BaseVOs.VOs[i], VarVO, VarVO->VOSize)) continue;
+		
+		if(EditCount == VBIOS_PLAN_MAX_EDITS)
+		{
+			printf("%s changes more than %d VOs.\n", VarName, VBIOS_PLAN_MAX_EDITS);
+			goto out;
+		}
+		
+		// Data points into the variant image; nothing to free.
+		memset(Edits + EditCount, 0x00, sizeof(VOEdit));
+		Edits[EditCount].Index = (i < BaseVOs.Count) ? (int32_t)i : VOEDIT_APPEND;
+		Edits[EditCount].SetMask = VOEDIT_SET_HDR | VOEDIT_SET_DATA;
+		Edits[EditCount].Hdr = *VarVO;
+		Edits[EditCount].Data = ((uint8_t *)VarVO) + sizeof(VoltageObject);
+		Edits[EditCount].DataLen = (VarVO->VOSize > sizeof(VoltageObject)) ? (VarVO->VOSize - sizeof(VoltageObject)) : 0;
+		EditCount++;
+	}
+	
+	// Variants are rebuilt with the shift strategy, which is all
+	// that archives have ever described.
+	if(!VBIOSPlanEdits(Plan, BaseInfo, Edits, EditCount, VBIOS_RELOC_SHIFT))
+	{
+		printf("%s cannot be stored as a delta: %s.\n", VarName, Plan->Error);
+		goto out;
+	}
+	
+	memcpy(WorkImg, BaseInfo->Image, BaseInfo->Size);
+	
+	if(!VBIOSLocateVOI(&WorkInfo, WorkImg, BaseInfo->Size) || !VBIOSApplyVOEdits(&WorkInfo, Edits, EditCount, VBIOS_RELOC_SHIFT) || (WorkInfo.Size != VarSize) || memcmp(WorkImg, VarImg, VarSize))
+	{
+		printf("%s differs from the base ROM outside of its VOI table, and cannot be stored as a delta.\n", VarName);
+		goto out;
+	}
+	
+	VarHdr.Size = VarSize;
+	SHA256(VarHdr.Hash, VarImg, VarSize);
+	VarHdr.SizeChange = Plan->SizeDiff;
+	VarHdr.GrowLen = Plan->GrowLen;
+	VarHdr.MoveCount = Plan->MoveCount;
+	VarHdr.EditCount = EditCount;
+	VarHdr.NameLen = strlen(VarName);
+	
+	if((fwrite(&VarHdr, sizeof(VarHdr), 1, ArchiveFile) != 1) || (fwrite(VarName, 1, VarHdr.NameLen, ArchiveFile) != VarHdr.NameLen))
+		goto write_fail;
+	
+	for(uint32_t i = 0; i < EditCount; ++i)
+	{
+		VOIArchiveEditHdr EditHdr = { Edits[i].Index, Edits[i].Hdr.VOSize, 0 };
+		
+		if((fwrite(&EditHdr, sizeof(EditHdr), 1, ArchiveFile) != 1) || (fwrite(&Edits[i].Hdr, sizeof(VoltageObject), 1, ArchiveFile) != 1))
+			goto write_fail;
+		
+		if(Edits[i].DataLen && (fwrite(Edits[i].Data, Edits[i].DataLen, 1, ArchiveFile) != 1))
+			goto write_fail;
+	}
+	
+	Ret = true;
+	goto out;
+	
+write_fail:
+	printf("Writing to the archive failed.\n");
+	
+out:
+	free(BaseVOs.VOs);
+	free(VarVOs.VOs);
+	free(Plan);
+	return(Ret);
+}
+
+// Stores ROMFiles[0] in full, and every other ROM as a variant of it.
+// ROMs that cannot be stored as a delta are skipped (and reported);
+// the archive holds the rest.
+bool VOIArchiveCreate(const char *ArchiveName, char **ROMFiles, uint32_t ROMFileCount)
+{
+	uint8_t *BaseImg = (uint8_t *)malloc(AMD_VBIOS_MAX_SIZE);
+	uint8_t *VarImg = (uint8_t *)malloc(AMD_VBIOS_MAX_SIZE);
+	uint8_t *WorkImg = (uint8_t *)malloc(AMD_VBIOS_MAX_SIZE);
+	VOIArchiveHdr Hdr = { 0 };
+	VBIOSInfo BaseInfo;
+	FILE *ArchiveFile = NULL;
+	size_t BaseSize;
+	bool Ret = false;
+	
+	if(!BaseImg || !VarImg || !WorkImg)
+	{
+		printf("Out of memory.\n");
+		goto out;
+	}
+	
+	BaseSize = ReadVBIOSFile(BaseImg, ROMFiles[0], AMD_VBIOS_MAX_SIZE);
+	
+	if(!BaseSize || !VBIOSLocateVOI(&BaseInfo, BaseImg, BaseSize))
+	{
+		printf("Unable to use %s as the base ROM.\n", ROMFiles[0]);
+		goto out;
+	}
+	
+	ArchiveFile = fopen(ArchiveName, "wb");
+	
+	if(!ArchiveFile)
+	{
+		printf("Unable to open %s for writing.\n", ArchiveName);
+		goto out;
+	}
+	
+	memcpy(Hdr.Magic, VOIARCHIVE_MAGIC, sizeof(Hdr.Magic));
+	Hdr.BaseSize = BaseSize;
+	SHA256(Hdr.BaseHash, BaseImg, BaseSize);
+	
+	// The variant count is filled in once they have all been tried.
+	if((fwrite(&Hdr, sizeof(Hdr), 1, ArchiveFile) != 1) || (fwrite(BaseImg, BaseSize, 1, ArchiveFile) != 1))
+	{
+		printf("Writing to the archive failed.\n");
+		goto out;
+	}
+	
+	Ret = true;
+	
+	for(uint32_t i = 1; i < ROMFileCount; ++i)
+	{
+		if(VOIArchiveAddVariant(ArchiveFile, &BaseInfo, VarImg, WorkImg, ROMFiles[i])) Hdr.VariantCount++;
+		else
+		{
+			printf("Skipping %s.\n", ROMFiles[i]);
+			Ret = false;
+			
+			// A failed write may have left part of a variant behind.
+			if(ferror(ArchiveFile)) goto out;
+		}
+	}
+	
+	if(fseek(ArchiveFile, 0, SEEK_SET) || (fwrite(&Hdr, sizeof(Hdr), 1, ArchiveFile) != 1))
+	{
+		printf("Writing to the archive failed.\n");
+		Ret = false;
+	}
+	else printf("Archived %s with %u variants in %s.\n", ROMFiles[0], Hdr.VariantCount, ArchiveName);
+	
+out:
+	if(ArchiveFile) fclose(ArchiveFile);
+	free(BaseImg);
+	free(VarImg);
+	free(WorkImg);
+	return(Ret);
+}
+
+// Reads an entire archive into memory, and checks its header and base.
+static uint8_t *VOIArchiveLoad(const char *ArchiveName, size_t *ArchiveLen)
+{
+	FILE *ArchiveFile = fopen(ArchiveName, "rb");
+	uint8_t *Archive = NULL, Hash[SHA256_DIGEST_LEN];
+	const VOIArchiveHdr *Hdr;
+	long Len;
+	
+	if(!ArchiveFile)
+	{
+		printf("Unable to open %s (does it exist?)\n", ArchiveName);
+		return(NULL);
+	}
+	
+	if(fseek(ArchiveFile, 0, SEEK_END) || ((Len = ftell(ArchiveFile)) < (long)sizeof(VOIArchiveHdr)) || fseek(ArchiveFile, 0, SEEK_SET))
+	{
+		printf("%s is not a ROM archive.\n", ArchiveName);
+		fclose(ArchiveFile);
+		return(NULL);
+	}
+	
+	Archive = (uint8_t *)malloc(Len);
+	
+	if(!Archive || (fread(Archive, 1, Len, ArchiveFile) != (size_t)Len))
+	{
+		printf("Reading %s failed.\n", ArchiveName);
+		fclose(ArchiveFile);
+		free(Archive);
+		return(NULL);
+	}
+	
+	fclose(ArchiveFile);
+	
+	Hdr = (const VOIArchiveHdr *)Archive;
+	
+	if(memcmp(Hdr->Magic, VOIARCHIVE_MAGIC, sizeof(Hdr->Magic)) || (Hdr->BaseSize > AMD_VBIOS_MAX_SIZE) || ((Len - sizeof(VOIArchiveHdr)) < Hdr->BaseSize))
+	{
+		printf("%s is not a ROM archive.\n", ArchiveName);
+		free(Archive);
+		return(NULL);
+	}
+	
+	SHA256(Hash, Archive + sizeof(VOIArchiveHdr), Hdr->BaseSize);
+	
+	if(memcmp(Hash, Hdr->BaseHash, SHA256_DIGEST_LEN))
+	{
+		printf("The base ROM in %s is corrupt.\n", ArchiveName);
+		free(Archive);
+		return(NULL);
+	}
+	
+	*ArchiveLen = Len;
+	return(Archive);
+}
+
+// Parses the variant at Pos, filling in Edits (which point into the
+// archive), and returns a pointer just past it, or NULL if it is
+// truncated or malformed.
+static const uint8_t *VOIArchiveNextVariant(const uint8_t *Pos, const uint8_t *End, const VOIArchiveVariantHdr **VarHdr, const char **Name, VOEdit *Edits)
+{
+	if((size_t)(End - Pos) < sizeof(VOIArchiveVariantHdr)) return(NULL);
+	
+	*VarHdr = (const VOIArchiveVariantHdr *)Pos;
+	Pos += sizeof(VOIArchiveVariantHdr);
+	
+	if(((End - Pos) < (*VarHdr)->NameLen) || ((*VarHdr)->EditCount > VBIOS_PLAN_MAX_EDITS)) return(NULL);
+	
+	*Name = (const char *)Pos;
+	Pos += (*VarHdr)->NameLen;
+	
+	for(uint32_t i = 0; i < (*VarHdr)->EditCount; ++i)
+	{
+		const VOIArchiveEditHdr *EditHdr = (const VOIArchiveEditHdr *)Pos;
+		
+		if(((size_t)(End - Pos) < sizeof(VOIArchiveEditHdr)) || (((size_t)(End - Pos) - sizeof(VOIArchiveEditHdr)) < EditHdr->VOLen) || (EditHdr->VOLen < sizeof(VoltageObject)))
+			return(NULL);
+		
+		Pos += sizeof(VOIArchiveEditHdr);
+		
+		memset(Edits + i, 0x00, sizeof(VOEdit));
+		Edits[i].Index = EditHdr->Index;
+		Edits[i].SetMask = VOEDIT_SET_HDR | VOEDIT_SET_DATA;
+		memcpy(&Edits[i].Hdr, Pos, sizeof(VoltageObject));
+		Edits[i].Data = (uint8_t *)Pos + sizeof(VoltageObject);
+		Edits[i].DataLen = EditHdr->VOLen - sizeof(VoltageObject);
+		
+		Pos += EditHdr->VOLen;
+	}
+	
+	return(Pos);
+}
+
+bool VOIArchiveList(const char *ArchiveName)
+{
+	size_t ArchiveLen;
+	uint8_t *Archive = VOIArchiveLoad(ArchiveName, &ArchiveLen);
+	const VOIArchiveHdr *Hdr = (const VOIArchiveHdr *)Archive;
+	const uint8_t *Pos, *End;
+	VOEdit Edits[VBIOS_PLAN_MAX_EDITS];
+	
+	if(!Archive) return(false);
+	
+	Pos = Archive + sizeof(VOIArchiveHdr) + Hdr->BaseSize;
+	End = Archive + ArchiveLen;
+	
+	printf("Base ROM: %u bytes, %u variants, %zu bytes in total.\n", Hdr->BaseSize, Hdr->VariantCount, ArchiveLen);
+	
+	for(uint32_t i = 0; i < Hdr->VariantCount; ++i)
+	{
+		const VOIArchiveVariantHdr *VarHdr;
+		const char *Name;
+		
+		if(!(Pos = VOIArchiveNextVariant(Pos, End, &VarHdr, &Name, Edits)))
+		{
+			printf("%s is truncated.\n", ArchiveName);
+			free(Archive);
+			return(false);
+		}
+		
+		printf("%.*s: %u bytes, %u VOs changed, VOI table %+d bytes, legacy image grows %u bytes, %u table offsets moved.\n", VarHdr->NameLen, Name, VarHdr->Size, VarHdr->EditCount, VarHdr->SizeChange, VarHdr->GrowLen, VarHdr->MoveCount);
+	}
+	
+	free(Archive);
+	return(true);
+}
+
+// Rebuilds one variant from the base and its edits. The plan for the
+// edits must agree with the one stored, and the result must hash to
+// the stored value, or nothing is written.
+static bool VOIArchiveRebuild(const uint8_t *Base, uint32_t BaseSize, const VOIArchiveVariantHdr *VarHdr, const VOEdit *Edits, uint8_t *WorkImg, VBIOSPlan *Plan, const char *OutName)
+{
+	uint8_t Hash[SHA256_DIGEST_LEN];
+	VBIOSInfo Info;
+	
+	memcpy(WorkImg, Base, BaseSize);
+	
+	if(!VBIOSLocateVOI(&Info, WorkImg, BaseSize)) return(false);
+	
+	if(!VBIOSPlanEdits(Plan, &Info, Edits, VarHdr->EditCount, VBIOS_RELOC_SHIFT) || (Plan->SizeDiff != VarHdr->SizeChange) || (Plan->GrowLen != VarHdr->GrowLen) || (Plan->MoveCount != VarHdr->MoveCount))
+	{
+		printf("The stored edits no longer match the base ROM.\n");
+		return(false);
+	}
+	
+	if(!VBIOSApplyVOEdits(&Info, Edits, VarHdr->EditCount, VBIOS_RELOC_SHIFT)) return(false);
+	
+	SHA256(Hash, WorkImg, Info.Size);
+	
+	if((Info.Size != VarHdr->Size) || memcmp(Hash, VarHdr->Hash, SHA256_DIGEST_LEN))
+	{
+		printf("The rebuilt ROM does not match the original.\n");
+		return(false);
+	}
+	
+	return(WriteVBIOSFile(OutName, WorkImg, Info.Size) == Info.Size);
+}
+
+// Rebuilds every variant (or just the one named VariantName) into
+// OutDir, under the file name it was archived with.
+bool VOIArchiveExtract(const char *ArchiveName, const char *VariantName, const char *OutDir)
+{
+	size_t ArchiveLen;
+	uint8_t *Archive = VOIArchiveLoad(ArchiveName, &ArchiveLen);
+	const VOIArchiveHdr *Hdr = (const VOIArchiveHdr *)Archive;
+	uint8_t *WorkImg = (uint8_t *)malloc(AMD_VBIOS_MAX_SIZE);
+	VBIOSPlan *Plan = (VBIOSPlan *)malloc(sizeof(VBIOSPlan));
+	VOEdit Edits[VBIOS_PLAN_MAX_EDITS];
+	const uint8_t *Pos, *End;
+	uint32_t Extracted = 0;
+	bool Ret = true;
+	
+	if(!Archive || !WorkImg || !Plan)
+	{
+		free(Archive);
+		free(WorkImg);
+		free(Plan);
+		return(false);
+	}
+	
+	Pos = Archive + sizeof(VOIArchiveHdr) + Hdr->BaseSize;
+	End = Archive + ArchiveLen;
+	
+	for(uint32_t i = 0; i < Hdr->VariantCount; ++i)
+	{
+		const VOIArchiveVariantHdr *VarHdr;
+		const char *Name, *BaseName;
+		char OutName[4096];
+		
+		if(!(Pos = VOIArchiveNextVariant(Pos, End, &VarHdr, &Name, Edits)))
+		{
+			printf("%s is truncated.\n", ArchiveName);
+			Ret = false;
+			break;
+		}
+		
+		if(VariantName && ((strlen(VariantName) != VarHdr->NameLen) || strncmp(VariantName, Name, VarHdr->NameLen))) continue;
+		
+		// Only the last path component is kept.
+		for(BaseName = Name + VarHdr->NameLen; (BaseName > Name) && (BaseName[-1] != '/'); --BaseName);
+		
+		snprintf(OutName, sizeof(OutName), "%s/%.*s", OutDir, (int)(Name + VarHdr->NameLen - BaseName), BaseName);
+		
+		if(VOIArchiveRebuild(Archive + sizeof(VOIArchiveHdr), Hdr->BaseSize, VarHdr, Edits, WorkImg, Plan, OutName))
+		{
+			printf("Extracted %s.\n", OutName);
+			Extracted++;
+		}
+		else
+		{
+			printf("Unable to extract %.*s.\n", VarHdr->NameLen, Name);
+			Ret = false;
+		}
+	}
+	
+	if(VariantName && !Extracted && Ret)
+	{
+		printf("%s holds no variant named %s.\n", ArchiveName, VariantName);
+		Ret = false;
+	}
+	
+	free(Archive);
+	free(WorkImg);
+	free(Plan);
+	return(Ret);
+}
@@ -0,0 +1,66 @@
+// Copyright 2022 Wolf9466/Wolf0/OhGodAPet
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "sha256.h"
+
+// A ROM archive holds one base ROM in full, and any number of
+// variants of it, each stored only as the VOs that differ from
+// the base - the edits that, made through the relocation engine,
+// turn the base into the variant - along with a summary of the
+// relocation plan for those edits. Variants are rebuilt on demand
+// and checked against the SHA-256 of the original.
+//
+// File layout (all little-endian):
+//
+//	VOIArchiveHdr
+//	uint8_t Base[BaseSize]
+//	for each variant:
+//		VOIArchiveVariantHdr
+//		char Name[NameLen]
+//		for each edit:
+//			VOIArchiveEditHdr
+//			uint8_t VO[VOLen]		(VO header, mode header and data)
+//
+// Only variants that differ from the base in their VOI table,
+// and what the relocation engine moves as a result, can be stored.
+
+#define VOIARCHIVE_MAGIC				"WVOIARC1"
+
+#pragma pack(push, 1)
+
+typedef struct
+{
+	char Magic[8];
+	uint32_t BaseSize;
+	uint32_t VariantCount;
+	uint8_t BaseHash[SHA256_DIGEST_LEN];
+} VOIArchiveHdr;
+
+typedef struct
+{
+	uint32_t Size;
+	uint8_t Hash[SHA256_DIGEST_LEN];
+	int32_t SizeChange;
+	uint32_t GrowLen;
+	uint16_t MoveCount;
+	uint16_t EditCount;
+	uint16_t NameLen;
+	uint16_t Reserved;
+} VOIArchiveVariantHdr;
+
+typedef struct
+{
+	int32_t Index;
+	uint16_t VOLen;
+	uint16_t Reserved;
+} VOIArchiveEditHdr;
+
+#pragma pack(pop)
+
+bool VOIArchiveCreate(const char *ArchiveName, char **ROMFiles, uint32_t ROMFileCount);
+bool VOIArchiveList(const char *ArchiveName);
+bool VOIArchiveExtract(const char *ArchiveName, const char *VariantName, const char *OutDir);
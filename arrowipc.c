@@ -0,0 +1,350 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "export.h"
+
+// Writes a VOIExport as an Apache Arrow IPC file, without pulling
+// in Arrow or FlatBuffers. The column buffers already have the
+// Arrow in-memory layout, so all that is needed is the metadata:
+// a Schema message, one RecordBatch message and the file footer,
+// each a FlatBuffer. Only the handful of tables and fields that
+// we actually emit are implemented below.
+
+// Arrow's Schema.fbs/Message.fbs/File.fbs constants
+#define ARROW_METADATA_V5				4
+#define ARROW_HEADER_SCHEMA				1
+#define ARROW_HEADER_RECORDBATCH		3
+#define ARROW_TYPE_INT					2
+#define ARROW_TYPE_BINARY				4
+#define ARROW_TYPE_UTF8					5
+
+#define ARROW_BODY_ALIGN				64
+
+// A minimal FlatBuffer builder. Unlike the real one, it builds
+// front to back: a parent table is written with placeholder
+// offsets, and each child is written after it and then patched
+// in, so every offset points forward as the format requires.
+typedef struct
+{
+	VOIExportBuf Buf;
+	bool Failed;
+} FBBuilder;
+
+typedef struct
+{
+	uint8_t Slot;
+	uint8_t Size;
+	bool IsOffset;
+	uint64_t Value;
+	size_t Pos;
+} FBField;
+
+static void FBPut(FBBuilder *B, const void *Src, size_t Len)
+{
+	if(!VOIExportBufPut(&B->Buf, Src, Len)) B->Failed = true;
+}
+
+// Pads with zeroes until the length is Phase modulo Align
+static size_t FBPadTo(FBBuilder *B, size_t Align, size_t Phase)
+{
+	const uint8_t Zero = 0;
+
+	while(!B->Failed && ((B->Buf.Len % Align) != Phase)) FBPut(B, &Zero, 1);
+
+	return(B->Buf.Len);
+}
+
+static void FBPatch(FBBuilder *B, size_t At, size_t Target)
+{
+	uint32_t Rel = Target - At;
+
+	if(!B->Failed) memcpy(B->Buf.Data + At, &Rel, sizeof(uint32_t));
+}
+
+// Writes a vtable and table for Fields. Scalars are laid out
+// largest first, with the table placed so that 8-byte fields
+// land on 8-byte boundaries. Offset fields are left as zero,
+// and their positions returned in Pos for FBPatch().
+static size_t FBTable(FBBuilder *B, FBField *Fields, uint32_t Count)
+{
+	uint16_t VTable[2 + 16] = { 0 };
+	uint32_t SlotCount = 0, FieldOff = sizeof(int32_t);
+	uint8_t Inline[128] = { 0 };
+	size_t VTablePos, TablePos;
+	int32_t SOffset;
+
+	for(uint8_t Size = 8; Size; Size >>= 1)
+	{
+		for(uint32_t i = 0; i < Count; ++i)
+		{
+			if(Fields[i].Size != Size) continue;
+
+			VTable[2 + Fields[i].Slot] = FieldOff;
+			Fields[i].Pos = FieldOff;
+
+			if(!Fields[i].IsOffset) memcpy(Inline + FieldOff, &Fields[i].Value, Size);
+
+			FieldOff += Size;
+			if(Fields[i].Slot >= SlotCount) SlotCount = Fields[i].Slot + 1;
+		}
+	}
+
+	VTable[0] = (2 + SlotCount) * sizeof(uint16_t);
+	VTable[1] = FieldOff;
+
+	VTablePos = FBPadTo(B, 2, 0);
+	FBPut(B, VTable, VTable[0]);
+
+	TablePos = FBPadTo(B, 8, 4);
+	SOffset = TablePos - VTablePos;
+	memcpy(Inline, &SOffset, sizeof(int32_t));
+	FBPut(B, Inline, FieldOff);
+
+	for(uint32_t i = 0; i < Count; ++i) Fields[i].Pos += TablePos;
+
+	return(TablePos);
+}
+
+static size_t FBString(FBBuilder *B, const char *Str)
+{
+	uint32_t Len = strlen(Str);
+	size_t Pos = FBPadTo(B, 4, 0);
+
+	FBPut(B, &Len, sizeof(uint32_t));
+	FBPut(B, Str, Len + 1);
+
+	return(Pos);
+}
+
+// Starts a vector, aligned so that its elements (which follow the
+// 4-byte length) are aligned to ElemAlign. Returns its position.
+static size_t FBVector(FBBuilder *B, uint32_t Count, size_t ElemAlign, const void *Elems, size_t ElemSize)
+{
+	size_t Pos = FBPadTo(B, ((ElemAlign > 4) ? ElemAlign : 4), ((ElemAlign > 4) ? (ElemAlign - 4) : 0));
+
+	FBPut(B, &Count, sizeof(uint32_t));
+
+	if(Elems) FBPut(B, Elems, ElemSize * Count);
+	else
+	{
+		// Vector of offsets, to be patched by the caller
+		for(uint32_t i = 0; i < Count; ++i) FBPut(B, &(uint32_t){ 0 }, sizeof(uint32_t));
+	}
+
+	return(Pos);
+}
+
+static size_t ArrowWriteField(FBBuilder *B, const VOIExportColumn *Column)
+{
+	uint8_t TypeType = ((Column->Kind == VOIEXPORT_KIND_UINT) ? ARROW_TYPE_INT : ((Column->Kind == VOIEXPORT_KIND_UTF8) ? ARROW_TYPE_UTF8 : ARROW_TYPE_BINARY));
+	FBField Field[] =
+	{
+		{ .Slot = 0, .Size = 4, .IsOffset = true, .Value = 0 },			// name
+		{ .Slot = 1, .Size = 1, .IsOffset = false, .Value = 0 },		// nullable
+		{ .Slot = 2, .Size = 1, .IsOffset = false, .Value = TypeType },	// type_type
+		{ .Slot = 3, .Size = 4, .IsOffset = true, .Value = 0 },			// type
+		{ .Slot = 5, .Size = 4, .IsOffset = true, .Value = 0 }			// children
+	};
+	size_t Pos = FBTable(B, Field, 5);
+
+	FBPatch(B, Field[0].Pos, FBString(B, Column->Name));
+
+	if(TypeType == ARROW_TYPE_INT)
+	{
+		FBField Int[] =
+		{
+			{ .Slot = 0, .Size = 4, .IsOffset = false, .Value = Column->Width * 8 },	// bitWidth
+			{ .Slot = 1, .Size = 1, .IsOffset = false, .Value = 0 }						// is_signed
+		};
+
+		FBPatch(B, Field[3].Pos, FBTable(B, Int, 2));
+	}
+	else FBPatch(B, Field[3].Pos, FBTable(B, NULL, 0));
+
+	FBPatch(B, Field[4].Pos, FBVector(B, 0, 4, NULL, 0));
+
+	return(Pos);
+}
+
+static size_t ArrowWriteSchema(FBBuilder *B, const VOIExport *Export)
+{
+	FBField Schema[] =
+	{
+		{ .Slot = 0, .Size = 2, .IsOffset = false, .Value = 0 },	// endianness (Little)
+		{ .Slot = 1, .Size = 4, .IsOffset = true, .Value = 0 }		// fields
+	};
+	size_t Pos = FBTable(B, Schema, 2), FieldsPos;
+
+	FieldsPos = FBVector(B, VOIEXPORT_COL_MAX, 4, NULL, 0);
+	FBPatch(B, Schema[1].Pos, FieldsPos);
+
+	for(int i = 0; i < VOIEXPORT_COL_MAX; ++i)
+		FBPatch(B, FieldsPos + 4 + (i << 2), ArrowWriteField(B, Export->Columns + i));
+
+	return(Pos);
+}
+
+static size_t ArrowWriteMessage(FBBuilder *B, uint8_t HeaderType, uint64_t BodyLen)
+{
+	FBField Message[] =
+	{
+		{ .Slot = 0, .Size = 2, .IsOffset = false, .Value = ARROW_METADATA_V5 },	// version
+		{ .Slot = 1, .Size = 1, .IsOffset = false, .Value = HeaderType },			// header_type
+		{ .Slot = 2, .Size = 4, .IsOffset = true, .Value = 0 },						// header
+		{ .Slot = 3, .Size = 8, .IsOffset = false, .Value = BodyLen }				// bodyLength
+	};
+
+	FBPut(B, &(uint32_t){ 0 }, sizeof(uint32_t));
+	FBPatch(B, 0, FBTable(B, Message, 4));
+
+	return(Message[2].Pos);
+}
+
+// Writes an encapsulated message: continuation marker, metadata
+// length, then the metadata padded so the body is 8-byte aligned.
+// Returns the metadata length as recorded in the footer blocks.
+static int32_t ArrowPutMessage(FILE *Out, FBBuilder *B, bool *Ok)
+{
+	const uint32_t Continuation = 0xFFFFFFFF;
+	int32_t MetaLen;
+
+	FBPadTo(B, 8, 0);
+	MetaLen = B->Buf.Len;
+
+	*Ok &= !B->Failed;
+	*Ok &= (fwrite(&Continuation, sizeof(uint32_t), 1, Out) == 1);
+	*Ok &= (fwrite(&MetaLen, sizeof(int32_t), 1, Out) == 1);
+	*Ok &= (fwrite(B->Buf.Data, 1, MetaLen, Out) == (size_t)MetaLen);
+
+	return(MetaLen + 8);
+}
+
+static inline uint64_t ArrowAlign(uint64_t Len)
+{
+	return((Len + ARROW_BODY_ALIGN - 1) & ~((uint64_t)ARROW_BODY_ALIGN - 1));
+}
+
+bool WriteArrowIPCFile(const VOIExport *Export, const char *FileName)
+{
+	static const uint8_t Zeroes[ARROW_BODY_ALIGN] = { 0 };
+	uint64_t Buffers[VOIEXPORT_COL_MAX * 3][2], Nodes[VOIEXPORT_COL_MAX][2];
+	uint64_t BodyLen = 0, BatchOffset;
+	uint32_t BufferCount = 0;
+	int32_t BatchMetaLen, FooterLen;
+	FBBuilder B = { { 0 }, false };
+	uint8_t Block[24] = { 0 };
+	bool Ok = true;
+	FILE *Out;
+
+	// Body layout: per column a zero-length validity bitmap (there
+	// are no nulls), then the values or offsets, then the heap.
+	for(int i = 0; i < VOIEXPORT_COL_MAX; ++i)
+	{
+		const VOIExportColumn *Column = Export->Columns + i;
+
+		Nodes[i][0] = Export->RowCount;
+		Nodes[i][1] = 0;
+
+		Buffers[BufferCount][0] = BodyLen;
+		Buffers[BufferCount++][1] = 0;
+
+		Buffers[BufferCount][0] = BodyLen;
+		Buffers[BufferCount++][1] = Column->Values.Len;
+		BodyLen = ArrowAlign(BodyLen + Column->Values.Len);
+
+		if(Column->Kind != VOIEXPORT_KIND_UINT)
+		{
+			Buffers[BufferCount][0] = BodyLen;
+			Buffers[BufferCount++][1] = Column->Heap.Len;
+			BodyLen = ArrowAlign(BodyLen + Column->Heap.Len);
+		}
+	}
+
+	if(!(Out = fopen(FileName, "wb")))
+	{
+		printf("Unable to open %s for writing.\n", FileName);
+		return(false);
+	}
+
+	Ok &= (fwrite("ARROW1\0\0", 1, 8, Out) == 8);
+
+	// Schema message
+	FBPatch(&B, ArrowWriteMessage(&B, ARROW_HEADER_SCHEMA, 0), ArrowWriteSchema(&B, Export));
+	ArrowPutMessage(Out, &B, &Ok);
+
+	// Record batch message, followed by its body
+	BatchOffset = ftell(Out);
+	B.Buf.Len = 0;
+
+	{
+		size_t HeaderPos = ArrowWriteMessage(&B, ARROW_HEADER_RECORDBATCH, BodyLen);
+		FBField Batch[] =
+		{
+			{ .Slot = 0, .Size = 8, .IsOffset = false, .Value = Export->RowCount },	// length
+			{ .Slot = 1, .Size = 4, .IsOffset = true, .Value = 0 },					// nodes
+			{ .Slot = 2, .Size = 4, .IsOffset = true, .Value = 0 }					// buffers
+		};
+
+		FBPatch(&B, HeaderPos, FBTable(&B, Batch, 3));
+		FBPatch(&B, Batch[1].Pos, FBVector(&B, VOIEXPORT_COL_MAX, 8, Nodes, sizeof(Nodes[0])));
+		FBPatch(&B, Batch[2].Pos, FBVector(&B, BufferCount, 8, Buffers, sizeof(Buffers[0])));
+	}
+
+	BatchMetaLen = ArrowPutMessage(Out, &B, &Ok);
+
+	for(int i = 0; Ok && (i < VOIEXPORT_COL_MAX); ++i)
+	{
+		const VOIExportColumn *Column = Export->Columns + i;
+		const VOIExportBuf *Bufs[2] = { &Column->Values, &Column->Heap };
+
+		for(int k = 0; k < ((Column->Kind != VOIEXPORT_KIND_UINT) ? 2 : 1); ++k)
+		{
+			uint64_t PadLen = ArrowAlign(Bufs[k]->Len) - Bufs[k]->Len;
+
+			Ok &= (fwrite(Bufs[k]->Data, 1, Bufs[k]->Len, Out) == Bufs[k]->Len);
+			Ok &= (fwrite(Zeroes, 1, PadLen, Out) == PadLen);
+		}
+	}
+
+	// End-of-stream marker, then the footer
+	Ok &= (fwrite("\xFF\xFF\xFF\xFF\0\0\0\0", 1, 8, Out) == 8);
+
+	B.Buf.Len = 0;
+	FBPut(&B, &(uint32_t){ 0 }, sizeof(uint32_t));
+
+	{
+		FBField Footer[] =
+		{
+			{ .Slot = 0, .Size = 2, .IsOffset = false, .Value = ARROW_METADATA_V5 },	// version
+			{ .Slot = 1, .Size = 4, .IsOffset = true, .Value = 0 },						// schema
+			{ .Slot = 3, .Size = 4, .IsOffset = true, .Value = 0 }						// recordBatches
+		};
+
+		FBPatch(&B, 0, FBTable(&B, Footer, 3));
+		FBPatch(&B, Footer[1].Pos, ArrowWriteSchema(&B, Export));
+
+		memcpy(Block, &BatchOffset, sizeof(uint64_t));
+		memcpy(Block + 8, &BatchMetaLen, sizeof(int32_t));
+		memcpy(Block + 16, &BodyLen, sizeof(uint64_t));
+		FBPatch(&B, Footer[2].Pos, FBVector(&B, 1, 8, Block, sizeof(Block)));
+	}
+
+	FBPadTo(&B, 8, 0);
+	FooterLen = B.Buf.Len;
+
+	Ok &= !B.Failed;
+	Ok &= (fwrite(B.Buf.Data, 1, FooterLen, Out) == (size_t)FooterLen);
+	Ok &= (fwrite(&FooterLen, sizeof(int32_t), 1, Out) == 1);
+	Ok &= (fwrite("ARROW1", 1, 6, Out) == 6);
+
+	if(fclose(Out)) Ok = false;
+
+	free(B.Buf.Data);
+
+	if(!Ok) printf("Writing the Arrow file %s failed.\n", FileName);
+
+	return(Ok);
+}
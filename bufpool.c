@@ -0,0 +1,93 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "vbios-tables.h"
+#include "bufpool.h"
+
+// Idle buffers are linked through their first bytes.
+typedef struct VBIOSPoolLink_s
+{
+	struct VBIOSPoolLink_s *Next;
+} VBIOSPoolLink;
+
+// A budget of zero is no budget at all.
+void VBIOSBufPoolInit(VBIOSBufPool *Pool, size_t Budget)
+{
+	memset(Pool, 0x00, sizeof(VBIOSBufPool));
+	Pool->Budget = Budget;
+}
+
+static uint32_t VBIOSBufPoolClass(size_t Len)
+{
+	uint32_t Class = 0;
+	
+	while((Class < (VBIOS_BUFPOOL_CLASSES - 1)) && (Len > ((size_t)1 << (VBIOS_BUFPOOL_MIN_SHIFT + Class)))) Class++;
+	
+	return(Class);
+}
+
+// Frees one idle buffer, of any class, to make room for another.
+// The largest are given up first, since they free the most.
+static bool VBIOSBufPoolTrim(VBIOSBufPool *Pool)
+{
+	for(int32_t Class = VBIOS_BUFPOOL_CLASSES - 1; Class >= 0; --Class)
+	{
+		VBIOSPoolLink *Link = (VBIOSPoolLink *)Pool->FreeLists[Class];
+		
+		if(!Link) continue;
+		
+		Pool->FreeLists[Class] = Link->Next;
+		Pool->Allocated -= (size_t)1 << (VBIOS_BUFPOOL_MIN_SHIFT + Class);
+		free(Link);
+		return(true);
+	}
+	
+	return(false);
+}
+
+// Returns a buffer of at least Len bytes (and at most
+// AMD_VBIOS_MAX_SIZE), and its actual size in BufLen, or NULL if
+// there is no room for it in the budget, or no memory.
+uint8_t *VBIOSBufPoolGet(VBIOSBufPool *Pool, size_t Len, size_t *BufLen)
+{
+	uint32_t Class = VBIOSBufPoolClass(Len);
+	size_t ClassLen = (size_t)1 << (VBIOS_BUFPOOL_MIN_SHIFT + Class);
+	uint8_t *Buf;
+	
+	*BufLen = ClassLen;
+	
+	if(Pool->FreeLists[Class])
+	{
+		VBIOSPoolLink *Link = (VBIOSPoolLink *)Pool->FreeLists[Class];
+		
+		Pool->FreeLists[Class] = Link->Next;
+		return((uint8_t *)Link);
+	}
+	
+	while(Pool->Budget && ((Pool->Allocated + ClassLen) > Pool->Budget))
+	{
+		if(!VBIOSBufPoolTrim(Pool)) return(NULL);
+	}
+	
+	if(!(Buf = (uint8_t *)malloc(ClassLen))) return(NULL);
+	
+	Pool->Allocated += ClassLen;
+	return(Buf);
+}
+
+void VBIOSBufPoolPut(VBIOSBufPool *Pool, uint8_t *Buf, size_t BufLen)
+{
+	uint32_t Class = VBIOSBufPoolClass(BufLen);
+	VBIOSPoolLink *Link = (VBIOSPoolLink *)Buf;
+	
+	Link->Next = (VBIOSPoolLink *)Pool->FreeLists[Class];
+	Pool->FreeLists[Class] = Link;
+}
+
+// Every buffer must have been put back first.
+void VBIOSBufPoolFree(VBIOSBufPool *Pool)
+{
+	while(VBIOSBufPoolTrim(Pool));
+}
@@ -0,0 +1,35 @@
+// Copyright 2022 Wolf9466/Wolf0/OhGodAPet
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// A pool of image buffers for bulk runs, so that processing many
+// ROMs does not cost an allocation (and the page faults of a fresh
+// mapping) per ROM. Buffers come in power-of-two size classes from
+// 64 KB up to AMD_VBIOS_MAX_SIZE, and a ROM is given the smallest
+// that holds it; released buffers are kept on a free list per
+// class for the next ROM of that size.
+//
+// Everything the pool holds - in use or kept for reuse - counts
+// against its budget. When a buffer cannot be had within it, idle
+// buffers of other classes are freed to make room, and failing
+// that, VBIOSBufPoolGet returns NULL; the caller is expected to
+// wait for a buffer to be released rather than allocate anyway.
+
+#define VBIOS_BUFPOOL_MIN_SHIFT			16
+#define VBIOS_BUFPOOL_CLASSES			6
+
+typedef struct
+{
+	size_t Budget;
+	size_t Allocated;
+	void *FreeLists[VBIOS_BUFPOOL_CLASSES];
+} VBIOSBufPool;
+
+void VBIOSBufPoolInit(VBIOSBufPool *Pool, size_t Budget);
+uint8_t *VBIOSBufPoolGet(VBIOSBufPool *Pool, size_t Len, size_t *BufLen);
+void VBIOSBufPoolPut(VBIOSBufPool *Pool, uint8_t *Buf, size_t BufLen);
+void VBIOSBufPoolFree(VBIOSBufPool *Pool);
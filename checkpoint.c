@@ -0,0 +1,304 @@
+#include <stdio.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <sys/types.h>
+
+#include "vbios-tables.h"
+#include "wolfvoitool.h"
+#include "sha256.h"
+#include "checkpoint.h"
+
+static bool CheckpointParseHash(uint8_t *Hash, const char *Hex)
+{
+	for(int i = 0; i < SHA256_DIGEST_LEN; ++i)
+	{
+		unsigned int Byte;
+		
+		if(sscanf(Hex + (i << 1), "%2x", &Byte) != 1) return(false);
+		Hash[i] = Byte;
+	}
+	
+	return(true);
+}
+
+static void CheckpointPrintHash(FILE *File, const uint8_t *Hash)
+{
+	for(int i = 0; i < SHA256_DIGEST_LEN; ++i) fprintf(File, "%02x", Hash[i]);
+}
+
+// Orders entries by path, and those of the same path oldest first.
+static int CompareCheckpointEntries(const void *A, const void *B)
+{
+	const CheckpointEntry *EntA = (const CheckpointEntry *)A, *EntB = (const CheckpointEntry *)B;
+	int Diff = strcmp(EntA->Path, EntB->Path);
+	
+	if(Diff) return(Diff);
+	return((EntA->Seq > EntB->Seq) - (EntA->Seq < EntB->Seq));
+}
+
+// Reads what an earlier run recorded, if anything. A last line cut
+// short by a crash is ignored.
+static bool CheckpointLoad(Checkpoint *CP, FILE *InFile, const char *FileName, bool *EndsClean)
+{
+	char *Line = NULL, InHex[65], OutHex[65], State;
+	size_t LineCap = 0;
+	ssize_t LineLen;
+	uint32_t Seq = 0, Cap = 0, Kept = 0;
+	int PathStart;
+	bool Ok = true;
+	
+	*EndsClean = true;
+	
+	while(Ok && ((LineLen = getline(&Line, &LineCap, InFile)) >= 0))
+	{
+		CheckpointEntry *Ent;
+		
+		if(!(*EndsClean = (LineLen && (Line[LineLen - 1] == '\n')))) break;
+		
+		Line[--LineLen] = 0x00;
+		
+		if(!Seq++)
+		{
+			int Version;
+			
+			if((sscanf(Line, CHECKPOINT_MAGIC " %d", &Version) != 1) || (Version != CHECKPOINT_VERSION))
+			{
+				printf("%s is not a checkpoint journal this version can read.\n", FileName);
+				Ok = false;
+			}
+			
+			continue;
+		}
+		
+		PathStart = 0;
+		
+		if((sscanf(Line, "%c %64s %64s %n", &State, InHex, OutHex, &PathStart) != 3) || !PathStart || !Line[PathStart] || ((State != CHECKPOINT_STATE_WRITING) && (State != CHECKPOINT_STATE_DONE)))
+		{
+			printf("Line %u of %s is malformed, ignoring it.\n", Seq, FileName);
+			continue;
+		}
+		
+		if(CP->EntryCount == Cap)
+		{
+			CheckpointEntry *NewEntries = (CheckpointEntry *)realloc(CP->Entries, sizeof(CheckpointEntry) * ((Cap) ? (Cap << 1) : 256));
+			
+			if(!NewEntries)
+			{
+				printf("Out of memory.\n");
+				Ok = false;
+				break;
+			}
+			
+			CP->Entries = NewEntries;
+			Cap = (Cap) ? (Cap << 1) : 256;
+		}
+		
+		Ent = CP->Entries + CP->EntryCount;
+		Ent->State = State;
+		Ent->Seq = Seq;
+		
+		if(!CheckpointParseHash(Ent->InHash, InHex) || !CheckpointParseHash(Ent->OutHash, OutHex))
+		{
+			printf("Line %u of %s is malformed, ignoring it.\n", Seq, FileName);
+			continue;
+		}
+		
+		if(!(Ent->Path = strdup(Line + PathStart)))
+		{
+			printf("Out of memory.\n");
+			Ok = false;
+			break;
+		}
+		
+		CP->EntryCount++;
+	}
+	
+	free(Line);
+	
+	if(!Ok) return(false);
+	
+	// Only the last record of each ROM matters.
+	qsort(CP->Entries, CP->EntryCount, sizeof(CheckpointEntry), CompareCheckpointEntries);
+	
+	for(uint32_t i = 0; i < CP->EntryCount; ++i)
+	{
+		if(((i + 1) < CP->EntryCount) && !strcmp(CP->Entries[i].Path, CP->Entries[i + 1].Path)) free(CP->Entries[i].Path);
+		else CP->Entries[Kept++] = CP->Entries[i];
+	}
+	
+	CP->EntryCount = Kept;
+	return(true);
+}
+
+// Opens the journal for appending, after reading whatever is in it
+// from an earlier run; a journal that does not exist is started.
+bool CheckpointOpen(Checkpoint *CP, const char *FileName)
+{
+	FILE *InFile = fopen(FileName, "r");
+	bool EndsClean = true;
+	
+	memset(CP, 0x00, sizeof(Checkpoint));
+	
+	if(InFile)
+	{
+		bool Ok = CheckpointLoad(CP, InFile, FileName, &EndsClean);
+		
+		fclose(InFile);
+		
+		if(!Ok)
+		{
+			CheckpointClose(CP);
+			return(false);
+		}
+	}
+	else if(errno != ENOENT)
+	{
+		printf("Unable to open %s (%s).\n", FileName, strerror(errno));
+		return(false);
+	}
+	
+	if(!(CP->File = fopen(FileName, "a")))
+	{
+		printf("Unable to open %s for writing (%s).\n", FileName, strerror(errno));
+		CheckpointClose(CP);
+		return(false);
+	}
+	
+	// A new journal needs its header; one cut short needs its
+	// partial last line ended, so the next record starts afresh.
+	fseek(CP->File, 0, SEEK_END);
+	
+	if(!ftell(CP->File)) fprintf(CP->File, "%s %d\n", CHECKPOINT_MAGIC, CHECKPOINT_VERSION);
+	else if(!EndsClean) fputc('\n', CP->File);
+	
+	fflush(CP->File);
+	return(true);
+}
+
+static const CheckpointEntry *CheckpointFind(const Checkpoint *CP, const char *Path)
+{
+	uint32_t Lo = 0, Hi = CP->EntryCount;
+	
+	while(Lo < Hi)
+	{
+		uint32_t Mid = (Lo + Hi) >> 1;
+		int Diff = strcmp(Path, CP->Entries[Mid].Path);
+		
+		if(!Diff) return(CP->Entries + Mid);
+		
+		if(Diff < 0) Hi = Mid;
+		else Lo = Mid + 1;
+	}
+	
+	return(NULL);
+}
+
+// Drops every ROM an earlier run finished from the list, keeping
+// the order of the rest, after checking again any it may or may not
+// have finished writing.
+bool CheckpointFilter(Checkpoint *CP, char **ROMFiles, uint32_t *ROMFileCount)
+{
+	uint32_t Kept = 0, Skipped = 0, Checked = 0;
+	uint8_t *VBIOSImg = NULL;
+	
+	for(uint32_t r = 0; r < *ROMFileCount; ++r)
+	{
+		const CheckpointEntry *Ent = CheckpointFind(CP, ROMFiles[r]);
+		bool Done = false;
+		
+		if(Ent && (Ent->State == CHECKPOINT_STATE_DONE)) Done = true;
+		else if(Ent)
+		{
+			uint8_t Hash[SHA256_DIGEST_LEN];
+			size_t VBIOSSize;
+			
+			if(!VBIOSImg && !(VBIOSImg = (uint8_t *)malloc(AMD_VBIOS_MAX_SIZE)))
+			{
+				printf("Out of memory.\n");
+				return(false);
+			}
+			
+			Checked++;
+			
+			if((VBIOSSize = ReadVBIOSFile(VBIOSImg, ROMFiles[r], AMD_VBIOS_MAX_SIZE)))
+			{
+				SHA256(Hash, VBIOSImg, VBIOSSize);
+				
+				if(!memcmp(Hash, Ent->OutHash, SHA256_DIGEST_LEN))
+				{
+					Done = true;
+					CheckpointDone(CP, ROMFiles[r], Ent->InHash, Ent->OutHash);
+				}
+			}
+		}
+		
+		if(Done)
+		{
+			free(ROMFiles[r]);
+			Skipped++;
+		}
+		else ROMFiles[Kept++] = ROMFiles[r];
+	}
+	
+	free(VBIOSImg);
+	
+	if(Skipped || Checked) fprintf(stderr, "Skipping %u ROMs finished by an earlier run; %u had to be checked again.\n", Skipped, Checked);
+	
+	*ROMFileCount = Kept;
+	return(true);
+}
+
+static bool CheckpointRecord(Checkpoint *CP, char State, const char *Path, const uint8_t *InHash, const uint8_t *OutHash)
+{
+	fprintf(CP->File, "%c ", State);
+	CheckpointPrintHash(CP->File, InHash);
+	fputc(' ', CP->File);
+	CheckpointPrintHash(CP->File, OutHash);
+	fprintf(CP->File, " %s\n", Path);
+	
+	return(!fflush(CP->File));
+}
+
+// Must be called, and succeed, before the ROM is written.
+bool CheckpointWriteAhead(Checkpoint *CP, const char *Path, const uint8_t *InHash, const uint8_t *OutHash)
+{
+	if(!CheckpointRecord(CP, CHECKPOINT_STATE_WRITING, Path, InHash, OutHash) || fsync(fileno(CP->File)))
+	{
+		printf("Writing the checkpoint journal failed.\n");
+		return(false);
+	}
+	
+	return(true);
+}
+
+bool CheckpointDone(Checkpoint *CP, const char *Path, const uint8_t *InHash, const uint8_t *OutHash)
+{
+	if(!CheckpointRecord(CP, CHECKPOINT_STATE_DONE, Path, InHash, OutHash))
+	{
+		printf("Writing the checkpoint journal failed.\n");
+		return(false);
+	}
+	
+	return(true);
+}
+
+bool CheckpointClose(Checkpoint *CP)
+{
+	bool Ok = true;
+	
+	if(CP->File)
+	{
+		Ok = !fflush(CP->File) && !fsync(fileno(CP->File));
+		Ok = !fclose(CP->File) && Ok;
+	}
+	
+	for(uint32_t i = 0; i < CP->EntryCount; ++i) free(CP->Entries[i].Path);
+	
+	free(CP->Entries);
+	memset(CP, 0x00, sizeof(Checkpoint));
+	return(Ok);
+}
@@ -0,0 +1,59 @@
+// Copyright 2022 Wolf9466/Wolf0/OhGodAPet
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "sha256.h"
+
+// A checkpoint journal, so a bulk run that dies part way through
+// can be restarted without redoing what it had finished. It is an
+// append-only text file, one record per line:
+//
+//	wolfvoitool-checkpoint 1
+//	W <input SHA-256> <output SHA-256> <path>
+//	D <input SHA-256> <output SHA-256> <path>
+//
+// W is written ahead of writing a ROM back, and synced to disk
+// before the write starts; D is written once a ROM is finished
+// with (its write, if any, complete), and is not synced, since a
+// lost D only means the ROM is checked again. For a ROM that was
+// not changed, both hashes are the same.
+//
+// A restarted run skips every ROM with a D record, without reading
+// it. A ROM whose last record is a W is uncertain - the run died
+// around its write - and is hashed again: if it now matches the
+// output hash, the write made it and the ROM is done; otherwise it
+// is processed again, which is safe since writes are atomic (and
+// patches check what they are applied to.) Only the last record of
+// each ROM counts.
+
+#define CHECKPOINT_MAGIC				"wolfvoitool-checkpoint"
+#define CHECKPOINT_VERSION				1
+
+#define CHECKPOINT_STATE_WRITING		'W'
+#define CHECKPOINT_STATE_DONE			'D'
+
+typedef struct
+{
+	char *Path;
+	char State;
+	uint32_t Seq;
+	uint8_t InHash[SHA256_DIGEST_LEN];
+	uint8_t OutHash[SHA256_DIGEST_LEN];
+} CheckpointEntry;
+
+typedef struct
+{
+	FILE *File;
+	uint32_t EntryCount;
+	CheckpointEntry *Entries;
+} Checkpoint;
+
+bool CheckpointOpen(Checkpoint *CP, const char *FileName);
+bool CheckpointFilter(Checkpoint *CP, char **ROMFiles, uint32_t *ROMFileCount);
+bool CheckpointWriteAhead(Checkpoint *CP, const char *Path, const uint8_t *InHash, const uint8_t *OutHash);
+bool CheckpointDone(Checkpoint *CP, const char *Path, const uint8_t *InHash, const uint8_t *OutHash);
+bool CheckpointClose(Checkpoint *CP);
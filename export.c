@@ -0,0 +1,247 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "voi.h"
+#include "export.h"
+
+#define VOIEXPORT_HDR_COL_SCHEMA(CType, Name, JSONKey, TextFormat, TextArgs, RawValue)	{ JSONKey,	VOIEXPORT_KIND_UINT,	sizeof(CType) },
+#define VOIEXPORT_HDR_PAD_SKIP(CType, Name, Count)
+#define VOIEXPORT_MODE_COL_SCHEMA(Mode, Member, StructName, Fields, DataKind, DataFits)	Fields(VOIEXPORT_HDR_COL_SCHEMA, VOIEXPORT_HDR_PAD_SKIP)
+
+static const struct
+{
+	const char *Name;
+	uint8_t Kind;
+	uint8_t Width;
+} VOIExportSchema[VOIEXPORT_COL_MAX] =
+{
+	{ "rom",			VOIEXPORT_KIND_UTF8,	4 },
+	{ "rom_index",		VOIEXPORT_KIND_UINT,	4 },
+	{ "vo_index",		VOIEXPORT_KIND_UINT,	2 },
+	{ "vo_type",		VOIEXPORT_KIND_UINT,	1 },
+	{ "vo_mode",		VOIEXPORT_KIND_UINT,	1 },
+	{ "vo_size",		VOIEXPORT_KIND_UINT,	2 },
+	VO_MODE_HDR_LIST(VOIEXPORT_MODE_COL_SCHEMA)
+	{ "payload",		VOIEXPORT_KIND_BINARY,	4 }
+};
+
+bool VOIExportBufPut(VOIExportBuf *Buf, const void *Src, size_t Len)
+{
+	if((Buf->Len + Len) > Buf->Cap)
+	{
+		size_t NewCap = (Buf->Cap ? Buf->Cap : 4096);
+		uint8_t *NewData;
+
+		while(NewCap < (Buf->Len + Len)) NewCap <<= 1;
+
+		if(!(NewData = (uint8_t *)realloc(Buf->Data, NewCap))) return(false);
+
+		Buf->Data = NewData;
+		Buf->Cap = NewCap;
+	}
+
+	memcpy(Buf->Data + Buf->Len, Src, Len);
+	Buf->Len += Len;
+
+	return(true);
+}
+
+// Appends a fixed-width value to a column. Values are stored in
+// host byte order, which (like the VBIOS itself) is little-endian.
+static inline bool ExportPutUInt(VOIExport *Export, uint8_t Col, uint32_t Value)
+{
+	return(VOIExportBufPut(&Export->Columns[Col].Values, &Value, Export->Columns[Col].Width));
+}
+
+// Appends a variable-length value to a column, and records the
+// new end of its heap as the next offset.
+static inline bool ExportPutBytes(VOIExport *Export, uint8_t Col, const void *Src, uint32_t Len)
+{
+	VOIExportColumn *Column = Export->Columns + Col;
+	uint32_t End = Column->Heap.Len + Len;
+
+	return(VOIExportBufPut(&Column->Heap, Src, Len) && VOIExportBufPut(&Column->Values, &End, sizeof(uint32_t)));
+}
+
+bool VOIExportInit(VOIExport *Export)
+{
+	const uint32_t Zero = 0;
+
+	memset(Export, 0x00, sizeof(VOIExport));
+
+	for(int i = 0; i < VOIEXPORT_COL_MAX; ++i)
+	{
+		Export->Columns[i].Name = VOIExportSchema[i].Name;
+		Export->Columns[i].Kind = VOIExportSchema[i].Kind;
+		Export->Columns[i].Width = VOIExportSchema[i].Width;
+
+		// Offsets for variable-length columns begin with zero
+		if(Export->Columns[i].Kind != VOIEXPORT_KIND_UINT)
+			if(!VOIExportBufPut(&Export->Columns[i].Values, &Zero, sizeof(uint32_t))) return(false);
+	}
+
+	return(true);
+}
+
+// Per-mode mode header columns, generated from the mode header fields
+// in voschema.h. Every mode's columns get a value in every row; those
+// of modes other than the VO's own are zero.
+
+#define VOIEXPORT_PUT_FIELD(CType, Name, JSONKey, TextFormat, TextArgs, RawValue) \
+	Ok &= ExportPutUInt(Export, VOIEXPORT_COL_HDR_##Name, (IsMode) ? (uint32_t)RawValue(Hdr->Name) : 0);
+
+#define VOIEXPORT_MODE_PUT(Mode, Member, StructName, Fields, DataKind, DataFits) \
+static bool ExportPutHdr_##Mode(VOIExport *Export, const VoltageObject *VO) \
+{ \
+	const StructName *Hdr = &VO->Member; \
+	const bool IsMode = (VO->VOMode == VOLTAGE_MODE_##Mode); \
+	bool Ok = true; \
+	Fields(VOIEXPORT_PUT_FIELD, VOIEXPORT_HDR_PAD_SKIP) \
+	return(Ok); \
+}
+
+VO_MODE_HDR_LIST(VOIEXPORT_MODE_PUT)
+
+#define VOIEXPORT_MODE_PUT_CALL(Mode, Member, StructName, Fields, DataKind, DataFits) \
+	Ok &= ExportPutHdr_##Mode(Export, VO);
+
+static bool VOIExportVisit(VoltageObject *VO, uint8_t *VOData, uint32_t VODataLen, uint16_t Index, void *Ctx)
+{
+	VOIExport *Export = (VOIExport *)Ctx;
+	bool Ok = true;
+
+	Ok &= ExportPutBytes(Export, VOIEXPORT_COL_ROM, Export->CurROMName, strlen(Export->CurROMName));
+	Ok &= ExportPutUInt(Export, VOIEXPORT_COL_ROM_INDEX, Export->ROMCount);
+	Ok &= ExportPutUInt(Export, VOIEXPORT_COL_VO_INDEX, Index);
+	Ok &= ExportPutUInt(Export, VOIEXPORT_COL_VO_TYPE, VO->VOType);
+	Ok &= ExportPutUInt(Export, VOIEXPORT_COL_VO_MODE, VO->VOMode);
+	Ok &= ExportPutUInt(Export, VOIEXPORT_COL_VO_SIZE, VO->VOSize);
+	VO_MODE_HDR_LIST(VOIEXPORT_MODE_PUT_CALL)
+	Ok &= ExportPutBytes(Export, VOIEXPORT_COL_PAYLOAD, VOData, VODataLen);
+
+	Export->RowCount++;
+
+	return(Ok);
+}
+
+// Appends every VO in the VOI table at VOITableBase that matches
+// Filter as a row, straight from the table walk. Returns the
+// number of rows added, or -1 if the table was malformed (in
+// which case nothing was added) or we ran out of memory part
+// way through, which callers should treat as fatal.
+int32_t VOIExportAddROM(VOIExport *Export, const char *ROMName, uint8_t *VOITableBase, const VOFilter *Filter)
+{
+	int32_t Rows;
+
+	// Validate the whole table first, so a bad ROM in a batch
+	// cannot leave half of its rows behind.
+	if(WalkVOTable(VOITableBase, 0xFF, NULL, NULL, NULL) < 0) return(-1);
+
+	Export->CurROMName = ROMName;
+	Rows = WalkVOTable(VOITableBase, 0xFF, Filter, VOIExportVisit, Export);
+	Export->CurROMName = NULL;
+
+	if(Rows >= 0) Export->ROMCount++;
+
+	return(Rows);
+}
+
+static bool ExportWritePadding(FILE *Out, uint64_t *Pos)
+{
+	static const uint8_t Zeroes[VOIEXPORT_ALIGN] = { 0 };
+	uint64_t PadLen = (VOIEXPORT_ALIGN - (*Pos & (VOIEXPORT_ALIGN - 1))) & (VOIEXPORT_ALIGN - 1);
+
+	*Pos += PadLen;
+	return(fwrite(Zeroes, 1, PadLen, Out) == PadLen);
+}
+
+static bool WriteNativeExportFile(const VOIExport *Export, const char *FileName)
+{
+	VOIExportColumnDesc Descs[VOIEXPORT_COL_MAX];
+	uint32_t Header[2] = { VOIEXPORT_COL_MAX, 0 };
+	uint64_t Pos;
+	bool Ok = true;
+	FILE *Out;
+
+	// Lay the buffers out first, so the descriptors can be
+	// written ahead of them in a single pass.
+	Pos = 8 + sizeof(Header) + sizeof(uint64_t) + sizeof(Descs);
+
+	for(int i = 0; i < VOIEXPORT_COL_MAX; ++i)
+	{
+		const VOIExportColumn *Column = Export->Columns + i;
+
+		memset(Descs + i, 0x00, sizeof(VOIExportColumnDesc));
+		strncpy(Descs[i].Name, Column->Name, sizeof(Descs[i].Name) - 1);
+		Descs[i].Kind = Column->Kind;
+		Descs[i].Width = Column->Width;
+
+		Pos = (Pos + VOIEXPORT_ALIGN - 1) & ~((uint64_t)VOIEXPORT_ALIGN - 1);
+		Descs[i].DataOffset = Pos;
+		Descs[i].DataLen = Column->Values.Len;
+		Pos += Column->Values.Len;
+
+		if(Column->Kind != VOIEXPORT_KIND_UINT)
+		{
+			Pos = (Pos + VOIEXPORT_ALIGN - 1) & ~((uint64_t)VOIEXPORT_ALIGN - 1);
+			Descs[i].HeapOffset = Pos;
+			Descs[i].HeapLen = Column->Heap.Len;
+			Pos += Column->Heap.Len;
+		}
+	}
+
+	if(!(Out = fopen(FileName, "wb")))
+	{
+		printf("Unable to open %s for writing.\n", FileName);
+		return(false);
+	}
+
+	Ok &= (fwrite(VOIEXPORT_MAGIC, 1, 8, Out) == 8);
+	Ok &= (fwrite(Header, sizeof(Header), 1, Out) == 1);
+	Ok &= (fwrite(&Export->RowCount, sizeof(uint64_t), 1, Out) == 1);
+	Ok &= (fwrite(Descs, sizeof(Descs), 1, Out) == 1);
+
+	Pos = 8 + sizeof(Header) + sizeof(uint64_t) + sizeof(Descs);
+
+	for(int i = 0; Ok && (i < VOIEXPORT_COL_MAX); ++i)
+	{
+		const VOIExportColumn *Column = Export->Columns + i;
+
+		Ok &= ExportWritePadding(Out, &Pos);
+		Ok &= (fwrite(Column->Values.Data, 1, Column->Values.Len, Out) == Column->Values.Len);
+		Pos += Column->Values.Len;
+
+		if(Column->Kind != VOIEXPORT_KIND_UINT)
+		{
+			Ok &= ExportWritePadding(Out, &Pos);
+			Ok &= (fwrite(Column->Heap.Data, 1, Column->Heap.Len, Out) == Column->Heap.Len);
+			Pos += Column->Heap.Len;
+		}
+	}
+
+	if(fclose(Out)) Ok = false;
+
+	if(!Ok) printf("Writing the export file %s failed.\n", FileName);
+
+	return(Ok);
+}
+
+bool VOIExportWrite(const VOIExport *Export, const char *FileName, uint8_t Format)
+{
+	if(Format == VOIEXPORT_FORMAT_ARROW) return(WriteArrowIPCFile(Export, FileName));
+	return(WriteNativeExportFile(Export, FileName));
+}
+
+void VOIExportFree(VOIExport *Export)
+{
+	for(int i = 0; i < VOIEXPORT_COL_MAX; ++i)
+	{
+		free(Export->Columns[i].Values.Data);
+		free(Export->Columns[i].Heap.Data);
+	}
+
+	memset(Export, 0x00, sizeof(VOIExport));
+}
@@ -0,0 +1,116 @@
+// Copyright 2022 Wolf9466/Wolf0/OhGodAPet
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "voi.h"
+
+// Columnar export of VOs from many ROMs at once. Every VO
+// becomes one row, with one column per VoltageObject field
+// (mode header fields that do not apply to a VO's mode are
+// zero), the ROM it came from, and its payload. Columns are
+// plain little-endian arrays, so a reader can map the file
+// and use them in place.
+//
+// Native file layout ("WVOICOL1"):
+//
+//	char Magic[8]			"WVOICOL1"
+//	uint32_t ColumnCount
+//	uint32_t Reserved
+//	uint64_t RowCount
+//	VOIExportColumnDesc[ColumnCount]
+//	column buffers, each starting on a 64-byte boundary
+//
+// Fixed-width columns have RowCount values of Width bytes in
+// their data buffer and no heap. Variable-length columns (the
+// payload and the ROM name) have RowCount + 1 uint32_t offsets
+// in their data buffer; row N occupies heap bytes Offsets[N]
+// through Offsets[N + 1]. This is the same layout Arrow uses for
+// its Binary and Utf8 arrays, so the buffers can equally be
+// written as an Arrow IPC file (see arrowipc.c).
+
+#define VOIEXPORT_MAGIC					"WVOICOL1"
+#define VOIEXPORT_ALIGN					64
+
+#define VOIEXPORT_KIND_UINT				0x00
+#define VOIEXPORT_KIND_BINARY			0x01
+#define VOIEXPORT_KIND_UTF8				0x02
+
+#define VOIEXPORT_FORMAT_NATIVE			0x00
+#define VOIEXPORT_FORMAT_ARROW			0x01
+
+// The mode header columns, one per field of every mode header in
+// voschema.h, come between the VO header columns and the payload,
+// named by the fields' JSON keys.
+#define VOIEXPORT_HDR_COL_ENUM(CType, Name, JSONKey, TextFormat, TextArgs, RawValue)	VOIEXPORT_COL_HDR_##Name,
+#define VOIEXPORT_HDR_PAD_ENUM(CType, Name, Count)
+#define VOIEXPORT_MODE_COL_ENUM(Mode, Member, StructName, Fields, DataKind, DataFits)	Fields(VOIEXPORT_HDR_COL_ENUM, VOIEXPORT_HDR_PAD_ENUM)
+
+typedef enum
+{
+	VOIEXPORT_COL_ROM,
+	VOIEXPORT_COL_ROM_INDEX,
+	VOIEXPORT_COL_VO_INDEX,
+	VOIEXPORT_COL_VO_TYPE,
+	VOIEXPORT_COL_VO_MODE,
+	VOIEXPORT_COL_VO_SIZE,
+	VO_MODE_HDR_LIST(VOIEXPORT_MODE_COL_ENUM)
+	VOIEXPORT_COL_PAYLOAD,
+	VOIEXPORT_COL_MAX
+} VOIExportColumnID;
+
+#undef VOIEXPORT_HDR_COL_ENUM
+#undef VOIEXPORT_HDR_PAD_ENUM
+#undef VOIEXPORT_MODE_COL_ENUM
+
+#pragma pack(push, 1)
+
+typedef struct
+{
+	char Name[24];
+	uint8_t Kind;
+	uint8_t Width;
+	uint8_t Reserved[6];
+	uint64_t DataOffset;
+	uint64_t DataLen;
+	uint64_t HeapOffset;
+	uint64_t HeapLen;
+} VOIExportColumnDesc;
+
+#pragma pack(pop)
+
+typedef struct
+{
+	uint8_t *Data;
+	size_t Len;
+	size_t Cap;
+} VOIExportBuf;
+
+typedef struct
+{
+	const char *Name;
+	uint8_t Kind;
+	uint8_t Width;
+	VOIExportBuf Values;
+	VOIExportBuf Heap;
+} VOIExportColumn;
+
+typedef struct
+{
+	uint64_t RowCount;
+	uint32_t ROMCount;
+	const char *CurROMName;
+	VOIExportColumn Columns[VOIEXPORT_COL_MAX];
+} VOIExport;
+
+bool VOIExportInit(VOIExport *Export);
+int32_t VOIExportAddROM(VOIExport *Export, const char *ROMName, uint8_t *VOITableBase, const VOFilter *Filter);
+bool VOIExportWrite(const VOIExport *Export, const char *FileName, uint8_t Format);
+void VOIExportFree(VOIExport *Export);
+
+// Shared with arrowipc.c
+bool VOIExportBufPut(VOIExportBuf *Buf, const void *Src, size_t Len);
+bool WriteArrowIPCFile(const VOIExport *Export, const char *FileName);
@@ -0,0 +1,338 @@
+#include <stdio.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdbool.h>
+
+#include "voi.h"
+#include "filter.h"
+
+static const char *VOFilterFieldNames[VOFILTER_FIELD_MAX] =
+{
+	"type",
+	"mode",
+	"size",
+	"datalen",
+	"regid",
+	"i2cline",
+	"i2caddr",
+	"ctrloffset",
+	"ctrlflag",
+	"offsettrim",
+	"llslopetrim"
+};
+
+// Depth counts the ! and ( the parser is inside of. Every ! emits an
+// instruction, and every ( holds at least a comparison, so no valid
+// expression nests deeper than the program may be long.
+typedef struct
+{
+	const char *Pos;
+	VOFilter *Out;
+	uint32_t Depth;
+} VOFilterParser;
+
+static void FilterSkipSpace(VOFilterParser *P)
+{
+	while(isspace((unsigned char)*P->Pos)) P->Pos++;
+}
+
+static bool FilterEmit(VOFilterParser *P, uint8_t Op, uint8_t Field, uint32_t Value)
+{
+	if(P->Out->InsnCount >= VOFILTER_MAX_INSNS)
+	{
+		printf("Filter expression is too long.\n");
+		return(false);
+	}
+
+	P->Out->Insns[P->Out->InsnCount].Op = Op;
+	P->Out->Insns[P->Out->InsnCount].Field = Field;
+	P->Out->Insns[P->Out->InsnCount].Value = Value;
+	P->Out->InsnCount++;
+
+	return(true);
+}
+
+// Reads an identifier or number token into Token, which must
+// have room for at least 64 bytes. Returns the token length.
+static size_t FilterReadToken(VOFilterParser *P, char *Token)
+{
+	size_t Len = 0;
+
+	FilterSkipSpace(P);
+
+	while((isalnum((unsigned char)*P->Pos) || (*P->Pos == '_')) && (Len < 63))
+		Token[Len++] = *P->Pos++;
+
+	Token[Len] = 0x00;
+	return(Len);
+}
+
+// Resolves a symbolic value against the name table for the
+// field on the left-hand side of the comparison. Only the
+// type and mode fields have names.
+static bool FilterResolveName(uint8_t Field, const char *Token, uint32_t *Value)
+{
+	uint8_t Tmp;
+
+	if((Field == VOFILTER_FIELD_TYPE) && VoltageTypeFromName(Token, &Tmp)) *Value = Tmp;
+	else if((Field == VOFILTER_FIELD_MODE) && VoltageModeFromName(Token, &Tmp)) *Value = Tmp;
+	else return(false);
+
+	return(true);
+}
+
+static bool FilterParseOr(VOFilterParser *P);
+
+static bool FilterParseCompare(VOFilterParser *P)
+{
+	char Token[64];
+	uint8_t Field, Op;
+	uint32_t Value;
+
+	if(!FilterReadToken(P, Token))
+	{
+		printf("Filter: expected a field name at \"%s\".\n", P->Pos);
+		return(false);
+	}
+
+	for(Field = 0; Field < VOFILTER_FIELD_MAX; ++Field)
+		if(!strcasecmp(VOFilterFieldNames[Field], Token)) break;
+
+	if(Field == VOFILTER_FIELD_MAX)
+	{
+		printf("Filter: unknown field \"%s\".\n", Token);
+		return(false);
+	}
+
+	FilterSkipSpace(P);
+
+	if(!strncmp(P->Pos, "==", 2)) Op = VOFILTER_OP_EQ, P->Pos += 2;
+	else if(!strncmp(P->Pos, "!=", 2)) Op = VOFILTER_OP_NE, P->Pos += 2;
+	else if(!strncmp(P->Pos, "<=", 2)) Op = VOFILTER_OP_LE, P->Pos += 2;
+	else if(!strncmp(P->Pos, ">=", 2)) Op = VOFILTER_OP_GE, P->Pos += 2;
+	else if(*P->Pos == '<') Op = VOFILTER_OP_LT, P->Pos++;
+	else if(*P->Pos == '>') Op = VOFILTER_OP_GT, P->Pos++;
+	else
+	{
+		printf("Filter: expected a comparison after \"%s\".\n", Token);
+		return(false);
+	}
+
+	if(!FilterReadToken(P, Token))
+	{
+		printf("Filter: expected a value at \"%s\".\n", P->Pos);
+		return(false);
+	}
+
+	if(isdigit((unsigned char)Token[0]))
+	{
+		char *End;
+
+		Value = strtoul(Token, &End, 0);
+
+		if(*End)
+		{
+			printf("Filter: invalid number \"%s\".\n", Token);
+			return(false);
+		}
+	}
+	else if(!FilterResolveName(Field, Token, &Value))
+	{
+		printf("Filter: unknown value \"%s\" for field \"%s\".\n", Token, VOFilterFieldNames[Field]);
+		return(false);
+	}
+
+	return(FilterEmit(P, Op, Field, Value));
+}
+
+// Enters a ! or (, unless that would nest too deeply.
+static bool FilterEnter(VOFilterParser *P)
+{
+	if(P->Depth >= VOFILTER_MAX_INSNS)
+	{
+		printf("Filter expression is nested too deeply.\n");
+		return(false);
+	}
+
+	P->Depth++;
+	return(true);
+}
+
+static bool FilterParseUnary(VOFilterParser *P)
+{
+	bool Ret;
+
+	FilterSkipSpace(P);
+
+	if((*P->Pos == '!') && (P->Pos[1] != '='))
+	{
+		P->Pos++;
+		if(!FilterEnter(P)) return(false);
+
+		Ret = FilterParseUnary(P);
+		P->Depth--;
+
+		if(!Ret) return(false);
+		return(FilterEmit(P, VOFILTER_OP_NOT, 0, 0));
+	}
+
+	if(*P->Pos == '(')
+	{
+		P->Pos++;
+		if(!FilterEnter(P)) return(false);
+
+		Ret = FilterParseOr(P);
+		P->Depth--;
+
+		if(!Ret) return(false);
+
+		FilterSkipSpace(P);
+
+		if(*P->Pos != ')')
+		{
+			printf("Filter: missing ')'.\n");
+			return(false);
+		}
+
+		P->Pos++;
+		return(true);
+	}
+
+	return(FilterParseCompare(P));
+}
+
+static bool FilterParseAnd(VOFilterParser *P)
+{
+	if(!FilterParseUnary(P)) return(false);
+
+	for(FilterSkipSpace(P); !strncmp(P->Pos, "&&", 2); FilterSkipSpace(P))
+	{
+		P->Pos += 2;
+		if(!FilterParseUnary(P)) return(false);
+		if(!FilterEmit(P, VOFILTER_OP_AND, 0, 0)) return(false);
+	}
+
+	return(true);
+}
+
+static bool FilterParseOr(VOFilterParser *P)
+{
+	if(!FilterParseAnd(P)) return(false);
+
+	for(FilterSkipSpace(P); !strncmp(P->Pos, "||", 2); FilterSkipSpace(P))
+	{
+		P->Pos += 2;
+		if(!FilterParseAnd(P)) return(false);
+		if(!FilterEmit(P, VOFILTER_OP_OR, 0, 0)) return(false);
+	}
+
+	return(true);
+}
+
+// Compiles the expression in Expr into Filter. Returns false
+// (after printing the reason) if the expression is malformed.
+bool CompileVOFilter(VOFilter *Filter, const char *Expr)
+{
+	VOFilterParser P = { Expr, Filter, 0 };
+
+	Filter->InsnCount = 0;
+
+	if(!FilterParseOr(&P)) return(false);
+
+	FilterSkipSpace(&P);
+
+	if(*P.Pos)
+	{
+		printf("Filter: unexpected \"%s\".\n", P.Pos);
+		return(false);
+	}
+
+	return(true);
+}
+
+// Fetches a field from the VO header. Returns false if the
+// field does not exist for the mode of this VO.
+static inline bool VOFilterLoadField(const VoltageObject *VO, uint8_t Field, uint32_t *Value)
+{
+	switch(Field)
+	{
+		case VOFILTER_FIELD_TYPE: *Value = VO->VOType; return(true);
+		case VOFILTER_FIELD_MODE: *Value = VO->VOMode; return(true);
+		case VOFILTER_FIELD_SIZE: *Value = VO->VOSize; return(true);
+		case VOFILTER_FIELD_DATALEN: *Value = ((VO->VOSize > sizeof(VoltageObject)) ? (VO->VOSize - sizeof(VoltageObject)) : 0); return(true);
+		default: break;
+	}
+
+	if(VO->VOMode == VOLTAGE_MODE_INIT_REGULATOR)
+	{
+		switch(Field)
+		{
+			case VOFILTER_FIELD_REGID: *Value = VO->AsType3.RegulatorID; return(true);
+			case VOFILTER_FIELD_I2CLINE: *Value = VO->AsType3.I2CLine; return(true);
+			case VOFILTER_FIELD_I2CADDR: *Value = VO->AsType3.I2CAddress; return(true);
+			case VOFILTER_FIELD_CTRLOFFSET: *Value = VO->AsType3.ControlOffset; return(true);
+			case VOFILTER_FIELD_CTRLFLAG: *Value = VO->AsType3.VoltageControlFlag; return(true);
+			default: return(false);
+		}
+	}
+
+	if(VO->VOMode == VOLTAGE_MODE_SVID2)
+	{
+		switch(Field)
+		{
+			case VOFILTER_FIELD_OFFSETTRIM: *Value = VO->AsType7.LoadLinePSI.Info.OffsetTrim; return(true);
+			case VOFILTER_FIELD_LLSLOPETRIM: *Value = VO->AsType7.LoadLinePSI.Info.LoadLineSlopeTrim; return(true);
+			default: return(false);
+		}
+	}
+
+	return(false);
+}
+
+// Runs the compiled program against a single VO header. A NULL
+// or empty filter matches everything.
+bool VOFilterMatch(const VOFilter *Filter, const VoltageObject *VO)
+{
+	bool Stack[VOFILTER_MAX_INSNS];
+	uint32_t Top = 0;
+
+	if(!Filter || !Filter->InsnCount) return(true);
+
+	for(uint32_t i = 0; i < Filter->InsnCount; ++i)
+	{
+		const VOFilterInsn *Insn = Filter->Insns + i;
+		uint32_t Value;
+
+		switch(Insn->Op)
+		{
+			case VOFILTER_OP_AND: Top--; Stack[Top - 1] = Stack[Top - 1] && Stack[Top]; break;
+			case VOFILTER_OP_OR: Top--; Stack[Top - 1] = Stack[Top - 1] || Stack[Top]; break;
+			case VOFILTER_OP_NOT: Stack[Top - 1] = !Stack[Top - 1]; break;
+			default:
+			{
+				bool Result = false;
+
+				if(VOFilterLoadField(VO, Insn->Field, &Value))
+				{
+					switch(Insn->Op)
+					{
+						case VOFILTER_OP_EQ: Result = (Value == Insn->Value); break;
+						case VOFILTER_OP_NE: Result = (Value != Insn->Value); break;
+						case VOFILTER_OP_LT: Result = (Value < Insn->Value); break;
+						case VOFILTER_OP_LE: Result = (Value <= Insn->Value); break;
+						case VOFILTER_OP_GT: Result = (Value > Insn->Value); break;
+						case VOFILTER_OP_GE: Result = (Value >= Insn->Value); break;
+					}
+				}
+
+				Stack[Top++] = Result;
+				break;
+			}
+		}
+	}
+
+	return(Stack[0]);
+}
@@ -0,0 +1,70 @@
+// Copyright 2022 Wolf9466/Wolf0/OhGodAPet
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "voi.h"
+
+// A VO filter is a small boolean expression over the header
+// fields of a voltage object, for example:
+//
+//	type==VDDC && mode==INIT_REGULATOR && i2caddr==96
+//
+// Comparisons (==, !=, <, <=, >, >=) may be combined with &&,
+// || and !, and grouped with parentheses. Values are decimal
+// or 0x-prefixed hex numbers, or - for the type and mode fields
+// only - the names from the schema in voschema.h.
+// The expression is compiled once into a postfix program, which
+// is then run against each VO header in place during the VOI
+// table walk, before anything is allocated or copied for it.
+// Mode-specific fields (such as i2caddr) never match a VO whose
+// mode does not carry them.
+
+#define VOFILTER_MAX_INSNS			64
+
+typedef enum
+{
+	VOFILTER_FIELD_TYPE,
+	VOFILTER_FIELD_MODE,
+	VOFILTER_FIELD_SIZE,
+	VOFILTER_FIELD_DATALEN,
+	VOFILTER_FIELD_REGID,
+	VOFILTER_FIELD_I2CLINE,
+	VOFILTER_FIELD_I2CADDR,
+	VOFILTER_FIELD_CTRLOFFSET,
+	VOFILTER_FIELD_CTRLFLAG,
+	VOFILTER_FIELD_OFFSETTRIM,
+	VOFILTER_FIELD_LLSLOPETRIM,
+	VOFILTER_FIELD_MAX
+} VOFilterField;
+
+typedef enum
+{
+	VOFILTER_OP_EQ,
+	VOFILTER_OP_NE,
+	VOFILTER_OP_LT,
+	VOFILTER_OP_LE,
+	VOFILTER_OP_GT,
+	VOFILTER_OP_GE,
+	VOFILTER_OP_AND,
+	VOFILTER_OP_OR,
+	VOFILTER_OP_NOT
+} VOFilterOp;
+
+typedef struct
+{
+	uint8_t Op;
+	uint8_t Field;
+	uint32_t Value;
+} VOFilterInsn;
+
+struct VOFilter_s
+{
+	uint32_t InsnCount;
+	VOFilterInsn Insns[VOFILTER_MAX_INSNS];
+};
+
+bool CompileVOFilter(VOFilter *Filter, const char *Expr);
+bool VOFilterMatch(const VOFilter *Filter, const VoltageObject *VO);
@@ -0,0 +1,299 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "vbios-tables.h"
+#include "vbios.h"
+#include "voi.h"
+#include "reloc.h"
+#include "freespace.h"
+
+// The scanners below look at 16 bytes at a time with SSE2, comparing
+// them all at once and turning the result into a bitmask, and finish
+// (or, without SSE2, do everything) a byte at a time.
+
+// Returns the offset of the first 0x00 or 0xFF byte at or past
+// Start, or End if there are none before it.
+uint32_t VBIOSFindFill(const uint8_t *Buf, uint32_t Start, uint32_t End)
+{
+	#ifdef __SSE2__
+	const __m128i Zeroes = _mm_setzero_si128(), Ones = _mm_set1_epi8(-1);
+
+	for(; (End - Start) >= 16; Start += 16)
+	{
+		const __m128i Chunk = _mm_loadu_si128((const __m128i *)(Buf + Start));
+		uint32_t Mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(Chunk, Zeroes), _mm_cmpeq_epi8(Chunk, Ones)));
+
+		if(Mask) return(Start + __builtin_ctz(Mask));
+	}
+	#endif
+
+	for(; Start < End; ++Start)
+		if(!Buf[Start] || (Buf[Start] == 0xFF)) return(Start);
+
+	return(End);
+}
+
+// Returns the offset of the first byte at or past Start that is
+// not Fill, or End if there are none before it.
+uint32_t VBIOSSkipFill(const uint8_t *Buf, uint32_t Start, uint32_t End, uint8_t Fill)
+{
+	#ifdef __SSE2__
+	const __m128i FillVec = _mm_set1_epi8((char)Fill);
+
+	for(; (End - Start) >= 16; Start += 16)
+	{
+		uint32_t Mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(Buf + Start)), FillVec)) ^ 0xFFFF;
+
+		if(Mask) return(Start + __builtin_ctz(Mask));
+	}
+	#endif
+
+	while((Start < End) && (Buf[Start] == Fill)) Start++;
+
+	return(Start);
+}
+
+// The same, backward: returns the lowest offset, no lower than
+// Start, from which every byte up to End is Fill.
+uint32_t VBIOSSkipFillBack(const uint8_t *Buf, uint32_t Start, uint32_t End, uint8_t Fill)
+{
+	#ifdef __SSE2__
+	const __m128i FillVec = _mm_set1_epi8((char)Fill);
+
+	for(; (End - Start) >= 16; End -= 16)
+	{
+		uint32_t Mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(Buf + End - 16)), FillVec)) ^ 0xFFFF;
+
+		if(Mask) return(End - 16 + (32 - __builtin_clz(Mask)));
+	}
+	#endif
+
+	while((End > Start) && (Buf[End - 1] == Fill)) End--;
+
+	return(End);
+}
+
+typedef struct
+{
+	uint32_t Start;
+	uint32_t End;
+} VBIOSClaim;
+
+static int CompareClaims(const void *A, const void *B)
+{
+	const VBIOSClaim *ClaimA = (const VBIOSClaim *)A, *ClaimB = (const VBIOSClaim *)B;
+
+	return((ClaimA->Start > ClaimB->Start) - (ClaimA->Start < ClaimB->Start));
+}
+
+// Claims the table at Offset, as far as its header says it goes,
+// if it is in the legacy image at all.
+static void ClaimTable(VBIOSClaim *Claims, uint32_t *ClaimCount, const VBIOSInfo *Info, uint32_t Offset)
+{
+	const uint32_t LegacyLen = Info->Chain.Images[0].Length;
+	uint32_t Size;
+
+	if(!Offset || ((Offset + sizeof(ATOM_COMMON_TABLE_HEADER)) > LegacyLen)) return;
+
+	Size = ((const ATOM_COMMON_TABLE_HEADER *)(Info->Image + Offset))->usStructureSize;
+
+	if(Size < sizeof(ATOM_COMMON_TABLE_HEADER)) Size = sizeof(ATOM_COMMON_TABLE_HEADER);
+	if((Offset + Size) > LegacyLen) Size = LegacyLen - Offset;
+
+	Claims[*ClaimCount].Start = Offset;
+	Claims[*ClaimCount].End = Offset + Size;
+	(*ClaimCount)++;
+}
+
+// Claims every table a master table lists, up to what fits in Claims.
+static void ClaimMasterTable(VBIOSClaim *Claims, uint32_t *ClaimCount, uint32_t MaxClaims, const VBIOSInfo *Info, uint32_t Offset)
+{
+	const uint32_t LegacyLen = Info->Chain.Images[0].Length;
+	const uint16_t *Entries;
+	uint32_t EntryCount;
+
+	if(!Offset || ((Offset + sizeof(ATOM_COMMON_TABLE_HEADER)) > LegacyLen)) return;
+
+	ClaimTable(Claims, ClaimCount, Info, Offset);
+
+	// The entries are whatever follows the header, two bytes each.
+	Entries = (const uint16_t *)(Info->Image + Offset + sizeof(ATOM_COMMON_TABLE_HEADER));
+	EntryCount = (Claims[*ClaimCount - 1].End - Offset - sizeof(ATOM_COMMON_TABLE_HEADER)) >> 1;
+
+	for(uint32_t i = 0; (i < EntryCount) && (*ClaimCount < MaxClaims); ++i) ClaimTable(Claims, ClaimCount, Info, Entries[i]);
+}
+
+static void AddFreeRun(VBIOSFreeMap *Map, uint32_t Offset, uint32_t Length, uint8_t Kind, uint8_t Fill)
+{
+	if(!Length) return;
+
+	if(Map->RunCount == VBIOS_FREEMAP_MAX_RUNS)
+	{
+		Map->RunsTruncated = true;
+		return;
+	}
+
+	Map->Runs[Map->RunCount].Offset = Offset;
+	Map->Runs[Map->RunCount].Length = Length;
+	Map->Runs[Map->RunCount].Kind = Kind;
+	Map->Runs[Map->RunCount].Fill = Fill;
+	Map->RunCount++;
+}
+
+// Sorts the bytes between Start and End, which no table claims,
+// into slack and unclaimed runs.
+static void MapGap(VBIOSFreeMap *Map, const uint8_t *Image, uint32_t Start, uint32_t End)
+{
+	uint32_t Pos = Start, UnclaimedStart = Start;
+
+	while(Pos < End)
+	{
+		uint32_t RunStart = VBIOSFindFill(Image, Pos, End), RunEnd;
+
+		if(RunStart == End) break;
+
+		RunEnd = VBIOSSkipFill(Image, RunStart, End, Image[RunStart]);
+
+		if((RunEnd - RunStart) >= VBIOS_FREEMAP_MIN_SLACK)
+		{
+			AddFreeRun(Map, UnclaimedStart, RunStart - UnclaimedStart, VBIOS_FREE_UNCLAIMED, 0x00);
+			AddFreeRun(Map, RunStart, RunEnd - RunStart, VBIOS_FREE_SLACK, Image[RunStart]);
+
+			Map->UnclaimedLen += RunStart - UnclaimedStart;
+			Map->SlackLen += RunEnd - RunStart;
+			Map->SlackRunCount++;
+
+			if((RunEnd - RunStart) > Map->LargestSlack) Map->LargestSlack = RunEnd - RunStart;
+
+			UnclaimedStart = RunEnd;
+		}
+
+		Pos = RunEnd;
+	}
+
+	AddFreeRun(Map, UnclaimedStart, End - UnclaimedStart, VBIOS_FREE_UNCLAIMED, 0x00);
+	Map->UnclaimedLen += End - UnclaimedStart;
+}
+
+// Maps the free space in the legacy image of a ROM that has already
+// been through VBIOSLocateVOI(). Fails only if the master tables
+// point at nothing that could be a table.
+bool VBIOSMapFreeSpace(VBIOSFreeMap *Map, const VBIOSInfo *Info)
+{
+	VBIOSClaim Claims[VBIOS_MAX_FIXUPS + 4];
+	uint32_t ClaimCount = 0, Merged = 0, PadStart, VOIRoom, BlockRoom, SizeRoom;
+
+	memset(Map, 0x00, sizeof(VBIOSFreeMap));
+
+	Map->LegacyLen = Info->Chain.Images[0].Length;
+	PadStart = VBIOSSkipFillBack(Info->Image, 0, Map->LegacyLen, 0xFF);
+	Map->PaddingLen = Map->LegacyLen - PadStart;
+
+	ClaimTable(Claims, &ClaimCount, Info, (uint8_t *)Info->ROMHdr - Info->Image);
+	ClaimMasterTable(Claims, &ClaimCount, (VBIOS_MAX_FIXUPS + 4) >> 1, Info, Info->ROMHdr->usMasterDataTableOffset);
+	ClaimMasterTable(Claims, &ClaimCount, VBIOS_MAX_FIXUPS + 4, Info, Info->ROMHdr->usMasterCommandTableOffset);
+
+	if(!ClaimCount)
+	{
+		printf("No tables found in the legacy image.\n");
+		return(false);
+	}
+
+	// Tables may overlap, or be listed more than once. None is taken
+	// to reach into the padding, since nothing else would spare it.
+	qsort(Claims, ClaimCount, sizeof(VBIOSClaim), CompareClaims);
+	
+	for(uint32_t i = 0; i < ClaimCount; ++i)
+	{
+		if(Claims[i].Start > PadStart) Claims[i].Start = PadStart;
+		if(Claims[i].End > PadStart) Claims[i].End = PadStart;
+	}
+
+	for(uint32_t i = 1; i < ClaimCount; ++i)
+	{
+		if(Claims[i].Start <= Claims[Merged].End)
+		{
+			if(Claims[i].End > Claims[Merged].End) Claims[Merged].End = Claims[i].End;
+		}
+		else Claims[++Merged] = Claims[i];
+	}
+
+	ClaimCount = Merged + 1;
+
+	Map->TableCount = ClaimCount;
+	Map->TablesStart = Claims[0].Start;
+	Map->TablesEnd = Claims[ClaimCount - 1].End;
+
+	for(uint32_t i = 0; i < ClaimCount; ++i)
+	{
+		Map->ClaimedLen += Claims[i].End - Claims[i].Start;
+
+		if((i + 1) < ClaimCount) MapGap(Map, Info->Image, Claims[i].End, Claims[i + 1].Start);
+	}
+
+	if(Map->TablesEnd < PadStart) MapGap(Map, Info->Image, Map->TablesEnd, PadStart);
+
+	AddFreeRun(Map, PadStart, Map->PaddingLen, VBIOS_FREE_PADDING, 0xFF);
+
+	// A VO grows into the padding, and past it by growing the image,
+	// which is bounded both by its size byte and the ROM size.
+	VOIRoom = 0xFFFF - Info->VOIHdr->usStructureSize;
+	BlockRoom = (0xFF * PCI_EXPANSION_ROM_BLOCK_SIZE) - Map->LegacyLen;
+	SizeRoom = (Info->Size < AMD_VBIOS_MAX_SIZE) ? ((AMD_VBIOS_MAX_SIZE - Info->Size) / PCI_EXPANSION_ROM_BLOCK_SIZE) * PCI_EXPANSION_ROM_BLOCK_SIZE : 0;
+
+	Map->Headroom = (Map->PaddingLen < VOIRoom) ? Map->PaddingLen : VOIRoom;
+	Map->GrowLimit = (BlockRoom < SizeRoom) ? BlockRoom : SizeRoom;
+
+	if(Map->GrowLimit > (VOIRoom - Map->Headroom)) Map->GrowLimit = VOIRoom - Map->Headroom;
+
+	return(true);
+}
+
+static const char *VBIOSFreeKindNames[] = { "padding", "slack", "unclaimed" };
+
+void VBIOSPrintFreeMap(const VBIOSFreeMap *Map, const char *ROMName, bool JSON)
+{
+	if(JSON)
+	{
+		printf("{\"rom\":");
+		PrintJSONString(ROMName);
+		printf(",\"legacy_len\":%u,\"padding\":%u,\"tables_start\":%u,\"tables_end\":%u", Map->LegacyLen, Map->PaddingLen, Map->TablesStart, Map->TablesEnd);
+		printf(",\"claimed\":%u,\"slack\":%u,\"slack_runs\":%u,\"largest_slack\":%u,\"unclaimed\":%u", Map->ClaimedLen, Map->SlackLen, Map->SlackRunCount, Map->LargestSlack, Map->UnclaimedLen);
+		printf(",\"headroom\":%u,\"grow_limit\":%u,\"runs\":[", Map->Headroom, Map->GrowLimit);
+
+		for(uint32_t i = 0; i < Map->RunCount; ++i)
+		{
+			const VBIOSFreeRun *Run = Map->Runs + i;
+
+			printf("%s{\"offset\":%u,\"length\":%u,\"kind\":\"%s\"", (i) ? "," : "", Run->Offset, Run->Length, VBIOSFreeKindNames[Run->Kind]);
+
+			if(Run->Kind != VBIOS_FREE_UNCLAIMED) printf(",\"fill\":%u", Run->Fill);
+
+			putchar('}');
+		}
+
+		printf("],\"runs_truncated\":%s}\n", (Map->RunsTruncated) ? "true" : "false");
+		return;
+	}
+
+	printf("Legacy image is 0x%X bytes; its tables span 0x%X to 0x%X.\n", Map->LegacyLen, Map->TablesStart, Map->TablesEnd);
+	printf("%u bytes are claimed by tables, %u are slack in %u runs (the largest %u bytes), %u are unclaimed, and %u are padding.\n", Map->ClaimedLen, Map->SlackLen, Map->SlackRunCount, Map->LargestSlack, Map->UnclaimedLen, Map->PaddingLen);
+	printf("A VO may grow by %u bytes in place, or by %u more by growing the image.\n", Map->Headroom, Map->GrowLimit);
+
+	for(uint32_t i = 0; i < Map->RunCount; ++i)
+	{
+		const VBIOSFreeRun *Run = Map->Runs + i;
+
+		if(Run->Kind == VBIOS_FREE_UNCLAIMED) printf("\t0x%06X - 0x%06X %8u bytes, %s\n", Run->Offset, Run->Offset + Run->Length, Run->Length, VBIOSFreeKindNames[Run->Kind]);
+		else printf("\t0x%06X - 0x%06X %8u bytes, %s (0x%02X)\n", Run->Offset, Run->Offset + Run->Length, Run->Length, VBIOSFreeKindNames[Run->Kind], Run->Fill);
+	}
+
+	if(Map->RunsTruncated) printf("\t(more runs not shown)\n");
+}
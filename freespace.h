@@ -0,0 +1,69 @@
+// Copyright 2022 Wolf9466/Wolf0/OhGodAPet
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "vbios.h"
+
+// A map of the space in the legacy image that nothing is using, or
+// at least nothing the master tables point to:
+//
+//	- the tail padding, the run of 0xFF at the end of the image,
+//	  which is what an edit that grows the VOI table eats into;
+//	- slack, runs of 0x00 or 0xFF at least VBIOS_FREEMAP_MIN_SLACK
+//	  bytes long between (or after) the ATOM tables;
+//	- everything else between the tables that no data or command
+//	  table entry claims. Code and strings may well live there, so
+//	  it is reported, but is not counted as free.
+//
+// The image is scanned for runs of fill 16 bytes at a time where
+// SSE2 is available, so mapping a ROM costs little more than
+// reading its master tables.
+
+#define VBIOS_FREEMAP_MIN_SLACK				16
+#define VBIOS_FREEMAP_MAX_RUNS				256
+
+#define VBIOS_FREE_PADDING					0x00
+#define VBIOS_FREE_SLACK					0x01
+#define VBIOS_FREE_UNCLAIMED				0x02
+
+typedef struct
+{
+	uint32_t Offset;
+	uint32_t Length;
+	uint8_t Kind;
+	uint8_t Fill;
+} VBIOSFreeRun;
+
+// TablesStart and TablesEnd bound every table the master tables
+// point to. Headroom is how far a VO may grow, or how big a new
+// one may be, without the legacy image growing; GrowLimit is how
+// much further it may go by growing the image in 512-byte blocks.
+// Both are capped by what the VOI table's 16-bit size can hold.
+typedef struct
+{
+	uint32_t LegacyLen;
+	uint32_t PaddingLen;
+	uint32_t TablesStart;
+	uint32_t TablesEnd;
+	uint32_t TableCount;
+	uint32_t ClaimedLen;
+	uint32_t SlackLen;
+	uint32_t SlackRunCount;
+	uint32_t LargestSlack;
+	uint32_t UnclaimedLen;
+	uint32_t Headroom;
+	uint32_t GrowLimit;
+	uint32_t RunCount;
+	bool RunsTruncated;
+	VBIOSFreeRun Runs[VBIOS_FREEMAP_MAX_RUNS];
+} VBIOSFreeMap;
+
+uint32_t VBIOSFindFill(const uint8_t *Buf, uint32_t Start, uint32_t End);
+uint32_t VBIOSSkipFill(const uint8_t *Buf, uint32_t Start, uint32_t End, uint8_t Fill);
+uint32_t VBIOSSkipFillBack(const uint8_t *Buf, uint32_t Start, uint32_t End, uint8_t Fill);
+
+bool VBIOSMapFreeSpace(VBIOSFreeMap *Map, const VBIOSInfo *Info);
+void VBIOSPrintFreeMap(const VBIOSFreeMap *Map, const char *ROMName, bool JSON);
@@ -0,0 +1,307 @@
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+#include "voi.h"
+#include "smbus.h"
+#include "i2c.h"
+
+#define I2C_FAKE_DEVICE_SIZE			(256 * sizeof(uint16_t))
+#define I2C_FAKE_SIZE					(I2C_FAKE_ADDRESSES * I2C_FAKE_DEVICE_SIZE)
+
+// A bare bus number is short for its i2c-dev node.
+static bool I2CLinuxOpen(I2CTransport *Xport, const char *Target)
+{
+	char Path[64];
+	
+	if(Target[0] && (strspn(Target, "0123456789") == strlen(Target)))
+	{
+		snprintf(Path, sizeof(Path), "/dev/i2c-%s", Target);
+		Target = Path;
+	}
+	
+	if((Xport->Fd = open(Target, O_RDWR)) < 0)
+	{
+		printf("Unable to open %s (%s).\n", Target, strerror(errno));
+		return(false);
+	}
+	
+	// Reads need a repeated start, so plain I2C transfers are a must;
+	// an SMBus-only adapter cannot do them.
+	if(ioctl(Xport->Fd, I2C_FUNCS, &Xport->Funcs) < 0)
+	{
+		printf("Unable to query what %s supports (%s).\n", Target, strerror(errno));
+		close(Xport->Fd);
+		return(false);
+	}
+	
+	if(!(Xport->Funcs & I2C_FUNC_I2C))
+	{
+		printf("The adapter behind %s cannot do plain I2C transfers.\n", Target);
+		close(Xport->Fd);
+		return(false);
+	}
+	
+	return(true);
+}
+
+// Each write is its own transaction - a start, the command code, the
+// value, and a stop - as the device would see it from SMBus. Where the
+// adapter can put a stop after each message, the whole batch goes to
+// it in one ioctl; otherwise, each write takes one of its own, since
+// messages in one ioctl are otherwise joined by repeated starts.
+static bool I2CLinuxWrite(I2CTransport *Xport, uint8_t Addr, const SMBusWrite *Writes, uint32_t Count)
+{
+	struct i2c_msg Msgs[I2C_BATCH_MAX];
+	uint8_t Bufs[I2C_BATCH_MAX][3];
+	bool StopEach = (Xport->Funcs & I2C_FUNC_PROTOCOL_MANGLING) != 0;
+	
+	for(uint32_t i = 0; i < Count; ++i)
+	{
+		Bufs[i][0] = Writes[i].Reg;
+		Bufs[i][1] = Writes[i].Value & 0xFF;
+		Bufs[i][2] = Writes[i].Value >> 8;
+		
+		Msgs[i].addr = Addr;
+		Msgs[i].flags = (StopEach) ? I2C_M_STOP : 0;
+		Msgs[i].len = (Writes[i].Word) ? 3 : 2;
+		Msgs[i].buf = Bufs[i];
+	}
+	
+	for(uint32_t i = 0; i < Count; i += (StopEach) ? Count : 1)
+	{
+		struct i2c_rdwr_ioctl_data Data = { Msgs + i, (StopEach) ? Count : 1 };
+		
+		if(ioctl(Xport->Fd, I2C_RDWR, &Data) < 0)
+		{
+			printf("Writing to the device at 0x%02X failed (%s).\n", Addr, strerror(errno));
+			return(false);
+		}
+	}
+	
+	return(true);
+}
+
+// An SMBus read: the command code, then a repeated start and the
+// byte or word read.
+static bool I2CLinuxRead(I2CTransport *Xport, uint8_t Addr, uint8_t Reg, bool Word, uint16_t *Value)
+{
+	uint8_t Buf[2] = { 0x00, 0x00 };
+	struct i2c_msg Msgs[2] =
+	{
+		{ .addr = Addr, .flags = 0, .len = 1, .buf = &Reg },
+		{ .addr = Addr, .flags = I2C_M_RD, .len = (Word) ? 2 : 1, .buf = Buf }
+	};
+	struct i2c_rdwr_ioctl_data Data = { Msgs, 2 };
+	
+	if(ioctl(Xport->Fd, I2C_RDWR, &Data) < 0)
+	{
+		printf("Reading from the device at 0x%02X failed (%s).\n", Addr, strerror(errno));
+		return(false);
+	}
+	
+	*Value = Buf[0] | (Buf[1] << 8);
+	return(true);
+}
+
+static bool I2CFakeOpen(I2CTransport *Xport, const char *Target)
+{
+	struct stat St;
+	
+	if((Xport->Fd = open(Target, O_RDWR | O_CREAT, 0666)) < 0)
+	{
+		printf("Unable to open %s (%s).\n", Target, strerror(errno));
+		return(false);
+	}
+	
+	if(fstat(Xport->Fd, &St) || ((St.st_size < (off_t)I2C_FAKE_SIZE) && ftruncate(Xport->Fd, I2C_FAKE_SIZE)))
+	{
+		printf("Unable to set up %s as a fake bus (%s).\n", Target, strerror(errno));
+		close(Xport->Fd);
+		return(false);
+	}
+	
+	return(true);
+}
+
+static bool I2CFakeCheckAddr(uint8_t Addr)
+{
+	if(Addr < I2C_FAKE_ADDRESSES) return(true);
+	
+	printf("No device can be at address 0x%02X.\n", Addr);
+	return(false);
+}
+
+// A batch is one read and one write of the device's registers.
+static bool I2CFakeWrite(I2CTransport *Xport, uint8_t Addr, const SMBusWrite *Writes, uint32_t Count)
+{
+	uint16_t Regs[256];
+	off_t Offset = (off_t)Addr * I2C_FAKE_DEVICE_SIZE;
+	
+	if(!I2CFakeCheckAddr(Addr)) return(false);
+	
+	if(pread(Xport->Fd, Regs, sizeof(Regs), Offset) != sizeof(Regs))
+	{
+		printf("Reading the fake bus failed.\n");
+		return(false);
+	}
+	
+	for(uint32_t i = 0; i < Count; ++i) Regs[Writes[i].Reg] = Writes[i].Value;
+	
+	if(pwrite(Xport->Fd, Regs, sizeof(Regs), Offset) != sizeof(Regs))
+	{
+		printf("Writing the fake bus failed.\n");
+		return(false);
+	}
+	
+	return(true);
+}
+
+static bool I2CFakeRead(I2CTransport *Xport, uint8_t Addr, uint8_t Reg, bool Word, uint16_t *Value)
+{
+	uint16_t RegValue;
+	
+	if(!I2CFakeCheckAddr(Addr)) return(false);
+	
+	if(pread(Xport->Fd, &RegValue, sizeof(RegValue), (off_t)Addr * I2C_FAKE_DEVICE_SIZE + Reg * sizeof(uint16_t)) != sizeof(RegValue))
+	{
+		printf("Reading the fake bus failed.\n");
+		return(false);
+	}
+	
+	*Value = (Word) ? RegValue : (RegValue & 0xFF);
+	return(true);
+}
+
+static void I2CCloseFd(I2CTransport *Xport)
+{
+	close(Xport->Fd);
+}
+
+// The first transport whose prefix the target starts with is used;
+// the Linux bus, with no prefix, takes anything else.
+static const I2CTransportOps I2CTransports[] =
+{
+	{ "fake:", I2CFakeOpen, I2CFakeWrite, I2CFakeRead, I2CCloseFd },
+	{ "", I2CLinuxOpen, I2CLinuxWrite, I2CLinuxRead, I2CCloseFd }
+};
+
+bool I2CTransportOpen(I2CTransport *Xport, const char *Target)
+{
+	memset(Xport, 0x00, sizeof(I2CTransport));
+	
+	for(size_t i = 0; i < (sizeof(I2CTransports) / sizeof(I2CTransports[0])); ++i)
+	{
+		size_t PrefixLen = strlen(I2CTransports[i].Prefix);
+		
+		if(strncmp(Target, I2CTransports[i].Prefix, PrefixLen)) continue;
+		
+		Xport->Ops = I2CTransports + i;
+		return(Xport->Ops->Open(Xport, Target + PrefixLen));
+	}
+	
+	return(false);
+}
+
+bool I2CTransportFlush(I2CTransport *Xport)
+{
+	bool Ok = true;
+	
+	if(Xport->QueueLen) Ok = Xport->Ops->Write(Xport, Xport->QueueAddr, Xport->Queue, Xport->QueueLen);
+	
+	Xport->QueueLen = 0;
+	return(Ok);
+}
+
+bool I2CTransportQueue(I2CTransport *Xport, uint8_t Addr, const SMBusWrite *Write)
+{
+	if(Xport->QueueLen && ((Xport->QueueAddr != Addr) || (Xport->QueueLen == I2C_BATCH_MAX)))
+	{
+		if(!I2CTransportFlush(Xport)) return(false);
+	}
+	
+	Xport->QueueAddr = Addr;
+	Xport->Queue[Xport->QueueLen++] = *Write;
+	return(true);
+}
+
+// Anything still queued is sent first, so reads always see it.
+bool I2CTransportRead(I2CTransport *Xport, uint8_t Addr, uint8_t Reg, bool Word, uint16_t *Value)
+{
+	if(!I2CTransportFlush(Xport)) return(false);
+	
+	return(Xport->Ops->Read(Xport, Addr, Reg, Word, Value));
+}
+
+void I2CTransportClose(I2CTransport *Xport)
+{
+	I2CTransportFlush(Xport);
+	Xport->Ops->Close(Xport);
+}
+
+// Sends every write of the VO, in order. When verifying, each register
+// written is then read back, and compared to the last value written
+// to it; registers that read back differently are listed, and make
+// the apply fail. Read-back sees the device as the sequence left it,
+// so a register that is not plain storage (a command, or one behind
+// a page that was switched away from) may legitimately differ.
+bool I2CApplyVO(I2CTransport *Xport, const VoltageObject *VO, const uint8_t *VOData, uint32_t VODataLen, bool Verify)
+{
+	uint8_t Addr = VO->AsType3.I2CAddress >> 1;
+	SMBusWrite *Writes;
+	uint32_t WriteCount, Verified = 0, Mismatched = 0;
+	int32_t LastWrite[256];
+	const char *Error;
+	bool Ok = true;
+	
+	if(!SMBusDecodeVO(VO, VOData, VODataLen, &Writes, &WriteCount, &Error))
+	{
+		printf("Unable to decode the writes: %s.\n", Error);
+		return(false);
+	}
+	
+	for(uint32_t i = 0; Ok && (i < WriteCount); ++i) Ok = I2CTransportQueue(Xport, Addr, Writes + i);
+	
+	if(Ok && (Ok = I2CTransportFlush(Xport))) printf("Sent %u writes to the device at 0x%02X.\n", WriteCount, Addr);
+	
+	if(Ok && Verify)
+	{
+		for(int i = 0; i < 256; ++i) LastWrite[i] = -1;
+		for(uint32_t i = 0; i < WriteCount; ++i) LastWrite[Writes[i].Reg] = i;
+		
+		for(int Reg = 0; Ok && (Reg < 256); ++Reg)
+		{
+			const SMBusWrite *Write;
+			uint16_t Value;
+			
+			if(LastWrite[Reg] < 0) continue;
+			
+			Write = Writes + LastWrite[Reg];
+			
+			if(!(Ok = I2CTransportRead(Xport, Addr, Reg, Write->Word, &Value))) break;
+			
+			if(Value != Write->Value)
+			{
+				printf("Register 0x%02X reads back as 0x%02X, not 0x%02X.\n", Reg, Value, Write->Value);
+				Mismatched++;
+			}
+			
+			Verified++;
+		}
+		
+		if(Ok) printf("Read back %u registers, %u of which differ.\n", Verified, Mismatched);
+		if(Mismatched) Ok = false;
+	}
+	
+	free(Writes);
+	return(Ok);
+}
@@ -0,0 +1,67 @@
+// Copyright 2022 Wolf9466/Wolf0/OhGodAPet
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "voi.h"
+#include "smbus.h"
+
+// Sends the register writes of an INIT_REGULATOR VO (see smbus.h)
+// straight to the device, rather than flashing them, so a sequence
+// can be tried out in moments. Writes go through a transport, of
+// which there are two:
+//
+//	/dev/i2c-N, or just N		A Linux I2C bus, through i2c-dev
+//	fake:<file>					A file standing in for the bus
+//
+// The fake bus holds 256 16-bit registers for each of the 128 7-bit
+// addresses, little-endian, and is created if it does not exist; a
+// byte write stores its value, and a byte read returns the low byte.
+//
+// Writes to a device are queued, and sent as one batch once the
+// queue fills, the device changes, or the queue is flushed. On a
+// Linux bus, each write ends in a stop, as an SMBus write would; a
+// batch is one I2C_RDWR ioctl of up to I2C_BATCH_MAX messages where
+// the adapter can stop after each, and one ioctl per write where it
+// cannot. An adapter without plain I2C transfers is refused when the
+// bus is opened. Afterwards, every register written can be read back
+// and compared to the last value written to it.
+//
+// A VO's I2CAddress is an 8-bit address (the 7-bit address shifted
+// left, as on the wire), and its I2CLine is the VBIOS's own number
+// for the bus, which need not match the Linux one; the bus used is
+// always the one given.
+
+#define I2C_BATCH_MAX					32
+#define I2C_FAKE_ADDRESSES				128
+
+typedef struct I2CTransport_s I2CTransport;
+
+typedef struct
+{
+	const char *Prefix;
+	bool (*Open)(I2CTransport *Xport, const char *Target);
+	bool (*Write)(I2CTransport *Xport, uint8_t Addr, const SMBusWrite *Writes, uint32_t Count);
+	bool (*Read)(I2CTransport *Xport, uint8_t Addr, uint8_t Reg, bool Word, uint16_t *Value);
+	void (*Close)(I2CTransport *Xport);
+} I2CTransportOps;
+
+struct I2CTransport_s
+{
+	const I2CTransportOps *Ops;
+	int Fd;
+	unsigned long Funcs;
+	uint8_t QueueAddr;
+	uint32_t QueueLen;
+	SMBusWrite Queue[I2C_BATCH_MAX];
+};
+
+bool I2CTransportOpen(I2CTransport *Xport, const char *Target);
+bool I2CTransportQueue(I2CTransport *Xport, uint8_t Addr, const SMBusWrite *Write);
+bool I2CTransportFlush(I2CTransport *Xport);
+bool I2CTransportRead(I2CTransport *Xport, uint8_t Addr, uint8_t Reg, bool Word, uint16_t *Value);
+void I2CTransportClose(I2CTransport *Xport);
+
+bool I2CApplyVO(I2CTransport *Xport, const VoltageObject *VO, const uint8_t *VOData, uint32_t VODataLen, bool Verify);
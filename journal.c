@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "vbios.h"
+#include "reloc.h"
+#include "journal.h"
+
+void JournalInit(VBIOSJournal *Journal)
+{
+	memset(Journal, 0x00, sizeof(VBIOSJournal));
+}
+
+// Drops every delta that has been undone, but not redone.
+static void JournalDropRedo(VBIOSJournal *Journal)
+{
+	while(Journal->Count > Journal->Pos) VBIOSFreeDelta(Journal->Deltas + --Journal->Count);
+}
+
+// Adds a delta that has just been applied to the image. The journal
+// takes ownership of its buffers; Delta is cleared. Anything that
+// could have been redone is lost, as it no longer applies.
+bool JournalRecord(VBIOSJournal *Journal, VBIOSDelta *Delta)
+{
+	JournalDropRedo(Journal);
+	
+	if(Journal->Count == Journal->Cap)
+	{
+		uint32_t NewCap = (Journal->Cap) ? Journal->Cap << 1 : 16;
+		VBIOSDelta *NewDeltas = (VBIOSDelta *)realloc(Journal->Deltas, sizeof(VBIOSDelta) * NewCap);
+		
+		if(!NewDeltas)
+		{
+			VBIOSFreeDelta(Delta);
+			return(false);
+		}
+		
+		Journal->Deltas = NewDeltas;
+		Journal->Cap = NewCap;
+	}
+	
+	Journal->Deltas[Journal->Count++] = *Delta;
+	Journal->Pos = Journal->Count;
+	
+	memset(Delta, 0x00, sizeof(VBIOSDelta));
+	return(true);
+}
+
+bool JournalUndo(VBIOSJournal *Journal, VBIOSInfo *Info)
+{
+	if(!Journal->Pos)
+	{
+		printf("Nothing to undo.\n");
+		return(false);
+	}
+	
+	if(!VBIOSApplyDelta(Info, Journal->Deltas + Journal->Pos - 1, true)) return(false);
+	
+	Journal->Pos--;
+	return(true);
+}
+
+bool JournalRedo(VBIOSJournal *Journal, VBIOSInfo *Info)
+{
+	if(Journal->Pos == Journal->Count)
+	{
+		printf("Nothing to redo.\n");
+		return(false);
+	}
+	
+	if(!VBIOSApplyDelta(Info, Journal->Deltas + Journal->Pos, false)) return(false);
+	
+	Journal->Pos++;
+	return(true);
+}
+
+void JournalFree(VBIOSJournal *Journal)
+{
+	for(uint32_t i = 0; i < Journal->Count; ++i) VBIOSFreeDelta(Journal->Deltas + i);
+	
+	free(Journal->Deltas);
+	JournalInit(Journal);
+}
@@ -0,0 +1,32 @@
+// Copyright 2022 Wolf9466/Wolf0/OhGodAPet
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "vbios.h"
+#include "reloc.h"
+
+// An undo/redo journal of edits to one image. Each edit is kept as
+// the VBIOSDelta the relocation engine recorded for it - the bytes
+// replaced, what replaced them and the table offsets that moved -
+// rather than as a copy of the image, so stepping backward or
+// forward costs only as much as the edit itself. Deltas must be
+// undone in the reverse of the order they were applied, which the
+// journal enforces: Deltas[0] through Deltas[Pos - 1] are applied,
+// and Deltas[Pos] through Deltas[Count - 1] may be redone.
+
+typedef struct
+{
+	VBIOSDelta *Deltas;
+	uint32_t Count;
+	uint32_t Pos;
+	uint32_t Cap;
+} VBIOSJournal;
+
+void JournalInit(VBIOSJournal *Journal);
+bool JournalRecord(VBIOSJournal *Journal, VBIOSDelta *Delta);
+bool JournalUndo(VBIOSJournal *Journal, VBIOSInfo *Info);
+bool JournalRedo(VBIOSJournal *Journal, VBIOSInfo *Info);
+void JournalFree(VBIOSJournal *Journal);
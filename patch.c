@@ -0,0 +1,275 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "vbios-tables.h"
+#include "vbios.h"
+#include "reloc.h"
+#include "journal.h"
+#include "sha256.h"
+#include "patch.h"
+
+typedef struct
+{
+	uint8_t *Data;
+	size_t Len;
+	size_t Cap;
+	uint32_t OpCount;
+	size_t LastOp;
+} VOIPatchBuf;
+
+static bool PatchBufReserve(VOIPatchBuf *Buf, size_t Len)
+{
+	if((Buf->Len + Len) > Buf->Cap)
+	{
+		size_t NewCap = (Buf->Cap) ? Buf->Cap : 4096;
+		uint8_t *NewData;
+		
+		while(NewCap < (Buf->Len + Len)) NewCap <<= 1;
+		
+		if(!(NewData = (uint8_t *)realloc(Buf->Data, NewCap))) return(false);
+		
+		Buf->Data = NewData;
+		Buf->Cap = NewCap;
+	}
+	
+	return(true);
+}
+
+static bool PatchEmit(VOIPatchBuf *Buf, uint8_t Type, uint32_t Dst, uint32_t Src, uint32_t Len, uint8_t Fill, const void *Data)
+{
+	VOIPatchOp Op = { Type, Fill, 0, Dst, Src, Len };
+	
+	if(!Len) return(true);
+	
+	// Writes that pick up where the last one left off are merged,
+	// which turns the many two-byte table fixups into a few runs.
+	if((Type == VOIPATCH_OP_WRITE) && Buf->OpCount)
+	{
+		VOIPatchOp *Last = (VOIPatchOp *)(Buf->Data + Buf->LastOp);
+		
+		if((Last->Type == VOIPATCH_OP_WRITE) && ((Last->Dst + Last->Len) == Dst))
+		{
+			if(!PatchBufReserve(Buf, Len)) return(false);
+			
+			Last = (VOIPatchOp *)(Buf->Data + Buf->LastOp);
+			memcpy(Buf->Data + Buf->Len, Data, Len);
+			Buf->Len += Len;
+			Last->Len += Len;
+			return(true);
+		}
+	}
+	
+	if(!PatchBufReserve(Buf, sizeof(VOIPatchOp) + ((Type == VOIPATCH_OP_WRITE) ? Len : 0))) return(false);
+	
+	Buf->LastOp = Buf->Len;
+	memcpy(Buf->Data + Buf->Len, &Op, sizeof(VOIPatchOp));
+	Buf->Len += sizeof(VOIPatchOp);
+	
+	if(Type == VOIPATCH_OP_WRITE)
+	{
+		memcpy(Buf->Data + Buf->Len, Data, Len);
+		Buf->Len += Len;
+	}
+	
+	Buf->OpCount++;
+	return(true);
+}
+
+// Emits the ops for one delta, applying it to the scratch image as
+// it goes, so that every offset and value written comes from the
+// relocation engine itself. The bytes moved are described as moves,
+// and only the bytes the engine actually set are written.
+static bool PatchEmitDelta(VOIPatchBuf *Buf, VBIOSInfo *Scratch, const VBIOSDelta *Delta)
+{
+	const int32_t SizeDiff = (int32_t)Delta->NewLen - (int32_t)Delta->OldLen;
+	const uint32_t LegacyLen = Scratch->Chain.Images[0].Length, PadEnd = LegacyLen + Delta->GrowLen;
+	const uint32_t ShiftStart = Delta->Offset + Delta->OldLen;
+	bool Ret = true;
+	
+	// The images after the legacy one move up, and the new
+	// blocks start out as padding.
+	if(Delta->GrowLen)
+	{
+		Ret &= PatchEmit(Buf, VOIPATCH_OP_MOVE, LegacyLen + Delta->GrowLen, LegacyLen, Scratch->Size - LegacyLen, 0, NULL);
+		Ret &= PatchEmit(Buf, VOIPATCH_OP_FILL, LegacyLen, 0, Delta->GrowLen, 0xFF, NULL);
+	}
+	
+	if(SizeDiff > 0)
+	{
+		Ret &= PatchEmit(Buf, VOIPATCH_OP_MOVE, ShiftStart + SizeDiff, ShiftStart, PadEnd - SizeDiff - ShiftStart, 0, NULL);
+	}
+	else if(SizeDiff < 0)
+	{
+		Ret &= PatchEmit(Buf, VOIPATCH_OP_MOVE, ShiftStart + SizeDiff, ShiftStart, PadEnd - ShiftStart, 0, NULL);
+		Ret &= PatchEmit(Buf, VOIPATCH_OP_FILL, PadEnd + SizeDiff, 0, -SizeDiff, 0xFF, NULL);
+	}
+	
+	Ret &= PatchEmit(Buf, VOIPATCH_OP_WRITE, Delta->Offset, 0, Delta->NewLen, 0, Delta->NewBytes);
+	
+	if(!Ret || !VBIOSApplyDelta(Scratch, Delta, false)) return(false);
+	
+	// Everything else the engine changed is a small value somewhere
+	// in the (now current) layout.
+	for(uint32_t i = 0; i < Delta->FixupCount; ++i)
+	{
+		const uint16_t *Entry = VBIOSGetFixupEntry(Scratch->Image, Scratch->ROMHdr, Delta->Fixups + i);
+		
+		Ret &= PatchEmit(Buf, VOIPATCH_OP_WRITE, ((const uint8_t *)Entry) - Scratch->Image, 0, sizeof(uint16_t), 0, Entry);
+	}
+	
+	for(uint32_t i = 0; i < Delta->PatchCount; ++i)
+		Ret &= PatchEmit(Buf, VOIPATCH_OP_WRITE, Delta->Patches[i].Offset, 0, sizeof(uint16_t), 0, Scratch->Image + Delta->Patches[i].Offset);
+	
+	if(Delta->GrowLen)
+	{
+		const uint32_t PCIRLenOffset = Scratch->Chain.Images[0].PCIROffset + offsetof(PCI_DATA_STRUCTURE, ImageLength);
+		
+		Ret &= PatchEmit(Buf, VOIPATCH_OP_WRITE, PCI_EXPANSION_ROM_SIZE_OFFSET, 0, 1, 0, Scratch->Image + PCI_EXPANSION_ROM_SIZE_OFFSET);
+		Ret &= PatchEmit(Buf, VOIPATCH_OP_WRITE, PCIRLenOffset, 0, sizeof(uint16_t), 0, Scratch->Image + PCIRLenOffset);
+	}
+	
+	Ret &= PatchEmit(Buf, VOIPATCH_OP_WRITE, ATOM_ROM_CHECKSUM_OFFSET, 0, 1, 0, Scratch->Image + ATOM_ROM_CHECKSUM_OFFSET);
+	
+	return(Ret);
+}
+
+// Writes a patch turning BaseImg into the image in Edited, made of the
+// edits in Journal that are currently applied. The edits are replayed
+// onto a copy of the base to generate it, and the result must match
+// Edited exactly.
+bool VOIPatchWrite(const char *FileName, const uint8_t *BaseImg, size_t BaseSize, const VBIOSInfo *Edited, const VBIOSJournal *Journal)
+{
+	VOIPatchBuf Buf = { 0 };
+	VOIPatchHdr Hdr = { 0 };
+	VBIOSInfo Scratch;
+	uint8_t *ScratchImg = (uint8_t *)malloc(AMD_VBIOS_MAX_SIZE);
+	FILE *PatchFile;
+	bool Ret = false;
+	
+	if(!ScratchImg)
+	{
+		printf("Out of memory.\n");
+		return(false);
+	}
+	
+	memcpy(ScratchImg, BaseImg, BaseSize);
+	
+	if(!VBIOSLocateVOI(&Scratch, ScratchImg, BaseSize)) goto out;
+	
+	for(uint32_t i = 0; i < Journal->Pos; ++i)
+	{
+		if(!PatchEmitDelta(&Buf, &Scratch, Journal->Deltas + i))
+		{
+			printf("Unable to generate the patch.\n");
+			goto out;
+		}
+	}
+	
+	if((Scratch.Size != Edited->Size) || memcmp(ScratchImg, Edited->Image, Edited->Size))
+	{
+		printf("Replaying the edits did not reproduce the edited image; no patch written.\n");
+		goto out;
+	}
+	
+	memcpy(Hdr.Magic, VOIPATCH_MAGIC, sizeof(Hdr.Magic));
+	Hdr.BaseSize = BaseSize;
+	Hdr.NewSize = Edited->Size;
+	SHA256(Hdr.BaseHash, BaseImg, BaseSize);
+	SHA256(Hdr.NewHash, Edited->Image, Edited->Size);
+	Hdr.OpCount = Buf.OpCount;
+	
+	if(!(PatchFile = fopen(FileName, "wb")))
+	{
+		printf("Unable to open %s for writing.\n", FileName);
+		goto out;
+	}
+	
+	Ret = (fwrite(&Hdr, sizeof(Hdr), 1, PatchFile) == 1) && (!Buf.Len || (fwrite(Buf.Data, Buf.Len, 1, PatchFile) == 1));
+	Ret &= !fclose(PatchFile);
+	
+	if(Ret) printf("Wrote a %zu byte patch of %u ops to %s.\n", sizeof(Hdr) + Buf.Len, Buf.OpCount, FileName);
+	else printf("Writing to %s failed.\n", FileName);
+	
+out:
+	free(Buf.Data);
+	free(ScratchImg);
+	return(Ret);
+}
+
+// Applies the patch in PatchName to Image (a buffer of at least
+// AMD_VBIOS_MAX_SIZE bytes) holding *Size bytes, and updates *Size.
+// The image must be the exact base the patch was made against. On
+// any failure, Image may be partly patched and must be discarded.
+bool VOIPatchApply(const char *PatchName, uint8_t *Image, size_t *Size)
+{
+	FILE *PatchFile = fopen(PatchName, "rb");
+	uint8_t Hash[SHA256_DIGEST_LEN];
+	VOIPatchHdr Hdr;
+	bool Ret = false;
+	
+	if(!PatchFile)
+	{
+		printf("Unable to open %s (does it exist?)\n", PatchName);
+		return(false);
+	}
+	
+	if((fread(&Hdr, sizeof(Hdr), 1, PatchFile) != 1) || memcmp(Hdr.Magic, VOIPATCH_MAGIC, sizeof(Hdr.Magic)) || (Hdr.NewSize > AMD_VBIOS_MAX_SIZE))
+	{
+		printf("%s is not a VOI patch.\n", PatchName);
+		goto out;
+	}
+	
+	SHA256(Hash, Image, *Size);
+	
+	if((*Size != Hdr.BaseSize) || memcmp(Hash, Hdr.BaseHash, SHA256_DIGEST_LEN))
+	{
+		printf("The ROM is not the one %s was made for.\n", PatchName);
+		goto out;
+	}
+	
+	for(uint32_t i = 0; i < Hdr.OpCount; ++i)
+	{
+		VOIPatchOp Op;
+		
+		if((fread(&Op, sizeof(Op), 1, PatchFile) != 1) || (Op.Len > AMD_VBIOS_MAX_SIZE) || (Op.Dst > (AMD_VBIOS_MAX_SIZE - Op.Len)) || (Op.Src > (AMD_VBIOS_MAX_SIZE - Op.Len)))
+		{
+			printf("%s is truncated or corrupt.\n", PatchName);
+			goto out;
+		}
+		
+		if(Op.Type == VOIPATCH_OP_WRITE)
+		{
+			if(fread(Image + Op.Dst, 1, Op.Len, PatchFile) != Op.Len)
+			{
+				printf("%s is truncated.\n", PatchName);
+				goto out;
+			}
+		}
+		else if(Op.Type == VOIPATCH_OP_MOVE) memmove(Image + Op.Dst, Image + Op.Src, Op.Len);
+		else if(Op.Type == VOIPATCH_OP_FILL) memset(Image + Op.Dst, Op.Fill, Op.Len);
+		else
+		{
+			printf("%s holds an unknown op %d.\n", PatchName, Op.Type);
+			goto out;
+		}
+	}
+	
+	SHA256(Hash, Image, Hdr.NewSize);
+	
+	if(memcmp(Hash, Hdr.NewHash, SHA256_DIGEST_LEN))
+	{
+		printf("Applying %s did not give the expected result.\n", PatchName);
+		goto out;
+	}
+	
+	*Size = Hdr.NewSize;
+	Ret = true;
+	
+out:
+	fclose(PatchFile);
+	return(Ret);
+}
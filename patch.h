@@ -0,0 +1,68 @@
+// Copyright 2022 Wolf9466/Wolf0/OhGodAPet
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "sha256.h"
+#include "journal.h"
+
+// A binary patch turns one exact base image into an edited one,
+// so that only the changes need to be shipped to a flashing tool.
+// It is generated from the edits recorded in the journal - each
+// delta becomes the moves, fills and writes the relocation engine
+// made for it - rather than by comparing two images.
+//
+// File layout (all little-endian):
+//
+//	VOIPatchHdr
+//	for each op:
+//		VOIPatchOp
+//		uint8_t Data[Len]		(VOIPATCH_OP_WRITE only)
+//
+// Ops are applied in order, in place, to a copy of the base image
+// in a buffer of AMD_VBIOS_MAX_SIZE bytes:
+//
+//	VOIPATCH_OP_WRITE	copy Data to Dst
+//	VOIPATCH_OP_MOVE	memmove Len bytes from Src to Dst
+//	VOIPATCH_OP_FILL	set Len bytes at Dst to Fill
+//
+// The first NewSize bytes are then the result. The base must hash
+// to BaseHash before anything is applied, and the result to NewHash
+// before it is written out.
+
+#define VOIPATCH_MAGIC					"WVOIPAT1"
+
+#define VOIPATCH_OP_WRITE				0x00
+#define VOIPATCH_OP_MOVE				0x01
+#define VOIPATCH_OP_FILL				0x02
+
+#pragma pack(push, 1)
+
+typedef struct
+{
+	char Magic[8];
+	uint32_t BaseSize;
+	uint32_t NewSize;
+	uint8_t BaseHash[SHA256_DIGEST_LEN];
+	uint8_t NewHash[SHA256_DIGEST_LEN];
+	uint32_t OpCount;
+	uint32_t Reserved;
+} VOIPatchHdr;
+
+typedef struct
+{
+	uint8_t Type;
+	uint8_t Fill;
+	uint16_t Reserved;
+	uint32_t Dst;
+	uint32_t Src;
+	uint32_t Len;
+} VOIPatchOp;
+
+#pragma pack(pop)
+
+bool VOIPatchWrite(const char *FileName, const uint8_t *BaseImg, size_t BaseSize, const VBIOSInfo *Edited, const VBIOSJournal *Journal);
+bool VOIPatchApply(const char *PatchName, uint8_t *Image, size_t *Size);
@@ -0,0 +1,255 @@
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "vbios-tables.h"
+#include "pcirom.h"
+
+// One device's capture, run on a thread of its own.
+typedef struct
+{
+	pthread_t Thread;
+	bool Started;
+	char *Address;
+	char *ROMPath;
+	uint8_t *Image;
+	size_t Size;
+	int Err;
+	const char *ErrWhat;
+} PCIROMDevice;
+
+// Reads up to BufSize bytes of the file at Path. Returns how many,
+// or -1 with errno set.
+static ssize_t PCIROMReadFile(const char *Path, uint8_t *Buf, size_t BufSize)
+{
+	size_t Total = 0;
+	ssize_t Len;
+	int Fd;
+
+	if((Fd = open(Path, O_RDONLY)) < 0) return(-1);
+
+	while(Total < BufSize)
+	{
+		do Len = read(Fd, Buf + Total, BufSize - Total); while((Len < 0) && (errno == EINTR));
+
+		if(Len <= 0) break;
+
+		Total += Len;
+	}
+
+	if(Len < 0)
+	{
+		int Err = errno;
+
+		close(Fd);
+		errno = Err;
+		return(-1);
+	}
+
+	close(Fd);
+	return(Total);
+}
+
+static bool PCIROMSetEnabled(const char *Path, bool Enable)
+{
+	int Fd;
+	bool Ok;
+
+	if((Fd = open(Path, O_WRONLY)) < 0) return(false);
+
+	Ok = write(Fd, (Enable) ? "1" : "0", 1) == 1;
+
+	close(Fd);
+	return(Ok);
+}
+
+static void *PCIROMDeviceThread(void *Arg)
+{
+	PCIROMDevice *Dev = (PCIROMDevice *)Arg;
+	ssize_t Len;
+
+	if(!(Dev->Image = (uint8_t *)malloc(AMD_VBIOS_MAX_SIZE)))
+	{
+		Dev->Err = ENOMEM;
+		Dev->ErrWhat = "read";
+		return(NULL);
+	}
+
+	// A real attribute is off until it is turned on, and is put back
+	// the way it was found.
+	if(((Len = PCIROMReadFile(Dev->ROMPath, Dev->Image, AMD_VBIOS_MAX_SIZE)) < 0) && (errno == EINVAL))
+	{
+		if(!PCIROMSetEnabled(Dev->ROMPath, true))
+		{
+			Dev->Err = errno;
+			Dev->ErrWhat = "enable";
+			return(NULL);
+		}
+
+		Len = PCIROMReadFile(Dev->ROMPath, Dev->Image, AMD_VBIOS_MAX_SIZE);
+		if(Len < 0) Dev->Err = errno;
+
+		PCIROMSetEnabled(Dev->ROMPath, false);
+	}
+	else if(Len < 0) Dev->Err = errno;
+
+	if(Len < 0) Dev->ErrWhat = "read";
+	else Dev->Size = Len;
+
+	return(NULL);
+}
+
+// Whether the device at Dir is display class, going by its class
+// attribute, which reads as, for example, 0x030000.
+static bool PCIROMIsDisplay(const char *Dir)
+{
+	char Path[PATH_MAX], Class[32];
+	ssize_t Len;
+
+	snprintf(Path, sizeof(Path), "%s/class", Dir);
+
+	if((Len = PCIROMReadFile(Path, (uint8_t *)Class, sizeof(Class) - 1)) <= 0) return(false);
+
+	Class[Len] = 0x00;
+
+	return((strtoul(Class, NULL, 16) >> 16) == PCIROM_DISPLAY_CLASS);
+}
+
+bool PCIROMCapture(const char *SysfsRoot, PCIROMVisitFn Visit, void *Ctx)
+{
+	PCIROMDevice *Devs = NULL;
+	struct dirent **Entries;
+	char *DevicesDir;
+	uint32_t DevCount = 0, ROMCount = 0;
+	int EntryCount;
+	bool Ok = false;
+
+	if(!(DevicesDir = (char *)malloc(strlen(SysfsRoot) + sizeof(PCIROM_DEVICES_DIR))))
+	{
+		printf("Out of memory.\n");
+		return(false);
+	}
+
+	sprintf(DevicesDir, "%s%s", SysfsRoot, PCIROM_DEVICES_DIR);
+
+	// Sorted, the devices are captured and reported in address order.
+	if((EntryCount = scandir(DevicesDir, &Entries, NULL, alphasort)) < 0)
+	{
+		printf("Unable to list PCI devices in %s (%s).\n", DevicesDir, strerror(errno));
+		free(DevicesDir);
+		return(false);
+	}
+
+	if(!(Devs = (PCIROMDevice *)calloc(EntryCount + 1, sizeof(PCIROMDevice))))
+	{
+		printf("Out of memory.\n");
+		goto out;
+	}
+
+	for(int e = 0; e < EntryCount; ++e)
+	{
+		const char *Name = Entries[e]->d_name;
+		size_t DirLen = strlen(DevicesDir) + strlen(Name) + 2;
+		char *Dir;
+
+		if(Name[0] == '.') continue;
+
+		if(!(Dir = (char *)malloc(DirLen)) || !(Devs[DevCount].ROMPath = (char *)malloc(DirLen + 4)) || !(Devs[DevCount].Address = strdup(Name)))
+		{
+			printf("Out of memory.\n");
+			free(Dir);
+			DevCount++;
+			goto out;
+		}
+
+		sprintf(Dir, "%s/%s", DevicesDir, Name);
+		sprintf(Devs[DevCount].ROMPath, "%s/rom", Dir);
+
+		if(PCIROMIsDisplay(Dir) && !access(Devs[DevCount].ROMPath, F_OK)) DevCount++;
+		else
+		{
+			free(Devs[DevCount].ROMPath);
+			free(Devs[DevCount].Address);
+			Devs[DevCount].ROMPath = Devs[DevCount].Address = NULL;
+		}
+
+		free(Dir);
+	}
+
+	// A device whose thread cannot be started is read here instead.
+	for(uint32_t d = 0; d < DevCount; ++d)
+	{
+		if(!(Devs[d].Started = !pthread_create(&Devs[d].Thread, NULL, PCIROMDeviceThread, Devs + d))) PCIROMDeviceThread(Devs + d);
+	}
+
+	for(uint32_t d = 0; d < DevCount; ++d)
+	{
+		if(Devs[d].Started) pthread_join(Devs[d].Thread, NULL);
+	}
+
+	Ok = true;
+
+	for(uint32_t d = 0; d < DevCount; ++d)
+	{
+		char *ROMName;
+
+		if(Devs[d].Err)
+		{
+			printf("Unable to %s the ROM of %s (%s).\n", Devs[d].ErrWhat, Devs[d].Address, strerror(Devs[d].Err));
+			Ok = false;
+			continue;
+		}
+
+		if((Devs[d].Size < 2) || (*((uint16_t *)Devs[d].Image) != PCI_EXPANSION_ROM_SIGNATURE))
+		{
+			printf("The ROM of %s is not a valid expansion ROM, skipping it.\n", Devs[d].Address);
+			Ok = false;
+			continue;
+		}
+
+		if(!(ROMName = (char *)malloc(strlen(Devs[d].Address) + 5)))
+		{
+			printf("Out of memory.\n");
+			Ok = false;
+			break;
+		}
+
+		sprintf(ROMName, "pci:%s", Devs[d].Address);
+		ROMCount++;
+
+		if(!Visit(Ctx, ROMName, Devs[d].Image, Devs[d].Size))
+		{
+			free(ROMName);
+			Ok = false;
+			break;
+		}
+
+		free(ROMName);
+	}
+
+	fprintf(stderr, "Captured %u ROMs from %u display devices under %s.\n", ROMCount, DevCount, DevicesDir);
+
+out:
+	for(uint32_t d = 0; Devs && (d < DevCount); ++d)
+	{
+		free(Devs[d].Address);
+		free(Devs[d].ROMPath);
+		free(Devs[d].Image);
+	}
+
+	for(int e = 0; e < EntryCount; ++e) free(Entries[e]);
+	free(Entries);
+
+	free(Devs);
+	free(DevicesDir);
+
+	return(Ok);
+}
@@ -0,0 +1,34 @@
+// Copyright 2022 Wolf9466/Wolf0/OhGodAPet
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Capturing the ROMs of the GPUs installed in the machine, through
+// the rom attribute Linux gives each PCI device in sysfs:
+//
+//	<root>/bus/pci/devices/<address>/class
+//	<root>/bus/pci/devices/<address>/rom
+//
+// Every display-class device (class 0x03xxxx) with a rom attribute
+// is read at once, each on its own thread, into memory. The kernel
+// refuses to read a ROM whose attribute is off (with EINVAL), so
+// such an attribute is turned on, the ROM read, and the attribute
+// turned off again; that needs root. Anything readable as it is, as
+// a plain file in a fake tree is, is just read, so the root can be
+// pointed at one to test without a GPU.
+//
+// Once all are read, the ROMs are handed over one at a time, in
+// address order, named pci:<address>.
+
+#define PCIROM_DEFAULT_SYSFS_ROOT			"/sys"
+#define PCIROM_DEVICES_DIR					"/bus/pci/devices"
+#define PCIROM_DISPLAY_CLASS				0x03
+
+// Called with each ROM; returning false stops the capture, which
+// then fails.
+typedef bool (*PCIROMVisitFn)(void *Ctx, const char *ROMName, uint8_t *Image, size_t Size);
+
+bool PCIROMCapture(const char *SysfsRoot, PCIROMVisitFn Visit, void *Ctx);
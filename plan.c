@@ -0,0 +1,584 @@
+#include <stdio.h>
+#include <ctype.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdbool.h>
+
+#include "vbios-tables.h"
+#include "vbios.h"
+#include "voi.h"
+#include "reloc.h"
+#include "plan.h"
+
+static const struct
+{
+	const char *Name;
+	uint8_t Flag;
+} VOEditFields[] =
+{
+	{ "type", VOEDIT_SET_TYPE },
+	{ "regid", VOEDIT_SET_REGID },
+	{ "i2cline", VOEDIT_SET_I2CLINE },
+	{ "i2caddr", VOEDIT_SET_I2CADDR },
+	{ "ctrloffset", VOEDIT_SET_CTRLOFFSET },
+	{ "ctrlflag", VOEDIT_SET_CTRLFLAG }
+};
+
+static int HexNibble(char c)
+{
+	if((c >= '0') && (c <= '9')) return(c - '0');
+	if((c >= 'a') && (c <= 'f')) return(c - 'a' + 10);
+	if((c >= 'A') && (c <= 'F')) return(c - 'A' + 10);
+	return(-1);
+}
+
+// Parses Len characters of Spec naming a field value. Numbers may
+// be decimal or 0x-prefixed hex; the type may also be given by name.
+static bool ParseVOEditValue(uint8_t Flag, const char *Spec, size_t Len, uint8_t *Value)
+{
+	char Token[64], *End;
+	unsigned long Tmp;
+	
+	if(!Len || (Len >= sizeof(Token))) return(false);
+	
+	memcpy(Token, Spec, Len);
+	Token[Len] = 0x00;
+	
+	if((Flag == VOEDIT_SET_TYPE) && VoltageTypeFromName(Token, Value)) return(true);
+	
+	Tmp = strtoul(Token, &End, 0);
+	
+	if(*End || (Tmp > 0xFF)) return(false);
+	
+	*Value = Tmp;
+	return(true);
+}
+
+bool ParseVOEdit(VOEdit *Edit, const char *Spec)
+{
+	const char *Pos = Spec, *Payload = strchr(Spec, ':');
+	const char *SpecEnd = (Payload) ? Payload : Spec + strlen(Spec);
+	size_t TargetLen = strcspn(Spec, ",:");
+	
+	memset(Edit, 0x00, sizeof(VOEdit));
+	
+	if((TargetLen == 6) && !strncasecmp(Spec, "append", 6))
+	{
+		// Same defaults the interactive editor uses.
+		Edit->Index = VOEDIT_APPEND;
+		Edit->Hdr.VOType = VOLTAGE_TYPE_VDDC;
+		Edit->Hdr.VOMode = VOLTAGE_MODE_INIT_REGULATOR;
+		Edit->Hdr.AsType3.RegulatorID = 0x08;
+		Edit->Hdr.AsType3.I2CLine = 150;
+		Edit->Hdr.AsType3.I2CAddress = 0x10;
+	}
+	else
+	{
+		char *End;
+		unsigned long Idx = strtoul(Spec, &End, 10);
+		
+		if(!TargetLen || (End != (Spec + TargetLen)) || (Idx > 0xFFFF))
+		{
+			printf("Invalid edit target in \"%s\".\n", Spec);
+			return(false);
+		}
+		
+		Edit->Index = Idx;
+	}
+	
+	Pos = Spec + TargetLen;
+	
+	// Field assignments
+	while((Pos < SpecEnd) && (*Pos == ','))
+	{
+		const char *Eq, *FieldEnd;
+		uint8_t Flag = 0, Value;
+		
+		Pos++;
+		FieldEnd = Pos + strcspn(Pos, ",:");
+		Eq = memchr(Pos, '=', FieldEnd - Pos);
+		
+		if(Eq)
+		{
+			for(size_t i = 0; i < (sizeof(VOEditFields) / sizeof(VOEditFields[0])); ++i)
+				if((strlen(VOEditFields[i].Name) == (size_t)(Eq - Pos)) && !strncasecmp(Pos, VOEditFields[i].Name, Eq - Pos)) Flag = VOEditFields[i].Flag;
+		}
+		
+		if(!Flag || !ParseVOEditValue(Flag, Eq + 1, FieldEnd - Eq - 1, &Value))
+		{
+			printf("Invalid field assignment \"%.*s\" in edit \"%s\".\n", (int)(FieldEnd - Pos), Pos, Spec);
+			return(false);
+		}
+		
+		if(Flag == VOEDIT_SET_TYPE) Edit->Hdr.VOType = Value;
+		else if(Flag == VOEDIT_SET_REGID) Edit->Hdr.AsType3.RegulatorID = Value;
+		else if(Flag == VOEDIT_SET_I2CLINE) Edit->Hdr.AsType3.I2CLine = Value;
+		else if(Flag == VOEDIT_SET_I2CADDR) Edit->Hdr.AsType3.I2CAddress = Value;
+		else if(Flag == VOEDIT_SET_CTRLOFFSET) Edit->Hdr.AsType3.ControlOffset = Value;
+		else Edit->Hdr.AsType3.VoltageControlFlag = Value;
+		
+		Edit->SetMask |= Flag;
+		Pos = FieldEnd;
+	}
+	
+	if(Pos != SpecEnd)
+	{
+		printf("Invalid edit \"%s\".\n", Spec);
+		return(false);
+	}
+	
+	// Payload
+	if(Payload)
+	{
+		size_t HexLen = strlen(++Payload);
+		
+		if(!HexLen || (HexLen & 1) || ((HexLen >> 1) > (0xFFFF - sizeof(VoltageObject))))
+		{
+			printf("Invalid payload in edit \"%s\".\n", Spec);
+			return(false);
+		}
+		
+		Edit->Data = (uint8_t *)malloc(HexLen >> 1);
+		
+		if(!Edit->Data) return(false);
+		
+		for(size_t i = 0; i < HexLen; i += 2)
+		{
+			int Hi = HexNibble(Payload[i]), Lo = HexNibble(Payload[i + 1]);
+			
+			if((Hi < 0) || (Lo < 0))
+			{
+				printf("Invalid payload in edit \"%s\".\n", Spec);
+				FreeVOEdit(Edit);
+				return(false);
+			}
+			
+			Edit->Data[i >> 1] = (Hi << 4) | Lo;
+		}
+		
+		Edit->DataLen = HexLen >> 1;
+		Edit->SetMask |= VOEDIT_SET_DATA;
+	}
+	else if(Edit->Index == VOEDIT_APPEND)
+	{
+		// Just the terminator (0xFF00)
+		Edit->Data = (uint8_t *)malloc(2);
+		
+		if(!Edit->Data) return(false);
+		
+		Edit->Data[0] = 0xFF;
+		Edit->Data[1] = 0x00;
+		Edit->DataLen = 2;
+		Edit->SetMask |= VOEDIT_SET_DATA;
+	}
+	
+	return(true);
+}
+
+void FreeVOEdit(VOEdit *Edit)
+{
+	free(Edit->Data);
+	Edit->Data = NULL;
+	Edit->DataLen = 0;
+}
+
+// Fills OutVO and OutNode with the VO that results from applying
+// Edit to OrigVO (which is ignored when appending.) The node's data
+// points into the edit or the original VO; nothing is allocated.
+void VOEditBuildNode(const VOEdit *Edit, const VoltageObject *OrigVO, const uint8_t *OrigData, uint32_t OrigDataLen, VoltageObject *OutVO, VOListNode *OutNode)
+{
+	*OutVO = ((Edit->Index == VOEDIT_APPEND) || (Edit->SetMask & VOEDIT_SET_HDR)) ? Edit->Hdr : *OrigVO;
+	
+	if(Edit->SetMask & VOEDIT_SET_TYPE) OutVO->VOType = Edit->Hdr.VOType;
+	if(Edit->SetMask & VOEDIT_SET_REGID) OutVO->AsType3.RegulatorID = Edit->Hdr.AsType3.RegulatorID;
+	if(Edit->SetMask & VOEDIT_SET_I2CLINE) OutVO->AsType3.I2CLine = Edit->Hdr.AsType3.I2CLine;
+	if(Edit->SetMask & VOEDIT_SET_I2CADDR) OutVO->AsType3.I2CAddress = Edit->Hdr.AsType3.I2CAddress;
+	if(Edit->SetMask & VOEDIT_SET_CTRLOFFSET) OutVO->AsType3.ControlOffset = Edit->Hdr.AsType3.ControlOffset;
+	if(Edit->SetMask & VOEDIT_SET_CTRLFLAG) OutVO->AsType3.VoltageControlFlag = Edit->Hdr.AsType3.VoltageControlFlag;
+	
+	memset(OutNode, 0x00, sizeof(VOListNode));
+	OutNode->VO = OutVO;
+	
+	if(Edit->SetMask & VOEDIT_SET_DATA)
+	{
+		OutNode->VOData = Edit->Data;
+		OutNode->VODataLen = Edit->DataLen;
+	}
+	else
+	{
+		OutNode->VOData = (uint8_t *)OrigData;
+		OutNode->VODataLen = OrigDataLen;
+	}
+	
+	OutVO->VOSize = sizeof(VoltageObject) + OutNode->VODataLen;
+}
+
+typedef struct
+{
+	uint16_t Index;
+	VoltageObject *VO;
+} VOFindCtx;
+
+static bool FindVOVisit(VoltageObject *VO, uint8_t *VOData, uint32_t VODataLen, uint16_t Index, void *Ctx)
+{
+	VOFindCtx *Find = (VOFindCtx *)Ctx;
+	
+	(void)VOData;
+	(void)VODataLen;
+	
+	if(Index == Find->Index) Find->VO = VO;
+	
+	return(true);
+}
+
+// Finds the VO an edit refers to by its index in the table, in
+// place. Returns NULL if there is no such VO.
+VoltageObject *VOEditFindVO(const VBIOSInfo *Info, int32_t Index)
+{
+	VOFindCtx Find = { (uint16_t)Index, NULL };
+	
+	if((Index < 0) || (WalkVOTable(Info->Image + Info->VOITblOffset, 0xFF, NULL, FindVOVisit, &Find) < 0)) return(NULL);
+	
+	return(Find.VO);
+}
+
+// Makes each edit in turn through the relocation engine, exactly as
+// the interactive editor would. Edits refer to VOs by their index in
+// the table at the time they are made. Stops at the first failure;
+// the edits before it remain applied. With VBIOS_RELOC_MOVE, the VOI
+// table is moved at most once, up front, if VBIOSPlanEdits() says so.
+bool VBIOSApplyVOEdits(VBIOSInfo *Info, const VOEdit *Edits, uint32_t EditCount, uint8_t Strategy)
+{
+	if(Strategy == VBIOS_RELOC_MOVE)
+	{
+		VBIOSPlan Plan;
+		
+		if(!VBIOSPlanEdits(&Plan, Info, Edits, EditCount, Strategy))
+		{
+			printf("Unable to make the edits: %s.\n", Plan.Error);
+			return(false);
+		}
+		
+		if((Plan.NewVOIOffset != Plan.VOIOffset) && !VBIOSMoveVOI(Info, NULL)) return(false);
+	}
+	
+	for(uint32_t i = 0; i < EditCount; ++i)
+	{
+		VoltageObject NewVO;
+		VOListNode NewNode;
+		uint32_t Offset, OldSize = 0;
+		
+		if(Edits[i].Index == VOEDIT_APPEND)
+		{
+			VOEditBuildNode(Edits + i, NULL, NULL, 0, &NewVO, &NewNode);
+			Offset = Info->VOITblOffset + Info->VOIHdr->usStructureSize;
+		}
+		else
+		{
+			VoltageObject *OrigVO = VOEditFindVO(Info, Edits[i].Index);
+			
+			if(!OrigVO)
+			{
+				printf("VO %d does not exist.\n", Edits[i].Index);
+				return(false);
+			}
+			
+			VOEditBuildNode(Edits + i, OrigVO, ((uint8_t *)OrigVO) + sizeof(VoltageObject), OrigVO->VOSize - sizeof(VoltageObject), &NewVO, &NewNode);
+			Offset = ((uint8_t *)OrigVO) - Info->Image;
+			OldSize = OrigVO->VOSize;
+		}
+		
+		if(!VBIOSReplaceVO(Info, Offset, OldSize, &NewNode, NULL)) return(false);
+	}
+	
+	return(true);
+}
+
+typedef struct
+{
+	VBIOSPlan *Plan;
+	const VOEdit *Edits;
+	uint32_t EditCount;
+	const uint8_t *VOITableBase;
+} VBIOSPlanWalk;
+
+// Finds the VOs the edits refer to and records where they are.
+static bool PlanVisit(VoltageObject *VO, uint8_t *VOData, uint32_t VODataLen, uint16_t Index, void *Ctx)
+{
+	VBIOSPlanWalk *Walk = (VBIOSPlanWalk *)Ctx;
+	
+	for(uint32_t i = 0; i < Walk->EditCount; ++i)
+	{
+		VBIOSPlanEdit *PlanEdit = Walk->Plan->Edits + i;
+		VoltageObject NewVO;
+		VOListNode NewNode;
+		
+		if(Walk->Edits[i].Index != Index) continue;
+		
+		if(VO->VOMode != VOLTAGE_MODE_INIT_REGULATOR)
+		{
+			snprintf(Walk->Plan->Error, sizeof(Walk->Plan->Error), "VO %d has mode %s, which cannot be edited", Index, VoltageModeName(VO->VOMode));
+			return(false);
+		}
+		
+		VOEditBuildNode(Walk->Edits + i, VO, VOData, VODataLen, &NewVO, &NewNode);
+		
+		if(NewVO.VOMode != VOLTAGE_MODE_INIT_REGULATOR)
+		{
+			snprintf(Walk->Plan->Error, sizeof(Walk->Plan->Error), "VO %d would get mode %d, which cannot be serialized", Index, NewVO.VOMode);
+			return(false);
+		}
+		
+		PlanEdit->Offset = ((const uint8_t *)VO) - Walk->VOITableBase;
+		PlanEdit->OldSize = VO->VOSize;
+		PlanEdit->NewSize = NewVO.VOSize;
+	}
+	
+	return(true);
+}
+
+// Works out the final layout of the image after making every edit
+// in Edits, without modifying or copying the image: whether the
+// change fits in the legacy image's padding, how far it must grow,
+// and every master table entry the relocation engine would rewrite,
+// with its old and new value. Only the headers of the tables are
+// read, so this costs about as much as parsing the ROM does.
+bool VBIOSPlanEdits(VBIOSPlan *Plan, const VBIOSInfo *Info, const VOEdit *Edits, uint32_t EditCount, uint8_t Strategy)
+{
+	VBIOSPlanWalk Walk = { Plan, Edits, EditCount, Info->Image + Info->VOITblOffset };
+	VBIOSFixup Fixups[VBIOS_MAX_FIXUPS];
+	uint32_t FixupCount, FirstChange = UINT32_MAX, MaxVOISize;
+	uint32_t ChangeStart[VBIOS_PLAN_MAX_EDITS];
+	
+	memset(Plan, 0x00, sizeof(VBIOSPlan));
+	
+	Plan->OldLegacyLen = Info->Chain.Images[0].Length;
+	Plan->PaddingLen = VBIOSGetPaddingLength(Info);
+	Plan->OldSize = Info->Size;
+	Plan->VOIOffset = Plan->NewVOIOffset = Info->VOITblOffset;
+	Plan->OldVOISize = MaxVOISize = Info->VOIHdr->usStructureSize;
+	
+	if(EditCount > VBIOS_PLAN_MAX_EDITS)
+	{
+		snprintf(Plan->Error, sizeof(Plan->Error), "too many edits (at most %d are allowed)", VBIOS_PLAN_MAX_EDITS);
+		return(false);
+	}
+	
+	Plan->EditCount = EditCount;
+	
+	for(uint32_t i = 0; i < EditCount; ++i)
+	{
+		Plan->Edits[i].Index = Edits[i].Index;
+		
+		for(uint32_t j = 0; j < i; ++j)
+		{
+			if((Edits[i].Index != VOEDIT_APPEND) && (Edits[j].Index == Edits[i].Index))
+			{
+				snprintf(Plan->Error, sizeof(Plan->Error), "VO %d is edited more than once", Edits[i].Index);
+				return(false);
+			}
+		}
+	}
+	
+	if(WalkVOTable(Info->Image + Info->VOITblOffset, 0xFF, NULL, PlanVisit, &Walk) < 0)
+	{
+		if(!Plan->Error[0]) snprintf(Plan->Error, sizeof(Plan->Error), "VOI table is malformed");
+		return(false);
+	}
+	
+	// Edits are made one at a time, in order, so an appended VO goes at
+	// the end of the table as the edits before it have left it, and the
+	// padding may run out part way through, even if it would hold the
+	// net change in size.
+	for(uint32_t i = 0, PadLeft = Plan->PaddingLen; i < EditCount; ++i)
+	{
+		VBIOSPlanEdit *PlanEdit = Plan->Edits + i;
+		
+		if(Edits[i].Index == VOEDIT_APPEND)
+		{
+			VoltageObject NewVO;
+			VOListNode NewNode;
+			
+			VOEditBuildNode(Edits + i, NULL, NULL, 0, &NewVO, &NewNode);
+			
+			if(NewVO.VOMode != VOLTAGE_MODE_INIT_REGULATOR)
+			{
+				snprintf(Plan->Error, sizeof(Plan->Error), "appended VO would have mode %d, which cannot be serialized", NewVO.VOMode);
+				return(false);
+			}
+			
+			PlanEdit->Offset = Plan->OldVOISize + Plan->SizeDiff;
+			PlanEdit->NewSize = NewVO.VOSize;
+		}
+		else if(!PlanEdit->OldSize)
+		{
+			snprintf(Plan->Error, sizeof(Plan->Error), "VO %d does not exist", Edits[i].Index);
+			return(false);
+		}
+		
+		// Table offsets at or past the end of the old VO move; in the
+		// unmodified image, every append is at the end of the table.
+		if(Edits[i].Index == VOEDIT_APPEND) ChangeStart[i] = Plan->VOIOffset + Plan->OldVOISize;
+		else ChangeStart[i] = Plan->VOIOffset + PlanEdit->Offset + PlanEdit->OldSize;
+		
+		if(ChangeStart[i] < FirstChange) FirstChange = ChangeStart[i];
+		
+		const int32_t EditDiff = (int32_t)PlanEdit->NewSize - (int32_t)PlanEdit->OldSize;
+		
+		// If the padding runs out, the legacy image grows by whole
+		// 512-byte blocks, as in VBIOSCreateDelta().
+		if((EditDiff > 0) && ((uint32_t)EditDiff > PadLeft))
+		{
+			const uint32_t Needed = EditDiff - PadLeft;
+			const uint32_t GrowLen = ((Needed + PCI_EXPANSION_ROM_BLOCK_SIZE - 1) / PCI_EXPANSION_ROM_BLOCK_SIZE) * PCI_EXPANSION_ROM_BLOCK_SIZE;
+			
+			Plan->GrowLen += GrowLen;
+			PadLeft += GrowLen;
+		}
+		
+		PadLeft -= EditDiff;
+		Plan->SizeDiff += EditDiff;
+		
+		if((int32_t)(Plan->OldVOISize + Plan->SizeDiff) > (int32_t)MaxVOISize) MaxVOISize = Plan->OldVOISize + Plan->SizeDiff;
+	}
+	
+	Plan->NewVOISize = Plan->OldVOISize + Plan->SizeDiff;
+	Plan->NewLegacyLen = Plan->OldLegacyLen;
+	Plan->NewSize = Plan->OldSize;
+	
+	if(Plan->NewVOISize > 0xFFFF)
+	{
+		snprintf(Plan->Error, sizeof(Plan->Error), "VOI table would grow to %u bytes", Plan->NewVOISize);
+		return(false);
+	}
+	
+	// Moved into the padding, the VOI table has room to grow, at its
+	// largest along the way, without anything after it; only its own
+	// master data table entry moves.
+	if((Strategy == VBIOS_RELOC_MOVE) && EditCount && VBIOSShouldMoveVOI(Info, MaxVOISize))
+	{
+		Plan->NewVOIOffset = Plan->OldLegacyLen - Plan->PaddingLen;
+		Plan->GrowLen = 0;
+		
+		Plan->Moves[0].Fixup.Table = VBIOS_FIXUP_DATA_TABLE;
+		Plan->Moves[0].Fixup.Index = offsetof(ATOM_MASTER_LIST_OF_DATA_TABLES, VoltageObjectInfo) / sizeof(uint16_t);
+		Plan->Moves[0].OldOffset = Plan->VOIOffset;
+		Plan->Moves[0].NewOffset = Plan->NewVOIOffset;
+		Plan->MoveCount = 1;
+		
+		Plan->Fits = true;
+		return(true);
+	}
+	
+	if(Plan->GrowLen)
+	{
+		Plan->NewLegacyLen += Plan->GrowLen;
+		Plan->NewSize += Plan->GrowLen;
+		
+		if((Plan->NewLegacyLen > (0xFF * PCI_EXPANSION_ROM_BLOCK_SIZE)) || (Plan->NewSize > AMD_VBIOS_MAX_SIZE))
+		{
+			snprintf(Plan->Error, sizeof(Plan->Error), "legacy image would grow past the maximum size (%u bytes)", Plan->NewLegacyLen);
+			return(false);
+		}
+	}
+	
+	if(!EditCount)
+	{
+		Plan->Fits = true;
+		return(true);
+	}
+	
+	// Every table offset at or past the first change is a candidate;
+	// each moves by the sum of the changes that start at or before it.
+	FixupCount = CollectTableFixups(Info->Image, Info->ROMHdr, FirstChange, Fixups);
+	
+	for(uint32_t i = 0; i < FixupCount; ++i)
+	{
+		const uint16_t OldOffset = *VBIOSGetFixupEntry(Info->Image, Info->ROMHdr, Fixups + i);
+		int32_t Moved = 0;
+		
+		for(uint32_t e = 0; e < EditCount; ++e)
+			if(OldOffset >= ChangeStart[e]) Moved += (int32_t)Plan->Edits[e].NewSize - (int32_t)Plan->Edits[e].OldSize;
+		
+		if(!Moved) continue;
+		
+		if((OldOffset + Moved) > 0xFFFF)
+		{
+			snprintf(Plan->Error, sizeof(Plan->Error), "table at 0x%04X would move out of 16-bit range", OldOffset);
+			return(false);
+		}
+		
+		Plan->Moves[Plan->MoveCount].Fixup = Fixups[i];
+		Plan->Moves[Plan->MoveCount].OldOffset = OldOffset;
+		Plan->Moves[Plan->MoveCount].NewOffset = OldOffset + Moved;
+		Plan->MoveCount++;
+	}
+	
+	Plan->Fits = true;
+	return(true);
+}
+
+static const char *VBIOSFixupTableNames[] = { "data", "command", "rom_header" };
+
+// Prints a plan as a single line of JSON, so that the plans for a
+// whole batch of ROMs may be fed to other tools as JSON lines.
+void VBIOSPrintPlan(const VBIOSPlan *Plan, const VBIOSInfo *Info, const char *ROMName)
+{
+	if(!Plan->Fits)
+	{
+		VBIOSPrintPlanError(ROMName, Plan->Error);
+		return;
+	}
+	
+	printf("{\"rom\":");
+	PrintJSONString(ROMName);
+	printf(",\"ok\":true");
+	printf(",\"size\":%zu,\"new_size\":%zu", Plan->OldSize, Plan->NewSize);
+	printf(",\"legacy_len\":%u,\"new_legacy_len\":%u,\"padding\":%u", Plan->OldLegacyLen, Plan->NewLegacyLen, Plan->PaddingLen);
+	printf(",\"size_change\":%d,\"fits_padding\":%s,\"grow\":%u", Plan->SizeDiff, (Plan->GrowLen) ? "false" : "true", Plan->GrowLen);
+	printf(",\"voi\":{\"offset\":%u,\"new_offset\":%u,\"size\":%u,\"new_size\":%u}", Plan->VOIOffset, Plan->NewVOIOffset, Plan->OldVOISize, Plan->NewVOISize);
+	
+	printf(",\"edits\":[");
+	
+	for(uint32_t i = 0; i < Plan->EditCount; ++i)
+	{
+		if(i) putchar(',');
+		
+		if(Plan->Edits[i].Index == VOEDIT_APPEND) printf("{\"vo\":\"append\"");
+		else printf("{\"vo\":%d", Plan->Edits[i].Index);
+		
+		printf(",\"offset\":%u,\"size\":%u,\"new_size\":%u}", Plan->VOIOffset + Plan->Edits[i].Offset, Plan->Edits[i].OldSize, Plan->Edits[i].NewSize);
+	}
+	
+	printf("],\"moves\":[");
+	
+	for(uint32_t i = 0; i < Plan->MoveCount; ++i)
+	{
+		const VBIOSPlanMove *Move = Plan->Moves + i;
+		
+		printf("%s{\"table\":\"%s\",\"index\":%u,\"offset\":%u,\"new_offset\":%u}", (i) ? "," : "", VBIOSFixupTableNames[Move->Fixup.Table], Move->Fixup.Index, Move->OldOffset, Move->NewOffset);
+	}
+	
+	printf("],\"images\":[");
+	
+	for(uint32_t i = 0; i < Info->Chain.ImageCount; ++i)
+	{
+		const VBIOSROMImage *Img = Info->Chain.Images + i;
+		
+		printf("%s{\"offset\":%u,\"new_offset\":%u,\"length\":%u,\"new_length\":%u,\"code_type\":%u}", (i) ? "," : "", Img->Offset, Img->Offset + ((i) ? Plan->GrowLen : 0), Img->Length, Img->Length + ((i) ? 0 : Plan->GrowLen), Img->CodeType);
+	}
+	
+	printf("]}\n");
+}
+
+void VBIOSPrintPlanError(const char *ROMName, const char *Error)
+{
+	printf("{\"rom\":");
+	PrintJSONString(ROMName);
+	printf(",\"ok\":false,\"error\":");
+	PrintJSONString(Error);
+	printf("}\n");
+}
@@ -0,0 +1,106 @@
+// Copyright 2022 Wolf9466/Wolf0/OhGodAPet
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "vbios.h"
+#include "voi.h"
+#include "reloc.h"
+
+// A VO edit, given on the command line as
+//
+//	<target>[,<field>=<value>...][:<hex payload>]
+//
+// where target is the index of a VO in the VOI table (as counted
+// by WalkVOTable(), all modes included) or "append" to add a new
+// one at the end of the table. The fields that may be set are
+// type, regid, i2cline, i2caddr, ctrloffset and ctrlflag; only
+// VOs with mode INIT_REGULATOR may be edited or appended, as
+// only those can be serialized. Without a payload, an edited VO
+// keeps its own, and an appended one gets just the terminator.
+// For example:
+//
+//	3:2604ff00
+//	append,i2cline=150,i2caddr=0x10:8d10ff00
+
+#define VOEDIT_APPEND						-1
+
+#define VOEDIT_SET_TYPE						0x01
+#define VOEDIT_SET_REGID					0x02
+#define VOEDIT_SET_I2CLINE					0x04
+#define VOEDIT_SET_I2CADDR					0x08
+#define VOEDIT_SET_CTRLOFFSET				0x10
+#define VOEDIT_SET_CTRLFLAG					0x20
+#define VOEDIT_SET_DATA						0x40
+
+// Hdr replaces the whole VO and mode header; used for edits that
+// are generated rather than typed, such as in archives.
+#define VOEDIT_SET_HDR						0x80
+
+#define VBIOS_PLAN_MAX_EDITS				32
+
+typedef struct
+{
+	int32_t Index;
+	uint8_t SetMask;
+	VoltageObject Hdr;
+	uint32_t DataLen;
+	uint8_t *Data;
+} VOEdit;
+
+typedef struct
+{
+	int32_t Index;
+	uint32_t Offset;
+	uint32_t OldSize;
+	uint32_t NewSize;
+} VBIOSPlanEdit;
+
+typedef struct
+{
+	VBIOSFixup Fixup;
+	uint16_t OldOffset;
+	uint16_t NewOffset;
+} VBIOSPlanMove;
+
+// What a set of edits would do to an image, worked out from its
+// tables alone. Offsets are those in the unmodified image, except for
+// appended VOs, each of which is where it lands once the edits before
+// it are made. GrowLen is the legacy image's growth over all of the
+// edits, made one at a time. If the edits cannot be made, Fits is
+// false and Error says why. The VOI table ends up at NewVOIOffset,
+// which is VOIOffset unless the VBIOS_RELOC_MOVE strategy moves it.
+typedef struct
+{
+	bool Fits;
+	char Error[128];
+	uint32_t OldLegacyLen;
+	uint32_t NewLegacyLen;
+	uint32_t PaddingLen;
+	int32_t SizeDiff;
+	uint32_t GrowLen;
+	size_t OldSize;
+	size_t NewSize;
+	uint32_t VOIOffset;
+	uint32_t NewVOIOffset;
+	uint32_t OldVOISize;
+	uint32_t NewVOISize;
+	uint32_t EditCount;
+	VBIOSPlanEdit Edits[VBIOS_PLAN_MAX_EDITS];
+	uint32_t MoveCount;
+	VBIOSPlanMove Moves[VBIOS_MAX_FIXUPS];
+} VBIOSPlan;
+
+bool ParseVOEdit(VOEdit *Edit, const char *Spec);
+void FreeVOEdit(VOEdit *Edit);
+VoltageObject *VOEditFindVO(const VBIOSInfo *Info, int32_t Index);
+void VOEditBuildNode(const VOEdit *Edit, const VoltageObject *OrigVO, const uint8_t *OrigData, uint32_t OrigDataLen, VoltageObject *OutVO, VOListNode *OutNode);
+
+bool VBIOSApplyVOEdits(VBIOSInfo *Info, const VOEdit *Edits, uint32_t EditCount, uint8_t Strategy);
+
+bool VBIOSPlanEdits(VBIOSPlan *Plan, const VBIOSInfo *Info, const VOEdit *Edits, uint32_t EditCount, uint8_t Strategy);
+void VBIOSPrintPlan(const VBIOSPlan *Plan, const VBIOSInfo *Info, const char *ROMName);
+void VBIOSPrintPlanError(const char *ROMName, const char *Error);
@@ -0,0 +1,176 @@
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+#include "wolfvoitool.h"
+#include "queue.h"
+
+bool ROMQueueOpen(ROMQueue *Queue, const char *ManifestName)
+{
+	char HostName[64] = "localhost";
+	size_t Len = strlen(ManifestName) + sizeof(ROMQUEUE_CLAIMS_SUFFIX);
+	uint32_t Hash = 2166136261u;
+	
+	memset(Queue, 0x00, sizeof(ROMQueue));
+	
+	if(!ReadROMList(&Queue->ROMFiles, &Queue->ROMFileCount, ManifestName)) goto fail;
+	
+	gethostname(HostName, sizeof(HostName) - 1);
+	snprintf(Queue->Owner, sizeof(Queue->Owner), "%s:%d", HostName, (int)getpid());
+	
+	if(!(Queue->ClaimDir = (char *)malloc(Len)) || !(Queue->TmpName = (char *)malloc(Len + sizeof(Queue->Owner) + 8)))
+	{
+		printf("Out of memory.\n");
+		goto fail;
+	}
+	
+	snprintf(Queue->ClaimDir, Len, "%s" ROMQUEUE_CLAIMS_SUFFIX, ManifestName);
+	sprintf(Queue->TmpName, "%s/.%s.tmp", Queue->ClaimDir, Queue->Owner);
+	
+	if(mkdir(Queue->ClaimDir, 0777) && (errno != EEXIST))
+	{
+		printf("Unable to create %s (%s).\n", Queue->ClaimDir, strerror(errno));
+		goto fail;
+	}
+	
+	// FNV-1a of the owner picks where this worker starts.
+	for(const char *c = Queue->Owner; *c; ++c) Hash = (Hash ^ (uint8_t)*c) * 16777619u;
+	
+	if(Queue->ROMFileCount) Queue->Start = Hash % Queue->ROMFileCount;
+	
+	return(true);
+	
+fail:
+	ROMQueueFree(Queue);
+	return(false);
+}
+
+// Returns the locked claim's descriptor, -1 if the ROM is claimed
+// by a live worker or done, or -2 on error.
+static int ROMQueueTryClaim(ROMQueue *Queue, uint32_t Index)
+{
+	char ClaimName[PATH_MAX], DoneName[PATH_MAX];
+	int Fd;
+	
+	snprintf(ClaimName, sizeof(ClaimName), "%s/%u.claim", Queue->ClaimDir, Index);
+	snprintf(DoneName, sizeof(DoneName), "%s/%u.done", Queue->ClaimDir, Index);
+	
+	Fd = open(Queue->TmpName, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	
+	if((Fd < 0) || flock(Fd, LOCK_EX))
+	{
+		printf("Unable to create a claim in %s (%s).\n", Queue->ClaimDir, strerror(errno));
+		if(Fd >= 0) close(Fd);
+		return(-2);
+	}
+	
+	dprintf(Fd, "%s\n", Queue->Owner);
+	
+	if(!link(Queue->TmpName, ClaimName))
+	{
+		unlink(Queue->TmpName);
+		return(Fd);
+	}
+	
+	if(errno != EEXIST)
+	{
+		printf("Unable to claim %s (%s).\n", ClaimName, strerror(errno));
+		unlink(Queue->TmpName);
+		close(Fd);
+		return(-2);
+	}
+	
+	unlink(Queue->TmpName);
+	close(Fd);
+	
+	// Claimed already; the claim is only up for grabs if its
+	// worker has gone, taking its lock with it, without finishing.
+	if((Fd = open(ClaimName, O_WRONLY)) < 0) return(-1);
+	
+	if(flock(Fd, LOCK_EX | LOCK_NB) || !access(DoneName, F_OK))
+	{
+		close(Fd);
+		return(-1);
+	}
+	
+	fprintf(stderr, "Reclaiming %s, whose worker is gone.\n", Queue->ROMFiles[Index]);
+	
+	if(ftruncate(Fd, 0) || (dprintf(Fd, "%s\n", Queue->Owner) < 0))
+	{
+		close(Fd);
+		return(-2);
+	}
+	
+	return(Fd);
+}
+
+// Claims up to Max ROMs, whose names are then in HeldNames. Returns
+// how many were claimed, which is zero once the whole manifest has
+// been gone through, or -1 on error. Claims must be finished before
+// more are made.
+int32_t ROMQueueClaim(ROMQueue *Queue, uint32_t Max)
+{
+	if(Max > ROMIO_MAX_DEPTH) Max = ROMIO_MAX_DEPTH;
+	
+	while((Queue->HeldCount < Max) && (Queue->Scanned < Queue->ROMFileCount))
+	{
+		uint32_t Index = (Queue->Start + Queue->Scanned++) % Queue->ROMFileCount;
+		int Fd = ROMQueueTryClaim(Queue, Index);
+		
+		if(Fd == -2) return(-1);
+		if(Fd < 0) continue;
+		
+		Queue->Held[Queue->HeldCount] = Index;
+		Queue->HeldFds[Queue->HeldCount] = Fd;
+		Queue->HeldNames[Queue->HeldCount++] = Queue->ROMFiles[Index];
+	}
+	
+	return(Queue->HeldCount);
+}
+
+// Marks every ROM held as done, whether or not it could be
+// processed, and lets go of the claims.
+bool ROMQueueFinish(ROMQueue *Queue)
+{
+	char DoneName[PATH_MAX];
+	bool Ok = true;
+	
+	for(uint32_t i = 0; i < Queue->HeldCount; ++i)
+	{
+		int Fd;
+		
+		snprintf(DoneName, sizeof(DoneName), "%s/%u.done", Queue->ClaimDir, Queue->Held[i]);
+		
+		if((Fd = open(DoneName, O_WRONLY | O_CREAT, 0666)) < 0)
+		{
+			printf("Unable to mark %s as done (%s).\n", Queue->HeldNames[i], strerror(errno));
+			Ok = false;
+		}
+		else close(Fd);
+		
+		close(Queue->HeldFds[i]);
+	}
+	
+	Queue->HeldCount = 0;
+	return(Ok);
+}
+
+void ROMQueueFree(ROMQueue *Queue)
+{
+	for(uint32_t i = 0; i < Queue->HeldCount; ++i) close(Queue->HeldFds[i]);
+	for(uint32_t r = 0; r < Queue->ROMFileCount; ++r) free(Queue->ROMFiles[r]);
+	
+	free(Queue->ROMFiles);
+	free(Queue->ClaimDir);
+	free(Queue->TmpName);
+	
+	memset(Queue, 0x00, sizeof(ROMQueue));
+}
@@ -0,0 +1,55 @@
+// Copyright 2022 Wolf9466/Wolf0/OhGodAPet
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "romio.h"
+
+// A work queue shared by any number of worker processes, on any
+// number of hosts, with no coordinator: just a manifest of ROMs (a
+// batch list, see ReadROMList()) and a claims directory beside it,
+// <manifest>.claims, holding for the Nth ROM in the manifest
+//
+//	N.claim		created by whichever worker claimed it, holding its
+//				host and pid, and kept locked until it is done
+//	N.done		created once it has been processed
+//
+// A claim is made by creating and locking a private file, then
+// hard linking it to N.claim; link() fails if N.claim exists, so
+// exactly one worker wins, and the claim is locked before anyone
+// else can see it. (A plain O_CREAT | O_EXCL open would leave the
+// claim visible but unlocked for a moment, and is not atomic on
+// every network filesystem.)
+//
+// A claim whose lock can be taken, with no N.done beside it, was
+// left by a worker that died; the worker that takes the lock
+// reclaims it. Claims are never removed, so a finished queue is run
+// again by deleting its claims directory.
+//
+// Each worker starts at a different place in the manifest, and
+// wraps around, so that workers starting together rarely race for
+// the same ROMs.
+
+#define ROMQUEUE_CLAIMS_SUFFIX			".claims"
+
+typedef struct
+{
+	char **ROMFiles;
+	uint32_t ROMFileCount;
+	char *ClaimDir;
+	char *TmpName;
+	char Owner[128];
+	uint32_t Start;
+	uint32_t Scanned;
+	uint32_t HeldCount;
+	uint32_t Held[ROMIO_MAX_DEPTH];
+	int HeldFds[ROMIO_MAX_DEPTH];
+	char *HeldNames[ROMIO_MAX_DEPTH];
+} ROMQueue;
+
+bool ROMQueueOpen(ROMQueue *Queue, const char *ManifestName);
+int32_t ROMQueueClaim(ROMQueue *Queue, uint32_t Max);
+bool ROMQueueFinish(ROMQueue *Queue);
+void ROMQueueFree(ROMQueue *Queue);
@@ -0,0 +1,438 @@
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "vbios-tables.h"
+#include "vbios.h"
+#include "voi.h"
+#include "reloc.h"
+#include "freespace.h"
+
+// Beginning at the padding (UEFI image start minus the modification size),
+// copy all bytes up by ModLength bytes, creating empty space at the
+// offset specified by ModificationOffset that is ModLength bytes in size.
+// A negative ModLength moves the bytes down instead, closing up space
+// just below ModificationOffset.
+// Does NOT fix ANY length/size entries!
+void PrepareROMForInsertionMod(void *VBIOSImage, size_t PadOffset, size_t ModificationOffset, int32_t ModLength)
+{
+	uint8_t *ModPosition = ((uint8_t *)VBIOSImage) + ModificationOffset;
+	
+	memmove(ModPosition + ModLength, ModPosition, PadOffset - ModificationOffset);
+}
+
+// Detects the amount of useless filler bytes at the end of the legacy
+// ROM image. 
+uint32_t VBIOSGetPaddingLength(const VBIOSInfo *Info)
+{
+	const uint32_t LegacyLen = Info->Chain.Images[0].Length;
+	
+	// Find the end of the legacy image, then walk backward until
+	// you find a byte that is not 0xFF.
+	return(LegacyLen - VBIOSSkipFillBack(Info->Image, 0, LegacyLen, 0xFF));
+}
+
+// Lists every data and command table offset that is at or past
+// ChangeStartOffset, as well as the master table offsets in the ROM
+// header, which are listed first. Unused (zero) entries are skipped.
+// Returns the number of fixups; if Fixups is NULL, they are only
+// counted. Nothing is modified.
+uint32_t CollectTableFixups(const void *VBIOSImage, const ATOM_ROM_HEADER *VBIOSROMHdr, uint32_t ChangeStartOffset, VBIOSFixup *Fixups)
+{
+	const uint16_t *VBIOSTableEntry;
+	uint32_t DataTableSize, CommandTableSize, FixupCount = 0;
+	const ATOM_MASTER_DATA_TABLE *MasterDataTable = (const ATOM_MASTER_DATA_TABLE *)(VBIOS_OFFSET(VBIOSImage, VBIOSROMHdr->usMasterDataTableOffset));
+	const ATOM_MASTER_COMMAND_TABLE *MasterCommandTable = (const ATOM_MASTER_COMMAND_TABLE *)(VBIOS_OFFSET(VBIOSImage, VBIOSROMHdr->usMasterCommandTableOffset));
+
+	#define ADD_FIXUP(T, I)		do { if(FixupCount < VBIOS_MAX_FIXUPS) { if(Fixups) { Fixups[FixupCount].Table = (T); Fixups[FixupCount].Index = (I); } FixupCount++; } } while(0)
+
+	if(VBIOSROMHdr->usMasterDataTableOffset >= ChangeStartOffset) ADD_FIXUP(VBIOS_FIXUP_ROM_HEADER, 0);
+	if(VBIOSROMHdr->usMasterCommandTableOffset >= ChangeStartOffset) ADD_FIXUP(VBIOS_FIXUP_ROM_HEADER, 1);
+
+	// Since every entry is two bytes, size (less the header) divided by 2 is all entries
+	DataTableSize = MasterDataTable->sHeader.usStructureSize - sizeof(ATOM_COMMON_TABLE_HEADER);
+	CommandTableSize = MasterCommandTable->sHeader.usStructureSize - sizeof(ATOM_COMMON_TABLE_HEADER);
+
+	VBIOSTableEntry = (const uint16_t *)(&MasterDataTable->ListOfDataTables);
+	for(uint32_t i = 0; i < (DataTableSize >> 1); ++i)
+		if(VBIOSTableEntry[i] && (VBIOSTableEntry[i] >= ChangeStartOffset)) ADD_FIXUP(VBIOS_FIXUP_DATA_TABLE, i);
+
+	VBIOSTableEntry = (const uint16_t *)(&MasterCommandTable->ListOfCommandTables);
+	for(uint32_t i = 0; i < (CommandTableSize >> 1); ++i)
+		if(VBIOSTableEntry[i] && (VBIOSTableEntry[i] >= ChangeStartOffset)) ADD_FIXUP(VBIOS_FIXUP_COMMAND_TABLE, i);
+
+	#undef ADD_FIXUP
+
+	return(FixupCount);
+}
+
+// Returns a pointer to the table offset a fixup refers to.
+uint16_t *VBIOSGetFixupEntry(const void *VBIOSImage, const ATOM_ROM_HEADER *VBIOSROMHdr, const VBIOSFixup *Fixup)
+{
+	if(Fixup->Table == VBIOS_FIXUP_ROM_HEADER)
+		return((uint16_t *)(Fixup->Index ? &VBIOSROMHdr->usMasterCommandTableOffset : &VBIOSROMHdr->usMasterDataTableOffset));
+	else if(Fixup->Table == VBIOS_FIXUP_DATA_TABLE)
+		return((uint16_t *)(&((ATOM_MASTER_DATA_TABLE *)(VBIOS_OFFSET(VBIOSImage, VBIOSROMHdr->usMasterDataTableOffset)))->ListOfDataTables) + Fixup->Index);
+	else
+		return((uint16_t *)(&((ATOM_MASTER_COMMAND_TABLE *)(VBIOS_OFFSET(VBIOSImage, VBIOSROMHdr->usMasterCommandTableOffset)))->ListOfCommandTables) + Fixup->Index);
+}
+
+// Adds ChangeSize to each offset in Fixups, after the bytes have been
+// shifted. The ROM header fixups come first in the list, so that if a
+// master table itself moved, its own entries are found at its new
+// location.
+void ApplyTableFixups(void *VBIOSImage, ATOM_ROM_HEADER *VBIOSROMHdr, const VBIOSFixup *Fixups, uint32_t FixupCount, int32_t ChangeSize)
+{
+	for(uint32_t i = 0; i < FixupCount; ++i)
+		*VBIOSGetFixupEntry(VBIOSImage, VBIOSROMHdr, Fixups + i) += ChangeSize;
+}
+
+// Grows the legacy image by enough whole 512-byte blocks to give at
+// least MinExtraLen more bytes. The UEFI image and any others after
+// it are moved up in a single shift, the new blocks are filled with
+// 0xFF (so they count as padding), and the size byte and PCIR image
+// length of the legacy image are updated. Fails, changing nothing,
+// if the result would not fit in AMD_VBIOS_MAX_SIZE or the size byte.
+bool VBIOSGrowLegacyImage(VBIOSInfo *Info, uint32_t MinExtraLen)
+{
+	VBIOSROMImage *Legacy = Info->Chain.Images;
+	const uint32_t Blocks = (MinExtraLen + PCI_EXPANSION_ROM_BLOCK_SIZE - 1) / PCI_EXPANSION_ROM_BLOCK_SIZE;
+	const uint32_t GrowLen = Blocks * PCI_EXPANSION_ROM_BLOCK_SIZE;
+	const uint32_t NewLegacyBlocks = (Legacy->Length / PCI_EXPANSION_ROM_BLOCK_SIZE) + Blocks;
+	
+	if(!Blocks) return(true);
+	
+	if((NewLegacyBlocks > 0xFF) || ((Info->Size + GrowLen) > AMD_VBIOS_MAX_SIZE))
+	{
+		printf("Growing the legacy image by %d blocks would exceed the maximum VBIOS size.\n", Blocks);
+		return(false);
+	}
+	
+	memmove(Info->Image + Legacy->Length + GrowLen, Info->Image + Legacy->Length, Info->Size - Legacy->Length);
+	memset(Info->Image + Legacy->Length, 0xFF, GrowLen);
+	
+	Info->Image[PCI_EXPANSION_ROM_SIZE_OFFSET] = NewLegacyBlocks;
+	((PCI_DATA_STRUCTURE *)(Info->Image + Legacy->PCIROffset))->ImageLength = NewLegacyBlocks;
+	
+	for(uint32_t i = 1; i < Info->Chain.ImageCount; ++i)
+	{
+		Info->Chain.Images[i].Offset += GrowLen;
+		Info->Chain.Images[i].PCIROffset += GrowLen;
+	}
+	
+	Legacy->Length += GrowLen;
+	Info->Chain.ChainLen += GrowLen;
+	Info->Size += GrowLen;
+	
+	return(true);
+}
+
+// The reverse of VBIOSGrowLegacyImage() - drops the last ShrinkLen
+// bytes (a multiple of 512, which must be padding) from the legacy
+// image, and moves everything after it down.
+void VBIOSShrinkLegacyImage(VBIOSInfo *Info, uint32_t ShrinkLen)
+{
+	VBIOSROMImage *Legacy = Info->Chain.Images;
+	const uint32_t NewLegacyBlocks = (Legacy->Length - ShrinkLen) / PCI_EXPANSION_ROM_BLOCK_SIZE;
+	
+	if(!ShrinkLen) return;
+	
+	memmove(Info->Image + Legacy->Length - ShrinkLen, Info->Image + Legacy->Length, Info->Size - Legacy->Length);
+	
+	Info->Image[PCI_EXPANSION_ROM_SIZE_OFFSET] = NewLegacyBlocks;
+	((PCI_DATA_STRUCTURE *)(Info->Image + Legacy->PCIROffset))->ImageLength = NewLegacyBlocks;
+	
+	for(uint32_t i = 1; i < Info->Chain.ImageCount; ++i)
+	{
+		Info->Chain.Images[i].Offset -= ShrinkLen;
+		Info->Chain.Images[i].PCIROffset -= ShrinkLen;
+	}
+	
+	Legacy->Length -= ShrinkLen;
+	Info->Chain.ChainLen -= ShrinkLen;
+	Info->Size -= ShrinkLen;
+}
+
+// Returns the value the checksum byte must have for the legacy image
+// to sum to zero.
+uint8_t VBIOSComputeChecksum(const VBIOSInfo *Info)
+{
+	uint8_t Sum = 0;
+	
+	for(uint32_t i = 0; i < Info->Chain.Images[0].Length; ++i) Sum += Info->Image[i];
+	
+	return(Info->Image[ATOM_ROM_CHECKSUM_OFFSET] - Sum);
+}
+
+void VBIOSFixChecksum(VBIOSInfo *Info)
+{
+	Info->Image[ATOM_ROM_CHECKSUM_OFFSET] = VBIOSComputeChecksum(Info);
+}
+
+// Works out what replacing the OldLen bytes at Offset in the legacy
+// image with the NewLen bytes at NewData would do - whether the image
+// must grow, and which table offsets must move - and records it in
+// Delta, along with copies of the old and new bytes. The image is not
+// modified; see VBIOSApplyDelta().
+bool VBIOSCreateDelta(VBIOSDelta *Delta, const VBIOSInfo *Info, uint32_t Offset, uint32_t OldLen, const void *NewData, uint32_t NewLen)
+{
+	const int32_t SizeDiff = (int32_t)NewLen - (int32_t)OldLen;
+	const uint32_t VBIOSPadLen = VBIOSGetPaddingLength(Info);
+	
+	memset(Delta, 0x00, sizeof(VBIOSDelta));
+	
+	// Nothing shifts if the size stays the same, so the padding
+	// itself may be written to.
+	if((Offset + OldLen) > (Info->Chain.Images[0].Length - ((SizeDiff) ? VBIOSPadLen : 0)))
+	{
+		printf("Modification at 0x%X is outside of the legacy image.\n", Offset);
+		return(false);
+	}
+	
+	Delta->Offset = Offset;
+	Delta->OldLen = OldLen;
+	Delta->NewLen = NewLen;
+	Delta->OldChecksum = Info->Image[ATOM_ROM_CHECKSUM_OFFSET];
+	
+	// If the padding runs out, the legacy image must grow by
+	// whole 512-byte blocks.
+	if((SizeDiff > 0) && ((uint32_t)SizeDiff > VBIOSPadLen))
+	{
+		const uint32_t Needed = SizeDiff - VBIOSPadLen;
+		
+		Delta->GrowLen = ((Needed + PCI_EXPANSION_ROM_BLOCK_SIZE - 1) / PCI_EXPANSION_ROM_BLOCK_SIZE) * PCI_EXPANSION_ROM_BLOCK_SIZE;
+		
+		if(((Info->Chain.Images[0].Length + Delta->GrowLen) > (0xFF * PCI_EXPANSION_ROM_BLOCK_SIZE)) || ((Info->Size + Delta->GrowLen) > AMD_VBIOS_MAX_SIZE))
+		{
+			printf("Growing the legacy image by %d bytes would exceed the maximum VBIOS size.\n", Delta->GrowLen);
+			return(false);
+		}
+	}
+	
+	Delta->OldBytes = (uint8_t *)malloc(OldLen + 1);
+	Delta->NewBytes = (uint8_t *)malloc(NewLen + 1);
+	
+	if(SizeDiff)
+	{
+		Delta->FixupCount = CollectTableFixups(Info->Image, Info->ROMHdr, Offset + OldLen, NULL);
+		Delta->Fixups = (VBIOSFixup *)malloc(sizeof(VBIOSFixup) * (Delta->FixupCount + 1));
+	}
+	
+	if(!Delta->OldBytes || !Delta->NewBytes || (SizeDiff && !Delta->Fixups))
+	{
+		VBIOSFreeDelta(Delta);
+		return(false);
+	}
+	
+	memcpy(Delta->OldBytes, Info->Image + Offset, OldLen);
+	memcpy(Delta->NewBytes, NewData, NewLen);
+	
+	if(SizeDiff) CollectTableFixups(Info->Image, Info->ROMHdr, Offset + OldLen, Delta->Fixups);
+	
+	return(true);
+}
+
+// Adds a 16-bit value at Offset (before the replaced range) that is to
+// be set to NewValue along with the rest of the delta.
+bool VBIOSDeltaAddPatch16(VBIOSDelta *Delta, const VBIOSInfo *Info, uint32_t Offset, uint16_t NewValue)
+{
+	if((Delta->PatchCount == VBIOS_DELTA_MAX_PATCHES) || ((Offset + sizeof(uint16_t)) > Delta->Offset)) return(false);
+	
+	Delta->Patches[Delta->PatchCount].Offset = Offset;
+	Delta->Patches[Delta->PatchCount].OldValue = *((uint16_t *)(Info->Image + Offset));
+	Delta->Patches[Delta->PatchCount].NewValue = NewValue;
+	Delta->PatchCount++;
+	
+	return(true);
+}
+
+// Shifts everything between the end of the NewLen bytes at Offset
+// and the end of the padding, so that the OldLen bytes there become
+// NewLen bytes, then copies Data in. When growing, it lops off the
+// last bytes of the padding; when shrinking, the bytes freed at the
+// end become padding.
+static void VBIOSShiftAndCopy(VBIOSInfo *Info, uint32_t Offset, uint32_t OldLen, const uint8_t *Data, uint32_t NewLen)
+{
+	const int32_t SizeDiff = (int32_t)NewLen - (int32_t)OldLen;
+	const uint32_t PadEnd = Info->Chain.Images[0].Length;
+	
+	if(SizeDiff > 0)
+	{
+		PrepareROMForInsertionMod(Info->Image, PadEnd - SizeDiff, Offset + OldLen, SizeDiff);
+	}
+	else if(SizeDiff < 0)
+	{
+		PrepareROMForInsertionMod(Info->Image, PadEnd, Offset + OldLen, SizeDiff);
+		memset(Info->Image + PadEnd + SizeDiff, 0xFF, -SizeDiff);
+	}
+	
+	memcpy(Info->Image + Offset, Data, NewLen);
+}
+
+// Applies a delta to the image it was created against, or, with
+// Reverse set, undoes it on the image it was applied to. Either way
+// the cost is proportional to the edit and the bytes shifted - no
+// copy of the image is made. The pointers in Info are refreshed
+// afterward, as the master tables may have moved.
+bool VBIOSApplyDelta(VBIOSInfo *Info, const VBIOSDelta *Delta, bool Reverse)
+{
+	const int32_t SizeDiff = (int32_t)Delta->NewLen - (int32_t)Delta->OldLen;
+	
+	if(!Reverse)
+	{
+		for(uint32_t i = 0; i < Delta->PatchCount; ++i)
+			*((uint16_t *)(Info->Image + Delta->Patches[i].Offset)) = Delta->Patches[i].NewValue;
+		
+		if(!VBIOSGrowLegacyImage(Info, Delta->GrowLen)) return(false);
+		
+		VBIOSShiftAndCopy(Info, Delta->Offset, Delta->OldLen, Delta->NewBytes, Delta->NewLen);
+		ApplyTableFixups(Info->Image, Info->ROMHdr, Delta->Fixups, Delta->FixupCount, SizeDiff);
+		
+		VBIOSFixChecksum(Info);
+	}
+	else
+	{
+		VBIOSShiftAndCopy(Info, Delta->Offset, Delta->NewLen, Delta->OldBytes, Delta->OldLen);
+		ApplyTableFixups(Info->Image, Info->ROMHdr, Delta->Fixups, Delta->FixupCount, -SizeDiff);
+		VBIOSShrinkLegacyImage(Info, Delta->GrowLen);
+		
+		for(uint32_t i = 0; i < Delta->PatchCount; ++i)
+			*((uint16_t *)(Info->Image + Delta->Patches[i].Offset)) = Delta->Patches[i].OldValue;
+		
+		Info->Image[ATOM_ROM_CHECKSUM_OFFSET] = Delta->OldChecksum;
+	}
+	
+	return(VBIOSLocateVOI(Info, Info->Image, Info->Size));
+}
+
+void VBIOSFreeDelta(VBIOSDelta *Delta)
+{
+	free(Delta->OldBytes);
+	free(Delta->NewBytes);
+	free(Delta->Fixups);
+	
+	memset(Delta, 0x00, sizeof(VBIOSDelta));
+}
+
+// Whether moving the VOI table into the padding, before it grows to
+// NewVOISize bytes, would spare any other table from moving. It must
+// fit in the padding whole, at an offset the master data table can
+// still point to.
+bool VBIOSShouldMoveVOI(const VBIOSInfo *Info, uint32_t NewVOISize)
+{
+	const uint32_t PadLen = VBIOSGetPaddingLength(Info), PadStart = Info->Chain.Images[0].Length - PadLen;
+	
+	if((NewVOISize <= Info->VOIHdr->usStructureSize) || (NewVOISize > PadLen) || (NewVOISize > 0xFFFF) || ((PadStart + NewVOISize) > 0x10000)) return(false);
+	
+	return(CollectTableFixups(Info->Image, Info->ROMHdr, Info->VOITblOffset + Info->VOIHdr->usStructureSize, NULL) != 0);
+}
+
+// Copies the VOI table, as it is, to the start of the padding, and
+// repoints the master data table's VoltageObjectInfo entry at the
+// copy. Nothing shifts, and no other table moves; the delta is the
+// copy and the one entry.
+bool VBIOSMoveVOI(VBIOSInfo *Info, VBIOSDelta *Delta)
+{
+	const uint32_t VOISize = Info->VOIHdr->usStructureSize;
+	const uint32_t PadStart = Info->Chain.Images[0].Length - VBIOSGetPaddingLength(Info);
+	const uint32_t EntryOffset = Info->ROMHdr->usMasterDataTableOffset + offsetof(ATOM_MASTER_DATA_TABLE, ListOfDataTables.VoltageObjectInfo);
+	VBIOSDelta LocalDelta;
+	bool Ret;
+	
+	if(!Delta) Delta = &LocalDelta;
+	
+	if(!VBIOSCreateDelta(Delta, Info, PadStart, VOISize, Info->Image + Info->VOITblOffset, VOISize)) return(false);
+	
+	if(!VBIOSDeltaAddPatch16(Delta, Info, EntryOffset, PadStart))
+	{
+		VBIOSFreeDelta(Delta);
+		return(false);
+	}
+	
+	Ret = VBIOSApplyDelta(Info, Delta, false);
+	
+	if((Delta == &LocalDelta) || !Ret) VBIOSFreeDelta(Delta);
+	
+	return(Ret);
+}
+
+// Called before an edit that grows the VOI table to NewVOISize bytes.
+// With VBIOS_RELOC_MOVE, moves the table into the padding first if
+// that would spare other tables from moving, recording it in Delta
+// and setting Moved; the edit is then made as usual. Offsets into
+// the VOI table must be taken again afterward.
+bool VBIOSPrepareVOIGrowth(VBIOSInfo *Info, uint8_t Strategy, uint32_t NewVOISize, VBIOSDelta *Delta, bool *Moved)
+{
+	*Moved = false;
+	
+	if((Strategy != VBIOS_RELOC_MOVE) || !VBIOSShouldMoveVOI(Info, NewVOISize)) return(true);
+	
+	if(!VBIOSMoveVOI(Info, Delta)) return(false);
+	
+	*Moved = true;
+	return(true);
+}
+
+// The relocation engine. Replaces the OldLen bytes at Offset in the
+// legacy image with the NewLen bytes at NewData, shifting everything
+// after them (up to the end of the padding) to make or close up room,
+// and fixing every table offset that moved. If the padding runs out,
+// the legacy image is grown in 512-byte blocks first. Table sizes
+// (such as the VOI usStructureSize) are left to the caller. If Delta
+// is not NULL, the change is recorded there (and must be freed by
+// the caller) so it may later be undone.
+bool VBIOSReplaceRange(VBIOSInfo *Info, uint32_t Offset, uint32_t OldLen, const void *NewData, uint32_t NewLen, VBIOSDelta *Delta)
+{
+	VBIOSDelta LocalDelta;
+	bool Ret;
+	
+	if(!Delta) Delta = &LocalDelta;
+	
+	if(!VBIOSCreateDelta(Delta, Info, Offset, OldLen, NewData, NewLen)) return(false);
+	
+	Ret = VBIOSApplyDelta(Info, Delta, false);
+	
+	if((Delta == &LocalDelta) || !Ret) VBIOSFreeDelta(Delta);
+	
+	return(Ret);
+}
+
+// Writes Node as the VO at VOOffset, which currently occupies OldVOSize
+// bytes. Pass an OldVOSize of zero to insert a new VO at VOOffset. The
+// VOI table header is corrected for the change in size, as part of
+// the same delta.
+bool VBIOSReplaceVO(VBIOSInfo *Info, uint32_t VOOffset, uint32_t OldVOSize, const VOListNode *Node, VBIOSDelta *Delta)
+{
+	uint8_t VOBuf[0x10000];
+	uint16_t VOLen = SerializeVO(VOBuf, Node, sizeof(VOBuf));
+	VBIOSDelta LocalDelta;
+	bool Ret;
+	
+	if(VOLen != Node->VO->VOSize)
+	{
+		printf("Unable to serialize a VO with mode %d.\n", Node->VO->VOMode);
+		return(false);
+	}
+	
+	if((Info->VOIHdr->usStructureSize + VOLen - OldVOSize) > 0xFFFF)
+	{
+		printf("VOI table would grow too large.\n");
+		return(false);
+	}
+	
+	if(!Delta) Delta = &LocalDelta;
+	
+	if(!VBIOSCreateDelta(Delta, Info, VOOffset, OldVOSize, VOBuf, VOLen)) return(false);
+	
+	// The table header lies before the change, so it does not move.
+	VBIOSDeltaAddPatch16(Delta, Info, Info->VOITblOffset, Info->VOIHdr->usStructureSize + VOLen - OldVOSize);
+	
+	Ret = VBIOSApplyDelta(Info, Delta, false);
+	
+	if((Delta == &LocalDelta) || !Ret) VBIOSFreeDelta(Delta);
+	
+	return(Ret);
+}
@@ -0,0 +1,94 @@
+// Copyright 2022 Wolf9466/Wolf0/OhGodAPet
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "vbios.h"
+#include "voi.h"
+
+// Offset of the ATOM BIOS checksum byte. The bytes of the legacy
+// image must sum to zero (mod 256) for the image to be accepted.
+#define ATOM_ROM_CHECKSUM_OFFSET					0x21
+
+// Which offset a table fixup applies to - an entry in the master
+// data or command table, or one of the master table offsets held
+// in the ROM header itself (Index 0 for data, 1 for command.)
+#define VBIOS_FIXUP_DATA_TABLE						0x00
+#define VBIOS_FIXUP_COMMAND_TABLE					0x01
+#define VBIOS_FIXUP_ROM_HEADER						0x02
+
+// How room is made for a VOI table that grows. SHIFT moves every
+// byte after the VO being changed up into the padding, and every
+// table offset past it along with them. MOVE first copies the VOI
+// table, as it is, into the padding and repoints its master data
+// table entry at the copy, so that only the rest of the VOI table
+// has to shift; it is used whenever tables lie after the VOI table
+// and the grown table fits in the padding, and SHIFT otherwise.
+// The old copy is left where it was, unreferenced.
+#define VBIOS_RELOC_SHIFT							0x00
+#define VBIOS_RELOC_MOVE							0x01
+
+// Far more than the master tables of any known VBIOS hold
+#define VBIOS_MAX_FIXUPS							512
+#define VBIOS_DELTA_MAX_PATCHES						4
+
+typedef struct
+{
+	uint8_t Table;
+	uint16_t Index;
+} VBIOSFixup;
+
+// A 16-bit value outside of the replaced range that changes along
+// with it, such as the size in a table header. It must lie before
+// the replaced range, so that it never moves.
+typedef struct
+{
+	uint32_t Offset;
+	uint16_t OldValue;
+	uint16_t NewValue;
+} VBIOSPatch16;
+
+// Everything an edit did to the image, in enough detail to apply
+// it again or reverse it without a copy of the image: the bytes
+// replaced and what replaced them, how much the legacy image grew,
+// which table offsets were moved, and any small patches alongside.
+// Everything between the end of the replaced range and the end of
+// the legacy image's padding moved by NewLen - OldLen bytes.
+typedef struct
+{
+	uint32_t Offset;
+	uint32_t OldLen;
+	uint32_t NewLen;
+	uint8_t *OldBytes;
+	uint8_t *NewBytes;
+	uint32_t GrowLen;
+	uint8_t OldChecksum;
+	uint32_t FixupCount;
+	VBIOSFixup *Fixups;
+	uint32_t PatchCount;
+	VBIOSPatch16 Patches[VBIOS_DELTA_MAX_PATCHES];
+} VBIOSDelta;
+
+void PrepareROMForInsertionMod(void *VBIOSImage, size_t PadOffset, size_t ModificationOffset, int32_t ModLength);
+uint32_t VBIOSGetPaddingLength(const VBIOSInfo *Info);
+uint32_t CollectTableFixups(const void *VBIOSImage, const ATOM_ROM_HEADER *VBIOSROMHdr, uint32_t ChangeStartOffset, VBIOSFixup *Fixups);
+uint16_t *VBIOSGetFixupEntry(const void *VBIOSImage, const ATOM_ROM_HEADER *VBIOSROMHdr, const VBIOSFixup *Fixup);
+void ApplyTableFixups(void *VBIOSImage, ATOM_ROM_HEADER *VBIOSROMHdr, const VBIOSFixup *Fixups, uint32_t FixupCount, int32_t ChangeSize);
+bool VBIOSGrowLegacyImage(VBIOSInfo *Info, uint32_t MinExtraLen);
+void VBIOSShrinkLegacyImage(VBIOSInfo *Info, uint32_t ShrinkLen);
+uint8_t VBIOSComputeChecksum(const VBIOSInfo *Info);
+void VBIOSFixChecksum(VBIOSInfo *Info);
+
+bool VBIOSCreateDelta(VBIOSDelta *Delta, const VBIOSInfo *Info, uint32_t Offset, uint32_t OldLen, const void *NewData, uint32_t NewLen);
+bool VBIOSDeltaAddPatch16(VBIOSDelta *Delta, const VBIOSInfo *Info, uint32_t Offset, uint16_t NewValue);
+bool VBIOSApplyDelta(VBIOSInfo *Info, const VBIOSDelta *Delta, bool Reverse);
+void VBIOSFreeDelta(VBIOSDelta *Delta);
+
+bool VBIOSShouldMoveVOI(const VBIOSInfo *Info, uint32_t NewVOISize);
+bool VBIOSMoveVOI(VBIOSInfo *Info, VBIOSDelta *Delta);
+bool VBIOSPrepareVOIGrowth(VBIOSInfo *Info, uint8_t Strategy, uint32_t NewVOISize, VBIOSDelta *Delta, bool *Moved);
+
+bool VBIOSReplaceRange(VBIOSInfo *Info, uint32_t Offset, uint32_t OldLen, const void *NewData, uint32_t NewLen, VBIOSDelta *Delta);
+bool VBIOSReplaceVO(VBIOSInfo *Info, uint32_t VOOffset, uint32_t OldVOSize, const VOListNode *Node, VBIOSDelta *Delta);
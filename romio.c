@@ -0,0 +1,763 @@
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include "vbios-tables.h"
+#include "bufpool.h"
+#include "romio.h"
+
+#define ROMIO_SLOT_FREE					0x00
+#define ROMIO_SLOT_READING				0x01
+#define ROMIO_SLOT_WRITING				0x02
+#define ROMIO_SLOT_WAITING				0x03
+
+// One ROM in flight, and the buffer it is read into, which comes
+// from the pool once the ROM is open; until then, the slot is left
+// WAITING. Done counts the bytes transferred so far, as a read or
+// write may come back short and need to be queued again for the
+// rest. TmpName is set while an atomic write is going to a
+// temporary file. LockFd holds the ROM's lock, when the run takes
+// them, from before it is read until it has been written back.
+typedef struct
+{
+	uint8_t State;
+	uint32_t Index;
+	int Fd;
+	int LockFd;
+	uint8_t *Buf;
+	size_t BufLen;
+	size_t Done;
+	size_t Want;
+	ssize_t Res;
+	char *TmpName;
+} ROMIOSlot;
+
+// The rings shared with the kernel. liburing is not required; the
+// two syscalls and the ring layout are all that is used of it.
+typedef struct
+{
+	int RingFd;
+	void *SQRing, *CQRing;
+	size_t SQRingLen, CQRingLen;
+	struct io_uring_sqe *SQEs;
+	size_t SQEsLen;
+	uint32_t *SQTail, *SQMask, *SQArray;
+	uint32_t *CQHead, *CQTail, *CQMask;
+	struct io_uring_cqe *CQEs;
+	uint32_t ToSubmit;
+} ROMIOUring;
+
+// The thread pool passes slots to its workers, and back, through
+// two rings of Cap entries each. A slot is only ever in one of
+// them, and there are never more than Cap slots, so they cannot
+// overflow.
+typedef struct
+{
+	pthread_t *Threads;
+	uint32_t ThreadCount;
+	pthread_mutex_t Lock;
+	pthread_cond_t ReqCond, DoneCond;
+	ROMIOSlot **Reqs, **Dones;
+	uint32_t ReqHead, ReqCount;
+	uint32_t DoneHead, DoneCount;
+	uint32_t Cap;
+	bool Stop;
+} ROMIOPool;
+
+typedef struct
+{
+	uint8_t Backend;
+	ROMIOUring Uring;
+	ROMIOPool Pool;
+} ROMIOEngine;
+
+static void ROMIOUringFree(ROMIOUring *Ring)
+{
+	if(Ring->SQEs) munmap(Ring->SQEs, Ring->SQEsLen);
+	if(Ring->CQRing && (Ring->CQRing != Ring->SQRing)) munmap(Ring->CQRing, Ring->CQRingLen);
+	if(Ring->SQRing) munmap(Ring->SQRing, Ring->SQRingLen);
+	if(Ring->RingFd >= 0) close(Ring->RingFd);
+}
+
+// IORING_OP_READ and IORING_OP_WRITE came some kernels after
+// io_uring itself, so a ring may be set up that cannot run them;
+// the probe, which came with them, says whether it can.
+static bool ROMIOUringProbe(ROMIOUring *Ring)
+{
+	const uint32_t OpCount = 256;
+	struct io_uring_probe *Probe = (struct io_uring_probe *)calloc(1, sizeof(struct io_uring_probe) + OpCount * sizeof(struct io_uring_probe_op));
+	bool Ret = false;
+	
+	if(!Probe) return(false);
+	
+	if(!syscall(__NR_io_uring_register, Ring->RingFd, IORING_REGISTER_PROBE, Probe, OpCount))
+	{
+		Ret = (Probe->ops_len > IORING_OP_READ) && (Probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED) &&
+			(Probe->ops_len > IORING_OP_WRITE) && (Probe->ops[IORING_OP_WRITE].flags & IO_URING_OP_SUPPORTED);
+		
+		if(!Ret) errno = EOPNOTSUPP;
+	}
+	
+	free(Probe);
+	return(Ret);
+}
+
+static bool ROMIOUringInit(ROMIOUring *Ring, uint32_t Depth)
+{
+	struct io_uring_params Params;
+	void *Map;
+	int Err;
+	
+	memset(Ring, 0x00, sizeof(ROMIOUring));
+	memset(&Params, 0x00, sizeof(Params));
+	
+	Ring->RingFd = syscall(__NR_io_uring_setup, Depth, &Params);
+	
+	if(Ring->RingFd < 0) return(false);
+	
+	Ring->SQRingLen = Params.sq_off.array + Params.sq_entries * sizeof(uint32_t);
+	Ring->CQRingLen = Params.cq_off.cqes + Params.cq_entries * sizeof(struct io_uring_cqe);
+	
+	// Newer kernels map both rings with one call.
+	if(Params.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		if(Ring->CQRingLen > Ring->SQRingLen) Ring->SQRingLen = Ring->CQRingLen;
+		Ring->CQRingLen = Ring->SQRingLen;
+	}
+	
+	Map = mmap(NULL, Ring->SQRingLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, Ring->RingFd, IORING_OFF_SQ_RING);
+	if(Map == MAP_FAILED) goto fail;
+	Ring->SQRing = Map;
+	
+	if(Params.features & IORING_FEAT_SINGLE_MMAP) Ring->CQRing = Ring->SQRing;
+	else
+	{
+		Map = mmap(NULL, Ring->CQRingLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, Ring->RingFd, IORING_OFF_CQ_RING);
+		if(Map == MAP_FAILED) goto fail;
+		Ring->CQRing = Map;
+	}
+	
+	Ring->SQEsLen = Params.sq_entries * sizeof(struct io_uring_sqe);
+	Map = mmap(NULL, Ring->SQEsLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, Ring->RingFd, IORING_OFF_SQES);
+	if(Map == MAP_FAILED) goto fail;
+	Ring->SQEs = (struct io_uring_sqe *)Map;
+	
+	Ring->SQTail = (uint32_t *)((uint8_t *)Ring->SQRing + Params.sq_off.tail);
+	Ring->SQMask = (uint32_t *)((uint8_t *)Ring->SQRing + Params.sq_off.ring_mask);
+	Ring->SQArray = (uint32_t *)((uint8_t *)Ring->SQRing + Params.sq_off.array);
+	Ring->CQHead = (uint32_t *)((uint8_t *)Ring->CQRing + Params.cq_off.head);
+	Ring->CQTail = (uint32_t *)((uint8_t *)Ring->CQRing + Params.cq_off.tail);
+	Ring->CQMask = (uint32_t *)((uint8_t *)Ring->CQRing + Params.cq_off.ring_mask);
+	Ring->CQEs = (struct io_uring_cqe *)((uint8_t *)Ring->CQRing + Params.cq_off.cqes);
+	
+	if(!ROMIOUringProbe(Ring)) goto fail;
+	
+	return(true);
+	
+fail:
+	Err = errno;
+	ROMIOUringFree(Ring);
+	errno = Err;
+	return(false);
+}
+
+// Only this thread ever writes the SQ tail, so it can be read
+// plainly; the release store publishes the SQE to the kernel.
+static void ROMIOUringQueue(ROMIOUring *Ring, ROMIOSlot *Slot)
+{
+	uint32_t Tail = *Ring->SQTail;
+	uint32_t Idx = Tail & *Ring->SQMask;
+	struct io_uring_sqe *SQE = Ring->SQEs + Idx;
+	
+	memset(SQE, 0x00, sizeof(struct io_uring_sqe));
+	
+	SQE->opcode = (Slot->State == ROMIO_SLOT_READING) ? IORING_OP_READ : IORING_OP_WRITE;
+	SQE->fd = Slot->Fd;
+	SQE->addr = (uint64_t)(uintptr_t)(Slot->Buf + Slot->Done);
+	SQE->len = (uint32_t)(Slot->Want - Slot->Done);
+	SQE->off = Slot->Done;
+	SQE->user_data = (uint64_t)(uintptr_t)Slot;
+	
+	Ring->SQArray[Idx] = Idx;
+	
+	__atomic_store_n(Ring->SQTail, Tail + 1, __ATOMIC_RELEASE);
+	Ring->ToSubmit++;
+}
+
+// Submits everything queued, and waits for a completion if none
+// is ready yet. Returns NULL if the ring itself failed.
+static ROMIOSlot *ROMIOUringReap(ROMIOUring *Ring, ssize_t *Res)
+{
+	do
+	{
+		uint32_t Head = *Ring->CQHead;
+		int Submitted;
+		
+		if(Head != __atomic_load_n(Ring->CQTail, __ATOMIC_ACQUIRE))
+		{
+			struct io_uring_cqe *CQE = Ring->CQEs + (Head & *Ring->CQMask);
+			ROMIOSlot *Slot = (ROMIOSlot *)(uintptr_t)CQE->user_data;
+			
+			*Res = CQE->res;
+			__atomic_store_n(Ring->CQHead, Head + 1, __ATOMIC_RELEASE);
+			return(Slot);
+		}
+		
+		Submitted = syscall(__NR_io_uring_enter, Ring->RingFd, Ring->ToSubmit, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+		
+		if(Submitted < 0)
+		{
+			if(errno == EINTR) continue;
+			return(NULL);
+		}
+		
+		Ring->ToSubmit -= Submitted;
+	} while(1);
+}
+
+static void *ROMIOPoolWorker(void *Arg)
+{
+	ROMIOPool *Pool = (ROMIOPool *)Arg;
+	
+	pthread_mutex_lock(&Pool->Lock);
+	
+	do
+	{
+		ROMIOSlot *Slot;
+		
+		while(!Pool->ReqCount && !Pool->Stop) pthread_cond_wait(&Pool->ReqCond, &Pool->Lock);
+		
+		if(!Pool->ReqCount) break;
+		
+		Slot = Pool->Reqs[Pool->ReqHead];
+		Pool->ReqHead = (Pool->ReqHead + 1) % Pool->Cap;
+		Pool->ReqCount--;
+		
+		pthread_mutex_unlock(&Pool->Lock);
+		
+		if(Slot->State == ROMIO_SLOT_READING) Slot->Res = pread(Slot->Fd, Slot->Buf + Slot->Done, Slot->Want - Slot->Done, Slot->Done);
+		else Slot->Res = pwrite(Slot->Fd, Slot->Buf + Slot->Done, Slot->Want - Slot->Done, Slot->Done);
+		
+		if(Slot->Res < 0) Slot->Res = -errno;
+		
+		pthread_mutex_lock(&Pool->Lock);
+		
+		Pool->Dones[(Pool->DoneHead + Pool->DoneCount) % Pool->Cap] = Slot;
+		Pool->DoneCount++;
+		pthread_cond_signal(&Pool->DoneCond);
+	} while(1);
+	
+	pthread_mutex_unlock(&Pool->Lock);
+	return(NULL);
+}
+
+static void ROMIOPoolFree(ROMIOPool *Pool)
+{
+	pthread_mutex_lock(&Pool->Lock);
+	Pool->Stop = true;
+	pthread_cond_broadcast(&Pool->ReqCond);
+	pthread_mutex_unlock(&Pool->Lock);
+	
+	for(uint32_t i = 0; i < Pool->ThreadCount; ++i) pthread_join(Pool->Threads[i], NULL);
+	
+	pthread_cond_destroy(&Pool->DoneCond);
+	pthread_cond_destroy(&Pool->ReqCond);
+	pthread_mutex_destroy(&Pool->Lock);
+	
+	free(Pool->Threads);
+	free(Pool->Dones);
+	free(Pool->Reqs);
+}
+
+// One worker per slot, so that every queued request can block in
+// the kernel at the same time, as it would in the ring.
+static bool ROMIOPoolInit(ROMIOPool *Pool, uint32_t Depth)
+{
+	memset(Pool, 0x00, sizeof(ROMIOPool));
+	
+	pthread_mutex_init(&Pool->Lock, NULL);
+	pthread_cond_init(&Pool->ReqCond, NULL);
+	pthread_cond_init(&Pool->DoneCond, NULL);
+	
+	Pool->Cap = Depth;
+	Pool->Reqs = (ROMIOSlot **)malloc(sizeof(ROMIOSlot *) * Depth);
+	Pool->Dones = (ROMIOSlot **)malloc(sizeof(ROMIOSlot *) * Depth);
+	Pool->Threads = (pthread_t *)malloc(sizeof(pthread_t) * Depth);
+	
+	if(!Pool->Reqs || !Pool->Dones || !Pool->Threads)
+	{
+		ROMIOPoolFree(Pool);
+		return(false);
+	}
+	
+	for(uint32_t i = 0; i < Depth; ++i)
+	{
+		if(pthread_create(Pool->Threads + i, NULL, ROMIOPoolWorker, Pool)) break;
+		Pool->ThreadCount++;
+	}
+	
+	if(!Pool->ThreadCount)
+	{
+		ROMIOPoolFree(Pool);
+		return(false);
+	}
+	
+	return(true);
+}
+
+static void ROMIOPoolQueue(ROMIOPool *Pool, ROMIOSlot *Slot)
+{
+	pthread_mutex_lock(&Pool->Lock);
+	
+	Pool->Reqs[(Pool->ReqHead + Pool->ReqCount) % Pool->Cap] = Slot;
+	Pool->ReqCount++;
+	pthread_cond_signal(&Pool->ReqCond);
+	
+	pthread_mutex_unlock(&Pool->Lock);
+}
+
+static ROMIOSlot *ROMIOPoolReap(ROMIOPool *Pool, ssize_t *Res)
+{
+	ROMIOSlot *Slot;
+	
+	pthread_mutex_lock(&Pool->Lock);
+	
+	while(!Pool->DoneCount) pthread_cond_wait(&Pool->DoneCond, &Pool->Lock);
+	
+	Slot = Pool->Dones[Pool->DoneHead];
+	Pool->DoneHead = (Pool->DoneHead + 1) % Pool->Cap;
+	Pool->DoneCount--;
+	
+	pthread_mutex_unlock(&Pool->Lock);
+	
+	*Res = Slot->Res;
+	return(Slot);
+}
+
+// Automatic selection prefers io_uring, and falls back to the
+// thread pool quietly; asking for io_uring outright makes its
+// absence an error.
+static bool ROMIOEngineInit(ROMIOEngine *Engine, uint8_t Backend, uint32_t Depth)
+{
+	if(Backend != ROMIO_BACKEND_THREADS)
+	{
+		if(ROMIOUringInit(&Engine->Uring, Depth))
+		{
+			Engine->Backend = ROMIO_BACKEND_URING;
+			return(true);
+		}
+		
+		if(Backend == ROMIO_BACKEND_URING)
+		{
+			printf("io_uring is unavailable (%s).\n", strerror(errno));
+			return(false);
+		}
+	}
+	
+	Engine->Backend = ROMIO_BACKEND_THREADS;
+	
+	if(ROMIOPoolInit(&Engine->Pool, Depth)) return(true);
+	
+	printf("Unable to start the I/O threads.\n");
+	return(false);
+}
+
+static void ROMIOEngineFree(ROMIOEngine *Engine)
+{
+	if(Engine->Backend == ROMIO_BACKEND_URING) ROMIOUringFree(&Engine->Uring);
+	else ROMIOPoolFree(&Engine->Pool);
+}
+
+static void ROMIOEngineQueue(ROMIOEngine *Engine, ROMIOSlot *Slot)
+{
+	if(Engine->Backend == ROMIO_BACKEND_URING) ROMIOUringQueue(&Engine->Uring, Slot);
+	else ROMIOPoolQueue(&Engine->Pool, Slot);
+}
+
+static ROMIOSlot *ROMIOEngineReap(ROMIOEngine *Engine, ssize_t *Res)
+{
+	if(Engine->Backend == ROMIO_BACKEND_URING) return(ROMIOUringReap(&Engine->Uring, Res));
+	return(ROMIOPoolReap(&Engine->Pool, Res));
+}
+
+// Opens a ROM and takes an exclusive advisory lock on it. Unless
+// told to wait for whoever holds it to let go, returns -1 with errno
+// set to EWOULDBLOCK if it is held. A ROM that was replaced by a
+// rename in the meantime is a different file, with a different
+// lock, so it is the new one that is opened and locked. Returns
+// the locked descriptor, or -1 if the ROM cannot be opened.
+int ROMIOLockFile(const char *FileName, bool Wait)
+{
+	struct stat FdSt, PathSt;
+	
+	for(;;)
+	{
+		int Fd = open(FileName, O_RDONLY);
+		
+		if(Fd < 0) return(-1);
+		
+		if(flock(Fd, (Wait) ? LOCK_EX : (LOCK_EX | LOCK_NB)))
+		{
+			int Err = errno;
+			
+			close(Fd);
+			errno = Err;
+			return(-1);
+		}
+		
+		if(!fstat(Fd, &FdSt) && !stat(FileName, &PathSt) && (FdSt.st_dev == PathSt.st_dev) && (FdSt.st_ino == PathSt.st_ino)) return(Fd);
+		
+		close(Fd);
+	}
+}
+
+static void ROMIOUnlock(ROMIOSlot *Slot)
+{
+	if(Slot->LockFd >= 0) close(Slot->LockFd);
+	Slot->LockFd = -1;
+}
+
+// Opening (and locking) is left synchronous; it is the reads and
+// writes that benefit from being queued together. A locked ROM is
+// read through a duplicate of the locked descriptor, so closing it
+// leaves the lock held. Returns 1 if the read was started, 0 if it
+// could not be, and -1 if the ROM's lock is held and Wait is false.
+static int ROMIOStartRead(ROMIOSlot *Slot, uint32_t Index, const char *FileName, uint32_t Flags, bool Wait)
+{
+	struct stat St;
+	
+	if(Flags & ROMIO_FLAG_LOCK)
+	{
+		if((Slot->LockFd = ROMIOLockFile(FileName, Wait)) >= 0) Slot->Fd = dup(Slot->LockFd);
+		else if(errno == EWOULDBLOCK) return(-1);
+		else Slot->Fd = -1;
+	}
+	else Slot->Fd = open(FileName, O_RDONLY);
+	
+	if(Slot->Fd < 0)
+	{
+		printf("Unable to open %s (does it exist?)\n", FileName);
+		ROMIOUnlock(Slot);
+		return(0);
+	}
+	
+	if(fstat(Slot->Fd, &St) || !St.st_size)
+	{
+		printf("Reading the VBIOS file failed.\n");
+		close(Slot->Fd);
+		ROMIOUnlock(Slot);
+		return(0);
+	}
+	
+	// Anything past the largest image a VBIOS may be is ignored.
+	Slot->State = ROMIO_SLOT_WAITING;
+	Slot->Index = Index;
+	Slot->Done = 0;
+	Slot->Want = ((size_t)St.st_size < AMD_VBIOS_MAX_SIZE) ? (size_t)St.st_size : AMD_VBIOS_MAX_SIZE;
+	
+	return(1);
+}
+
+// An atomic write goes to a hidden file beside the ROM, which is
+// renamed over it once the write is complete and synced; readers
+// of the ROM see either the old image or the new one, never part
+// of each. The hidden file takes the ROM's mode, and its owner as
+// far as we may give it away.
+static bool ROMIOStartWrite(ROMIOSlot *Slot, const char *FileName, size_t Len, uint32_t Flags)
+{
+	const char *OpenName = FileName;
+	struct stat St;
+	bool KeepMode = false;
+	
+	if(Flags & ROMIO_FLAG_ATOMIC_WRITES)
+	{
+		const char *BaseName = strrchr(FileName, '/');
+		int DirLen = (BaseName) ? (int)(++BaseName - FileName) : 0;
+		size_t TmpLen = strlen(FileName) + 16;
+		
+		if(!BaseName) BaseName = FileName;
+		
+		if(!(Slot->TmpName = (char *)malloc(TmpLen)))
+		{
+			printf("Out of memory.\n");
+			return(false);
+		}
+		
+		snprintf(Slot->TmpName, TmpLen, "%.*s.%s.wvoitmp", DirLen, FileName, BaseName);
+		OpenName = Slot->TmpName;
+		KeepMode = !stat(FileName, &St);
+	}
+	
+	Slot->Fd = open(OpenName, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	
+	if(Slot->Fd < 0)
+	{
+		printf("Unable to open %s (does it exist?)\n", OpenName);
+		free(Slot->TmpName);
+		Slot->TmpName = NULL;
+		return(false);
+	}
+	
+	// Changing the owner clears the set-ID bits, so it comes first.
+	// Only root may give a file away; others may still keep the
+	// group, if they are in it.
+	if(KeepMode)
+	{
+		if(((St.st_uid != geteuid()) || (St.st_gid != getegid())) && fchown(Slot->Fd, St.st_uid, St.st_gid) && fchown(Slot->Fd, -1, St.st_gid))
+			printf("Unable to keep the owner of %s (%s); the new image will be owned by this user.\n", FileName, strerror(errno));
+		
+		if(fchmod(Slot->Fd, St.st_mode & 07777))
+		{
+			printf("Unable to set the mode of %s (%s).\n", OpenName, strerror(errno));
+			close(Slot->Fd);
+			Slot->Fd = -1;
+			unlink(Slot->TmpName);
+			free(Slot->TmpName);
+			Slot->TmpName = NULL;
+			return(false);
+		}
+	}
+	
+	Slot->State = ROMIO_SLOT_WRITING;
+	Slot->Done = 0;
+	Slot->Want = Len;
+	
+	return(true);
+}
+
+// Syncs the directory holding FileName, so that a rename into it
+// survives a crash as the renamed file's contents do.
+static bool ROMIOSyncDir(const char *FileName)
+{
+	const char *BaseName = strrchr(FileName, '/');
+	char *DirName = (BaseName) ? strndup(FileName, (BaseName == FileName) ? 1 : (size_t)(BaseName - FileName)) : strdup(".");
+	int Fd;
+	bool Ret;
+	
+	if(!DirName) return(false);
+	
+	Fd = open(DirName, O_RDONLY | O_DIRECTORY);
+	free(DirName);
+	
+	if(Fd < 0) return(false);
+	
+	Ret = !fsync(Fd);
+	close(Fd);
+	return(Ret);
+}
+
+// Moves a finished atomic write into place, or discards it.
+static bool ROMIOFinishWrite(ROMIOSlot *Slot, const char *FileName, bool Failed)
+{
+	if(Slot->TmpName)
+	{
+		if(Failed || rename(Slot->TmpName, FileName))
+		{
+			unlink(Slot->TmpName);
+			Failed = true;
+		}
+		else if(!ROMIOSyncDir(FileName)) printf("Unable to sync the directory of %s; it may not keep the new image through a crash.\n", FileName);
+		
+		free(Slot->TmpName);
+		Slot->TmpName = NULL;
+	}
+	
+	return(!Failed);
+}
+
+// Gives a slot that has opened its ROM a buffer to read it into,
+// if the pool can spare one.
+static bool ROMIOGetBuf(ROMIOSlot *Slot, const ROMIOConfig *Config)
+{
+	size_t Len = (Config->Flags & ROMIO_FLAG_FULL_BUFFERS) ? AMD_VBIOS_MAX_SIZE : Slot->Want;
+	
+	return((Slot->Buf = VBIOSBufPoolGet(Config->Pool, Len, &Slot->BufLen)) != NULL);
+}
+
+static void ROMIOPutBuf(ROMIOSlot *Slot, const ROMIOConfig *Config)
+{
+	if(Slot->Buf) VBIOSBufPoolPut(Config->Pool, Slot->Buf, Slot->BufLen);
+	Slot->Buf = NULL;
+}
+
+bool ROMIORun(const ROMIOConfig *Config, char **FileNames, uint32_t FileCount, ROMIOProcessFn Process, void *Ctx)
+{
+	ROMIOEngine Engine;
+	ROMIOSlot *Slots;
+	uint32_t Depth = Config->Depth;
+	uint32_t Next = 0, Active = 0, Waiting = 0;
+	bool Ret = false;
+	
+	if(!Depth) Depth = ROMIO_DEFAULT_DEPTH;
+	if(Depth > ROMIO_MAX_DEPTH) Depth = ROMIO_MAX_DEPTH;
+	
+	// There is no use in more slots than ROMs.
+	if(Depth > FileCount) Depth = FileCount;
+	if(!Depth) return(true);
+	
+	Slots = (ROMIOSlot *)calloc(Depth, sizeof(ROMIOSlot));
+	
+	if(!Slots)
+	{
+		printf("Out of memory.\n");
+		return(false);
+	}
+	
+	for(uint32_t s = 0; s < Depth; ++s) Slots[s].Fd = Slots[s].LockFd = -1;
+	
+	if(!ROMIOEngineInit(&Engine, Config->Backend, Depth)) goto out;
+	
+	Ret = true;
+	
+	while((Next < FileCount) || Active || Waiting)
+	{
+		ROMIOSlot *Slot;
+		ssize_t Res;
+		bool Failed, Stalled = false, Locked = false;
+		
+		// Keep every free slot busy with the next ROM's read, for as
+		// long as the pool has buffers to spare. Once it runs out,
+		// nothing more is started until a ROM in flight is done with
+		// its buffer.
+		//
+		// Likewise, a ROM whose lock is held is not waited for while
+		// others are in flight - the holder may well be one of them,
+		// should the same ROM be given twice - but only once they are
+		// done.
+		for(uint32_t s = 0; (s < Depth) && !Stalled; ++s)
+		{
+			Slot = Slots + s;
+			
+			while((Slot->State == ROMIO_SLOT_FREE) && (Next < FileCount) && !Locked)
+			{
+				int Started = ROMIOStartRead(Slot, Next, FileNames[Next], Config->Flags, !Active && !Waiting);
+				
+				if(Started < 0)
+				{
+					Locked = true;
+					break;
+				}
+				
+				if(Started) Waiting++;
+				else Process(Ctx, Next, NULL, 0);
+				
+				Next++;
+			}
+			
+			if(Slot->State != ROMIO_SLOT_WAITING) continue;
+			
+			if(ROMIOGetBuf(Slot, Config))
+			{
+				Slot->State = ROMIO_SLOT_READING;
+				ROMIOEngineQueue(&Engine, Slot);
+				Waiting--;
+				Active++;
+			}
+			else if(Active) Stalled = true;
+			else
+			{
+				// Nothing in flight will free up a buffer for it.
+				printf("No buffer for %s fits in the memory budget.\n", FileNames[Slot->Index]);
+				close(Slot->Fd);
+				Slot->Fd = -1;
+				ROMIOUnlock(Slot);
+				Slot->State = ROMIO_SLOT_FREE;
+				Waiting--;
+				Process(Ctx, Slot->Index, NULL, 0);
+			}
+		}
+		
+		if(!Active) continue;
+		
+		if(!(Slot = ROMIOEngineReap(&Engine, &Res)))
+		{
+			printf("Waiting for ROM I/O failed (%s).\n", strerror(errno));
+			Ret = false;
+			break;
+		}
+		
+		// A read that comes back empty has hit the end of the file,
+		// should it have shrunk; a write that does is an error.
+		Failed = (Res < 0) || (!Res && (Slot->State == ROMIO_SLOT_WRITING));
+		
+		if(Res > 0)
+		{
+			Slot->Done += Res;
+			
+			if(Slot->Done < Slot->Want)
+			{
+				ROMIOEngineQueue(&Engine, Slot);
+				continue;
+			}
+		}
+		
+		if(!Failed && Slot->TmpName && fsync(Slot->Fd)) Failed = true;
+		
+		close(Slot->Fd);
+		Slot->Fd = -1;
+		
+		if(Slot->State == ROMIO_SLOT_READING)
+		{
+			size_t Len;
+			
+			if(Failed || !Slot->Done)
+			{
+				printf("Reading the VBIOS file failed.\n");
+				Process(Ctx, Slot->Index, NULL, 0);
+			}
+			else if((Len = Process(Ctx, Slot->Index, Slot->Buf, Slot->Done)))
+			{
+				if(ROMIOStartWrite(Slot, FileNames[Slot->Index], Len, Config->Flags))
+				{
+					ROMIOEngineQueue(&Engine, Slot);
+					continue;
+				}
+				
+				if(Config->Done) Config->Done(Ctx, Slot->Index, false);
+				Ret = false;
+			}
+			else if(Config->Done) Config->Done(Ctx, Slot->Index, true);
+		}
+		else if(!ROMIOFinishWrite(Slot, FileNames[Slot->Index], Failed))
+		{
+			printf("Writing %s failed.\n", FileNames[Slot->Index]);
+			if(Config->Done) Config->Done(Ctx, Slot->Index, false);
+			Ret = false;
+		}
+		else if(Config->Done) Config->Done(Ctx, Slot->Index, true);
+		
+		ROMIOPutBuf(Slot, Config);
+		ROMIOUnlock(Slot);
+		Slot->State = ROMIO_SLOT_FREE;
+		Active--;
+	}
+	
+	ROMIOEngineFree(&Engine);
+	
+out:
+	for(uint32_t s = 0; s < Depth; ++s)
+	{
+		if(Slots[s].Fd >= 0)
+		{
+			close(Slots[s].Fd);
+			ROMIOFinishWrite(Slots + s, NULL, true);
+		}
+		
+		ROMIOPutBuf(Slots + s, Config);
+		ROMIOUnlock(Slots + s);
+	}
+	
+	free(Slots);
+	return(Ret);
+}
@@ -0,0 +1,80 @@
+// Copyright 2022 Wolf9466/Wolf0/OhGodAPet
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "bufpool.h"
+
+// Batched ROM I/O for bulk runs. Rather than reading, processing
+// and writing one file at a time, up to Depth ROMs are in flight
+// at once: reads (and the writes back of anything the processing
+// changed) are queued together, and each ROM is handed to the
+// processing callback as soon as its read completes, while the
+// reads of the others carry on behind it.
+//
+// Two backends do the I/O. io_uring submits every queued read and
+// write with a single syscall, and reaps completions from a ring
+// shared with the kernel; where the kernel lacks it (or it has
+// been disabled), a pool of threads issues plain pread/pwrite
+// calls instead. Either way, the callback always runs on the
+// calling thread, one ROM at a time, so it needs no locking.
+//
+// ROMs complete - and are processed - in whatever order the device
+// returns them, not the order they were given in.
+//
+// Image buffers come from a VBIOSBufPool, which may outlive any one
+// run. A ROM is only read once the pool can spare a buffer for it;
+// until then, the engine waits for ROMs in flight to finish instead,
+// so a run never holds more than the pool's budget.
+
+#define ROMIO_BACKEND_AUTO				0x00
+#define ROMIO_BACKEND_URING				0x01
+#define ROMIO_BACKEND_THREADS			0x02
+
+// Write each ROM to a temporary file beside it, and rename that
+// over the ROM once complete.
+#define ROMIO_FLAG_ATOMIC_WRITES		0x01
+
+// Give every ROM a buffer of AMD_VBIOS_MAX_SIZE bytes, rather than
+// one just large enough to hold it, for processing that may grow it.
+#define ROMIO_FLAG_FULL_BUFFERS			0x02
+
+// Lock each ROM (see ROMIOLockFile()) from before it is read until
+// it has been written back, so that several processes patching the
+// same ROMs - on the same host or, where the filesystem supports
+// flock(), on others - cannot undo each other's changes. The lock
+// is advisory, and only keeps out others that take it too.
+#define ROMIO_FLAG_LOCK					0x04
+
+#define ROMIO_DEFAULT_DEPTH				8
+#define ROMIO_MAX_DEPTH					64
+
+// Called, if set, once a ROM that was read is finished with: as
+// soon as it has been processed, if nothing was to be written back,
+// and otherwise once the write has completed (and, for an atomic
+// write, been moved into place), with Ok false if it failed. It is
+// given the same Ctx as the processing callback, on the same thread.
+typedef void (*ROMIODoneFn)(void *Ctx, uint32_t Index, bool Ok);
+
+typedef struct
+{
+	uint8_t Backend;
+	uint32_t Depth;
+	uint32_t Flags;
+	VBIOSBufPool *Pool;
+	ROMIODoneFn Done;
+} ROMIOConfig;
+
+// Called once per ROM with its image in Buf, which may be modified
+// in place; it holds room for AMD_VBIOS_MAX_SIZE bytes if the run
+// has ROMIO_FLAG_FULL_BUFFERS set, and only Len otherwise. Returns
+// the number of bytes of Buf to write back to the ROM's file, or
+// zero to leave it untouched. If the ROM could not be read, Buf is
+// NULL and Len is zero, and the return value is ignored.
+typedef size_t (*ROMIOProcessFn)(void *Ctx, uint32_t Index, uint8_t *Buf, size_t Len);
+
+int ROMIOLockFile(const char *FileName, bool Wait);
+bool ROMIORun(const ROMIOConfig *Config, char **FileNames, uint32_t FileCount, ROMIOProcessFn Process, void *Ctx);
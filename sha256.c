@@ -0,0 +1,123 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "sha256.h"
+
+// Plain FIPS 180-4 SHA-256, used to identify ROM images.
+
+static const uint32_t SHA256K[64] =
+{
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define ROTR32(x, n)		(((x) >> (n)) | ((x) << (32 - (n))))
+
+static void SHA256Block(SHA256Ctx *Ctx, const uint8_t *Block)
+{
+	uint32_t W[64], a, b, c, d, e, f, g, h;
+	
+	for(int i = 0; i < 16; ++i)
+		W[i] = ((uint32_t)Block[i << 2] << 24) | ((uint32_t)Block[(i << 2) + 1] << 16) | ((uint32_t)Block[(i << 2) + 2] << 8) | Block[(i << 2) + 3];
+	
+	for(int i = 16; i < 64; ++i)
+	{
+		uint32_t s0 = ROTR32(W[i - 15], 7) ^ ROTR32(W[i - 15], 18) ^ (W[i - 15] >> 3);
+		uint32_t s1 = ROTR32(W[i - 2], 17) ^ ROTR32(W[i - 2], 19) ^ (W[i - 2] >> 10);
+		
+		W[i] = W[i - 16] + s0 + W[i - 7] + s1;
+	}
+	
+	a = Ctx->State[0]; b = Ctx->State[1]; c = Ctx->State[2]; d = Ctx->State[3];
+	e = Ctx->State[4]; f = Ctx->State[5]; g = Ctx->State[6]; h = Ctx->State[7];
+	
+	for(int i = 0; i < 64; ++i)
+	{
+		uint32_t t1 = h + (ROTR32(e, 6) ^ ROTR32(e, 11) ^ ROTR32(e, 25)) + ((e & f) ^ (~e & g)) + SHA256K[i] + W[i];
+		uint32_t t2 = (ROTR32(a, 2) ^ ROTR32(a, 13) ^ ROTR32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+		
+		h = g; g = f; f = e; e = d + t1;
+		d = c; c = b; b = a; a = t1 + t2;
+	}
+	
+	Ctx->State[0] += a; Ctx->State[1] += b; Ctx->State[2] += c; Ctx->State[3] += d;
+	Ctx->State[4] += e; Ctx->State[5] += f; Ctx->State[6] += g; Ctx->State[7] += h;
+}
+
+void SHA256Init(SHA256Ctx *Ctx)
+{
+	static const uint32_t IV[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+	
+	memcpy(Ctx->State, IV, sizeof(IV));
+	Ctx->TotalLen = 0;
+	Ctx->BlockLen = 0;
+}
+
+void SHA256Update(SHA256Ctx *Ctx, const void *Data, size_t Len)
+{
+	const uint8_t *Ptr = (const uint8_t *)Data;
+	
+	Ctx->TotalLen += Len;
+	
+	while(Len)
+	{
+		uint32_t Take = 64 - Ctx->BlockLen;
+		
+		if(Take > Len) Take = Len;
+		
+		memcpy(Ctx->Block + Ctx->BlockLen, Ptr, Take);
+		Ctx->BlockLen += Take;
+		Ptr += Take;
+		Len -= Take;
+		
+		if(Ctx->BlockLen == 64)
+		{
+			SHA256Block(Ctx, Ctx->Block);
+			Ctx->BlockLen = 0;
+		}
+	}
+}
+
+void SHA256Final(SHA256Ctx *Ctx, uint8_t *Digest)
+{
+	const uint64_t BitLen = Ctx->TotalLen << 3;
+	
+	Ctx->Block[Ctx->BlockLen++] = 0x80;
+	
+	if(Ctx->BlockLen > 56)
+	{
+		memset(Ctx->Block + Ctx->BlockLen, 0x00, 64 - Ctx->BlockLen);
+		SHA256Block(Ctx, Ctx->Block);
+		Ctx->BlockLen = 0;
+	}
+	
+	memset(Ctx->Block + Ctx->BlockLen, 0x00, 56 - Ctx->BlockLen);
+	
+	for(int i = 0; i < 8; ++i) Ctx->Block[56 + i] = BitLen >> (56 - (i << 3));
+	
+	SHA256Block(Ctx, Ctx->Block);
+	
+	for(int i = 0; i < 8; ++i)
+	{
+		Digest[(i << 2) + 0] = Ctx->State[i] >> 24;
+		Digest[(i << 2) + 1] = Ctx->State[i] >> 16;
+		Digest[(i << 2) + 2] = Ctx->State[i] >> 8;
+		Digest[(i << 2) + 3] = Ctx->State[i];
+	}
+}
+
+void SHA256(uint8_t *Digest, const void *Data, size_t Len)
+{
+	SHA256Ctx Ctx;
+	
+	SHA256Init(&Ctx);
+	SHA256Update(&Ctx, Data, Len);
+	SHA256Final(&Ctx, Digest);
+}
@@ -0,0 +1,21 @@
+// Copyright 2022 Wolf9466/Wolf0/OhGodAPet
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SHA256_DIGEST_LEN					32
+
+typedef struct
+{
+	uint32_t State[8];
+	uint64_t TotalLen;
+	uint8_t Block[64];
+	uint32_t BlockLen;
+} SHA256Ctx;
+
+void SHA256Init(SHA256Ctx *Ctx);
+void SHA256Update(SHA256Ctx *Ctx, const void *Data, size_t Len);
+void SHA256Final(SHA256Ctx *Ctx, uint8_t *Digest);
+void SHA256(uint8_t *Digest, const void *Data, size_t Len);
@@ -0,0 +1,197 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include "stats.h"
+#include "shard.h"
+
+#define ROM_RECORD_PREFIX				"{\"rom\":\""
+#define ROM_RECORD_INDEX				"\",\"index\":"
+
+// Takes the form i/N, with i counted from zero.
+bool ParseShardSpec(ROMShardSpec *Spec, const char *Str)
+{
+	char *End;
+	
+	Spec->Shard = strtoul(Str, &End, 10);
+	
+	if((End == Str) || (*End != '/') || !End[1])
+	{
+		printf("Shards are given as i/N, not \"%s\".\n", Str);
+		return(false);
+	}
+	
+	Str = End + 1;
+	Spec->ShardCount = strtoul(Str, &End, 10);
+	
+	if(*End || !Spec->ShardCount || (Spec->Shard >= Spec->ShardCount))
+	{
+		printf("Shard %u/%s does not exist; shards are numbered from 0 to N - 1.\n", Spec->Shard, Str);
+		return(false);
+	}
+	
+	return(true);
+}
+
+uint32_t ROMShardOf(const char *Path, uint32_t ShardCount)
+{
+	uint64_t Hash = 0xCBF29CE484222325ULL;
+	
+	for(; *Path; ++Path) Hash = (Hash ^ (uint8_t)*Path) * 0x100000001B3ULL;
+	
+	return(Hash % ShardCount);
+}
+
+// Drops every ROM not in this shard from the list, keeping the
+// order of the rest.
+void ApplyShardSpec(const ROMShardSpec *Spec, char **ROMFiles, uint32_t *ROMFileCount)
+{
+	uint32_t Kept = 0;
+	
+	for(uint32_t r = 0; r < *ROMFileCount; ++r)
+	{
+		if(ROMShardOf(ROMFiles[r], Spec->ShardCount) == Spec->Shard) ROMFiles[Kept++] = ROMFiles[r];
+		else free(ROMFiles[r]);
+	}
+	
+	*ROMFileCount = Kept;
+}
+
+// Tells saved statistics apart from records by their first line.
+bool IsStatsFile(const char *FileName, bool *IsStats)
+{
+	FILE *InFile = fopen(FileName, "r");
+	char Line[64];
+	
+	if(!InFile)
+	{
+		printf("Unable to open %s (does it exist?)\n", FileName);
+		return(false);
+	}
+	
+	*IsStats = fgets(Line, sizeof(Line), InFile) && !strncmp(Line, VOISTATS_MAGIC " ", sizeof(VOISTATS_MAGIC));
+	
+	fclose(InFile);
+	return(true);
+}
+
+typedef struct
+{
+	char *Line;
+	const char *ROM;
+	size_t ROMLen;
+	long long Index;
+} ROMRecord;
+
+// The ROM name is compared as it appears, still escaped; any
+// consistent order will do, so long as it is the same everywhere.
+static void ROMRecordKey(ROMRecord *Rec)
+{
+	const char *p;
+	
+	Rec->ROM = NULL;
+	Rec->ROMLen = 0;
+	Rec->Index = -1;
+	
+	if(strncmp(Rec->Line, ROM_RECORD_PREFIX, sizeof(ROM_RECORD_PREFIX) - 1)) return;
+	
+	for(p = Rec->ROM = Rec->Line + sizeof(ROM_RECORD_PREFIX) - 1; *p && (*p != '"'); ++p)
+	{
+		if((*p == '\\') && p[1]) ++p;
+	}
+	
+	Rec->ROMLen = p - Rec->ROM;
+	
+	if(!strncmp(p, ROM_RECORD_INDEX, sizeof(ROM_RECORD_INDEX) - 1)) Rec->Index = strtoll(p + sizeof(ROM_RECORD_INDEX) - 1, NULL, 10);
+}
+
+static int CompareROMRecords(const void *A, const void *B)
+{
+	const ROMRecord *RecA = (const ROMRecord *)A, *RecB = (const ROMRecord *)B;
+	int Diff;
+	
+	if(!RecA->ROM != !RecB->ROM) return((RecA->ROM) ? 1 : -1);
+	
+	if(RecA->ROM)
+	{
+		Diff = memcmp(RecA->ROM, RecB->ROM, (RecA->ROMLen < RecB->ROMLen) ? RecA->ROMLen : RecB->ROMLen);
+		
+		if(Diff) return(Diff);
+		if(RecA->ROMLen != RecB->ROMLen) return((RecA->ROMLen < RecB->ROMLen) ? -1 : 1);
+		if(RecA->Index != RecB->Index) return((RecA->Index < RecB->Index) ? -1 : 1);
+	}
+	
+	return(strcmp(RecA->Line, RecB->Line));
+}
+
+// Merges the JSON lines output of any number of runs into one
+// sorted whole, on stdout.
+bool MergeRecordFiles(char **FileNames, uint32_t FileCount)
+{
+	ROMRecord *Recs = NULL;
+	size_t RecCount = 0, RecCap = 0, LineCap = 0;
+	char *Line = NULL;
+	ssize_t LineLen;
+	bool Ok = true;
+	
+	for(uint32_t f = 0; Ok && (f < FileCount); ++f)
+	{
+		FILE *InFile = fopen(FileNames[f], "r");
+		
+		if(!InFile)
+		{
+			printf("Unable to open %s (does it exist?)\n", FileNames[f]);
+			Ok = false;
+			break;
+		}
+		
+		while(Ok && ((LineLen = getline(&Line, &LineCap, InFile)) >= 0))
+		{
+			while(LineLen && ((Line[LineLen - 1] == '\n') || (Line[LineLen - 1] == '\r'))) Line[--LineLen] = 0x00;
+			
+			if(!LineLen) continue;
+			
+			if(RecCount == RecCap)
+			{
+				ROMRecord *NewRecs = (ROMRecord *)realloc(Recs, sizeof(ROMRecord) * ((RecCap) ? (RecCap << 1) : 1024));
+				
+				if(!NewRecs)
+				{
+					Ok = false;
+					break;
+				}
+				
+				Recs = NewRecs;
+				RecCap = (RecCap) ? (RecCap << 1) : 1024;
+			}
+			
+			if(!(Recs[RecCount].Line = strdup(Line)))
+			{
+				Ok = false;
+				break;
+			}
+			
+			ROMRecordKey(Recs + RecCount++);
+		}
+		
+		if(!Ok) printf("Out of memory.\n");
+		
+		fclose(InFile);
+	}
+	
+	if(Ok)
+	{
+		qsort(Recs, RecCount, sizeof(ROMRecord), CompareROMRecords);
+		
+		for(size_t i = 0; i < RecCount; ++i) puts(Recs[i].Line);
+	}
+	
+	for(size_t i = 0; i < RecCount; ++i) free(Recs[i].Line);
+	
+	free(Recs);
+	free(Line);
+	return(Ok);
+}
@@ -0,0 +1,36 @@
+// Copyright 2022 Wolf9466/Wolf0/OhGodAPet
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Splitting a scan across machines, and putting the results back
+// together.
+//
+// A ROM belongs to shard FNV-1a-64(path) % ShardCount, with the
+// path exactly as it was given, so every node given the same list
+// agrees on which ROMs are whose without talking to the others.
+//
+// The results of each shard - JSON lines from a dump, plan or
+// simulation, or saved statistics - are merged by concatenating
+// them and sorting the records by ROM, then VO index, then their
+// text. Since a single run emits ROMs in whatever order their
+// reads complete, it is the merge of a single run's output that
+// the merge of the shards' outputs equals, byte for byte. Lines
+// that are not records of a ROM (such as those for ROMs that
+// could not be read) sort by their text, ahead of all records.
+// Statistics simply add up (see stats.h).
+
+typedef struct
+{
+	uint32_t Shard;
+	uint32_t ShardCount;
+} ROMShardSpec;
+
+bool ParseShardSpec(ROMShardSpec *Spec, const char *Str);
+uint32_t ROMShardOf(const char *Path, uint32_t ShardCount);
+void ApplyShardSpec(const ROMShardSpec *Spec, char **ROMFiles, uint32_t *ROMFileCount);
+
+bool IsStatsFile(const char *FileName, bool *IsStats);
+bool MergeRecordFiles(char **FileNames, uint32_t FileCount);
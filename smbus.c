@@ -0,0 +1,362 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "voi.h"
+#include "smbus.h"
+
+#define PMBUS_PAGE					0x00
+
+// Decodes the register writes of an INIT_REGULATOR VO into an array
+// (freed by the caller) of WriteCount entries. On failure, nothing
+// is allocated and Error says why.
+bool SMBusDecodeVO(const VoltageObject *VO, const uint8_t *VOData, uint32_t VODataLen, SMBusWrite **Writes, uint32_t *WriteCount, const char **Error)
+{
+	SMBusWrite *Out;
+	uint32_t Count = 0, Pos = 0;
+	bool Word;
+	
+	*Writes = NULL;
+	*WriteCount = 0;
+	
+	if(VO->VOMode != VOLTAGE_MODE_INIT_REGULATOR)
+	{
+		*Error = "not an INIT_REGULATOR VO";
+		return(false);
+	}
+	
+	Word = VO->AsType3.VoltageControlFlag & 0x01;
+	
+	// Every entry takes four bytes, so this is always enough.
+	if(!(Out = (SMBusWrite *)malloc(sizeof(SMBusWrite) * ((VODataLen >> 2) + 1))))
+	{
+		*Error = "out of memory";
+		return(false);
+	}
+	
+	do
+	{
+		uint16_t Reg, Value;
+		
+		if((Pos + sizeof(uint16_t)) > VODataLen)
+		{
+			*Error = "the write list has no terminator";
+			goto fail;
+		}
+		
+		memcpy(&Reg, VOData + Pos, sizeof(uint16_t));
+		
+		if(Reg == 0xFF) break;
+		
+		if((Pos + (sizeof(uint16_t) << 1)) > VODataLen)
+		{
+			*Error = "the last write is truncated";
+			goto fail;
+		}
+		
+		memcpy(&Value, VOData + Pos + sizeof(uint16_t), sizeof(uint16_t));
+		
+		if(Reg > 0xFF)
+		{
+			*Error = "a register index does not fit in an SMBus command";
+			goto fail;
+		}
+		
+		if(!Word && (Value > 0xFF))
+		{
+			*Error = "a byte write has a value over 0xFF";
+			goto fail;
+		}
+		
+		Out[Count].Reg = (uint8_t)Reg;
+		Out[Count].Value = Value;
+		Out[Count].Word = Word;
+		Count++;
+		
+		Pos += sizeof(uint16_t) << 1;
+	} while(1);
+	
+	*Writes = Out;
+	*WriteCount = Count;
+	return(true);
+	
+fail:
+	free(Out);
+	return(false);
+}
+
+// A flat file of registers, one per command code, which stores
+// whatever is written to it.
+static uint8_t SMBusSimGenericWrite(SMBusSimDevice *Dev, const SMBusWrite *Write, SMBusSimReg **Slot)
+{
+	*Slot = &Dev->Regs[0][Write->Reg];
+	return(SMBUS_SIM_STORED);
+}
+
+// PMBus devices with more than one rail select the rail the other
+// commands act on with the PAGE command. Writing 0xFF to PAGE (all
+// pages at once) is not modelled, and is rejected.
+static uint8_t SMBusSimPMBusWrite(SMBusSimDevice *Dev, const SMBusWrite *Write, SMBusSimReg **Slot)
+{
+	if(Write->Reg == PMBUS_PAGE)
+	{
+		if(Write->Word || (Write->Value >= Dev->Model->PageCount)) return(SMBUS_SIM_REJECTED);
+		
+		Dev->Page = (uint8_t)Write->Value;
+		return(SMBUS_SIM_CONTROL);
+	}
+	
+	*Slot = &Dev->Regs[Dev->Page][Write->Reg];
+	return(SMBUS_SIM_STORED);
+}
+
+static const SMBusSimModel SMBusSimModels[] =
+{
+	{ "generic", 1, SMBusSimGenericWrite },
+	{ "pmbus", SMBUS_SIM_MAX_PAGES, SMBusSimPMBusWrite }
+};
+
+const SMBusSimModel *SMBusSimFindModel(const char *Name)
+{
+	for(size_t i = 0; i < (sizeof(SMBusSimModels) / sizeof(SMBusSimModels[0])); ++i)
+	{
+		if(!strcmp(SMBusSimModels[i].Name, Name)) return(SMBusSimModels + i);
+	}
+	
+	return(NULL);
+}
+
+// A NULL model is the generic one.
+void SMBusSimInit(SMBusSim *Sim, const SMBusSimModel *Model)
+{
+	memset(Sim, 0x00, sizeof(SMBusSim));
+	Sim->Model = (Model) ? Model : SMBusSimModels;
+}
+
+void SMBusSimFree(SMBusSim *Sim)
+{
+	for(uint32_t i = 0; i < Sim->DeviceCount; ++i) free(Sim->Devices[i]);
+	Sim->DeviceCount = 0;
+}
+
+static SMBusSimDevice *SMBusSimGetDevice(SMBusSim *Sim, uint8_t I2CLine, uint8_t I2CAddress)
+{
+	SMBusSimDevice *Dev;
+	
+	for(uint32_t i = 0; i < Sim->DeviceCount; ++i)
+	{
+		if((Sim->Devices[i]->I2CLine == I2CLine) && (Sim->Devices[i]->I2CAddress == I2CAddress)) return(Sim->Devices[i]);
+	}
+	
+	if((Sim->DeviceCount == SMBUS_SIM_MAX_DEVICES) || !(Dev = (SMBusSimDevice *)calloc(1, sizeof(SMBusSimDevice)))) return(NULL);
+	
+	Dev->I2CLine = I2CLine;
+	Dev->I2CAddress = I2CAddress;
+	Dev->Model = Sim->Model;
+	
+	Sim->Devices[Sim->DeviceCount++] = Dev;
+	return(Dev);
+}
+
+static void SMBusSimAddBadVO(SMBusSim *Sim, uint16_t Index, const char *Error)
+{
+	if(Sim->BadVOCount < SMBUS_SIM_MAX_CONFLICTS)
+	{
+		Sim->BadVOs[Sim->BadVOCount].VO = Index;
+		Sim->BadVOs[Sim->BadVOCount].Error = Error;
+	}
+	
+	Sim->BadVOCount++;
+}
+
+// Two VOs conflict over a register when both write it, and the one
+// that runs later leaves a different value than the earlier did.
+// Writing a register more than once within one VO is how sequences
+// work, and is not a conflict.
+static void SMBusSimStore(SMBusSim *Sim, SMBusSimDevice *Dev, SMBusSimReg *Slot, const SMBusWrite *Write, uint16_t Index)
+{
+	if(Slot->Written && (Slot->LastVO != Index) && (Slot->Value != Write->Value))
+	{
+		if(Sim->ConflictCount < SMBUS_SIM_MAX_CONFLICTS)
+		{
+			SMBusSimConflict *Conflict = Sim->Conflicts + Sim->ConflictCount++;
+			uint32_t RegIdx = (uint32_t)(Slot - Dev->Regs[0]);
+			
+			Conflict->I2CLine = Dev->I2CLine;
+			Conflict->I2CAddress = Dev->I2CAddress;
+			Conflict->Page = RegIdx >> 8;
+			Conflict->Reg = RegIdx & 0xFF;
+			Conflict->FirstVO = Slot->LastVO;
+			Conflict->FirstValue = Slot->Value;
+			Conflict->VO = Index;
+			Conflict->Value = Write->Value;
+		}
+		else Sim->LostConflicts++;
+	}
+	
+	if(!Slot->Written) Slot->FirstVO = Index;
+	
+	Slot->Written = true;
+	Slot->Word = Write->Word;
+	Slot->Value = Write->Value;
+	Slot->LastVO = Index;
+	Slot->WriteCount++;
+}
+
+static bool SMBusSimVisit(VoltageObject *VO, uint8_t *VOData, uint32_t VODataLen, uint16_t Index, void *Ctx)
+{
+	SMBusSim *Sim = (SMBusSim *)Ctx;
+	SMBusSimDevice *Dev;
+	SMBusWrite *Writes;
+	uint32_t WriteCount;
+	const char *Error;
+	
+	Sim->VOCount++;
+	
+	if(!SMBusDecodeVO(VO, VOData, VODataLen, &Writes, &WriteCount, &Error))
+	{
+		SMBusSimAddBadVO(Sim, Index, Error);
+		return(true);
+	}
+	
+	if(!(Dev = SMBusSimGetDevice(Sim, VO->AsType3.I2CLine, VO->AsType3.I2CAddress)))
+	{
+		SMBusSimAddBadVO(Sim, Index, "too many devices to simulate");
+		free(Writes);
+		return(true);
+	}
+	
+	for(uint32_t i = 0; i < WriteCount; ++i)
+	{
+		SMBusSimReg *Slot;
+		
+		switch(Dev->Model->Write(Dev, Writes + i, &Slot))
+		{
+			case SMBUS_SIM_STORED: SMBusSimStore(Sim, Dev, Slot, Writes + i, Index); break;
+			case SMBUS_SIM_REJECTED: Dev->Rejected++; break;
+			default: break;
+		}
+	}
+	
+	free(Writes);
+	return(true);
+}
+
+// Replays every INIT_REGULATOR VO in the table (that matches Filter,
+// if given.) Returns false only if the table itself is malformed;
+// VOs whose writes cannot be decoded are noted and skipped.
+bool SMBusSimRunTable(SMBusSim *Sim, uint8_t *VOITableBase, const VOFilter *Filter)
+{
+	return(WalkVOTable(VOITableBase, VOLTAGE_MODE_INIT_REGULATOR, Filter, SMBusSimVisit, Sim) >= 0);
+}
+
+static void SMBusSimPrintText(const SMBusSim *Sim)
+{
+	printf("Replayed %u INIT_REGULATOR VOs onto %u devices (%s model).\n", Sim->VOCount, Sim->DeviceCount, Sim->Model->Name);
+	
+	for(uint32_t i = 0; i < Sim->DeviceCount; ++i)
+	{
+		const SMBusSimDevice *Dev = Sim->Devices[i];
+		
+		printf("\nDevice on I2C line %d, address 0x%02X:\n", Dev->I2CLine, Dev->I2CAddress);
+		
+		for(uint32_t Page = 0; Page < Dev->Model->PageCount; ++Page)
+		{
+			for(uint32_t Reg = 0; Reg < 256; ++Reg)
+			{
+				const SMBusSimReg *Slot = &Dev->Regs[Page][Reg];
+				
+				if(!Slot->Written) continue;
+				
+				if(Dev->Model->PageCount > 1) printf("\tPage %u, ", Page);
+				else putchar('\t');
+				
+				printf("Register 0x%02X = ", Reg);
+				
+				if(Slot->Word) printf("0x%04X (word)", Slot->Value);
+				else printf("0x%02X (byte)", Slot->Value);
+				
+				if(Slot->FirstVO == Slot->LastVO) printf(", written %u times by VO %d\n", Slot->WriteCount, Slot->LastVO);
+				else printf(", written %u times, first by VO %d and last by VO %d\n", Slot->WriteCount, Slot->FirstVO, Slot->LastVO);
+			}
+		}
+		
+		if(Dev->Rejected) printf("\t%u writes were rejected by the device.\n", Dev->Rejected);
+	}
+	
+	if(Sim->ConflictCount) putchar('\n');
+	
+	for(uint32_t i = 0; i < Sim->ConflictCount; ++i)
+	{
+		const SMBusSimConflict *Conflict = Sim->Conflicts + i;
+		
+		printf("Conflict on I2C line %d, address 0x%02X, ", Conflict->I2CLine, Conflict->I2CAddress);
+		if(Sim->Model->PageCount > 1) printf("page %d, ", Conflict->Page);
+		printf("register 0x%02X: VO %d wrote 0x%02X, then VO %d wrote 0x%02X.\n", Conflict->Reg, Conflict->FirstVO, Conflict->FirstValue, Conflict->VO, Conflict->Value);
+	}
+	
+	if(Sim->LostConflicts) printf("%u more conflicts were not recorded.\n", Sim->LostConflicts);
+	
+	for(uint32_t i = 0; (i < Sim->BadVOCount) && (i < SMBUS_SIM_MAX_CONFLICTS); ++i)
+		printf("VO %d was not replayed: %s.\n", Sim->BadVOs[i].VO, Sim->BadVOs[i].Error);
+}
+
+static void SMBusSimPrintJSON(const SMBusSim *Sim, const char *ROMName)
+{
+	printf("{\"rom\":");
+	PrintJSONString(ROMName);
+	printf(",\"model\":\"%s\",\"vos\":%u,\"devices\":[", Sim->Model->Name, Sim->VOCount);
+	
+	for(uint32_t i = 0; i < Sim->DeviceCount; ++i)
+	{
+		const SMBusSimDevice *Dev = Sim->Devices[i];
+		bool First = true;
+		
+		printf("%s{\"i2c_line\":%d,\"i2c_address\":%d,\"rejected\":%u,\"registers\":[", (i) ? "," : "", Dev->I2CLine, Dev->I2CAddress, Dev->Rejected);
+		
+		for(uint32_t Page = 0; Page < Dev->Model->PageCount; ++Page)
+		{
+			for(uint32_t Reg = 0; Reg < 256; ++Reg)
+			{
+				const SMBusSimReg *Slot = &Dev->Regs[Page][Reg];
+				
+				if(!Slot->Written) continue;
+				
+				printf("%s{\"page\":%u,\"reg\":%u,\"value\":%d,\"word\":%s,\"writes\":%u,\"first_vo\":%d,\"last_vo\":%d}", (First) ? "" : ",",
+					Page, Reg, Slot->Value, (Slot->Word) ? "true" : "false", Slot->WriteCount, Slot->FirstVO, Slot->LastVO);
+				First = false;
+			}
+		}
+		
+		printf("]}");
+	}
+	
+	printf("],\"conflicts\":[");
+	
+	for(uint32_t i = 0; i < Sim->ConflictCount; ++i)
+	{
+		const SMBusSimConflict *Conflict = Sim->Conflicts + i;
+		
+		printf("%s{\"i2c_line\":%d,\"i2c_address\":%d,\"page\":%d,\"reg\":%d,\"first_vo\":%d,\"first_value\":%d,\"vo\":%d,\"value\":%d}", (i) ? "," : "",
+			Conflict->I2CLine, Conflict->I2CAddress, Conflict->Page, Conflict->Reg, Conflict->FirstVO, Conflict->FirstValue, Conflict->VO, Conflict->Value);
+	}
+	
+	printf("],\"lost_conflicts\":%u,\"bad_vos\":[", Sim->LostConflicts);
+	
+	for(uint32_t i = 0; (i < Sim->BadVOCount) && (i < SMBUS_SIM_MAX_CONFLICTS); ++i)
+	{
+		printf("%s{\"index\":%d,\"error\":", (i) ? "," : "", Sim->BadVOs[i].VO);
+		PrintJSONString(Sim->BadVOs[i].Error);
+		putchar('}');
+	}
+	
+	printf("]}\n");
+}
+
+void SMBusSimPrint(const SMBusSim *Sim, const char *ROMName, bool JSON)
+{
+	if(JSON) SMBusSimPrintJSON(Sim, ROMName);
+	else SMBusSimPrintText(Sim);
+}
@@ -0,0 +1,125 @@
+// Copyright 2022 Wolf9466/Wolf0/OhGodAPet
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "voi.h"
+
+// The data of an INIT_REGULATOR VO is a list of register writes,
+// each a little-endian uint16_t register index followed by a
+// uint16_t value, ending with a lone index of 0xFF:
+//
+//	41 00 71 00		write 0x71 to register 0x41
+//	37 00 28 00		write 0x28 to register 0x37
+//	FF 00			end
+//
+// Bit 0 of VoltageControlFlag selects how each is sent: clear for
+// an SMBus write byte (only the low byte of the value is used),
+// set for an SMBus write word. The register index is the SMBus
+// command code, so it must fit in a byte.
+
+typedef struct
+{
+	uint8_t Reg;
+	uint16_t Value;
+	bool Word;
+} SMBusWrite;
+
+bool SMBusDecodeVO(const VoltageObject *VO, const uint8_t *VOData, uint32_t VODataLen, SMBusWrite **Writes, uint32_t *WriteCount, const char **Error);
+
+// A simulator that replays the writes of every INIT_REGULATOR VO
+// in a VOI table, in table order, onto an in-memory model of each
+// device they address - one per I2C line and address - as a way
+// to see what a sequence does without flashing a card.
+//
+// How a device takes a write is up to its model. The generic model
+// is a flat file of byte or word registers; the PMBus model keeps
+// a bank of registers per page, switched by writes to PAGE (0x00),
+// as multi-rail VRM controllers do. New models need only a write
+// function and an entry in the list in smbus.c.
+//
+// Afterwards, the final state of every register written is
+// reported, along with every register that two VOs set to
+// different values - as happens when, say, the VDDC and VDDGFX
+// VOs carry overlapping sequences for the same controller.
+
+#define SMBUS_SIM_MAX_DEVICES			16
+#define SMBUS_SIM_MAX_PAGES				4
+#define SMBUS_SIM_MAX_CONFLICTS			64
+
+#define SMBUS_SIM_STORED				0x00
+#define SMBUS_SIM_CONTROL				0x01
+#define SMBUS_SIM_REJECTED				0x02
+
+typedef struct
+{
+	bool Written;
+	bool Word;
+	uint16_t Value;
+	uint16_t FirstVO;
+	uint16_t LastVO;
+	uint32_t WriteCount;
+} SMBusSimReg;
+
+typedef struct SMBusSimDevice_s SMBusSimDevice;
+
+typedef struct
+{
+	const char *Name;
+	uint32_t PageCount;
+
+	// Returns SMBUS_SIM_STORED with the register the write lands in
+	// set in *Slot, SMBUS_SIM_CONTROL for a write the device acts on
+	// but does not store (such as a page switch), or
+	// SMBUS_SIM_REJECTED for one it would NAK.
+	uint8_t (*Write)(SMBusSimDevice *Dev, const SMBusWrite *Write, SMBusSimReg **Slot);
+} SMBusSimModel;
+
+struct SMBusSimDevice_s
+{
+	uint8_t I2CLine;
+	uint8_t I2CAddress;
+	const SMBusSimModel *Model;
+	uint8_t Page;
+	uint32_t Rejected;
+	SMBusSimReg Regs[SMBUS_SIM_MAX_PAGES][256];
+};
+
+typedef struct
+{
+	uint8_t I2CLine;
+	uint8_t I2CAddress;
+	uint8_t Page;
+	uint8_t Reg;
+	uint16_t FirstVO;
+	uint16_t FirstValue;
+	uint16_t VO;
+	uint16_t Value;
+} SMBusSimConflict;
+
+typedef struct
+{
+	uint16_t VO;
+	const char *Error;
+} SMBusSimBadVO;
+
+typedef struct
+{
+	const SMBusSimModel *Model;
+	uint32_t DeviceCount;
+	SMBusSimDevice *Devices[SMBUS_SIM_MAX_DEVICES];
+	uint32_t ConflictCount;
+	uint32_t LostConflicts;
+	SMBusSimConflict Conflicts[SMBUS_SIM_MAX_CONFLICTS];
+	uint32_t VOCount;
+	uint32_t BadVOCount;
+	SMBusSimBadVO BadVOs[SMBUS_SIM_MAX_CONFLICTS];
+} SMBusSim;
+
+const SMBusSimModel *SMBusSimFindModel(const char *Name);
+void SMBusSimInit(SMBusSim *Sim, const SMBusSimModel *Model);
+bool SMBusSimRunTable(SMBusSim *Sim, uint8_t *VOITableBase, const VOFilter *Filter);
+void SMBusSimPrint(const SMBusSim *Sim, const char *ROMName, bool JSON);
+void SMBusSimFree(SMBusSim *Sim);
@@ -0,0 +1,293 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "vbios-tables.h"
+#include "vbios.h"
+#include "voi.h"
+#include "plan.h"
+#include "smbus.h"
+#include "smbusopt.h"
+
+#define SMBUSOPT_KEEP					0x00
+#define SMBUSOPT_REDUNDANT				0x01
+#define SMBUSOPT_OVERWRITTEN			0x02
+
+// A write, what the device model made of it, and whether it stays.
+typedef struct
+{
+	SMBusWrite Write;
+	uint8_t Result;
+	SMBusSimReg *Slot;
+	uint8_t Drop;
+} SMBusOptWrite;
+
+typedef struct
+{
+	VoltageObject *VO;
+	uint8_t *Data;
+	uint32_t DataLen;
+	uint16_t Index;
+	uint32_t Device;
+	uint32_t WriteCount;
+	SMBusOptWrite *Writes;
+} SMBusOptVO;
+
+// Last is the last write kept so far that reached the device.
+typedef struct
+{
+	SMBusSimDevice *Dev;
+	bool Bad;
+	SMBusOptWrite *Last;
+} SMBusOptDevice;
+
+typedef struct
+{
+	SMBusOpt *Opt;
+	bool OutOfMemory;
+	uint32_t VOCount;
+	SMBusOptVO *VOs;
+	uint32_t DeviceCount;
+	SMBusOptDevice Devices[SMBUS_SIM_MAX_DEVICES];
+} SMBusOptCtx;
+
+// Returns the index of the device on I2CLine at I2CAddress, adding
+// it if need be, or SMBUS_SIM_MAX_DEVICES if there is no room.
+static uint32_t SMBusOptGetDevice(SMBusOptCtx *Ctx, uint8_t I2CLine, uint8_t I2CAddress)
+{
+	SMBusSimDevice *Dev;
+
+	for(uint32_t i = 0; i < Ctx->DeviceCount; ++i)
+	{
+		if((Ctx->Devices[i].Dev->I2CLine == I2CLine) && (Ctx->Devices[i].Dev->I2CAddress == I2CAddress)) return(i);
+	}
+
+	if((Ctx->DeviceCount == SMBUS_SIM_MAX_DEVICES) || !(Dev = (SMBusSimDevice *)calloc(1, sizeof(SMBusSimDevice)))) return(SMBUS_SIM_MAX_DEVICES);
+
+	Dev->I2CLine = I2CLine;
+	Dev->I2CAddress = I2CAddress;
+	Dev->Model = Ctx->Opt->Model;
+
+	Ctx->Devices[Ctx->DeviceCount].Dev = Dev;
+	return(Ctx->DeviceCount++);
+}
+
+static bool SMBusOptCollectVisit(VoltageObject *VO, uint8_t *VOData, uint32_t VODataLen, uint16_t Index, void *Ctx)
+{
+	SMBusOptCtx *Opt = (SMBusOptCtx *)Ctx;
+	SMBusOptVO *Out = Opt->VOs + Opt->VOCount++;
+	SMBusWrite *Writes;
+	const char *Error;
+
+	memset(Out, 0x00, sizeof(SMBusOptVO));
+	Out->VO = VO;
+	Out->Data = VOData;
+	Out->DataLen = VODataLen;
+	Out->Index = Index;
+
+	if((Out->Device = SMBusOptGetDevice(Opt, VO->AsType3.I2CLine, VO->AsType3.I2CAddress)) == SMBUS_SIM_MAX_DEVICES) return(true);
+
+	if(!SMBusDecodeVO(VO, VOData, VODataLen, &Writes, &Out->WriteCount, &Error))
+	{
+		Opt->Devices[Out->Device].Bad = true;
+		return(true);
+	}
+
+	if(!(Out->Writes = (SMBusOptWrite *)calloc(Out->WriteCount + 1, sizeof(SMBusOptWrite))))
+	{
+		Opt->OutOfMemory = true;
+		free(Writes);
+		return(false);
+	}
+
+	for(uint32_t w = 0; w < Out->WriteCount; ++w) Out->Writes[w].Write = Writes[w];
+
+	free(Writes);
+	return(true);
+}
+
+// Replays one VO's writes, marking those that may be dropped.
+static void SMBusOptReplay(SMBusOptDevice *Dev, SMBusOptVO *VO)
+{
+	for(uint32_t w = 0; w < VO->WriteCount; ++w)
+	{
+		SMBusOptWrite *Cur = VO->Writes + w;
+
+		Cur->Result = Dev->Dev->Model->Write(Dev->Dev, &Cur->Write, &Cur->Slot);
+
+		if(Cur->Result == SMBUS_SIM_STORED)
+		{
+			if(Cur->Slot->Written && (Cur->Slot->Word == Cur->Write.Word) && (Cur->Slot->Value == Cur->Write.Value))
+			{
+				Cur->Drop = SMBUSOPT_REDUNDANT;
+				continue;
+			}
+
+			if(Dev->Last && (Dev->Last->Result == SMBUS_SIM_STORED) && (Dev->Last->Slot == Cur->Slot)) Dev->Last->Drop = SMBUSOPT_OVERWRITTEN;
+
+			Cur->Slot->Written = true;
+			Cur->Slot->Word = Cur->Write.Word;
+			Cur->Slot->Value = Cur->Write.Value;
+		}
+
+		Dev->Last = Cur;
+	}
+}
+
+// Makes the edit giving VO the writes it keeps. Whatever followed
+// the terminator is kept after the new one.
+static bool SMBusOptMakeEdit(SMBusOpt *Opt, const SMBusOptVO *VO)
+{
+	VOEdit *Edit = Opt->Edits + Opt->EditCount;
+	uint32_t Kept = 0, TailLen = VO->DataLen - ((VO->WriteCount << 2) + sizeof(uint16_t));
+
+	for(uint32_t w = 0; w < VO->WriteCount; ++w)
+	{
+		if(VO->Writes[w].Drop == SMBUSOPT_KEEP) Kept++;
+	}
+
+	memset(Edit, 0x00, sizeof(VOEdit));
+	Edit->Index = VO->Index;
+	Edit->SetMask = VOEDIT_SET_DATA;
+	Edit->DataLen = (Kept << 2) + sizeof(uint16_t) + TailLen;
+
+	if(!(Edit->Data = (uint8_t *)malloc(Edit->DataLen))) return(false);
+
+	Kept = 0;
+
+	for(uint32_t w = 0; w < VO->WriteCount; ++w)
+	{
+		const SMBusOptWrite *Cur = VO->Writes + w;
+		uint16_t Reg = Cur->Write.Reg;
+
+		if(Cur->Drop != SMBUSOPT_KEEP)
+		{
+			if(Cur->Drop == SMBUSOPT_REDUNDANT) Opt->RedundantCount++;
+			else Opt->OverwrittenCount++;
+
+			Opt->NanosSaved += (((uint64_t)((Cur->Write.Word) ? SMBUSOPT_WRITE_WORD_CLOCKS : SMBUSOPT_WRITE_BYTE_CLOCKS) * 1000000000ULL) / SMBUSOPT_BUS_HZ) + SMBUSOPT_BUS_FREE_NS;
+			continue;
+		}
+
+		memcpy(Edit->Data + (Kept << 2), &Reg, sizeof(uint16_t));
+		memcpy(Edit->Data + (Kept << 2) + sizeof(uint16_t), &Cur->Write.Value, sizeof(uint16_t));
+		Kept++;
+	}
+
+	Edit->Data[Kept << 2] = 0xFF;
+	Edit->Data[(Kept << 2) + 1] = 0x00;
+	memcpy(Edit->Data + (Kept << 2) + sizeof(uint16_t), VO->Data + VO->DataLen - TailLen, TailLen);
+
+	if(!Kept) Opt->EmptiedCount++;
+
+	Opt->BytesSaved += VO->DataLen - Edit->DataLen;
+	Opt->EditCount++;
+	return(true);
+}
+
+// Works out which INIT_REGULATOR writes in the ROM may be dropped,
+// and the edits that drop them, to be planned and applied as any
+// other edits are. Returns false only if the table is malformed,
+// or memory runs out.
+bool SMBusOptimize(SMBusOpt *Opt, const VBIOSInfo *Info, const SMBusSimModel *Model)
+{
+	SMBusOptCtx Ctx;
+	bool Ret = false;
+
+	memset(Opt, 0x00, sizeof(SMBusOpt));
+	Opt->Model = (Model) ? Model : SMBusSimFindModel("generic");
+
+	memset(&Ctx, 0x00, sizeof(SMBusOptCtx));
+	Ctx.Opt = Opt;
+
+	if(!(Ctx.VOs = (SMBusOptVO *)malloc(sizeof(SMBusOptVO) * VOI_MAX_VOS)))
+	{
+		printf("Out of memory.\n");
+		return(false);
+	}
+
+	if(WalkVOTable(Info->Image + Info->VOITblOffset, VOLTAGE_MODE_INIT_REGULATOR, NULL, SMBusOptCollectVisit, &Ctx) < 0)
+	{
+		if(Ctx.OutOfMemory) printf("Out of memory.\n");
+		goto out;
+	}
+
+	Opt->VOCount = Ctx.VOCount;
+	Opt->DeviceCount = Ctx.DeviceCount;
+
+	for(uint32_t v = 0; v < Ctx.VOCount; ++v)
+	{
+		SMBusOptVO *VO = Ctx.VOs + v;
+
+		if((VO->Device == SMBUS_SIM_MAX_DEVICES) || Ctx.Devices[VO->Device].Bad)
+		{
+			Opt->SkippedVOs++;
+			continue;
+		}
+
+		Opt->WriteCount += VO->WriteCount;
+		SMBusOptReplay(Ctx.Devices + VO->Device, VO);
+	}
+
+	for(uint32_t v = 0; v < Ctx.VOCount; ++v)
+	{
+		SMBusOptVO *VO = Ctx.VOs + v;
+		bool Changed = false;
+
+		if((VO->Device == SMBUS_SIM_MAX_DEVICES) || Ctx.Devices[VO->Device].Bad) continue;
+
+		for(uint32_t w = 0; w < VO->WriteCount; ++w) Changed |= VO->Writes[w].Drop != SMBUSOPT_KEEP;
+
+		if(!Changed) continue;
+
+		if(Opt->EditCount == VBIOS_PLAN_MAX_EDITS)
+		{
+			Opt->EditsCapped = true;
+			break;
+		}
+
+		if(!SMBusOptMakeEdit(Opt, VO))
+		{
+			printf("Out of memory.\n");
+			goto out;
+		}
+	}
+
+	Ret = true;
+
+out:
+	for(uint32_t v = 0; v < Ctx.VOCount; ++v) free(Ctx.VOs[v].Writes);
+	for(uint32_t d = 0; d < Ctx.DeviceCount; ++d) free(Ctx.Devices[d].Dev);
+	free(Ctx.VOs);
+
+	if(!Ret) SMBusOptFree(Opt);
+	return(Ret);
+}
+
+void SMBusOptPrint(const SMBusOpt *Opt, const char *ROMName, bool JSON)
+{
+	if(JSON)
+	{
+		printf("{\"rom\":");
+		PrintJSONString(ROMName);
+		printf(",\"model\":\"%s\",\"vos\":%u,\"devices\":%u,\"skipped_vos\":%u,\"writes\":%u", Opt->Model->Name, Opt->VOCount, Opt->DeviceCount, Opt->SkippedVOs, Opt->WriteCount);
+		printf(",\"redundant\":%u,\"overwritten\":%u,\"vos_changed\":%u,\"vos_emptied\":%u", Opt->RedundantCount, Opt->OverwrittenCount, Opt->EditCount, Opt->EmptiedCount);
+		printf(",\"bytes_saved\":%u,\"smbus_ns_saved\":%llu,\"capped\":%s}\n", Opt->BytesSaved, (unsigned long long)Opt->NanosSaved, (Opt->EditsCapped) ? "true" : "false");
+		return;
+	}
+
+	printf("%u INIT_REGULATOR VOs send %u writes to %u devices (%s model).\n", Opt->VOCount, Opt->WriteCount, Opt->DeviceCount, Opt->Model->Name);
+	printf("%u redundant and %u overwritten writes can be dropped from %u VOs, %u of which are left with none.\n", Opt->RedundantCount, Opt->OverwrittenCount, Opt->EditCount, Opt->EmptiedCount);
+	printf("That frees %u bytes, and saves about %.2f ms of SMBus time (at 100 kHz) at every init.\n", Opt->BytesSaved, Opt->NanosSaved / 1000000.0);
+
+	if(Opt->SkippedVOs) printf("%u VOs were left as they are, as their writes, or another VO's for the same device, cannot be decoded.\n", Opt->SkippedVOs);
+	if(Opt->EditsCapped) printf("Only the first %d VOs that can be optimized were; run again for the rest.\n", VBIOS_PLAN_MAX_EDITS);
+}
+
+void SMBusOptFree(SMBusOpt *Opt)
+{
+	for(uint32_t i = 0; i < Opt->EditCount; ++i) FreeVOEdit(Opt->Edits + i);
+	Opt->EditCount = 0;
+}
@@ -0,0 +1,69 @@
+// Copyright 2022 Wolf9466/Wolf0/OhGodAPet
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "vbios.h"
+#include "plan.h"
+#include "smbus.h"
+
+// An optimizer for the INIT_REGULATOR sequences the driver replays
+// at every GPU init. The writes of every INIT_REGULATOR VO are run,
+// in table order, through the simulator's model of the device they
+// address, as the simulator does, and two kinds of write dropped:
+//
+//	- redundant writes, which store the value the register already
+//	  holds from an earlier write, and the same way (byte or word);
+//	- overwritten writes, which are followed by a write to the same
+//	  register before anything else is sent to the device.
+//
+// Nothing is assumed about a register no write has set yet, so the
+// first write to each is always kept. A write is only overwritten
+// when nothing else reaches the device in between, so sequences
+// such as unlock, write, lock keep their order and every step. The
+// model decides what a register is: with the PMBus model, a write
+// on another page is another register, and page switches are never
+// dropped. A device with any VO that cannot be decoded is left as
+// it is.
+//
+// Like the simulator, this takes every VO to run, in table order,
+// at each init, so writes are dropped across VOs as well as within
+// them; a VO that only repeats the sequence an earlier VO sent the
+// same device (as VDDC and VDDGFX VOs often do) is left with just
+// its terminator. No VO is removed, as the driver looks them up by
+// type. At most VBIOS_PLAN_MAX_EDITS VOs are changed, the first in
+// the table; that is safe, as a write is only dropped for what the
+// writes before it did, or for one after it, which a VO left as it
+// is still sends.
+//
+// The bus time saved is estimated for a 100 kHz bus: a write byte
+// is 29 clocks and a write word 38, start and stop included, plus
+// the 4.7 us of bus free time between transactions.
+
+#define SMBUSOPT_BUS_HZ					100000
+#define SMBUSOPT_WRITE_BYTE_CLOCKS		29
+#define SMBUSOPT_WRITE_WORD_CLOCKS		38
+#define SMBUSOPT_BUS_FREE_NS			4700
+
+typedef struct
+{
+	const SMBusSimModel *Model;
+	uint32_t VOCount;
+	uint32_t DeviceCount;
+	uint32_t SkippedVOs;
+	uint32_t WriteCount;
+	uint32_t RedundantCount;
+	uint32_t OverwrittenCount;
+	uint32_t EmptiedCount;
+	uint32_t BytesSaved;
+	uint64_t NanosSaved;
+	bool EditsCapped;
+	uint32_t EditCount;
+	VOEdit Edits[VBIOS_PLAN_MAX_EDITS];
+} SMBusOpt;
+
+bool SMBusOptimize(SMBusOpt *Opt, const VBIOSInfo *Info, const SMBusSimModel *Model);
+void SMBusOptPrint(const SMBusOpt *Opt, const char *ROMName, bool JSON);
+void SMBusOptFree(SMBusOpt *Opt);
@@ -0,0 +1,323 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "vbios-tables.h"
+#include "voi.h"
+#include "stats.h"
+
+#define VOISTATS_MIN_CAPACITY			16
+
+typedef struct
+{
+	const char *Name;
+	const char *Title;
+} VOIStatsHistDesc;
+
+static const VOIStatsHistDesc VOIStatsHists[VOISTATS_HIST_COUNT] =
+{
+	{ "vosize", "VO sizes" },
+	{ "datalen", "Payload lengths" },
+	{ "typemode", "Types and modes" },
+	{ "regid", "Regulator IDs" },
+	{ "i2c", "I2C lines and addresses" },
+	{ "llslopetrim", "LoadLineSlopeTrim settings" },
+	{ "voirev", "VOI table revisions" }
+};
+
+void VOIStatsInit(VOIStats *Stats)
+{
+	memset(Stats, 0x00, sizeof(VOIStats));
+}
+
+static uint32_t VOIStatsHash(uint32_t Key)
+{
+	Key ^= Key >> 16;
+	Key *= 0x45D9F3B;
+	Key ^= Key >> 16;
+
+	return(Key);
+}
+
+static bool VOIStatsHistGrow(VOIStatsHist *Hist)
+{
+	uint32_t NewCapacity = (Hist->Capacity) ? (Hist->Capacity << 1) : VOISTATS_MIN_CAPACITY;
+	VOIStatsBin *NewBins = (VOIStatsBin *)calloc(NewCapacity, sizeof(VOIStatsBin));
+
+	if(!NewBins) return(false);
+
+	for(uint32_t i = 0; i < Hist->Capacity; ++i)
+	{
+		uint32_t Slot;
+
+		if(!Hist->Bins[i].Count) continue;
+
+		for(Slot = VOIStatsHash(Hist->Bins[i].Key) & (NewCapacity - 1); NewBins[Slot].Count; Slot = (Slot + 1) & (NewCapacity - 1));
+
+		NewBins[Slot] = Hist->Bins[i];
+	}
+
+	free(Hist->Bins);
+	Hist->Bins = NewBins;
+	Hist->Capacity = NewCapacity;
+	return(true);
+}
+
+// Kept at most half full, so probes stay short.
+static bool VOIStatsHistAdd(VOIStatsHist *Hist, uint32_t Key, uint64_t Count)
+{
+	uint32_t Slot;
+
+	if(!Count) return(true);
+
+	if((((Hist->BinCount + 1) << 1) > Hist->Capacity) && !VOIStatsHistGrow(Hist))
+	{
+		printf("Out of memory.\n");
+		return(false);
+	}
+
+	for(Slot = VOIStatsHash(Key) & (Hist->Capacity - 1); Hist->Bins[Slot].Count && (Hist->Bins[Slot].Key != Key); Slot = (Slot + 1) & (Hist->Capacity - 1));
+
+	if(!Hist->Bins[Slot].Count)
+	{
+		Hist->Bins[Slot].Key = Key;
+		Hist->BinCount++;
+	}
+
+	Hist->Bins[Slot].Count += Count;
+	return(true);
+}
+
+static bool VOIStatsVisit(VoltageObject *VO, uint8_t *VOData, uint32_t VODataLen, uint16_t Index, void *Ctx)
+{
+	VOIStats *Stats = (VOIStats *)Ctx;
+
+	(void)VOData;
+	(void)Index;
+
+	Stats->VOCount++;
+	if(!ValidateVO(VO)) Stats->MalformedVOCount++;
+
+	if(!VOIStatsHistAdd(Stats->Hists + VOISTATS_HIST_VOSIZE, VO->VOSize, 1)) return(false);
+	if(!VOIStatsHistAdd(Stats->Hists + VOISTATS_HIST_DATALEN, VODataLen, 1)) return(false);
+	if(!VOIStatsHistAdd(Stats->Hists + VOISTATS_HIST_TYPEMODE, (VO->VOType << 8) | VO->VOMode, 1)) return(false);
+
+	if(VO->VOMode == VOLTAGE_MODE_INIT_REGULATOR)
+	{
+		if(!VOIStatsHistAdd(Stats->Hists + VOISTATS_HIST_REGID, VO->AsType3.RegulatorID, 1)) return(false);
+		if(!VOIStatsHistAdd(Stats->Hists + VOISTATS_HIST_I2C, (VO->AsType3.I2CLine << 8) | VO->AsType3.I2CAddress, 1)) return(false);
+	}
+	else if(VO->VOMode == VOLTAGE_MODE_SVID2)
+	{
+		if(!VOIStatsHistAdd(Stats->Hists + VOISTATS_HIST_LLSLOPETRIM, VO->AsType7.LoadLinePSI.Info.LoadLineSlopeTrim, 1)) return(false);
+	}
+
+	return(true);
+}
+
+// Adds every VO of a ROM's VOI table that the filter selects. The
+// table is checked before anything is counted, so a malformed one
+// adds nothing but to the count of bad ROMs. Returns false only if
+// out of memory.
+bool VOIStatsAddROM(VOIStats *Stats, const char *ROMName, uint8_t *VOITableBase, const VOFilter *Filter)
+{
+	ATOM_COMMON_TABLE_HEADER *Hdr = (ATOM_COMMON_TABLE_HEADER *)VOITableBase;
+
+	if(WalkVOTable(VOITableBase, 0xFF, NULL, NULL, NULL) < 0)
+	{
+		printf("VOI table in %s is malformed, skipping it.\n", ROMName);
+		Stats->BadROMCount++;
+		return(true);
+	}
+
+	Stats->ROMCount++;
+
+	if(!VOIStatsHistAdd(Stats->Hists + VOISTATS_HIST_VOIREV, (Hdr->ucTableFormatRevision << 8) | Hdr->ucTableContentRevision, 1)) return(false);
+
+	return(WalkVOTable(VOITableBase, 0xFF, Filter, VOIStatsVisit, Stats) >= 0);
+}
+
+bool VOIStatsMerge(VOIStats *Dst, const VOIStats *Src)
+{
+	Dst->ROMCount += Src->ROMCount;
+	Dst->BadROMCount += Src->BadROMCount;
+	Dst->VOCount += Src->VOCount;
+	Dst->MalformedVOCount += Src->MalformedVOCount;
+
+	for(int h = 0; h < VOISTATS_HIST_COUNT; ++h)
+	{
+		const VOIStatsHist *Hist = Src->Hists + h;
+
+		for(uint32_t i = 0; i < Hist->Capacity; ++i)
+		{
+			if(!VOIStatsHistAdd(Dst->Hists + h, Hist->Bins[i].Key, Hist->Bins[i].Count)) return(false);
+		}
+	}
+
+	return(true);
+}
+
+bool VOIStatsSave(const VOIStats *Stats, const char *FileName)
+{
+	FILE *StatsFile = fopen(FileName, "w");
+	bool Ok;
+
+	if(!StatsFile)
+	{
+		printf("Unable to open %s for writing.\n", FileName);
+		return(false);
+	}
+
+	fprintf(StatsFile, "%s %d\n", VOISTATS_MAGIC, VOISTATS_VERSION);
+	fprintf(StatsFile, "roms %llu\nbadroms %llu\n", (unsigned long long)Stats->ROMCount, (unsigned long long)Stats->BadROMCount);
+	fprintf(StatsFile, "vos %llu\nmalformedvos %llu\n", (unsigned long long)Stats->VOCount, (unsigned long long)Stats->MalformedVOCount);
+
+	for(int h = 0; h < VOISTATS_HIST_COUNT; ++h)
+	{
+		const VOIStatsHist *Hist = Stats->Hists + h;
+
+		for(uint32_t i = 0; i < Hist->Capacity; ++i)
+		{
+			if(Hist->Bins[i].Count) fprintf(StatsFile, "%s 0x%X %llu\n", VOIStatsHists[h].Name, Hist->Bins[i].Key, (unsigned long long)Hist->Bins[i].Count);
+		}
+	}
+
+	Ok = !ferror(StatsFile);
+
+	if(fclose(StatsFile) || !Ok)
+	{
+		printf("Writing %s failed.\n", FileName);
+		return(false);
+	}
+
+	return(true);
+}
+
+// Merges saved statistics into Stats.
+bool VOIStatsLoad(VOIStats *Stats, const char *FileName)
+{
+	FILE *StatsFile = fopen(FileName, "r");
+	char Line[256], Name[32];
+	unsigned long long Key, Count;
+	int Version, LineNum = 1;
+	bool Ok = true;
+
+	if(!StatsFile)
+	{
+		printf("Unable to open %s (does it exist?)\n", FileName);
+		return(false);
+	}
+
+	if(!fgets(Line, sizeof(Line), StatsFile) || (sscanf(Line, VOISTATS_MAGIC " %d", &Version) != 1) || (Version != VOISTATS_VERSION))
+	{
+		printf("%s does not hold statistics this version can read.\n", FileName);
+		fclose(StatsFile);
+		return(false);
+	}
+
+	while(Ok && fgets(Line, sizeof(Line), StatsFile))
+	{
+		int h;
+
+		LineNum++;
+		Name[0] = 0x00;
+
+		if(sscanf(Line, "%31s %llu", Name, &Count) == 2)
+		{
+			if(!strcmp(Name, "roms")) { Stats->ROMCount += Count; continue; }
+			if(!strcmp(Name, "badroms")) { Stats->BadROMCount += Count; continue; }
+			if(!strcmp(Name, "vos")) { Stats->VOCount += Count; continue; }
+			if(!strcmp(Name, "malformedvos")) { Stats->MalformedVOCount += Count; continue; }
+		}
+
+		for(h = 0; (h < VOISTATS_HIST_COUNT) && strcmp(Name, VOIStatsHists[h].Name); ++h);
+
+		if((h == VOISTATS_HIST_COUNT) || (sscanf(Line, "%31s %lli %llu", Name, (long long *)&Key, &Count) != 3) || (Key > UINT32_MAX))
+		{
+			printf("Line %d of %s is malformed.\n", LineNum, FileName);
+			Ok = false;
+		}
+		else Ok = VOIStatsHistAdd(Stats->Hists + h, (uint32_t)Key, Count);
+	}
+
+	fclose(StatsFile);
+	return(Ok);
+}
+
+static int VOIStatsCompareBins(const void *A, const void *B)
+{
+	uint32_t KeyA = ((const VOIStatsBin *)A)->Key, KeyB = ((const VOIStatsBin *)B)->Key;
+
+	return((KeyA > KeyB) - (KeyA < KeyB));
+}
+
+static void VOIStatsKeyName(char *Buf, size_t BufLen, int h, uint32_t Key)
+{
+	switch(h)
+	{
+		case VOISTATS_HIST_TYPEMODE: snprintf(Buf, BufLen, "%s/%s", VoltageTypeName(Key >> 8), VoltageModeName(Key & 0xFF)); break;
+		case VOISTATS_HIST_I2C: snprintf(Buf, BufLen, "%u/0x%02X", Key >> 8, Key & 0xFF); break;
+		case VOISTATS_HIST_VOIREV: snprintf(Buf, BufLen, "%u.%u", Key >> 8, Key & 0xFF); break;
+		default: snprintf(Buf, BufLen, "%u", Key); break;
+	}
+}
+
+// Histograms are printed in key order, whatever order their bins
+// happen to be in.
+void VOIStatsPrint(const VOIStats *Stats, bool JSON)
+{
+	if(JSON) printf("{\"roms\":%llu,\"bad_roms\":%llu,\"vos\":%llu,\"malformed_vos\":%llu", (unsigned long long)Stats->ROMCount, (unsigned long long)Stats->BadROMCount, (unsigned long long)Stats->VOCount, (unsigned long long)Stats->MalformedVOCount);
+	else printf("Statistics over %llu ROMs (%llu skipped) and %llu VOs (%llu malformed).\n", (unsigned long long)Stats->ROMCount, (unsigned long long)Stats->BadROMCount, (unsigned long long)Stats->VOCount, (unsigned long long)Stats->MalformedVOCount);
+
+	for(int h = 0; h < VOISTATS_HIST_COUNT; ++h)
+	{
+		const VOIStatsHist *Hist = Stats->Hists + h;
+		VOIStatsBin *Sorted = (VOIStatsBin *)malloc(sizeof(VOIStatsBin) * (Hist->BinCount + 1));
+		uint64_t Total = 0;
+		uint32_t BinCount = 0;
+		char KeyName[64];
+
+		if(!Sorted)
+		{
+			printf("Out of memory.\n");
+			return;
+		}
+
+		for(uint32_t i = 0; i < Hist->Capacity; ++i)
+		{
+			if(!Hist->Bins[i].Count) continue;
+
+			Sorted[BinCount++] = Hist->Bins[i];
+			Total += Hist->Bins[i].Count;
+		}
+
+		qsort(Sorted, BinCount, sizeof(VOIStatsBin), VOIStatsCompareBins);
+
+		if(JSON) printf(",\"%s\":{", VOIStatsHists[h].Name);
+		else printf("\n%s:\n", VOIStatsHists[h].Title);
+
+		for(uint32_t i = 0; i < BinCount; ++i)
+		{
+			VOIStatsKeyName(KeyName, sizeof(KeyName), h, Sorted[i].Key);
+
+			if(JSON) printf("%s\"%s\":%llu", (i) ? "," : "", KeyName, (unsigned long long)Sorted[i].Count);
+			else printf("\t%-24s%10llu  %5.1f%%\n", KeyName, (unsigned long long)Sorted[i].Count, (Sorted[i].Count * 100.0) / Total);
+		}
+
+		if(JSON) putchar('}');
+		else if(!BinCount) printf("\t(none)\n");
+
+		free(Sorted);
+	}
+
+	if(JSON) printf("}\n");
+}
+
+void VOIStatsFree(VOIStats *Stats)
+{
+	for(int h = 0; h < VOISTATS_HIST_COUNT; ++h) free(Stats->Hists[h].Bins);
+
+	memset(Stats, 0x00, sizeof(VOIStats));
+}
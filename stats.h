@@ -0,0 +1,81 @@
+// Copyright 2022 Wolf9466/Wolf0/OhGodAPet
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "voi.h"
+
+// Fleet statistics over the VOs of many ROMs: how many ROMs and
+// VOs were seen, and a histogram for each of
+//
+//	vosize			VOSize
+//	datalen			payload length
+//	typemode		VO type and mode, together
+//	regid			RegulatorID (INIT_REGULATOR)
+//	i2c				I2C line and address, together (INIT_REGULATOR)
+//	llslopetrim		LoadLineSlopeTrim (SVID2)
+//	voirev			VOI table format and content revision
+//
+// filled straight from the table walk. A histogram is a small open
+// addressed hash table of key to count, so any two sets of
+// statistics - from two threads, or two runs - merge by adding
+// counts, and the result does not depend on the order they were
+// gathered in.
+//
+// Saved statistics are text, one value per line, so they can be
+// merged by the tool, or by anything else:
+//
+//	wolfvoitool-stats 1
+//	roms 200
+//	badroms 0
+//	vos 1400
+//	malformedvos 0
+//	vosize 0x36 400
+//	typemode 0x0503 200
+//	...
+
+#define VOISTATS_MAGIC					"wolfvoitool-stats"
+#define VOISTATS_VERSION				1
+
+#define VOISTATS_HIST_VOSIZE			0
+#define VOISTATS_HIST_DATALEN			1
+#define VOISTATS_HIST_TYPEMODE			2
+#define VOISTATS_HIST_REGID				3
+#define VOISTATS_HIST_I2C				4
+#define VOISTATS_HIST_LLSLOPETRIM		5
+#define VOISTATS_HIST_VOIREV			6
+#define VOISTATS_HIST_COUNT				7
+
+typedef struct
+{
+	uint32_t Key;
+	uint64_t Count;
+} VOIStatsBin;
+
+// Unused bins have a count of zero; Capacity is a power of two.
+typedef struct
+{
+	uint32_t BinCount;
+	uint32_t Capacity;
+	VOIStatsBin *Bins;
+} VOIStatsHist;
+
+typedef struct
+{
+	uint64_t ROMCount;
+	uint64_t BadROMCount;
+	uint64_t VOCount;
+	uint64_t MalformedVOCount;
+	VOIStatsHist Hists[VOISTATS_HIST_COUNT];
+} VOIStats;
+
+void VOIStatsInit(VOIStats *Stats);
+bool VOIStatsAddROM(VOIStats *Stats, const char *ROMName, uint8_t *VOITableBase, const VOFilter *Filter);
+bool VOIStatsMerge(VOIStats *Dst, const VOIStats *Src);
+bool VOIStatsSave(const VOIStats *Stats, const char *FileName);
+bool VOIStatsLoad(VOIStats *Stats, const char *FileName);
+void VOIStatsPrint(const VOIStats *Stats, bool JSON);
+void VOIStatsFree(VOIStats *Stats);
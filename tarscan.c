@@ -0,0 +1,482 @@
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dlfcn.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <lzma.h>
+
+#include "vbios-tables.h"
+#include "tarscan.h"
+
+#define ROMTAR_IN_BUF_SIZE					(1 << 20)
+
+// libzstd is loaded when an archive first needs it, so it need not
+// be installed to build or to run without it. These match its
+// streaming API.
+typedef struct
+{
+	const void *Src;
+	size_t Size;
+	size_t Pos;
+} ZstdInBuf;
+
+typedef struct
+{
+	void *Dst;
+	size_t Size;
+	size_t Pos;
+} ZstdOutBuf;
+
+static struct
+{
+	bool Tried;
+	void *Lib;
+	void *(*CreateDStream)(void);
+	size_t (*FreeDStream)(void *);
+	size_t (*DecompressStream)(void *, ZstdOutBuf *, ZstdInBuf *);
+	unsigned (*IsError)(size_t);
+	const char *(*GetErrorName)(size_t);
+} Zstd;
+
+typedef struct
+{
+	const char *Name;
+	int Fd;
+	uint8_t Format;
+	uint8_t *InBuf;
+	size_t InLen;
+	size_t InPos;
+	bool InEOF;
+	bool OutEOF;
+	lzma_stream Lzma;
+	void *ZstdStream;
+} ROMTarSource;
+
+bool IsROMTarName(const char *FileName)
+{
+	static const char *Suffixes[] = { ".tar", ".tar.xz", ".txz", ".tar.zst", ".tzst" };
+	size_t Len = strlen(FileName);
+
+	for(size_t i = 0; i < (sizeof(Suffixes) / sizeof(Suffixes[0])); ++i)
+	{
+		size_t SuffixLen = strlen(Suffixes[i]);
+
+		if((Len > SuffixLen) && !strcmp(FileName + Len - SuffixLen, Suffixes[i])) return(true);
+	}
+
+	return(false);
+}
+
+static bool ZstdLoad(void)
+{
+	if(Zstd.Tried) return(!!Zstd.Lib);
+
+	Zstd.Tried = true;
+
+	if(!(Zstd.Lib = dlopen("libzstd.so.1", RTLD_NOW))) return(false);
+
+	*(void **)&Zstd.CreateDStream = dlsym(Zstd.Lib, "ZSTD_createDStream");
+	*(void **)&Zstd.FreeDStream = dlsym(Zstd.Lib, "ZSTD_freeDStream");
+	*(void **)&Zstd.DecompressStream = dlsym(Zstd.Lib, "ZSTD_decompressStream");
+	*(void **)&Zstd.IsError = dlsym(Zstd.Lib, "ZSTD_isError");
+	*(void **)&Zstd.GetErrorName = dlsym(Zstd.Lib, "ZSTD_getErrorName");
+
+	if(!Zstd.CreateDStream || !Zstd.FreeDStream || !Zstd.DecompressStream || !Zstd.IsError || !Zstd.GetErrorName)
+	{
+		dlclose(Zstd.Lib);
+		Zstd.Lib = NULL;
+	}
+
+	return(!!Zstd.Lib);
+}
+
+// Reads more of the archive, once everything read so far has been
+// decompressed.
+static bool ROMTarFill(ROMTarSource *Src)
+{
+	ssize_t Len;
+
+	if((Src->InPos < Src->InLen) || Src->InEOF) return(true);
+
+	do Len = read(Src->Fd, Src->InBuf, ROMTAR_IN_BUF_SIZE); while((Len < 0) && (errno == EINTR));
+
+	if(Len < 0)
+	{
+		printf("Reading %s failed (%s).\n", Src->Name, strerror(errno));
+		return(false);
+	}
+
+	Src->InLen = Len;
+	Src->InPos = 0;
+	Src->InEOF = !Len;
+
+	return(true);
+}
+
+static void ROMTarClose(ROMTarSource *Src)
+{
+	if(Src->Format == ROMTAR_FORMAT_XZ) lzma_end(&Src->Lzma);
+	if(Src->ZstdStream) Zstd.FreeDStream(Src->ZstdStream);
+	if(Src->Fd >= 0) close(Src->Fd);
+
+	free(Src->InBuf);
+}
+
+// Opens the archive and picks a decompressor by its first bytes.
+static bool ROMTarOpen(ROMTarSource *Src, const char *TarName, uint32_t Threads)
+{
+	memset(Src, 0x00, sizeof(ROMTarSource));
+	Src->Name = TarName;
+
+	if((Src->Fd = open(TarName, O_RDONLY)) < 0)
+	{
+		printf("Unable to open %s (does it exist?)\n", TarName);
+		return(false);
+	}
+
+	posix_fadvise(Src->Fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+	if(!(Src->InBuf = (uint8_t *)malloc(ROMTAR_IN_BUF_SIZE)))
+	{
+		printf("Out of memory.\n");
+		goto fail;
+	}
+
+	if(!ROMTarFill(Src)) goto fail;
+
+	if((Src->InLen >= 6) && !memcmp(Src->InBuf, "\xFD" "7zXZ", 6))
+	{
+		lzma_mt Mt = { 0 };
+		lzma_ret Ret;
+
+		Mt.flags = LZMA_CONCATENATED;
+		Mt.threads = (Threads) ? Threads : 1;
+		Mt.memlimit_threading = lzma_physmem() >> 2;
+		Mt.memlimit_stop = UINT64_MAX;
+
+		Src->Format = ROMTAR_FORMAT_XZ;
+
+		if((Ret = lzma_stream_decoder_mt(&Src->Lzma, &Mt)) != LZMA_OK)
+		{
+			printf("Unable to start decompressing %s (liblzma error %d).\n", TarName, Ret);
+			goto fail;
+		}
+	}
+	else if((Src->InLen >= 4) && !memcmp(Src->InBuf, "\x28\xB5\x2F\xFD", 4))
+	{
+		Src->Format = ROMTAR_FORMAT_ZSTD;
+
+		if(!ZstdLoad())
+		{
+			printf("%s is compressed with zstd, but libzstd could not be loaded.\n", TarName);
+			goto fail;
+		}
+
+		if(!(Src->ZstdStream = Zstd.CreateDStream()))
+		{
+			printf("Out of memory.\n");
+			goto fail;
+		}
+	}
+	else Src->Format = ROMTAR_FORMAT_TAR;
+
+	return(true);
+
+fail:
+	ROMTarClose(Src);
+	return(false);
+}
+
+// Reads Len bytes of the tar stream into Out. Returns how many were
+// read, which is less than Len only at its end, or -1 on error.
+static ssize_t ROMTarRead(ROMTarSource *Src, uint8_t *Out, size_t Len)
+{
+	size_t Got = 0;
+
+	while((Got < Len) && !Src->OutEOF)
+	{
+		if(!ROMTarFill(Src)) return(-1);
+
+		if(Src->Format == ROMTAR_FORMAT_TAR)
+		{
+			size_t Copy = Src->InLen - Src->InPos;
+
+			if(Src->InEOF)
+			{
+				Src->OutEOF = true;
+				break;
+			}
+
+			if(Copy > (Len - Got)) Copy = Len - Got;
+
+			memcpy(Out + Got, Src->InBuf + Src->InPos, Copy);
+			Src->InPos += Copy;
+			Got += Copy;
+		}
+		else if(Src->Format == ROMTAR_FORMAT_XZ)
+		{
+			lzma_ret Ret;
+
+			Src->Lzma.next_in = Src->InBuf + Src->InPos;
+			Src->Lzma.avail_in = Src->InLen - Src->InPos;
+			Src->Lzma.next_out = Out + Got;
+			Src->Lzma.avail_out = Len - Got;
+
+			Ret = lzma_code(&Src->Lzma, (Src->InEOF) ? LZMA_FINISH : LZMA_RUN);
+
+			Src->InPos = Src->InLen - Src->Lzma.avail_in;
+			Got = Len - Src->Lzma.avail_out;
+
+			if(Ret == LZMA_STREAM_END) Src->OutEOF = true;
+			else if(Ret != LZMA_OK)
+			{
+				if(Ret == LZMA_BUF_ERROR) printf("%s is truncated.\n", Src->Name);
+				else printf("Decompressing %s failed (liblzma error %d).\n", Src->Name, Ret);
+
+				return(-1);
+			}
+		}
+		else
+		{
+			ZstdInBuf In = { Src->InBuf, Src->InLen, Src->InPos };
+			ZstdOutBuf Dec = { Out, Len, Got };
+			size_t Ret = Zstd.DecompressStream(Src->ZstdStream, &Dec, &In);
+
+			if(Zstd.IsError(Ret))
+			{
+				printf("Decompressing %s failed (%s).\n", Src->Name, Zstd.GetErrorName(Ret));
+				return(-1);
+			}
+
+			// Once the input is gone, the stream is over when
+			// nothing more comes out of the decoder.
+			if(Src->InEOF && (Dec.Pos == Got)) Src->OutEOF = true;
+
+			Src->InPos = In.Pos;
+			Got = Dec.Pos;
+		}
+	}
+
+	return(Got);
+}
+
+// Reads exactly Len bytes of the tar stream into Out.
+static bool ROMTarReadAll(ROMTarSource *Src, uint8_t *Out, size_t Len)
+{
+	ssize_t Got = ROMTarRead(Src, Out, Len);
+
+	if(Got < 0) return(false);
+
+	if((size_t)Got != Len)
+	{
+		printf("%s is truncated.\n", Src->Name);
+		return(false);
+	}
+
+	return(true);
+}
+
+// Reads and throws away Len bytes of the tar stream, using Scratch.
+static bool ROMTarSkip(ROMTarSource *Src, uint8_t *Scratch, size_t ScratchLen, uint64_t Len)
+{
+	while(Len)
+	{
+		size_t Chunk = (Len < ScratchLen) ? Len : ScratchLen;
+
+		if(!ROMTarReadAll(Src, Scratch, Chunk)) return(false);
+
+		Len -= Chunk;
+	}
+
+	return(true);
+}
+
+// Numeric header fields are octal text, or, in GNU archives, big
+// endian binary flagged by the top bit of their first byte.
+static uint64_t ROMTarParseNumber(const uint8_t *Field, size_t Len)
+{
+	uint64_t Value = 0;
+	size_t i = 0;
+
+	if(Field[0] & 0x80)
+	{
+		Value = Field[0] & 0x7F;
+
+		for(i = 1; i < Len; ++i) Value = (Value << 8) | Field[i];
+
+		return(Value);
+	}
+
+	while((i < Len) && ((Field[i] == ' ') || !Field[i])) i++;
+
+	for(; (i < Len) && (Field[i] >= '0') && (Field[i] <= '7'); ++i) Value = (Value << 3) | (Field[i] - '0');
+
+	return(Value);
+}
+
+// The checksum is the sum of the header's bytes, with its own eight
+// counted as spaces. Some old writers summed them as signed bytes.
+static bool ROMTarCheckHeader(const uint8_t *Hdr)
+{
+	uint64_t Stored = ROMTarParseNumber(Hdr + 148, 8);
+	uint32_t Sum = 0;
+	int32_t SignedSum = 0;
+
+	for(int i = 0; i < ROMTAR_BLOCK_SIZE; ++i)
+	{
+		uint8_t Byte = ((i >= 148) && (i < 156)) ? ' ' : Hdr[i];
+
+		Sum += Byte;
+		SignedSum += (int8_t)Byte;
+	}
+
+	return((Stored == Sum) || (Stored == (uint32_t)SignedSum));
+}
+
+static bool ROMTarIsZeroBlock(const uint8_t *Hdr)
+{
+	for(int i = 0; i < ROMTAR_BLOCK_SIZE; ++i)
+		if(Hdr[i]) return(false);
+
+	return(true);
+}
+
+// Finds the path in a pax extended header, whose records are each
+// "<length> <key>=<value>\n".
+static void ROMTarParsePax(const char *Data, size_t Len, char *Name)
+{
+	size_t Pos = 0;
+
+	while(Pos < Len)
+	{
+		const char *Rec = Data + Pos, *Key, *Eq;
+		size_t RecLen = 0, i = 0;
+
+		while(((Pos + i) < Len) && (RecLen <= Len) && (Rec[i] >= '0') && (Rec[i] <= '9')) RecLen = (RecLen * 10) + (Rec[i++] - '0');
+
+		// The length must take in the space, a key, its '=' and the newline.
+		if((RecLen <= (i + 1)) || (RecLen > (Len - Pos)) || (Rec[i] != ' ') || (Rec[RecLen - 1] != '\n')) return;
+
+		Key = Rec + i + 1;
+		Eq = (const char *)memchr(Key, '=', RecLen - i - 2);
+
+		if(!Eq || (Eq == Key)) return;
+
+		if(((Eq - Key) == 4) && !memcmp(Key, "path", 4))
+		{
+			size_t NameLen = (Rec + RecLen - 1) - (Eq + 1);
+
+			if(NameLen >= ROMTAR_MAX_NAME) NameLen = ROMTAR_MAX_NAME - 1;
+
+			memcpy(Name, Eq + 1, NameLen);
+			Name[NameLen] = 0x00;
+		}
+
+		Pos += RecLen;
+	}
+}
+
+// Scans the archive front to back, handing each ROM in it to Visit.
+// Threads is how many threads may decompress it, where its format
+// allows that.
+bool ROMTarScan(const char *TarName, uint32_t Threads, ROMTarVisitFn Visit, void *Ctx)
+{
+	ROMTarSource Src;
+	uint8_t Hdr[ROMTAR_BLOCK_SIZE], *Image;
+	char *LongName, *ROMName;
+	uint32_t ROMCount = 0, SkipCount = 0;
+	bool Ok = false;
+
+	if(!ROMTarOpen(&Src, TarName, Threads)) return(false);
+
+	Image = (uint8_t *)malloc(AMD_VBIOS_MAX_SIZE);
+	LongName = (char *)malloc(ROMTAR_MAX_NAME);
+	ROMName = (char *)malloc(strlen(TarName) + ROMTAR_MAX_NAME + 2);
+
+	if(!Image || !LongName || !ROMName)
+	{
+		printf("Out of memory.\n");
+		goto out;
+	}
+
+	LongName[0] = 0x00;
+
+	while(1)
+	{
+		ssize_t Len = ROMTarRead(&Src, Hdr, sizeof(Hdr));
+		uint64_t Size;
+		uint8_t Type;
+
+		if(Len < 0) goto out;
+
+		// Not every writer bothers with the two zero blocks at the end.
+		if(!Len || ROMTarIsZeroBlock(Hdr)) break;
+
+		if((Len != sizeof(Hdr)) || !ROMTarCheckHeader(Hdr))
+		{
+			printf("%s is not a tar archive, or is corrupt.\n", TarName);
+			goto out;
+		}
+
+		Size = ROMTarParseNumber(Hdr + 124, 12);
+		Type = Hdr[156];
+
+		// GNU long names and pax headers name the entry after them.
+		if(((Type == 'L') || (Type == 'x')) && (Size < ROMTAR_MAX_NAME))
+		{
+			if(!ROMTarReadAll(&Src, Image, Size)) goto out;
+
+			if(Type == 'L')
+			{
+				memcpy(LongName, Image, Size);
+				LongName[Size] = 0x00;
+			}
+			else ROMTarParsePax((const char *)Image, Size, LongName);
+		}
+		else if((!Type || (Type == '0') || (Type == '7')) && (Size <= AMD_VBIOS_MAX_SIZE))
+		{
+			if(!ROMTarReadAll(&Src, Image, Size)) goto out;
+
+			if((Size < 2) || (*((uint16_t *)Image) != PCI_EXPANSION_ROM_SIGNATURE)) SkipCount++;
+			else
+			{
+				// ustar splits long paths between the name and a prefix.
+				if(LongName[0]) sprintf(ROMName, "%s:%s", TarName, LongName);
+				else if(!memcmp(Hdr + 257, "ustar", 5) && Hdr[345]) sprintf(ROMName, "%s:%.155s/%.100s", TarName, (const char *)Hdr + 345, (const char *)Hdr);
+				else sprintf(ROMName, "%s:%.100s", TarName, (const char *)Hdr);
+
+				ROMCount++;
+
+				if(!Visit(Ctx, ROMName, Image, Size)) goto out;
+			}
+
+			LongName[0] = 0x00;
+		}
+		else
+		{
+			if((Type != 'g') && (Type != '5')) SkipCount++;
+			if(Type != 'g') LongName[0] = 0x00;
+
+			if(!ROMTarSkip(&Src, Image, AMD_VBIOS_MAX_SIZE, Size)) goto out;
+		}
+
+		// Entries are padded out to whole blocks.
+		if(!ROMTarSkip(&Src, Image, AMD_VBIOS_MAX_SIZE, (ROMTAR_BLOCK_SIZE - (Size % ROMTAR_BLOCK_SIZE)) % ROMTAR_BLOCK_SIZE)) goto out;
+	}
+
+	fprintf(stderr, "Read %u ROMs from %s, skipping %u other files.\n", ROMCount, TarName, SkipCount);
+	Ok = true;
+
+out:
+	ROMTarClose(&Src);
+
+	free(Image);
+	free(LongName);
+	free(ROMName);
+
+	return(Ok);
+}
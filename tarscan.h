@@ -0,0 +1,39 @@
+// Copyright 2022 Wolf9466/Wolf0/OhGodAPet
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Reading ROMs straight out of tar archives, without extracting them.
+// An archive given in place of a ROM (recognized by its name, see
+// IsROMTarName()) is read once, front to back, through an in-process
+// decompressor chosen by its first bytes:
+//
+//	xz		liblzma's multithreaded decoder, which decodes the
+//			blocks of an archive written with more than one (as
+//			xz -T does) in parallel
+//	zstd	libzstd, loaded when first needed, if it is installed
+//	none	plain tar
+//
+// Each regular file in it that is small enough to be a ROM and starts
+// with the expansion ROM signature is handed over, named
+// <archive>:<path>, as it is reached; everything else is skipped.
+// ustar, GNU long names and pax paths are understood. Nothing in an
+// archive can be written back, so modes that change ROMs cannot use
+// them.
+
+#define ROMTAR_BLOCK_SIZE					512
+#define ROMTAR_MAX_NAME						4096
+
+#define ROMTAR_FORMAT_TAR					0x00
+#define ROMTAR_FORMAT_XZ					0x01
+#define ROMTAR_FORMAT_ZSTD					0x02
+
+// Called with each ROM; returning false stops the scan, which then
+// fails.
+typedef bool (*ROMTarVisitFn)(void *Ctx, const char *ROMName, uint8_t *Image, size_t Size);
+
+bool IsROMTarName(const char *FileName);
+bool ROMTarScan(const char *TarName, uint32_t Threads, ROMTarVisitFn Visit, void *Ctx);
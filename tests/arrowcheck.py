@@ -0,0 +1,145 @@
+#!/usr/bin/env python3
+
+# Exports the VOs of synthetic ROMs with wolfvoitool as Arrow IPC, and
+# reads the file back with pyarrow, checking the schema and that every
+# row holds what the ROM does. Uses whatever pyarrow the system has,
+# and is skipped if there is none.
+#
+# Usage: arrowcheck.py <wolfvoitool> <mkrom>
+
+import os
+import shutil
+import struct
+import subprocess
+import sys
+import tempfile
+
+try:
+	import pyarrow as pa
+	import pyarrow.ipc
+except ImportError:
+	print("pyarrow is not installed, skipping.")
+	sys.exit(0)
+
+# Where tests/testrom.h puts the VOI table, and the size of a VO with
+# its mode header.
+TESTROM_VOI_OFFSET = 0x800
+VO_HDR_LEN = 12
+VOLTAGE_MODE_INIT_REGULATOR = 0x03
+
+FIXED_COLUMNS = [
+	("rom", pa.string()),
+	("rom_index", pa.uint32()),
+	("vo_index", pa.uint16()),
+	("vo_type", pa.uint8()),
+	("vo_mode", pa.uint8()),
+	("vo_size", pa.uint16()),
+]
+
+# The INIT_REGULATOR mode header columns, and their offsets in a VO.
+INIT_REGULATOR_COLUMNS = [
+	("regulator_id", 4),
+	("i2c_line", 5),
+	("i2c_address", 6),
+	("control_offset", 7),
+	("control_flag", 8),
+]
+
+Failures = 0
+
+def Check(Cond, What):
+	global Failures
+
+	if not Cond:
+		print("check failed: " + What)
+		Failures += 1
+
+# The rows wolfvoitool should export for the ROM, read straight out of
+# its VOI table.
+def ExpectedRows(ROMName, ROMIndex):
+	with open(ROMName, "rb") as ROMFile:
+		Image = ROMFile.read()
+
+	TableLen = struct.unpack_from("<H", Image, TESTROM_VOI_OFFSET)[0]
+	Offset, End, Rows = TESTROM_VOI_OFFSET + 4, TESTROM_VOI_OFFSET + TableLen, []
+
+	while Offset < End:
+		VOType, VOMode, VOSize = struct.unpack_from("<BBH", Image, Offset)
+		VO = Image[Offset:Offset + VOSize]
+		Row = {
+			"rom": ROMName,
+			"rom_index": ROMIndex,
+			"vo_index": len(Rows),
+			"vo_type": VOType,
+			"vo_mode": VOMode,
+			"vo_size": VOSize,
+			"payload": VO[VO_HDR_LEN:] if VOSize > VO_HDR_LEN else b"",
+		}
+
+		for Name, HdrOffset in INIT_REGULATOR_COLUMNS:
+			Row[Name] = VO[HdrOffset] if VOMode == VOLTAGE_MODE_INIT_REGULATOR else 0
+
+		Rows.append(Row)
+		Offset += VOSize
+
+	return Rows
+
+def main():
+	if len(sys.argv) != 3:
+		print("Usage: %s <wolfvoitool> <mkrom>" % sys.argv[0])
+		return 1
+
+	Tool, MkROM = os.path.abspath(sys.argv[1]), os.path.abspath(sys.argv[2])
+	TempDir = tempfile.mkdtemp(prefix="arrowcheck")
+
+	try:
+		ROMs = [os.path.join(TempDir, "a.rom"), os.path.join(TempDir, "b.rom")]
+		ArrowName = os.path.join(TempDir, "vos.arrow")
+
+		subprocess.run([MkROM, ROMs[0]], check=True, stdout=subprocess.DEVNULL)
+		shutil.copyfile(ROMs[0], ROMs[1])
+
+		Args = [Tool]
+		for ROMName in ROMs: Args += ["-f", ROMName]
+		subprocess.run(Args + ["-x", ArrowName, "--export-format", "arrow"], check=True, stdout=subprocess.DEVNULL)
+
+		with pa.memory_map(ArrowName) as Source:
+			Reader = pa.ipc.open_file(Source)
+			Table = Reader.read_all()
+
+		Expected = ExpectedRows(ROMs[0], 0) + ExpectedRows(ROMs[1], 1)
+
+		# The fixed columns come first and the payload last, with the
+		# mode header columns in between, all as non-nullable.
+		Names = Table.schema.names
+		Check(Names[:len(FIXED_COLUMNS)] == [Name for Name, Type in FIXED_COLUMNS], "fixed column names")
+		Check(Names[-1] == "payload", "payload is the last column")
+
+		for Name, Type in FIXED_COLUMNS:
+			Check(Table.schema.field(Name).type == Type, "type of " + Name)
+
+		Check(Table.schema.field("payload").type == pa.binary(), "type of payload")
+
+		for Name, HdrOffset in INIT_REGULATOR_COLUMNS:
+			Check(Name in Names and Table.schema.field(Name).type == pa.uint8(), "type of " + Name)
+
+		Check(all(not Field.nullable for Field in Table.schema), "no column is nullable")
+
+		# Every row holds what the ROM does, and the mode header columns
+		# of modes the VOs are not in are zero.
+		Rows = Table.to_pylist()
+		Check(len(Rows) == len(Expected), "row count is %d, expected %d" % (len(Rows), len(Expected)))
+
+		for Row, Want in zip(Rows, Expected):
+			for Name in Names:
+				Check(Row[Name] == Want.get(Name, 0), "row %d:%d column %s" % (Want["rom_index"], Want["vo_index"], Name))
+	finally:
+		shutil.rmtree(TempDir)
+
+	if Failures: print("%d checks failed." % Failures)
+	else: print("All checks passed.")
+
+	return 1 if Failures else 0
+
+if __name__ == "__main__":
+	sys.exit(main())
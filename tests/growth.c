@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "../vbios-tables.h"
+#include "../vbios.h"
+#include "../voi.h"
+#include "../reloc.h"
+#include "../plan.h"
+#include "testrom.h"
+
+// Grows a VO in ROMs with no padding at all, so that the legacy image
+// itself must grow, by one block and by several.
+
+static uint8_t LegacySum(const VBIOSInfo *Info)
+{
+	uint8_t Sum = 0;
+
+	for(uint32_t i = 0; i < Info->Chain.Images[0].Length; ++i) Sum += Info->Image[i];
+
+	return(Sum);
+}
+
+static void CheckGrowth(uint32_t WriteCount, uint8_t Strategy)
+{
+	uint8_t *Image = (uint8_t *)malloc(AMD_VBIOS_MAX_SIZE);
+	uint8_t VOs[64];
+	char *Spec = NULL;
+	uint16_t Writes[] = { 0x26, 0x04, 0x8D, 0x10 };
+	uint32_t VOsLen = 0, OldLegacyLen, NewBlocks;
+	size_t Size;
+	VBIOSInfo Info;
+	VBIOSPlan *Plan = (VBIOSPlan *)malloc(sizeof(VBIOSPlan));
+	VoltageObject *VO;
+	VOEdit Edit;
+	bool Located;
+
+	CHECK(Image && Plan);
+	if(!Image || !Plan) goto out;
+
+	VOsLen += TestROMInitRegVO(VOs + VOsLen, VOLTAGE_TYPE_VDDC, 150, 0x10, 0, Writes, 2, NULL, 0);
+	VOsLen += TestROMEVVVO(VOs + VOsLen, VOLTAGE_TYPE_VDDC);
+	Size = TestROMBuild(Image, VOs, VOsLen, 0);
+
+	CHECK(Located = VBIOSLocateVOI(&Info, Image, Size));
+	if(!Located) goto out;
+
+	CHECK(VBIOSGetPaddingLength(&Info) == 0);
+	CHECK(LegacySum(&Info) == 0);
+	OldLegacyLen = Info.Chain.Images[0].Length;
+
+	// VO 0 gets WriteCount writes of register 0x40 + n with value n.
+	Spec = (char *)malloc(2 + (WriteCount << 3) + 5);
+	CHECK(Spec != NULL);
+	if(!Spec) goto out;
+
+	strcpy(Spec, "0:");
+
+	for(uint32_t w = 0; w < WriteCount; ++w) sprintf(Spec + 2 + (w << 3), "%02X00%02X00", 0x40 + (w & 0x3F), w & 0xFF);
+
+	strcat(Spec, "FF00");
+	CHECK(ParseVOEdit(&Edit, Spec));
+
+	CHECK(VBIOSPlanEdits(Plan, &Info, &Edit, 1, Strategy));
+	CHECK(Plan->Fits && (Plan->GrowLen > 0) && !(Plan->GrowLen % PCI_EXPANSION_ROM_BLOCK_SIZE));
+
+	CHECK(VBIOSApplyVOEdits(&Info, &Edit, 1, Strategy));
+
+	// The legacy image grew by whole blocks, taking the UEFI image along.
+	NewBlocks = Info.Chain.Images[0].Length / PCI_EXPANSION_ROM_BLOCK_SIZE;
+	CHECK(Info.Chain.Images[0].Length == Plan->NewLegacyLen);
+	CHECK(Info.Chain.Images[0].Length == (OldLegacyLen + Plan->GrowLen));
+	CHECK(Info.Chain.Images[0].Length >= (OldLegacyLen + (WriteCount << 2) - 4));
+	CHECK(Info.Size == (Size + Plan->GrowLen));
+	CHECK(Info.Size == Plan->NewSize);
+	CHECK(Image[PCI_EXPANSION_ROM_SIZE_OFFSET] == NewBlocks);
+	CHECK(((PCI_DATA_STRUCTURE *)(Image + Info.Chain.Images[0].PCIROffset))->ImageLength == NewBlocks);
+
+	// The checksum was fixed to match.
+	CHECK(LegacySum(&Info) == 0);
+	CHECK(VBIOSComputeChecksum(&Info) == Image[ATOM_ROM_CHECKSUM_OFFSET]);
+
+	// The result reads back as a ROM with the edit made, and nothing
+	// else changed.
+	CHECK(Located = VBIOSLocateVOI(&Info, Image, Info.Size));
+
+	if(Located)
+	{
+		CHECK(TestROMCheckTrailer(&Info));
+		CHECK(WalkVOTable(Image + Info.VOITblOffset, 0xFF, NULL, NULL, NULL) == 2);
+		CHECK((VO = VOEditFindVO(&Info, 0)) != NULL);
+
+		if(VO)
+		{
+			CHECK(VO->VOSize == (sizeof(VoltageObject) + Edit.DataLen));
+			CHECK(!memcmp(((uint8_t *)VO) + sizeof(VoltageObject), Edit.Data, Edit.DataLen));
+		}
+	}
+
+	FreeVOEdit(&Edit);
+
+out:
+	free(Spec);
+	free(Plan);
+	free(Image);
+}
+
+int main(void)
+{
+	CheckGrowth(16, VBIOS_RELOC_SHIFT);
+	CheckGrowth(400, VBIOS_RELOC_SHIFT);
+
+	// With no padding to move the VOI table into, a move is a shift.
+	CheckGrowth(16, VBIOS_RELOC_MOVE);
+
+	return(TestReport());
+}
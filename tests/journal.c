@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "../vbios-tables.h"
+#include "../vbios.h"
+#include "../voi.h"
+#include "../reloc.h"
+#include "../plan.h"
+#include "../journal.h"
+#include "testrom.h"
+
+// Makes edits through the journal as the editor does - a shift, a
+// move of the VOI table, an edit of the moved table and an append
+// that grows the legacy image - then undoes and redoes all of them,
+// checking the image is byte for byte what it was at every step.
+
+#define JOURNAL_TEST_STEPS					5
+
+typedef struct
+{
+	size_t Size;
+	uint8_t *Image;
+} Snapshot;
+
+static void TakeSnapshot(Snapshot *Snap, const VBIOSInfo *Info)
+{
+	Snap->Size = Info->Size;
+
+	if((Snap->Image = (uint8_t *)malloc(Info->Size))) memcpy(Snap->Image, Info->Image, Info->Size);
+}
+
+static bool SameAsSnapshot(const Snapshot *Snap, const VBIOSInfo *Info)
+{
+	return(Snap->Image && (Snap->Size == Info->Size) && !memcmp(Snap->Image, Info->Image, Info->Size));
+}
+
+// Edits (or, with an Index of VOEDIT_APPEND, appends) a VO as Spec
+// says, first moving the VOI table into the padding if Strategy calls
+// for it. Each change is journaled as an edit of its own, and the
+// image after a move is kept in AfterMove.
+static bool JournaledEdit(VBIOSInfo *Info, VBIOSJournal *Journal, const char *Spec, uint8_t Strategy, bool *Moved, Snapshot *AfterMove)
+{
+	VoltageObject NewVO, *OrigVO = NULL;
+	VOListNode NewNode;
+	VBIOSDelta Delta;
+	VOEdit Edit;
+	uint32_t Offset, OldSize = 0;
+	bool Ok = false;
+
+	*Moved = false;
+
+	if(!ParseVOEdit(&Edit, Spec)) return(false);
+
+	if(Edit.Index == VOEDIT_APPEND) VOEditBuildNode(&Edit, NULL, NULL, 0, &NewVO, &NewNode);
+	else
+	{
+		if(!(OrigVO = VOEditFindVO(Info, Edit.Index))) goto out;
+
+		VOEditBuildNode(&Edit, OrigVO, ((uint8_t *)OrigVO) + sizeof(VoltageObject), OrigVO->VOSize - sizeof(VoltageObject), &NewVO, &NewNode);
+		OldSize = OrigVO->VOSize;
+	}
+
+	if(NewVO.VOSize > OldSize)
+	{
+		if(!VBIOSPrepareVOIGrowth(Info, Strategy, Info->VOIHdr->usStructureSize + NewVO.VOSize - OldSize, &Delta, Moved)) goto out;
+		if(*Moved && !JournalRecord(Journal, &Delta)) goto out;
+		if(*Moved && AfterMove) TakeSnapshot(AfterMove, Info);
+	}
+
+	// The VO is found again, as the table may have moved.
+	if(Edit.Index == VOEDIT_APPEND) Offset = Info->VOITblOffset + Info->VOIHdr->usStructureSize;
+	else Offset = ((uint8_t *)VOEditFindVO(Info, Edit.Index)) - Info->Image;
+
+	if(!VBIOSReplaceVO(Info, Offset, OldSize, &NewNode, &Delta)) goto out;
+
+	Ok = JournalRecord(Journal, &Delta);
+
+out:
+	FreeVOEdit(&Edit);
+	return(Ok);
+}
+
+int main(void)
+{
+	uint8_t *Image = (uint8_t *)malloc(AMD_VBIOS_MAX_SIZE), VOs[64];
+	uint16_t Writes[] = { 0x26, 0x04, 0x8D, 0x10 };
+	Snapshot Snaps[JOURNAL_TEST_STEPS];
+	uint32_t VOsLen = 0, OldVOIOffset, OldLegacyLen, Steps = 0;
+	char BigSpec[7 + (200 << 3) + 5];
+	VBIOSJournal Journal;
+	VBIOSInfo Info;
+	bool Moved;
+
+	memset(Snaps, 0x00, sizeof(Snaps));
+	CHECK(Image != NULL);
+	if(!Image) return(TestReport());
+
+	VOsLen += TestROMInitRegVO(VOs + VOsLen, VOLTAGE_TYPE_VDDC, 150, 0x10, 0, Writes, 2, NULL, 0);
+	VOsLen += TestROMEVVVO(VOs + VOsLen, VOLTAGE_TYPE_VDDC);
+	VOsLen += TestROMInitRegVO(VOs + VOsLen, VOLTAGE_TYPE_VDDGFX, 150, 0x10, 0, Writes, 1, NULL, 0);
+
+	CHECK(VBIOSLocateVOI(&Info, Image, TestROMBuild(Image, VOs, VOsLen, 0x200)));
+	JournalInit(&Journal);
+	TakeSnapshot(Snaps + Steps++, &Info);
+
+	OldVOIOffset = Info.VOITblOffset;
+	OldLegacyLen = Info.Chain.Images[0].Length;
+
+	// A shift: VO 0 grows in place, and the tables after it move up.
+	CHECK(JournaledEdit(&Info, &Journal, "0:260400008d100000ff00", VBIOS_RELOC_SHIFT, &Moved, NULL) && !Moved);
+	CHECK(Info.VOITblOffset == OldVOIOffset);
+	TakeSnapshot(Snaps + Steps++, &Info);
+
+	// A move: the VOI table is copied into the padding first, then
+	// VO 2 grows there; the move and the edit are two journal entries.
+	CHECK(JournaledEdit(&Info, &Journal, "2:4100710037002800ff00", VBIOS_RELOC_MOVE, &Moved, Snaps + Steps++) && Moved);
+	CHECK(Info.VOITblOffset != OldVOIOffset);
+	CHECK(Journal.Count == 3);
+	TakeSnapshot(Snaps + Steps++, &Info);
+
+	// An append too big for what padding is left, so the legacy
+	// image grows.
+	strcpy(BigSpec, "append:");
+	for(uint32_t w = 0; w < 200; ++w) sprintf(BigSpec + 7 + (w << 3), "%02X00%02X00", 0x40 + (w & 0x3F), w & 0xFF);
+	strcat(BigSpec, "FF00");
+
+	CHECK(JournaledEdit(&Info, &Journal, BigSpec, VBIOS_RELOC_SHIFT, &Moved, NULL) && !Moved);
+	CHECK(Info.Chain.Images[0].Length > OldLegacyLen);
+	TakeSnapshot(Snaps + Steps++, &Info);
+
+	CHECK(Journal.Count == (Steps - 1));
+	CHECK(TestROMCheckTrailer(&Info));
+
+	// Every undo gives back the image as it was before that edit.
+	for(int32_t s = Steps - 2; s >= 0; --s)
+	{
+		CHECK(JournalUndo(&Journal, &Info));
+		CHECK(SameAsSnapshot(Snaps + s, &Info));
+	}
+
+	CHECK(!JournalUndo(&Journal, &Info));
+	CHECK(SameAsSnapshot(Snaps, &Info));
+	CHECK(VBIOSLocateVOI(&Info, Image, Info.Size) && TestROMCheckTrailer(&Info));
+
+	// And every redo, the image as it was after it.
+	for(uint32_t s = 1; s < Steps; ++s)
+	{
+		CHECK(JournalRedo(&Journal, &Info));
+		CHECK(SameAsSnapshot(Snaps + s, &Info));
+	}
+
+	CHECK(!JournalRedo(&Journal, &Info));
+	CHECK(SameAsSnapshot(Snaps + Steps - 1, &Info));
+	CHECK(VBIOSLocateVOI(&Info, Image, Info.Size) && TestROMCheckTrailer(&Info));
+
+	JournalFree(&Journal);
+
+	for(uint32_t s = 0; s < Steps; ++s) free(Snaps[s].Image);
+	free(Image);
+
+	return(TestReport());
+}
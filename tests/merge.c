@@ -0,0 +1,274 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+#include "../vbios-tables.h"
+#include "../wolfvoitool.h"
+#include "../vbios.h"
+#include "../voi.h"
+#include "../reloc.h"
+#include "../plan.h"
+#include "../vomerge.h"
+#include "testrom.h"
+
+// Three-way merges of synthetic base, ours and theirs ROMs: a clean
+// merge, with a register only ours added, a tail after theirs'
+// terminator and a VO only ours added, and one merge for each way
+// a VO or register can conflict.
+
+#define MERGE_VDDC_ADDR						0x10
+#define MERGE_VDDGFX_ADDR					0x20
+
+typedef struct
+{
+	uint32_t Len;
+	uint8_t VOs[256];
+} MergeSide;
+
+static char TempDir[] = "/tmp/vomergeXXXXXX";
+static char BaseName[64], OursName[64], TheirsName[64], OutName[64];
+
+// vomerge.c reads and writes ROMs with the tool's own functions,
+// which live alongside main(); these stand in for them.
+size_t ReadVBIOSFile(void *VBIOSOut, const char *FileName, size_t BufSize)
+{
+	FILE *VBIOSFile = fopen(FileName, "rb");
+	size_t BytesRead;
+
+	if(!VBIOSFile) return(0);
+
+	BytesRead = fread(VBIOSOut, 1, BufSize, VBIOSFile);
+	fclose(VBIOSFile);
+	return(BytesRead);
+}
+
+size_t WriteVBIOSFile(const char *FileName, void *VBIOSData, size_t VBIOSSize)
+{
+	return(TestROMWrite(FileName, (const uint8_t *)VBIOSData, VBIOSSize) ? VBIOSSize : 0);
+}
+
+static void AddRegVO(MergeSide *Side, uint8_t Type, uint8_t Addr, const uint16_t *Writes, uint32_t WriteCount)
+{
+	Side->Len += TestROMInitRegVO(Side->VOs + Side->Len, Type, 150, Addr, 0, Writes, WriteCount, NULL, 0);
+}
+
+// Runs the merge, returning whether it succeeded and, in *Output,
+// what it printed.
+static bool RunMerge(const MergeSide *Base, const MergeSide *Ours, const MergeSide *Theirs, char **Output)
+{
+	uint8_t *Image = (uint8_t *)malloc(AMD_VBIOS_MAX_SIZE);
+	bool Ret;
+
+	*Output = NULL;
+	unlink(OutName);
+
+	CHECK(Image != NULL);
+	if(!Image) return(false);
+
+	CHECK(TestROMWrite(BaseName, Image, TestROMBuild(Image, Base->VOs, Base->Len, 0x200)));
+	CHECK(TestROMWrite(OursName, Image, TestROMBuild(Image, Ours->VOs, Ours->Len, 0x200)));
+	CHECK(TestROMWrite(TheirsName, Image, TestROMBuild(Image, Theirs->VOs, Theirs->Len, 0x200)));
+	free(Image);
+
+	CHECK(TestCaptureStart());
+	Ret = VOIMerge3(BaseName, OursName, TheirsName, OutName, VBIOS_RELOC_SHIFT);
+	*Output = TestCaptureEnd();
+
+	return(Ret);
+}
+
+// A merge that must fail with Message, writing nothing.
+static void CheckConflict(const MergeSide *Base, const MergeSide *Ours, const MergeSide *Theirs, const char *Message)
+{
+	char *Output;
+
+	CHECK(!RunMerge(Base, Ours, Theirs, &Output));
+	CHECK(Output && strstr(Output, Message));
+	CHECK(Output && strstr(Output, "nothing was written"));
+	CHECK(access(OutName, F_OK));
+
+	if(Output && !strstr(Output, Message)) printf("Expected \"%s\", got:\n%s", Message, Output);
+
+	free(Output);
+}
+
+static void CheckCleanMerge(void)
+{
+	const uint16_t BaseW[] = { 0x26, 0x04, 0x8D, 0x10, 0x41, 0x71 };
+	const uint16_t OursW[] = { 0x26, 0x04, 0x50, 0x01, 0x8D, 0x20, 0x41, 0x71 };
+	const uint16_t TheirsW[] = { 0x26, 0x04, 0x8D, 0x10, 0x41, 0x72, 0x60, 0x02 };
+	const uint16_t MergedW[] = { 0x26, 0x04, 0x50, 0x01, 0x8D, 0x20, 0x41, 0x72, 0x60, 0x02 };
+	const uint16_t GfxW[] = { 0x21, 0x33 };
+	const uint8_t Tail[] = { 0xAA, 0xBB, 0xCC };
+	MergeSide Base = { 0 }, Ours = { 0 }, Theirs = { 0 };
+	uint8_t *Image = (uint8_t *)malloc(AMD_VBIOS_MAX_SIZE), Want[64];
+	VoltageObject *VO;
+	VBIOSInfo Info;
+	size_t Size;
+	char *Output;
+
+	AddRegVO(&Base, VOLTAGE_TYPE_VDDC, MERGE_VDDC_ADDR, BaseW, 3);
+	Base.Len += TestROMEVVVO(Base.VOs + Base.Len, VOLTAGE_TYPE_VDDC);
+
+	// Ours inserts a write after 0x26 and changes 0x8D, and adds a
+	// VDDGFX VO.
+	AddRegVO(&Ours, VOLTAGE_TYPE_VDDC, MERGE_VDDC_ADDR, OursW, 4);
+	Ours.Len += TestROMEVVVO(Ours.VOs + Ours.Len, VOLTAGE_TYPE_VDDC);
+	AddRegVO(&Ours, VOLTAGE_TYPE_VDDGFX, MERGE_VDDGFX_ADDR, GfxW, 1);
+
+	// Theirs changes 0x41, appends a write, and carries bytes after
+	// the terminator.
+	Theirs.Len += TestROMInitRegVO(Theirs.VOs, VOLTAGE_TYPE_VDDC, 150, MERGE_VDDC_ADDR, 0, TheirsW, 4, Tail, sizeof(Tail));
+	Theirs.Len += TestROMEVVVO(Theirs.VOs + Theirs.Len, VOLTAGE_TYPE_VDDC);
+
+	CHECK(RunMerge(&Base, &Ours, &Theirs, &Output));
+	CHECK(Output && strstr(Output, "1 VOs changed (1 register by register) and 1 added"));
+	free(Output);
+
+	CHECK(Image != NULL);
+	if(!Image) return;
+
+	CHECK((Size = ReadVBIOSFile(Image, OutName, AMD_VBIOS_MAX_SIZE)) != 0);
+
+	if(Size && VBIOSLocateVOI(&Info, Image, Size))
+	{
+		CHECK(VBIOSComputeChecksum(&Info) == Image[ATOM_ROM_CHECKSUM_OFFSET]);
+		CHECK(TestROMCheckTrailer(&Info));
+		CHECK(WalkVOTable(Image + Info.VOITblOffset, 0xFF, NULL, NULL, NULL) == 3);
+
+		// Theirs' order, with ours' insertion after the write it
+		// followed in ours, and theirs' tail kept.
+		TestROMInitRegVO(Want, VOLTAGE_TYPE_VDDC, 150, MERGE_VDDC_ADDR, 0, MergedW, 5, Tail, sizeof(Tail));
+		CHECK((VO = VOEditFindVO(&Info, 0)) && (VO->VOSize == ((VoltageObject *)Want)->VOSize) && !memcmp(VO, Want, VO->VOSize));
+
+		CHECK((VO = VOEditFindVO(&Info, 1)) && (VO->VOMode == VOLTAGE_MODE_EVV));
+
+		TestROMInitRegVO(Want, VOLTAGE_TYPE_VDDGFX, 150, MERGE_VDDGFX_ADDR, 0, GfxW, 1, NULL, 0);
+		CHECK((VO = VOEditFindVO(&Info, 2)) && (VO->VOSize == ((VoltageObject *)Want)->VOSize) && !memcmp(VO, Want, VO->VOSize));
+	}
+	else CHECK(!"the merged ROM cannot be read");
+
+	free(Image);
+}
+
+// The VDDC VO with the given writes on each side, and nothing else.
+static void CheckWriteConflict(const uint16_t *BaseW, uint32_t BaseCount, const uint16_t *OursW, uint32_t OursCount, const uint16_t *TheirsW, uint32_t TheirsCount, const char *Message)
+{
+	MergeSide Base = { 0 }, Ours = { 0 }, Theirs = { 0 };
+
+	AddRegVO(&Base, VOLTAGE_TYPE_VDDC, MERGE_VDDC_ADDR, BaseW, BaseCount);
+	AddRegVO(&Ours, VOLTAGE_TYPE_VDDC, MERGE_VDDC_ADDR, OursW, OursCount);
+	AddRegVO(&Theirs, VOLTAGE_TYPE_VDDC, MERGE_VDDC_ADDR, TheirsW, TheirsCount);
+
+	CheckConflict(&Base, &Ours, &Theirs, Message);
+}
+
+static void CheckWriteConflicts(void)
+{
+	const uint16_t BaseW[] = { 0x26, 0x04, 0x8D, 0x10, 0x41, 0x71 };
+
+	{
+		const uint16_t OursW[] = { 0x26, 0x04, 0x8D, 0x20, 0x41, 0x71 };
+		const uint16_t TheirsW[] = { 0x26, 0x05, 0x8D, 0x30, 0x41, 0x71 };
+
+		CheckWriteConflict(BaseW, 3, OursW, 3, TheirsW, 3, "register 0x8D is written 0x10 in the base ROM, 0x20 in ours and 0x30 in theirs");
+	}
+
+	{
+		const uint16_t OursW[] = { 0x26, 0x04, 0x8D, 0x20 };
+		const uint16_t TheirsW[] = { 0x26, 0x04, 0x8D, 0x10, 0x41, 0x72 };
+
+		CheckWriteConflict(BaseW, 3, OursW, 2, TheirsW, 3, "the write to register 0x41 was removed in ours, but changed in theirs");
+	}
+
+	{
+		const uint16_t OursW[] = { 0x26, 0x04, 0x8D, 0x10, 0x41, 0x75 };
+		const uint16_t TheirsW[] = { 0x26, 0x05, 0x8D, 0x10 };
+
+		CheckWriteConflict(BaseW, 3, OursW, 3, TheirsW, 2, "the write to register 0x41 was removed in theirs, but changed in ours");
+	}
+
+	{
+		const uint16_t OursW[] = { 0x26, 0x04, 0x8D, 0x10, 0x41, 0x71, 0x50, 0x01 };
+		const uint16_t TheirsW[] = { 0x26, 0x04, 0x8D, 0x10, 0x41, 0x71, 0x50, 0x02 };
+
+		CheckWriteConflict(BaseW, 3, OursW, 4, TheirsW, 4, "register 0x50 was added as 0x1 in ours, and as 0x2 in theirs");
+	}
+
+	{
+		const uint16_t OursW[] = { 0x26, 0x04, 0x8D, 0x20, 0x41, 0x71 };
+		const uint16_t TheirsW[] = { 0x26, 0x04, 0x8D, 0x10, 0x41, 0x71, 0x1FF, 0x00 };
+
+		CheckWriteConflict(BaseW, 3, OursW, 3, TheirsW, 4, "cannot be merged register by register");
+	}
+}
+
+static void CheckVOConflicts(void)
+{
+	const uint16_t W[] = { 0x26, 0x04 }, ChangedW[] = { 0x26, 0x05 };
+	MergeSide Base = { 0 }, Ours = { 0 }, Theirs = { 0 };
+
+	// A mode header field changed on both sides.
+	AddRegVO(&Base, VOLTAGE_TYPE_VDDC, MERGE_VDDC_ADDR, W, 1);
+	Ours = Base;
+	Theirs = Base;
+	((VoltageObject *)Ours.VOs)->AsType3.ControlOffset = 1;
+	((VoltageObject *)Theirs.VOs)->AsType3.ControlOffset = 2;
+	CheckConflict(&Base, &Ours, &Theirs, "control_offset is 0x0 in the base ROM, 0x1 in ours and 0x2 in theirs");
+
+	// A VDDGFX VO removed in ours, but changed in theirs.
+	AddRegVO(&Base, VOLTAGE_TYPE_VDDGFX, MERGE_VDDGFX_ADDR, W, 1);
+	memset(&Ours, 0x00, sizeof(Ours));
+	memset(&Theirs, 0x00, sizeof(Theirs));
+	AddRegVO(&Ours, VOLTAGE_TYPE_VDDC, MERGE_VDDC_ADDR, W, 1);
+	AddRegVO(&Theirs, VOLTAGE_TYPE_VDDC, MERGE_VDDC_ADDR, W, 1);
+	AddRegVO(&Theirs, VOLTAGE_TYPE_VDDGFX, MERGE_VDDGFX_ADDR, ChangedW, 1);
+	CheckConflict(&Base, &Ours, &Theirs, "it was removed in ours, but changed in theirs");
+
+	// The other way around.
+	CheckConflict(&Base, &Theirs, &Ours, "it was removed in theirs, but changed in ours");
+
+	// Removed in ours, and left alone in theirs: still not a merge
+	// that can be made.
+	CheckConflict(&Base, &Ours, &Base, "was removed in ours, but a merge cannot remove VOs");
+
+	// The same VO added on both sides, differently.
+	memset(&Ours, 0x00, sizeof(Ours));
+	AddRegVO(&Ours, VOLTAGE_TYPE_VDDC, MERGE_VDDC_ADDR, W, 1);
+	AddRegVO(&Ours, VOLTAGE_TYPE_VDDCI, MERGE_VDDGFX_ADDR, W, 1);
+	memset(&Theirs, 0x00, sizeof(Theirs));
+	AddRegVO(&Theirs, VOLTAGE_TYPE_VDDC, MERGE_VDDC_ADDR, W, 1);
+	AddRegVO(&Theirs, VOLTAGE_TYPE_VDDCI, MERGE_VDDGFX_ADDR, ChangedW, 1);
+	memset(&Base, 0x00, sizeof(Base));
+	AddRegVO(&Base, VOLTAGE_TYPE_VDDC, MERGE_VDDC_ADDR, W, 1);
+	CheckConflict(&Base, &Ours, &Theirs, "it was added in both ours and theirs, differently");
+}
+
+int main(void)
+{
+	if(!mkdtemp(TempDir))
+	{
+		printf("Unable to make a directory for the test ROMs.\n");
+		return(1);
+	}
+
+	snprintf(BaseName, sizeof(BaseName), "%s/base.rom", TempDir);
+	snprintf(OursName, sizeof(OursName), "%s/ours.rom", TempDir);
+	snprintf(TheirsName, sizeof(TheirsName), "%s/theirs.rom", TempDir);
+	snprintf(OutName, sizeof(OutName), "%s/out.rom", TempDir);
+
+	CheckCleanMerge();
+	CheckWriteConflicts();
+	CheckVOConflicts();
+
+	unlink(BaseName);
+	unlink(OursName);
+	unlink(TheirsName);
+	unlink(OutName);
+	rmdir(TempDir);
+
+	return(TestReport());
+}
@@ -0,0 +1,40 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "../vbios-tables.h"
+#include "../vbios.h"
+#include "../voi.h"
+#include "testrom.h"
+
+// Writes a synthetic ROM to the file named, for the checks that drive
+// wolfvoitool itself rather than calling into it. Its VOI table holds
+// byte and word INIT_REGULATOR VOs, one with a tail, and an EVV VO.
+
+int main(int argc, char **argv)
+{
+	const uint16_t VDDCW[] = { 0x26, 0x04, 0x8D, 0x10 };
+	const uint16_t MVDDCW[] = { 0x21, 0x1234, 0x22, 0x0001 };
+	const uint8_t Tail[] = { 0xA5, 0x5A };
+	uint8_t *Image = (uint8_t *)malloc(AMD_VBIOS_MAX_SIZE), VOs[128];
+	uint32_t VOsLen = 0;
+	bool Ok;
+
+	if(argc != 2)
+	{
+		printf("Usage: %s <output ROM>\n", argv[0]);
+		return(1);
+	}
+
+	if(!Image) return(1);
+
+	VOsLen += TestROMInitRegVO(VOs + VOsLen, VOLTAGE_TYPE_VDDC, 150, 0x10, 0, VDDCW, 2, Tail, sizeof(Tail));
+	VOsLen += TestROMEVVVO(VOs + VOsLen, VOLTAGE_TYPE_VDDC);
+	VOsLen += TestROMInitRegVO(VOs + VOsLen, VOLTAGE_TYPE_MVDDC, 151, 0x30, 1, MVDDCW, 2, NULL, 0);
+
+	if(!(Ok = TestROMWrite(argv[1], Image, TestROMBuild(Image, VOs, VOsLen, 0x200)))) printf("Unable to write %s.\n", argv[1]);
+
+	free(Image);
+	return(Ok ? 0 : 1);
+}
@@ -0,0 +1,195 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+#include "../vbios-tables.h"
+#include "../vbios.h"
+#include "../voi.h"
+#include "../reloc.h"
+#include "../plan.h"
+#include "../smbus.h"
+#include "../smbusopt.h"
+#include "../i2c.h"
+#include "testrom.h"
+
+// Optimizes the INIT_REGULATOR sequences of a synthetic ROM with each
+// device model, and checks that the optimized ROM leaves every device
+// as the original does: in the simulator, under the same model, and
+// for the generic model, on the fake I2C bus too.
+
+static char TempDir[] = "/tmp/smbusoptXXXXXX";
+
+// Redundant and overwritten writes, within and across VOs, a VO that
+// only repeats an earlier one, PMBus page switches, and word writes.
+static size_t BuildROM(uint8_t *Image)
+{
+	const uint16_t VDDCW[] = { 0x26, 0x04, 0x8D, 0x10, 0x8D, 0x20, 0x41, 0x71, 0x41, 0x71 };
+	const uint16_t VDDGFXW[] = { 0x26, 0x04, 0x8D, 0x20 };
+	const uint16_t PagedW[] = { 0x00, 0x00, 0x21, 0x50, 0x00, 0x01, 0x21, 0x60, 0x00, 0x00, 0x21, 0x50, 0x22, 0x01, 0x22, 0x02 };
+	const uint16_t WordW[] = { 0x21, 0x1234, 0x21, 0x1234, 0x22, 0x0001, 0x21, 0x1234 };
+	uint8_t VOs[256];
+	uint32_t VOsLen = 0;
+
+	VOsLen += TestROMInitRegVO(VOs + VOsLen, VOLTAGE_TYPE_VDDC, 150, 0x10, 0, VDDCW, 5, NULL, 0);
+	VOsLen += TestROMEVVVO(VOs + VOsLen, VOLTAGE_TYPE_VDDC);
+	VOsLen += TestROMInitRegVO(VOs + VOsLen, VOLTAGE_TYPE_VDDGFX, 150, 0x10, 0, VDDGFXW, 2, NULL, 0);
+	VOsLen += TestROMInitRegVO(VOs + VOsLen, VOLTAGE_TYPE_VDDCI, 150, 0x20, 0, PagedW, 8, NULL, 0);
+	VOsLen += TestROMInitRegVO(VOs + VOsLen, VOLTAGE_TYPE_MVDDC, 150, 0x30, 1, WordW, 4, NULL, 0);
+
+	return(TestROMBuild(Image, VOs, VOsLen, 0x200));
+}
+
+static const SMBusSimDevice *FindDevice(const SMBusSim *Sim, uint8_t I2CLine, uint8_t I2CAddress)
+{
+	for(uint32_t i = 0; i < Sim->DeviceCount; ++i)
+	{
+		if((Sim->Devices[i]->I2CLine == I2CLine) && (Sim->Devices[i]->I2CAddress == I2CAddress)) return(Sim->Devices[i]);
+	}
+
+	return(NULL);
+}
+
+// Whether every device is left with the same registers written, to
+// the same values, and on the same page. How often, and by which VOs,
+// is what the optimizer changes, so it is not compared.
+static bool SameFinalState(const SMBusSim *A, const SMBusSim *B)
+{
+	if((A->DeviceCount != B->DeviceCount) || A->BadVOCount || B->BadVOCount) return(false);
+
+	for(uint32_t i = 0; i < A->DeviceCount; ++i)
+	{
+		const SMBusSimDevice *DevA = A->Devices[i], *DevB = FindDevice(B, DevA->I2CLine, DevA->I2CAddress);
+
+		if(!DevB || (DevA->Page != DevB->Page) || (DevA->Rejected != DevB->Rejected)) return(false);
+
+		for(uint32_t Page = 0; Page < DevA->Model->PageCount; ++Page)
+		{
+			for(uint32_t Reg = 0; Reg < 256; ++Reg)
+			{
+				const SMBusSimReg *RegA = &DevA->Regs[Page][Reg], *RegB = &DevB->Regs[Page][Reg];
+
+				if(RegA->Written != RegB->Written) return(false);
+				if(RegA->Written && ((RegA->Word != RegB->Word) || (RegA->Value != RegB->Value))) return(false);
+			}
+		}
+	}
+
+	return(true);
+}
+
+static bool ApplyVisit(VoltageObject *VO, uint8_t *VOData, uint32_t VODataLen, uint16_t Index, void *Ctx)
+{
+	(void)Index;
+
+	return(I2CApplyVO((I2CTransport *)Ctx, VO, VOData, VODataLen, false));
+}
+
+// Sends every INIT_REGULATOR VO of the ROM, in table order, to a new
+// fake bus, and returns what the bus holds after (to be freed by the
+// caller.)
+static uint8_t *ReplayOnFakeBus(const VBIOSInfo *Info, const char *BusName)
+{
+	char Target[64];
+	I2CTransport Xport;
+	uint8_t *Bus = NULL;
+	FILE *BusFile;
+	bool Ok;
+
+	snprintf(Target, sizeof(Target), "fake:%s", BusName);
+	unlink(BusName);
+
+	if(!TestCaptureStart()) return(NULL);
+
+	if((Ok = I2CTransportOpen(&Xport, Target)))
+	{
+		Ok = WalkVOTable(Info->Image + Info->VOITblOffset, VOLTAGE_MODE_INIT_REGULATOR, NULL, ApplyVisit, &Xport) >= 0;
+		I2CTransportClose(&Xport);
+	}
+
+	free(TestCaptureEnd());
+
+	if(Ok && (BusFile = fopen(BusName, "rb")))
+	{
+		if((Bus = (uint8_t *)malloc(I2C_FAKE_ADDRESSES * 256 * sizeof(uint16_t))) && (fread(Bus, sizeof(uint16_t), I2C_FAKE_ADDRESSES * 256, BusFile) != (I2C_FAKE_ADDRESSES * 256)))
+		{
+			free(Bus);
+			Bus = NULL;
+		}
+
+		fclose(BusFile);
+	}
+
+	unlink(BusName);
+	return(Bus);
+}
+
+static void CheckModel(const char *ModelName)
+{
+	const SMBusSimModel *Model = SMBusSimFindModel(ModelName);
+	uint8_t *Image = (uint8_t *)malloc(AMD_VBIOS_MAX_SIZE), *OrigBus = NULL, *OptBus = NULL;
+	char OrigBusName[64], OptBusName[64];
+	SMBusSim OrigSim, OptSim;
+	SMBusOpt Opt;
+	VBIOSInfo Info;
+
+	CHECK(Model && Image);
+	if(!Model || !Image) goto out;
+
+	snprintf(OrigBusName, sizeof(OrigBusName), "%s/orig.bus", TempDir);
+	snprintf(OptBusName, sizeof(OptBusName), "%s/opt.bus", TempDir);
+
+	CHECK(VBIOSLocateVOI(&Info, Image, BuildROM(Image)));
+
+	SMBusSimInit(&OrigSim, Model);
+	CHECK(SMBusSimRunTable(&OrigSim, Image + Info.VOITblOffset, NULL));
+
+	if(Model->PageCount == 1) CHECK((OrigBus = ReplayOnFakeBus(&Info, OrigBusName)) != NULL);
+
+	CHECK(SMBusOptimize(&Opt, &Info, Model));
+	CHECK(Opt.RedundantCount && Opt.OverwrittenCount && Opt.EmptiedCount && Opt.EditCount && !Opt.SkippedVOs);
+
+	CHECK(VBIOSApplyVOEdits(&Info, Opt.Edits, Opt.EditCount, VBIOS_RELOC_SHIFT));
+	CHECK(VBIOSLocateVOI(&Info, Image, Info.Size) && TestROMCheckTrailer(&Info));
+
+	SMBusSimInit(&OptSim, Model);
+	CHECK(SMBusSimRunTable(&OptSim, Image + Info.VOITblOffset, NULL));
+	CHECK(SameFinalState(&OrigSim, &OptSim));
+
+	if(Model->PageCount == 1)
+	{
+		CHECK((OptBus = ReplayOnFakeBus(&Info, OptBusName)) != NULL);
+		CHECK(OrigBus && OptBus && !memcmp(OrigBus, OptBus, I2C_FAKE_ADDRESSES * 256 * sizeof(uint16_t)));
+	}
+
+	// Optimizing again finds nothing more to drop.
+	SMBusOptFree(&Opt);
+	CHECK(SMBusOptimize(&Opt, &Info, Model));
+	CHECK(!Opt.RedundantCount && !Opt.OverwrittenCount && !Opt.EditCount);
+
+	SMBusOptFree(&Opt);
+	SMBusSimFree(&OrigSim);
+	SMBusSimFree(&OptSim);
+
+out:
+	free(OrigBus);
+	free(OptBus);
+	free(Image);
+}
+
+int main(void)
+{
+	if(!mkdtemp(TempDir))
+	{
+		printf("Unable to make a directory for the fake buses.\n");
+		return(1);
+	}
+
+	CheckModel("generic");
+	CheckModel("pmbus");
+
+	rmdir(TempDir);
+	return(TestReport());
+}
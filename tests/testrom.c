@@ -0,0 +1,229 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+#include "../vbios-tables.h"
+#include "../vbios.h"
+#include "../voi.h"
+#include "../reloc.h"
+#include "testrom.h"
+
+uint32_t TestFailCount = 0;
+
+static FILE *CaptureFile = NULL;
+static int SavedStdout = -1;
+
+// An INIT_REGULATOR VO: the writes, the terminator, then Tail, which
+// the driver never reads but some VBIOSes carry anyway.
+uint32_t TestROMInitRegVO(uint8_t *Out, uint8_t Type, uint8_t Line, uint8_t Addr, uint8_t Flag, const uint16_t *Writes, uint32_t WriteCount, const uint8_t *Tail, uint32_t TailLen)
+{
+	VoltageObject *VO = (VoltageObject *)Out;
+	uint8_t *Data = Out + sizeof(VoltageObject);
+
+	memset(VO, 0x00, sizeof(VoltageObject));
+	VO->VOType = Type;
+	VO->VOMode = VOLTAGE_MODE_INIT_REGULATOR;
+	VO->VOSize = sizeof(VoltageObject) + (WriteCount << 2) + sizeof(uint16_t) + TailLen;
+	VO->AsType3.I2CLine = Line;
+	VO->AsType3.I2CAddress = Addr;
+	VO->AsType3.VoltageControlFlag = Flag;
+
+	for(uint32_t w = 0; w < WriteCount; ++w)
+	{
+		memcpy(Data + (w << 2), Writes + (w << 1), sizeof(uint16_t));
+		memcpy(Data + (w << 2) + sizeof(uint16_t), Writes + (w << 1) + 1, sizeof(uint16_t));
+	}
+
+	Data[WriteCount << 2] = 0xFF;
+	Data[(WriteCount << 2) + 1] = 0x00;
+	if(TailLen) memcpy(Data + (WriteCount << 2) + sizeof(uint16_t), Tail, TailLen);
+
+	return(VO->VOSize);
+}
+
+// An EVV VO, which is shorter than a mode header.
+uint32_t TestROMEVVVO(uint8_t *Out, uint8_t Type)
+{
+	uint16_t Size = 8;
+
+	memset(Out, 0x00, Size);
+	Out[0] = Type;
+	Out[1] = VOLTAGE_MODE_EVV;
+	memcpy(Out + 2, &Size, sizeof(uint16_t));
+
+	return(Size);
+}
+
+// A table of Len bytes whose body is a pattern seeded by Seed, so
+// that it can be found intact wherever it ends up.
+static void TestROMFillTable(uint8_t *Table, uint16_t Len, uint8_t Seed)
+{
+	ATOM_COMMON_TABLE_HEADER *Hdr = (ATOM_COMMON_TABLE_HEADER *)Table;
+
+	Hdr->usStructureSize = Len;
+	Hdr->ucTableFormatRevision = 1;
+	Hdr->ucTableContentRevision = 1;
+
+	for(uint32_t i = sizeof(ATOM_COMMON_TABLE_HEADER); i < Len; ++i) Table[i] = (uint8_t)((i * 7) + Seed);
+}
+
+static bool TestROMCheckTable(const uint8_t *Image, uint32_t Offset, uint16_t Len, uint8_t Seed)
+{
+	if(((const ATOM_COMMON_TABLE_HEADER *)(Image + Offset))->usStructureSize != Len) return(false);
+
+	for(uint32_t i = sizeof(ATOM_COMMON_TABLE_HEADER); i < Len; ++i)
+	{
+		if(Image[Offset + i] != (uint8_t)((i * 7) + Seed)) return(false);
+	}
+
+	return(true);
+}
+
+static void TestROMSetPCIR(uint8_t *Image, uint32_t PCIROffset, uint16_t Blocks, uint8_t CodeType, uint8_t Indicator)
+{
+	PCI_DATA_STRUCTURE *PCIR = (PCI_DATA_STRUCTURE *)(Image + PCIROffset);
+	uint16_t Signature = PCI_EXPANSION_ROM_SIGNATURE, Ptr = PCIROffset;
+
+	memcpy(Image, &Signature, sizeof(uint16_t));
+	memcpy(Image + PCI_EXPANSION_ROM_PCIR_PTR_OFFSET, &Ptr, sizeof(uint16_t));
+
+	memset(PCIR, 0x00, sizeof(PCI_DATA_STRUCTURE));
+	PCIR->Signature = PCI_DATA_STRUCTURE_SIGNATURE;
+	PCIR->VendorID = 0x1002;
+	PCIR->DeviceID = 0x67DF;
+	PCIR->StructureLength = sizeof(PCI_DATA_STRUCTURE);
+	PCIR->ClassCode[2] = 0x03;
+	PCIR->ImageLength = Blocks;
+	PCIR->CodeType = CodeType;
+	PCIR->Indicator = Indicator;
+}
+
+// Builds the ROM into Image, which must hold AMD_VBIOS_MAX_SIZE bytes,
+// and returns its size.
+size_t TestROMBuild(uint8_t *Image, const uint8_t *VOs, uint32_t VOsLen, uint32_t PadLen)
+{
+	ATOM_ROM_HEADER *ROMHdr = (ATOM_ROM_HEADER *)(Image + TESTROM_ROM_HDR_OFFSET);
+	ATOM_MASTER_COMMAND_TABLE *MasterCmd = (ATOM_MASTER_COMMAND_TABLE *)(Image + TESTROM_MASTER_CMD_OFFSET);
+	ATOM_MASTER_DATA_TABLE *MasterData = (ATOM_MASTER_DATA_TABLE *)(Image + TESTROM_MASTER_DATA_OFFSET);
+	ATOM_COMMON_TABLE_HEADER *VOIHdr = (ATOM_COMMON_TABLE_HEADER *)(Image + TESTROM_VOI_OFFSET);
+	uint32_t DataTblOffset = TESTROM_VOI_OFFSET + sizeof(ATOM_COMMON_TABLE_HEADER) + VOsLen;
+	uint32_t CmdTblOffset = DataTblOffset + (TESTROM_TRAILER_LEN >> 1);
+	uint32_t TablesEnd = CmdTblOffset + (TESTROM_TRAILER_LEN >> 1);
+	uint32_t LegacyLen = ((TablesEnd + PadLen + PCI_EXPANSION_ROM_BLOCK_SIZE - 1) / PCI_EXPANSION_ROM_BLOCK_SIZE) * PCI_EXPANSION_ROM_BLOCK_SIZE;
+	uint8_t Sum = 0;
+
+	// Padding that does not fill the last block is rounded up with zeroes.
+	memset(Image, 0x00, LegacyLen + TESTROM_UEFI_LEN);
+	memset(Image + LegacyLen - PadLen, 0xFF, PadLen);
+
+	TestROMSetPCIR(Image, 0x80, LegacyLen / PCI_EXPANSION_ROM_BLOCK_SIZE, PCI_CODE_TYPE_X86, 0x00);
+	Image[PCI_EXPANSION_ROM_SIZE_OFFSET] = LegacyLen / PCI_EXPANSION_ROM_BLOCK_SIZE;
+	memcpy(Image + OFFSET_TO_POINTER_TO_ATOM_ROM_HEADER, &(uint16_t){ TESTROM_ROM_HDR_OFFSET }, sizeof(uint16_t));
+
+	ROMHdr->sHeader.usStructureSize = sizeof(ATOM_ROM_HEADER);
+	ROMHdr->sHeader.ucTableFormatRevision = 1;
+	ROMHdr->sHeader.ucTableContentRevision = 1;
+	memcpy(ROMHdr->uaFirmWareSignature, "ATOM", 4);
+	ROMHdr->usMasterCommandTableOffset = TESTROM_MASTER_CMD_OFFSET;
+	ROMHdr->usMasterDataTableOffset = TESTROM_MASTER_DATA_OFFSET;
+
+	MasterCmd->sHeader.usStructureSize = sizeof(ATOM_MASTER_COMMAND_TABLE);
+	MasterCmd->sHeader.ucTableFormatRevision = 1;
+	MasterCmd->sHeader.ucTableContentRevision = 1;
+	MasterCmd->ListOfCommandTables.ASIC_Init = CmdTblOffset;
+
+	MasterData->sHeader.usStructureSize = sizeof(ATOM_MASTER_DATA_TABLE);
+	MasterData->sHeader.ucTableFormatRevision = 1;
+	MasterData->sHeader.ucTableContentRevision = 1;
+	MasterData->ListOfDataTables.VoltageObjectInfo = TESTROM_VOI_OFFSET;
+	MasterData->ListOfDataTables.PowerPlayInfo = DataTblOffset;
+
+	VOIHdr->usStructureSize = sizeof(ATOM_COMMON_TABLE_HEADER) + VOsLen;
+	VOIHdr->ucTableFormatRevision = 4;
+	VOIHdr->ucTableContentRevision = 2;
+	memcpy(Image + TESTROM_VOI_OFFSET + sizeof(ATOM_COMMON_TABLE_HEADER), VOs, VOsLen);
+
+	TestROMFillTable(Image + DataTblOffset, TESTROM_TRAILER_LEN >> 1, 0x11);
+	TestROMFillTable(Image + CmdTblOffset, TESTROM_TRAILER_LEN >> 1, 0x5A);
+
+	for(uint32_t i = 0; i < LegacyLen; ++i) Sum += Image[i];
+	Image[ATOM_ROM_CHECKSUM_OFFSET] = -Sum;
+
+	TestROMSetPCIR(Image + LegacyLen, 0x40, TESTROM_UEFI_LEN / PCI_EXPANSION_ROM_BLOCK_SIZE, PCI_CODE_TYPE_EFI, PCI_INDICATOR_LAST_IMAGE);
+
+	return(LegacyLen + TESTROM_UEFI_LEN);
+}
+
+// Whether the tables after the VOI table are intact where the master
+// tables now point, and the UEFI image is still the last in the chain.
+bool TestROMCheckTrailer(const VBIOSInfo *Info)
+{
+	const ATOM_MASTER_COMMAND_TABLE *MasterCmd = (const ATOM_MASTER_COMMAND_TABLE *)(Info->Image + Info->ROMHdr->usMasterCommandTableOffset);
+	const VBIOSROMImage *UEFI = Info->Chain.Images + 1;
+
+	if(!TestROMCheckTable(Info->Image, Info->MasterDataTable->ListOfDataTables.PowerPlayInfo, TESTROM_TRAILER_LEN >> 1, 0x11)) return(false);
+	if(!TestROMCheckTable(Info->Image, MasterCmd->ListOfCommandTables.ASIC_Init, TESTROM_TRAILER_LEN >> 1, 0x5A)) return(false);
+
+	return((Info->Chain.ImageCount == 2) && (UEFI->Offset == Info->Chain.Images[0].Length) && (UEFI->Length == TESTROM_UEFI_LEN) &&
+		(UEFI->CodeType == PCI_CODE_TYPE_EFI) && ((UEFI->Offset + UEFI->Length) == Info->Size));
+}
+
+bool TestROMWrite(const char *FileName, const uint8_t *Image, size_t Size)
+{
+	FILE *ROMFile = fopen(FileName, "wb");
+	bool Ok;
+
+	if(!ROMFile) return(false);
+
+	Ok = fwrite(Image, 1, Size, ROMFile) == Size;
+	return(!fclose(ROMFile) && Ok);
+}
+
+// Sends stdout to a temporary file until TestCaptureEnd(), which
+// returns what was written to it (to be freed by the caller).
+bool TestCaptureStart(void)
+{
+	fflush(stdout);
+
+	if(!(CaptureFile = tmpfile())) return(false);
+
+	if(((SavedStdout = dup(STDOUT_FILENO)) < 0) || (dup2(fileno(CaptureFile), STDOUT_FILENO) < 0))
+	{
+		fclose(CaptureFile);
+		CaptureFile = NULL;
+		return(false);
+	}
+
+	return(true);
+}
+
+char *TestCaptureEnd(void)
+{
+	char *Output;
+	long Len;
+
+	fflush(stdout);
+	dup2(SavedStdout, STDOUT_FILENO);
+	close(SavedStdout);
+
+	fseek(CaptureFile, 0, SEEK_END);
+	Len = ftell(CaptureFile);
+	rewind(CaptureFile);
+
+	if((Output = (char *)calloc(Len + 1, 1)) && (fread(Output, 1, Len, CaptureFile) != (size_t)Len)) Output[0] = 0x00;
+
+	fclose(CaptureFile);
+	CaptureFile = NULL;
+	return(Output);
+}
+
+int TestReport(void)
+{
+	if(TestFailCount) printf("%u checks failed.\n", TestFailCount);
+	else printf("All checks passed.\n");
+
+	return(TestFailCount ? 1 : 0);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "../vbios-tables.h"
+#include "../vbios.h"
+#include "../voi.h"
+
+// Synthetic ROMs for the tests, built in memory. The legacy image
+// holds, in order, the PCI data structure, the ATOM ROM header, the
+// master command and data tables, the VOI table, a data table and a
+// command table after it (so that shifting the VOI table has offsets
+// to fix), PadLen bytes of 0xFF padding at the very end, and zeroes
+// in between to round it up to whole 512-byte blocks. A 1 KB UEFI
+// image follows it, and is the last in the chain.
+
+#define TESTROM_ROM_HDR_OFFSET				0x100
+#define TESTROM_MASTER_CMD_OFFSET			0x200
+#define TESTROM_MASTER_DATA_OFFSET			0x400
+#define TESTROM_VOI_OFFSET					0x800
+#define TESTROM_TRAILER_LEN					0x40
+#define TESTROM_UEFI_LEN					0x400
+
+extern uint32_t TestFailCount;
+
+#define CHECK(Cond) do { if(!(Cond)) { printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #Cond); TestFailCount++; } } while(0)
+
+// Register writes are (register, value) pairs.
+uint32_t TestROMInitRegVO(uint8_t *Out, uint8_t Type, uint8_t Line, uint8_t Addr, uint8_t Flag, const uint16_t *Writes, uint32_t WriteCount, const uint8_t *Tail, uint32_t TailLen);
+uint32_t TestROMEVVVO(uint8_t *Out, uint8_t Type);
+
+size_t TestROMBuild(uint8_t *Image, const uint8_t *VOs, uint32_t VOsLen, uint32_t PadLen);
+bool TestROMCheckTrailer(const VBIOSInfo *Info);
+bool TestROMWrite(const char *FileName, const uint8_t *Image, size_t Size);
+
+bool TestCaptureStart(void);
+char *TestCaptureEnd(void);
+
+int TestReport(void);
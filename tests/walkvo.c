@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "../vbios-tables.h"
+#include "../voi.h"
+#include "../filter.h"
+
+// Walks VOI tables built in memory, with VOs shorter than a mode
+// header (as EVV VOs legally are) among INIT_REGULATOR VOs.
+
+typedef struct
+{
+	uint32_t Count;
+	uint16_t Indices[8];
+	uint32_t DataLens[8];
+} WalkRecord;
+
+static uint32_t FailCount = 0;
+
+#define CHECK(Cond) do { if(!(Cond)) { printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #Cond); FailCount++; } } while(0)
+
+static bool RecordVisit(VoltageObject *VO, uint8_t *VOData, uint32_t VODataLen, uint16_t Index, void *Ctx)
+{
+	WalkRecord *Rec = (WalkRecord *)Ctx;
+
+	(void)VO;
+	(void)VOData;
+
+	Rec->Indices[Rec->Count] = Index;
+	Rec->DataLens[Rec->Count++] = VODataLen;
+	return(true);
+}
+
+// Appends a VO with the given header and Size - 4 bytes of body.
+static uint32_t AddVO(uint8_t *Table, uint32_t Offset, uint8_t Type, uint8_t Mode, uint16_t Size)
+{
+	Table[Offset] = Type;
+	Table[Offset + 1] = Mode;
+	memcpy(Table + Offset + 2, &Size, sizeof(uint16_t));
+	memset(Table + Offset + VO_HEADER_SIZE, 0x00, Size - VO_HEADER_SIZE);
+
+	// An INIT_REGULATOR VO's data is just the terminator.
+	if((Mode == VOLTAGE_MODE_INIT_REGULATOR) && (Size >= sizeof(VoltageObject) + 2)) Table[Offset + Size - 2] = 0xFF;
+
+	return(Offset + Size);
+}
+
+static void SetTableSize(uint8_t *Table, uint32_t Size)
+{
+	ATOM_COMMON_TABLE_HEADER *Hdr = (ATOM_COMMON_TABLE_HEADER *)Table;
+
+	Hdr->usStructureSize = Size;
+	Hdr->ucTableFormatRevision = 4;
+	Hdr->ucTableContentRevision = 2;
+}
+
+int main(void)
+{
+	uint8_t Table[256] = { 0 };
+	uint32_t End = sizeof(ATOM_COMMON_TABLE_HEADER);
+	WalkRecord Rec;
+	VOListNode *List;
+
+	End = AddVO(Table, End, VOLTAGE_TYPE_VDDGFX, VOLTAGE_MODE_INIT_REGULATOR, sizeof(VoltageObject) + 2);
+	End = AddVO(Table, End, VOLTAGE_TYPE_VDDC, VOLTAGE_MODE_EVV, 8);
+	End = AddVO(Table, End, VOLTAGE_TYPE_VDDC, VOLTAGE_MODE_INIT_REGULATOR, sizeof(VoltageObject) + 2);
+	SetTableSize(Table, End);
+
+	// All modes: the EVV VO is visited, with no data.
+	memset(&Rec, 0x00, sizeof(Rec));
+	CHECK(WalkVOTable(Table, 0xFF, NULL, RecordVisit, &Rec) == 3);
+	CHECK((Rec.Indices[0] == 0) && (Rec.Indices[1] == 1) && (Rec.Indices[2] == 2));
+	CHECK((Rec.DataLens[0] == 2) && (Rec.DataLens[1] == 0) && (Rec.DataLens[2] == 2));
+
+	// INIT_REGULATOR only: the EVV VO is stepped over, but counted.
+	memset(&Rec, 0x00, sizeof(Rec));
+	CHECK(WalkVOTable(Table, VOLTAGE_MODE_INIT_REGULATOR, NULL, RecordVisit, &Rec) == 2);
+	CHECK((Rec.Indices[0] == 0) && (Rec.Indices[1] == 2));
+
+	CHECK(CreateVOList(&List, Table, 0xFF, NULL) == 3);
+	CHECK(List && List->next && ValidateVO(List->next->VO) && !List->next->VODataLen);
+	FreeVOList(List);
+
+	// An INIT_REGULATOR VO too short for its mode header is malformed
+	// when selected, and may still be stepped over when it is not.
+	Table[sizeof(ATOM_COMMON_TABLE_HEADER) + sizeof(VoltageObject) + 2 + 1] = VOLTAGE_MODE_INIT_REGULATOR;
+	CHECK(WalkVOTable(Table, 0xFF, NULL, NULL, NULL) < 0);
+	CHECK(WalkVOTable(Table, VOLTAGE_MODE_SVID2, NULL, NULL, NULL) == 0);
+
+	// The short VO is rejected before a filter reads its mode header,
+	// even as the last VO, whose mode header would lie past the table.
+	{
+		uint32_t ShortEnd = AddVO(Table, sizeof(ATOM_COMMON_TABLE_HEADER), VOLTAGE_TYPE_VDDGFX, VOLTAGE_MODE_INIT_REGULATOR, sizeof(VoltageObject) + 2);
+		uint8_t *Exact;
+		VOFilter Filter;
+
+		ShortEnd = AddVO(Table, ShortEnd, VOLTAGE_TYPE_VDDC, VOLTAGE_MODE_INIT_REGULATOR, 8);
+		SetTableSize(Table, ShortEnd);
+
+		CHECK((Exact = (uint8_t *)malloc(ShortEnd)) != NULL);
+		memcpy(Exact, Table, ShortEnd);
+
+		CHECK(CompileVOFilter(&Filter, "i2caddr == 96"));
+		CHECK(WalkVOTable(Exact, 0xFF, &Filter, NULL, NULL) < 0);
+		CHECK(WalkVOTable(Exact, VOLTAGE_MODE_INIT_REGULATOR, &Filter, NULL, NULL) < 0);
+		CHECK(WalkVOTable(Exact, VOLTAGE_MODE_SVID2, &Filter, NULL, NULL) == 0);
+
+		free(Exact);
+	}
+
+	// A VO too short for even the VO header can never be stepped over.
+	End = AddVO(Table, sizeof(ATOM_COMMON_TABLE_HEADER), VOLTAGE_TYPE_VDDC, VOLTAGE_MODE_EVV, 8);
+	memset(Table + End, 0x00, VO_HEADER_SIZE);
+	Table[End + 1] = VOLTAGE_MODE_EVV;
+	SetTableSize(Table, End + VO_HEADER_SIZE);
+	CHECK(WalkVOTable(Table, VOLTAGE_MODE_SVID2, NULL, NULL, NULL) < 0);
+
+	// The VO's own end must also lie within the table.
+	SetTableSize(Table, sizeof(ATOM_COMMON_TABLE_HEADER) + 6);
+	CHECK(WalkVOTable(Table, VOLTAGE_MODE_SVID2, NULL, NULL, NULL) < 0);
+
+	// A filter nested past the program bound is refused, however deep,
+	// rather than overflowing the stack.
+	{
+		static char Expr[200001];
+		VOFilter Filter;
+
+		memset(Expr, '(', 100000);
+		memset(Expr + 100000, '!', 100000);
+		CHECK(!CompileVOFilter(&Filter, Expr));
+		CHECK(CompileVOFilter(&Filter, "((!(mode == EVV)))"));
+	}
+
+	if(FailCount) printf("%u checks failed.\n", FailCount);
+	else printf("All checks passed.\n");
+
+	return(FailCount ? 1 : 0);
+}
@@ -10,6 +10,47 @@
 
 #define OFFSET_TO_POINTER_TO_ATOM_ROM_HEADER		0x00000048L
 
+// PCI expansion ROM images. A ROM may hold a chain of them (on
+// AMD cards, typically the legacy VBIOS followed by a UEFI GOP
+// driver), each beginning with the 0x55AA signature, a size in
+// 512-byte blocks at offset 0x02, and a pointer to its PCI data
+// structure at offset 0x18. The PCI data structure holds the
+// authoritative image length and code type, and marks the last
+// image in the chain.
+#define PCI_EXPANSION_ROM_SIGNATURE					0xAA55
+#define PCI_EXPANSION_ROM_SIZE_OFFSET				0x02
+#define PCI_EXPANSION_ROM_PCIR_PTR_OFFSET			0x18
+#define PCI_EXPANSION_ROM_BLOCK_SIZE				512
+
+#define PCI_DATA_STRUCTURE_SIGNATURE				0x52494350		// "PCIR"
+
+#define PCI_CODE_TYPE_X86							0x00
+#define PCI_CODE_TYPE_OPEN_FIRMWARE					0x01
+#define PCI_CODE_TYPE_HP_PA_RISC					0x02
+#define PCI_CODE_TYPE_EFI							0x03
+
+#define PCI_INDICATOR_LAST_IMAGE					0x80
+
+#pragma pack(push, 1)
+
+typedef struct _PCI_DATA_STRUCTURE
+{
+	uint32_t Signature;
+	uint16_t VendorID;
+	uint16_t DeviceID;
+	uint16_t DeviceListOffset;
+	uint16_t StructureLength;
+	uint8_t  StructureRevision;
+	uint8_t  ClassCode[3];
+	uint16_t ImageLength;						// In 512-byte blocks
+	uint16_t CodeRevision;
+	uint8_t  CodeType;
+	uint8_t  Indicator;
+	uint16_t MaxRuntimeImageLength;
+}PCI_DATA_STRUCTURE;
+
+#pragma pack(pop)
+
 typedef struct _ATOM_COMMON_TABLE_HEADER
 {
 	uint16_t usStructureSize;
@@ -0,0 +1,163 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "vbios-tables.h"
+#include "vbios.h"
+#include "voi.h"
+
+// Walks the PCI expansion ROM image chain in a single pass,
+// recording the offset, length and code type of every image.
+// Each image must begin with the 0x55AA signature and point to
+// a valid PCIR structure inside itself, and the chain must end
+// with an image flagged as the last one, all within Size bytes.
+// Returns false (after printing why) for a broken chain.
+bool VBIOSWalkROMChain(VBIOSROMChain *Chain, const uint8_t *Image, size_t Size)
+{
+	uint32_t Offset = 0;
+
+	memset(Chain, 0x00, sizeof(VBIOSROMChain));
+
+	do
+	{
+		const PCI_DATA_STRUCTURE *PCIR;
+		VBIOSROMImage *Cur = Chain->Images + Chain->ImageCount;
+		uint32_t PCIROffset;
+
+		if(Chain->ImageCount == VBIOS_MAX_ROM_IMAGES)
+		{
+			printf("ROM chain has more than %d images.\n", VBIOS_MAX_ROM_IMAGES);
+			return(false);
+		}
+
+		if(((Offset + PCI_EXPANSION_ROM_PCIR_PTR_OFFSET + sizeof(uint16_t)) > Size) || (*((uint16_t *)(Image + Offset)) != PCI_EXPANSION_ROM_SIGNATURE))
+		{
+			printf("No ROM image signature at 0x%X.\n", Offset);
+			return(false);
+		}
+
+		PCIROffset = Offset + *((uint16_t *)(Image + Offset + PCI_EXPANSION_ROM_PCIR_PTR_OFFSET));
+
+		if((PCIROffset + sizeof(PCI_DATA_STRUCTURE)) > Size)
+		{
+			printf("PCIR structure of ROM image at 0x%X is out of bounds.\n", Offset);
+			return(false);
+		}
+
+		PCIR = (const PCI_DATA_STRUCTURE *)(Image + PCIROffset);
+
+		if(PCIR->Signature != PCI_DATA_STRUCTURE_SIGNATURE)
+		{
+			printf("Bad PCIR signature for ROM image at 0x%X.\n", Offset);
+			return(false);
+		}
+
+		Cur->Offset = Offset;
+		Cur->Length = PCIR->ImageLength * PCI_EXPANSION_ROM_BLOCK_SIZE;
+		Cur->PCIROffset = PCIROffset;
+		Cur->CodeType = PCIR->CodeType;
+
+		if(!Cur->Length || ((Offset + Cur->Length) > Size) || ((PCIROffset + sizeof(PCI_DATA_STRUCTURE)) > (Offset + Cur->Length)))
+		{
+			printf("ROM image at 0x%X has a bad length (0x%X).\n", Offset, Cur->Length);
+			return(false);
+		}
+
+		Offset += Cur->Length;
+		Chain->ImageCount++;
+
+		if(PCIR->Indicator & PCI_INDICATOR_LAST_IMAGE) break;
+	} while(1);
+
+	Chain->ChainLen = Offset;
+
+	return(true);
+}
+
+// Walks the ROM image chain, then finds the ATOM ROM header,
+// master data table and VOI table in the legacy image, checking
+// that each lies within it. Returns false (after printing why) if
+// any of them are missing or out of bounds, which is common
+// enough when fed arbitrary files in batch runs. Since the chain
+// is checked first, broken ROMs are rejected before any real
+// work is done on them.
+bool VBIOSLocateVOI(VBIOSInfo *Info, uint8_t *Image, size_t Size)
+{
+	uint32_t ROMHdrOffset, MasterDataOffset;
+
+	memset(Info, 0x00, sizeof(VBIOSInfo));
+	Info->Image = Image;
+	Info->Size = Size;
+
+	if(!VBIOSWalkROMChain(&Info->Chain, Image, Size)) return(false);
+
+	// Everything we look for lives in the legacy image.
+	Size = Info->Chain.Images[0].Length;
+
+	if(Size < (OFFSET_TO_POINTER_TO_ATOM_ROM_HEADER + sizeof(uint16_t)))
+	{
+		printf("Image is too small to be a VBIOS.\n");
+		return(false);
+	}
+
+	ROMHdrOffset = *((uint16_t *)(Image + OFFSET_TO_POINTER_TO_ATOM_ROM_HEADER));
+
+	if((ROMHdrOffset + sizeof(ATOM_ROM_HEADER)) > Size)
+	{
+		printf("ATOM ROM header offset 0x%X is out of bounds.\n", ROMHdrOffset);
+		return(false);
+	}
+
+	Info->ROMHdr = (ATOM_ROM_HEADER *)(Image + ROMHdrOffset);
+	MasterDataOffset = Info->ROMHdr->usMasterDataTableOffset;
+
+	if((MasterDataOffset + sizeof(ATOM_MASTER_DATA_TABLE)) > Size)
+	{
+		printf("Master data table offset 0x%X is out of bounds.\n", MasterDataOffset);
+		return(false);
+	}
+
+	Info->MasterDataTable = (ATOM_MASTER_DATA_TABLE *)(Image + MasterDataOffset);
+	Info->VOITblOffset = Info->MasterDataTable->ListOfDataTables.VoltageObjectInfo;
+
+	if(!Info->VOITblOffset || ((Info->VOITblOffset + sizeof(ATOM_COMMON_TABLE_HEADER)) > Size))
+	{
+		printf("VOI table offset 0x%X is missing or out of bounds.\n", Info->VOITblOffset);
+		return(false);
+	}
+
+	Info->VOIHdr = (ATOM_COMMON_TABLE_HEADER *)(Image + Info->VOITblOffset);
+
+	if((Info->VOITblOffset + Info->VOIHdr->usStructureSize) > Size)
+	{
+		printf("VOI table at 0x%X runs past the end of the image.\n", Info->VOITblOffset);
+		return(false);
+	}
+
+	if(!FindVOIParser(Info->VOIHdr->ucTableFormatRevision))
+	{
+		printf("VOI table format revision %d (content revision %d) is not supported.\n", Info->VOIHdr->ucTableFormatRevision, Info->VOIHdr->ucTableContentRevision);
+		return(false);
+	}
+
+	return(true);
+}
+
+static const char *VBIOSCodeTypeName(uint8_t CodeType)
+{
+	switch(CodeType)
+	{
+		case PCI_CODE_TYPE_X86: return("x86/legacy");
+		case PCI_CODE_TYPE_OPEN_FIRMWARE: return("Open Firmware");
+		case PCI_CODE_TYPE_HP_PA_RISC: return("HP PA-RISC");
+		case PCI_CODE_TYPE_EFI: return("UEFI");
+		default: return("unknown");
+	}
+}
+
+void VBIOSDumpROMChain(const VBIOSROMChain *Chain)
+{
+	for(uint32_t i = 0; i < Chain->ImageCount; ++i)
+		printf("ROM image %d: offset 0x%06X, length 0x%06X, code type 0x%02X (%s)\n", i, Chain->Images[i].Offset, Chain->Images[i].Length, Chain->Images[i].CodeType, VBIOSCodeTypeName(Chain->Images[i].CodeType));
+}
@@ -0,0 +1,53 @@
+// Copyright 2022 Wolf9466/Wolf0/OhGodAPet
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "vbios-tables.h"
+
+#define VBIOS_GET_PADDING_END(Image)		((uint32_t)((((uint8_t *)(Image))[0x02])) * 512UL)
+#define VBIOS_OFFSET(Image, OffsetValue)	(((uint8_t *)Image) + (OffsetValue))
+#define VBIOS_GET_ROM_HDR_OFFSET(Image)		(*((uint16_t *)(VBIOS_OFFSET((Image), OFFSET_TO_POINTER_TO_ATOM_ROM_HEADER))))
+
+// Enough for the legacy and UEFI images, plus the odd extra
+// image some vendors tack on.
+#define VBIOS_MAX_ROM_IMAGES						16
+
+typedef struct
+{
+	uint32_t Offset;
+	uint32_t Length;
+	uint32_t PCIROffset;
+	uint8_t CodeType;
+} VBIOSROMImage;
+
+// Every image in the PCI expansion ROM chain, in order. The
+// legacy VBIOS (the one holding the ATOM tables) is image 0.
+// ChainLen is the offset just past the last image; anything
+// from there to the end of the file is not part of the chain.
+typedef struct
+{
+	uint32_t ImageCount;
+	uint32_t ChainLen;
+	VBIOSROMImage Images[VBIOS_MAX_ROM_IMAGES];
+} VBIOSROMChain;
+
+// Pointers to the parts of a loaded VBIOS image that most
+// modes need. All of them point INTO the image buffer.
+typedef struct
+{
+	uint8_t *Image;
+	size_t Size;
+	VBIOSROMChain Chain;
+	ATOM_ROM_HEADER *ROMHdr;
+	ATOM_MASTER_DATA_TABLE *MasterDataTable;
+	uint32_t VOITblOffset;
+	ATOM_COMMON_TABLE_HEADER *VOIHdr;
+} VBIOSInfo;
+
+bool VBIOSWalkROMChain(VBIOSROMChain *Chain, const uint8_t *Image, size_t Size);
+bool VBIOSLocateVOI(VBIOSInfo *Info, uint8_t *Image, size_t Size);
+void VBIOSDumpROMChain(const VBIOSROMChain *Chain);
@@ -1,15 +1,173 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <string.h>
+#include <stdbool.h>
 
 #include "vbios-tables.h"
 #include "voi.h"
+#include "filter.h"
+
+#include <strings.h>
+
+#define VO_TYPE_NAME_CASE(Name, Value, DisplayName)		case Value: return(DisplayName);
+#define VO_MODE_NAME_CASE(Name, Value, DisplayName)		case Value: return(DisplayName);
+
+// Safe for any byte read from a ROM; unknown values get a
+// placeholder name rather than indexing past a table.
+const char *VoltageTypeName(uint8_t VOType)
+{
+	switch(VOType)
+	{
+		VO_TYPE_LIST(VO_TYPE_NAME_CASE)
+		default: return("UNKNOWN/INVALID");
+	}
+}
+
+const char *VoltageModeName(uint8_t VOMode)
+{
+	switch(VOMode)
+	{
+		VO_MODE_LIST(VO_MODE_NAME_CASE)
+		default: return("UNKNOWN/INVALID");
+	}
+}
+
+#define VO_KNOWN_CASE(Name, Value, DisplayName)			case Value:
+
+static bool VoltageTypeKnown(uint8_t VOType)
+{
+	switch(VOType)
+	{
+		VO_TYPE_LIST(VO_KNOWN_CASE) return(true);
+		default: return(false);
+	}
+}
+
+static bool VoltageModeKnown(uint8_t VOMode)
+{
+	switch(VOMode)
+	{
+		VO_MODE_LIST(VO_KNOWN_CASE) return(true);
+		default: return(false);
+	}
+}
+
+#define VO_HAS_HDR_CASE(Mode, Member, StructName, Fields, DataKind, DataFits)	case VOLTAGE_MODE_##Mode:
+
+// Whether VOs of the mode carry a mode header, and so must be at
+// least as large as VoltageObject.
+bool VoltageModeHasHeader(uint8_t VOMode)
+{
+	switch(VOMode)
+	{
+		VO_MODE_HDR_LIST(VO_HAS_HDR_CASE) return(true);
+		default: return(false);
+	}
+}
+
+typedef struct
+{
+	const char *Name;
+	const char *DisplayName;
+	uint8_t Value;
+} VONameEntry;
+
+#define VO_NAME_ENTRY(Name, Value, DisplayName)			{ #Name, DisplayName, Value },
+
+static const VONameEntry VoltageTypeTable[] = { VO_TYPE_LIST(VO_NAME_ENTRY) };
+static const VONameEntry VoltageModeTable[] = { VO_MODE_LIST(VO_NAME_ENTRY) };
+
+// Accepts either the short name from the schema or the name
+// shown in dumps, in any case.
+static bool VOLookupName(const VONameEntry *Table, uint32_t Count, const char *Name, uint8_t *Value)
+{
+	for(uint32_t i = 0; i < Count; ++i)
+	{
+		if(!strcasecmp(Name, Table[i].Name) || !strcasecmp(Name, Table[i].DisplayName))
+		{
+			*Value = Table[i].Value;
+			return(true);
+		}
+	}
+	
+	return(false);
+}
+
+bool VoltageTypeFromName(const char *Name, uint8_t *VOType)
+{
+	return(VOLookupName(VoltageTypeTable, sizeof(VoltageTypeTable) / sizeof(VoltageTypeTable[0]), Name, VOType));
+}
+
+bool VoltageModeFromName(const char *Name, uint8_t *VOMode)
+{
+	return(VOLookupName(VoltageModeTable, sizeof(VoltageModeTable) / sizeof(VoltageModeTable[0]), Name, VOMode));
+}
+
+// Per-mode encoders, and text and JSON renderers, all generated from
+// the mode header fields in voschema.h. Each is a straight line of
+// code for its own mode.
+
+#define VO_ENCODE_FIELD(CType, Name, JSONKey, TextFormat, TextArgs, RawValue) \
+	memcpy(Pos, &Hdr->Name, sizeof(CType)); Pos += sizeof(CType);
+#define VO_ENCODE_PAD(CType, Name, Count) \
+	memcpy(Pos, Hdr->Name, sizeof(CType) * (Count)); Pos += sizeof(CType) * (Count);
+#define VO_TEXT_FIELD(CType, Name, JSONKey, TextFormat, TextArgs, RawValue) \
+	printf(TextFormat, TextArgs(Hdr->Name));
+#define VO_JSON_FIELD(CType, Name, JSONKey, TextFormat, TextArgs, RawValue) \
+	printf(",\"" JSONKey "\":%u", (unsigned)RawValue(Hdr->Name));
+#define VO_SKIP_PAD(CType, Name, Count)
+
+#define VO_DATA_TEXT_HEX(Node)		DumpVOData(Node)
+#define VO_DATA_TEXT_NONE(Node)
+
+static void DumpVOData(const VOListNode *Node)
+{
+	printf("\tData = ");
+	for(uint32_t i = 0; i < Node->VODataLen; ++i)
+	{
+		if(!(i & 15)) printf("\n\t\t");
+		printf("%02X", Node->VOData[i]);
+	}
+	
+	putchar('\n');
+}
+
+#define VO_MODE_CODEC(Mode, Member, StructName, Fields, DataKind, DataFits) \
+static void EncodeVO_##Mode(uint8_t *Pos, const VoltageObject *VO) \
+{ \
+	const StructName *Hdr = &VO->Member; \
+	Fields(VO_ENCODE_FIELD, VO_ENCODE_PAD) \
+} \
+static void DumpVOText_##Mode(const VOListNode *Node) \
+{ \
+	const StructName *Hdr = &Node->VO->Member; \
+	Fields(VO_TEXT_FIELD, VO_SKIP_PAD) \
+	VO_DATA_TEXT_##DataKind(Node); \
+} \
+static void DumpVOJSON_##Mode(const VoltageObject *VO) \
+{ \
+	const StructName *Hdr = &VO->Member; \
+	Fields(VO_JSON_FIELD, VO_SKIP_PAD) \
+}
+
+VO_MODE_HDR_LIST(VO_MODE_CODEC)
+
+#define VO_ENCODE_CASE(Mode, Member, StructName, Fields, DataKind, DataFits) \
+	case VOLTAGE_MODE_##Mode: EncodeVO_##Mode(BufPtr + 4, Node->VO); break;
+#define VO_VALIDATE_CASE(Mode, Member, StructName, Fields, DataKind, DataFits) \
+	case VOLTAGE_MODE_##Mode: return((VO->VOSize >= sizeof(VoltageObject)) && DataFits(&VO->Member, VO->VOSize - sizeof(VoltageObject)));
+#define VO_TEXT_CASE(Mode, Member, StructName, Fields, DataKind, DataFits) \
+	case VOLTAGE_MODE_##Mode: DumpVOText_##Mode(CurVO); break;
+#define VO_JSON_CASE(Mode, Member, StructName, Fields, DataKind, DataFits) \
+	case VOLTAGE_MODE_##Mode: DumpVOJSON_##Mode(CurVO->VO); break;
 
 // Serializes a VO for writing. It accepts a pointer to an output buffer,
 // a pointer to the node to serialize, and the size of the output buffer
 // in bytes. It returns the length of the serialized VO written to OutBuf.
 // If the output buffer size is too small, nothing is written, and the
 // number of bytes required to serialize the node provided is returned.
+// VOs of a mode with no known header are not serialized, and 1 is
+// returned for them.
 uint16_t SerializeVO(void *OutBuf, const VOListNode *Node, uint32_t OutBufSize)
 {
 	const uint16_t NodeBufLen = Node->VO->VOSize;
@@ -17,101 +175,194 @@ uint16_t SerializeVO(void *OutBuf, const VOListNode *Node, uint32_t OutBufSize)
 	
 	if(NodeBufLen > OutBufSize) return(NodeBufLen);
 	
-	// We only support serializing VOs with mode INIT_REGULATOR
-	// for right now, so bail out if the VO has a different mode.
-	if(Node->VO->VOMode != VOLTAGE_MODE_INIT_REGULATOR)
-		return(1);
+	// The VO header, then the mode header, field by field.
+	BufPtr[0] = Node->VO->VOType;
+	BufPtr[1] = Node->VO->VOMode;
+	memcpy(BufPtr + 2, &Node->VO->VOSize, sizeof(uint16_t));
 	
-	// The first 12 bytes are the VO header and the mode
-	// header, so they may be copied verbatim.
-	memcpy(BufPtr, Node->VO, sizeof(VoltageObject));
+	switch(Node->VO->VOMode)
+	{
+		VO_MODE_HDR_LIST(VO_ENCODE_CASE)
+		default: return(1);
+	}
 	
-	// Following those headers (for objects with mode INIT_REGULATOR)
-	// is a variable length set of data for the I2C codes.
+	// Following those headers is the variable length data
+	// (for objects with mode INIT_REGULATOR, the I2C codes.)
 	memcpy(BufPtr + sizeof(VoltageObject), Node->VOData, Node->VODataLen);
 	
 	return(NodeBufLen);
 }
-// TODO/FIXME: Check Content & Format revisions of the VOI table passed by caller
-// This function accepts a pointer to the base of a VOI table in VOITableBase, and
-// it accepts a VO mode in DesiredVOMode. It outputs a pointer to a new linked list 
-// of VOListNode structures, and returns the amount of entries in the list. Only
-// Only VOs with the desired mode are returned. To return all VOs, simply set
-// DesiredVOMode to 0xFF.
-uint16_t CreateVOList(VOListNode **OutputList, uint8_t *VOITableBase, uint8_t DesiredVOMode)
-{
-	uint16_t TableSize, CurOffset, EntriesFound = 0;
 
-	if(!OutputList || !VOITableBase) return(0);
-	
-	*OutputList = NULL;
+// Checks a VO against the schema: its type and mode must be known,
+// and it must be large enough for its mode header, if its mode has
+// one, and the data that header says follows.
+bool ValidateVO(const VoltageObject *VO)
+{
+	if((VO->VOSize < VO_HEADER_SIZE) || !VoltageTypeKnown(VO->VOType)) return(false);
 	
+	switch(VO->VOMode)
+	{
+		VO_MODE_HDR_LIST(VO_VALIDATE_CASE)
+		default: return(VoltageModeKnown(VO->VOMode));
+	}
+}
+
+// Walks a table of VOs that each begin with the four-byte VO header
+// (type, mode, 16-bit size), as ATOM_VOLTAGE_OBJECT_INFO_V3_1 and
+// voltage_object_info_v4_1 both lay them out.
+static int32_t WalkVOTableV3(uint8_t *VOITableBase, uint8_t DesiredVOMode, const VOFilter *Filter, VOVisitFn Visit, void *Ctx)
+{
+	uint32_t TableSize, CurOffset;
+	int32_t EntriesFound = 0;
+
 	// Get the size of the table so we know when to stop walking it.	
 	TableSize = (((ATOM_COMMON_TABLE_HEADER*)VOITableBase)->usStructureSize);
 	
 	// Begin walking the table immediately following its header
 	CurOffset = sizeof(ATOM_COMMON_TABLE_HEADER);
 
-	while(CurOffset < TableSize)
+	for(uint16_t Index = 0; CurOffset < TableSize; ++Index)
 	{
-		VOListNode *CurrentNode, *NewNode;
 		VoltageObject *CurVO = (VoltageObject *)(VOITableBase + CurOffset);
 
+		// Sanity check for invalid sizes. This is checked for every
+		// VO, not just the ones selected, as a zero size would
+		// otherwise have us walking in place forever, but only the
+		// VO header is needed to step over one.
+		if((CurVO->VOSize < VO_HEADER_SIZE) || ((CurOffset + CurVO->VOSize) > TableSize)) return(-1);
+		
 		if((CurVO->VOMode == DesiredVOMode) || (DesiredVOMode == 0xFF))
-		{		
-			// Sanity check for invalid sizes, but do not leak memory
-			// on failure - because we set the next pointer and VO
-			// data pointer to NULL with every new entry, we may still
-			// walk the list and free it.
-			if(CurVO->VOSize < sizeof(VoltageObject))
-			{
-				for(NewNode = CurrentNode = *OutputList; CurrentNode; CurrentNode = NewNode)
-				{
-					NewNode = CurrentNode->next;
-					if(CurrentNode->VOData) free(CurrentNode->VOData);
-					
-					free(CurrentNode);
-				}
-				
-				return(0);
-			}			
+		{
+			uint32_t VODataLen = 0;
 			
-			if(!(*OutputList)) *OutputList = CurrentNode = NewNode = (VOListNode *)calloc(1, sizeof(VOListNode));
-			else
-			{
-				for(CurrentNode = *OutputList; CurrentNode->next; CurrentNode = CurrentNode->next);
-				NewNode = CurrentNode->next = (VOListNode *)calloc(1, sizeof(VOListNode));
-				NewNode->prev = CurrentNode;
-			}
+			// A VO with no room for its mode header is only legal
+			// in a mode that has none; it is visited with no data.
+			// This comes before the filter, which reads the mode
+			// header of the modes that have one.
+			if(CurVO->VOSize > sizeof(VoltageObject)) VODataLen = CurVO->VOSize - sizeof(VoltageObject);
+			else if((CurVO->VOSize < sizeof(VoltageObject)) && VoltageModeHasHeader(CurVO->VOMode)) return(-1);
 			
-			// If the size of the VO is less than or equal to the
-			// sum of the VO header and the VO mode header, then
-			// there is no data.
-			if(CurVO->VOSize <= sizeof(VoltageObject))
-			{
-				if(NewNode->VOData) free(NewNode->VOData);
-				NewNode->VOData = NULL;
-				NewNode->VODataLen = 0;
-			}
-			else
+			if(VOFilterMatch(Filter, CurVO))
 			{
-				NewNode->VODataLen = CurVO->VOSize - sizeof(VoltageObject);
+				if(Visit && !Visit(CurVO, VOITableBase + CurOffset + sizeof(VoltageObject), VODataLen, Index, Ctx))
+					return(-1);
 				
-				if(!NewNode->VOData) 
-					NewNode->VOData = (uint8_t *)calloc(1, NewNode->VODataLen);
-				else
-					NewNode->VOData = (uint8_t *)realloc(NewNode->VOData, NewNode->VODataLen);
-				
-				memcpy(NewNode->VOData, VOITableBase + CurOffset + sizeof(VoltageObject), NewNode->VODataLen);
+				EntriesFound++;
 			}
-			
-			NewNode->VO = CurVO;
-			NewNode->next = NULL;
-			EntriesFound++;
 		}
 
 		CurOffset += CurVO->VOSize;
 	}
+	
+	return(EntriesFound);
+}
+
+// Formats 1 and 2 (up to Northern Islands) size each VO with a single
+// byte and have no mode byte, so they cannot be walked as above, and
+// are not supported.
+static const VOIParser VOIParsers[] =
+{
+	{ 3, "ATOM_VOLTAGE_OBJECT_INFO_V3_1", WalkVOTableV3 },
+	{ 4, "voltage_object_info_v4_1", WalkVOTableV3 }
+};
+
+// Returns NULL for a format revision that cannot be parsed.
+const VOIParser *FindVOIParser(uint8_t FormatRevision)
+{
+	for(size_t i = 0; i < (sizeof(VOIParsers) / sizeof(VOIParsers[0])); ++i)
+	{
+		if(VOIParsers[i].FormatRevision == FormatRevision) return(VOIParsers + i);
+	}
+	
+	return(NULL);
+}
+
+// Walks the VOI table at VOITableBase, calling Visit for every VO with the
+// mode DesiredVOMode (0xFF for all modes) that also matches Filter (if not
+// NULL). Nothing is allocated or copied - the VO and VOData pointers passed
+// to Visit point into the table itself, and Index is the position of the VO
+// in the table, counting VOs that were skipped. Returns the number of VOs
+// visited, or -1 if the table is malformed, of a format revision that
+// cannot be parsed, or Visit returned false. The walker is chosen once,
+// from the table header, so nothing is decided per VO.
+int32_t WalkVOTable(uint8_t *VOITableBase, uint8_t DesiredVOMode, const VOFilter *Filter, VOVisitFn Visit, void *Ctx)
+{
+	const VOIParser *Parser;
+	
+	if(!VOITableBase || !(Parser = FindVOIParser(((ATOM_COMMON_TABLE_HEADER *)VOITableBase)->ucTableFormatRevision))) return(-1);
+	
+	return(Parser->Walk(VOITableBase, DesiredVOMode, Filter, Visit, Ctx));
+}
+
+typedef struct
+{
+	VOListNode *Head;
+	VOListNode *Tail;
+} VOListBuilder;
+
+static bool CreateVOListVisit(VoltageObject *VO, uint8_t *VOData, uint32_t VODataLen, uint16_t Index, void *Ctx)
+{
+	VOListBuilder *Builder = (VOListBuilder *)Ctx;
+	VOListNode *NewNode = (VOListNode *)calloc(1, sizeof(VOListNode));
+	
+	if(!NewNode) return(false);
+	
+	// If the size of the VO is less than or equal to the
+	// sum of the VO header and the VO mode header, then
+	// there is no data.
+	if(VODataLen)
+	{
+		NewNode->VOData = (uint8_t *)malloc(VODataLen);
+		
+		if(!NewNode->VOData)
+		{
+			free(NewNode);
+			return(false);
+		}
+		
+		memcpy(NewNode->VOData, VOData, VODataLen);
+		NewNode->VODataLen = VODataLen;
+	}
+	
+	NewNode->VO = VO;
+	NewNode->Index = Index;
+	NewNode->prev = Builder->Tail;
+	
+	if(Builder->Tail) Builder->Tail->next = NewNode;
+	else Builder->Head = NewNode;
+	
+	Builder->Tail = NewNode;
+	
+	return(true);
+}
+
+// This function accepts a pointer to the base of a VOI table in VOITableBase, and
+// it accepts a VO mode in DesiredVOMode. It outputs a pointer to a new linked list 
+// of VOListNode structures, and returns the amount of entries in the list. Only
+// Only VOs with the desired mode are returned. To return all VOs, simply set
+// DesiredVOMode to 0xFF. If Filter is not NULL, VOs must also match it; the
+// filter is run against the VO header in place, so VOs that do not match are
+// never copied.
+uint16_t CreateVOList(VOListNode **OutputList, uint8_t *VOITableBase, uint8_t DesiredVOMode, const VOFilter *Filter)
+{
+	VOListBuilder Builder = { NULL, NULL };
+	int32_t EntriesFound;
+
+	if(!OutputList || !VOITableBase) return(0);
+	
+	*OutputList = NULL;
+	
+	EntriesFound = WalkVOTable(VOITableBase, DesiredVOMode, Filter, CreateVOListVisit, &Builder);
+	
+	// Do not leak memory on failure - every node that was
+	// created is linked, so we may still walk the list and free it.
+	if(EntriesFound < 0)
+	{
+		FreeVOList(Builder.Head);
+		return(0);
+	}
+	
+	*OutputList = Builder.Head;
 	return(EntriesFound);
 }
 
@@ -122,67 +373,60 @@ void DumpVOList(VOListNode *VOList)
 	for(int i = 0; CurVO; CurVO = CurVO->next, ++i)
 	{
 		printf("\nVOI entry %d:\n", i);
-		printf("\tVOType = %d\t(Type \"%s\")\n", CurVO->VO->VOType, VoltageTypeNames[CurVO->VO->VOType]);
-		printf("\tVOMode = %d\t(Mode \"%s\")\n", CurVO->VO->VOMode, VoltageModeNames[CurVO->VO->VOMode]);
+		printf("\tVOType = %d\t(Type \"%s\")\n", CurVO->VO->VOType, VoltageTypeName(CurVO->VO->VOType));
+		printf("\tVOMode = %d\t(Mode \"%s\")\n", CurVO->VO->VOMode, VoltageModeName(CurVO->VO->VOMode));
 		printf("\tSize = %d\n", CurVO->VO->VOSize);
 		
 		switch(CurVO->VO->VOMode)
 		{
-			case VOLTAGE_MODE_GPIO_LUT:
-			{
-				printf("\tVoltage GPIO Control ID: 0x%02X\n", CurVO->VO->AsType0.VoltageGPIOCntlID);
-				printf("\tGPIO Entry Number: 0x%02X\n", CurVO->VO->AsType0.GPIOEntryNum);
-				printf("\tPhase Delay: 0x%02X\n", CurVO->VO->AsType0.PhaseDelay);
-				printf("\tGPIO Mask Value: 0x%08X\n", CurVO->VO->AsType0.GPIOMaskValue);
-				
-				// TODO - walk LUT entries
-				break;
-			}
-			case VOLTAGE_MODE_INIT_REGULATOR:
-			{
-				printf("\tRegulatorID = %d\n", CurVO->VO->AsType3.RegulatorID);
-				printf("\tI2CLine = %d\n", CurVO->VO->AsType3.I2CLine);
-				printf("\tI2CAddress = %d\n", CurVO->VO->AsType3.I2CAddress);
-				printf("\tControlOffset = %d\n", CurVO->VO->AsType3.ControlOffset);
-				printf("\tVoltage entries are %d-bit.\n", (CurVO->VO->AsType3.VoltageControlFlag ? 16 : 8));
-				printf("\tData = ");
-				for(int i = 0; i < CurVO->VODataLen; ++i)
-				{
-					if(!(i & 15)) printf("\n\t\t");
-					printf("%02X", CurVO->VOData[i]);
-				}
-
-				putchar('\n');
-				break;
-			}
-			case VOLTAGE_MODE_SVID2:
-			{
-				printf("\tLoadLinePSI = 0x%04X\n", CurVO->VO->AsType7.LoadLinePSI.Value);
-				printf("\t\tOffsetTrim = %d\n", CurVO->VO->AsType7.LoadLinePSI.Info.OffsetTrim);
-				printf("\t\tLoadLineSlopeTrim = %d\n", CurVO->VO->AsType7.LoadLinePSI.Info.LoadLineSlopeTrim);
-				printf("\t\tPSI1: %d\n", CurVO->VO->AsType7.LoadLinePSI.Info.PSI1);
-				printf("\t\tPSI0_EN: %d\n", CurVO->VO->AsType7.LoadLinePSI.Info.PSI0_EN);
-				printf("\t\tPSI0_VID: %d\n", CurVO->VO->AsType7.LoadLinePSI.Info.PSI0_VID);
-				printf("\tSVD GPIO ID: %d\n", CurVO->VO->AsType7.SVDGPIOID);
-				printf("\tSVC GPIO ID: %d\n", CurVO->VO->AsType7.SVCGPIOID);
-				break;
-			}
-			default:
-			{
-				printf("\tData = ");
-				for(int i = 0; i < CurVO->VODataLen; ++i)
-				{
-					if(!(i & 15)) printf("\n\t\t");
-					printf("%02X", CurVO->VOData[i]);
-				}
-				putchar('\n');
-			}
+			VO_MODE_HDR_LIST(VO_TEXT_CASE)
+			default: DumpVOData(CurVO);
 		}
 
 		putchar('\n');
 	}
 }
 
+void PrintJSONString(const char *Str)
+{
+	putchar('"');
+	
+	for(; *Str; ++Str)
+	{
+		if((*Str == '"') || (*Str == '\\')) printf("\\%c", *Str);
+		else if((unsigned char)*Str < 0x20) printf("\\u%04x", *Str);
+		else putchar(*Str);
+	}
+	
+	putchar('"');
+}
+
+// Same as DumpVOList(), but one line of JSON per VO, with the mode
+// header fields of its mode (named as in the export columns), its
+// data in hex, and whether it passes ValidateVO().
+void DumpVOListJSON(VOListNode *VOList, const char *ROMName)
+{
+	VOListNode *CurVO = VOList;
+	
+	for(; CurVO; CurVO = CurVO->next)
+	{
+		printf("{\"rom\":");
+		PrintJSONString(ROMName);
+		printf(",\"index\":%d,\"type\":%d,\"type_name\":\"%s\"", CurVO->Index, CurVO->VO->VOType, VoltageTypeName(CurVO->VO->VOType));
+		printf(",\"mode\":%d,\"mode_name\":\"%s\",\"size\":%d", CurVO->VO->VOMode, VoltageModeName(CurVO->VO->VOMode), CurVO->VO->VOSize);
+		
+		switch(CurVO->VO->VOMode)
+		{
+			VO_MODE_HDR_LIST(VO_JSON_CASE)
+			default: break;
+		}
+		
+		printf(",\"data\":\"");
+		for(uint32_t j = 0; j < CurVO->VODataLen; ++j) printf("%02x", CurVO->VOData[j]);
+		printf("\",\"valid\":%s}\n", ValidateVO(CurVO->VO) ? "true" : "false");
+	}
+}
+
 void FreeVOList(VOListNode *List)
 {
 	VOListNode *NextVO;
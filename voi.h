@@ -4,6 +4,9 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <stdbool.h>
+
+#include "voschema.h"
 
 #pragma pack(push, 1)
 
@@ -23,126 +26,17 @@ typedef struct
 } VOHdr;
 */
 
-// Known voltage types
-
-#define VOLTAGE_TYPE_VDDC						0x01
-#define VOLTAGE_TYPE_MVDDC						0x02
-#define VOLTAGE_TYPE_MVDDQ						0x03
-#define VOLTAGE_TYPE_VDDCI						0x04
-#define VOLTAGE_TYPE_VDDGFX						0x05
-#define VOLTAGE_TYPE_PCC						0x06
-#define VOLTAGE_TYPE_MVPP						0x07
-#define VOLTAGE_TYPE_LEDDPM						0x08
-#define VOLTAGE_TYPE_PCC_MVDD					0x09
-#define VOLTAGE_TYPE_PCIE_VDDC					0x0A
-#define VOLTAGE_TYPE_PCIE_VDDR					0x0B
-#define VOLTAGE_TYPE_GENERIC_I2C_1				0x11
-#define VOLTAGE_TYPE_GENERIC_I2C_2				0x12
-#define VOLTAGE_TYPE_GENERIC_I2C_3				0x13
-#define VOLTAGE_TYPE_GENERIC_I2C_4				0x14
-#define VOLTAGE_TYPE_GENERIC_I2C_5				0x15
-#define VOLTAGE_TYPE_GENERIC_I2C_6				0x16
-#define VOLTAGE_TYPE_GENERIC_I2C_7				0x17
-#define VOLTAGE_TYPE_GENERIC_I2C_8				0x18
-#define VOLTAGE_TYPE_GENERIC_I2C_9				0x19
-#define VOLTAGE_TYPE_GENERIC_I2C_10				0x1A
-
-#define VOLTAGE_TYPE_MAX						0x1B
-
-static const char *VoltageTypeNames[VOLTAGE_TYPE_MAX] =
-{
-	"UNKNOWN/INVALID",
-	"VDDC",
-	"MVDDC",
-	"MVDDQ",
-	"VDDCI",
-	"VDDGFX",
-	"PCC",
-	"MVPP",
-	"LEDDPM",
-	"PCC_MVDD",
-	"PCIE_VDDC",
-	"PCIE_VDDR",
-	"UNKNOWN/INVALID",
-	"UNKNOWN/INVALID",
-	"UNKNOWN/INVALID",
-	"UNKNOWN/INVALID",
-	"UNKNOWN/INVALID",
-	"VOLTAGE_TYPE_GENERIC_I2C_1",
-	"VOLTAGE_TYPE_GENERIC_I2C_2",
-	"VOLTAGE_TYPE_GENERIC_I2C_3",
-	"VOLTAGE_TYPE_GENERIC_I2C_4",
-	"VOLTAGE_TYPE_GENERIC_I2C_5",
-	"VOLTAGE_TYPE_GENERIC_I2C_6",
-	"VOLTAGE_TYPE_GENERIC_I2C_7",
-	"VOLTAGE_TYPE_GENERIC_I2C_8",
-	"VOLTAGE_TYPE_GENERIC_I2C_9",
-	"VOLTAGE_TYPE_GENERIC_I2C_10"
-};
-
-// Known voltage modes
-
-#define	VOLTAGE_MODE_GPIO_LUT					0x00
-#define VOLTAGE_MODE_INIT_REGULATOR				0x03
-#define VOLTAGE_MODE_VOLTAGE_PHASE				0x04
-#define VOLTAGE_MODE_SVID2						0x07
-#define VOLTAGE_MODE_EVV						0x08
-#define VOLTAGE_MODE_PWRBOOST_LEAKAGE_LUT		0x10
-#define VOLTAGE_MODE_HIGH_STATE_LEAKAGE_LUT		0x11
-#define VOLTAGE_MODE_HIGH1_STATE_LEAKAGE_LUT	0x12
-#define VOLTAGE_MODE_MAX						0x13
-
-static const char *VoltageModeNames[VOLTAGE_MODE_MAX] =
-{
-	"GPIO_LUT",
-	"UNKNOWN/INVALID",
-	"UNKNOWN/INVALID",
-	"INIT_REGULATOR",
-	"VOLTAGE_PHASE",
-	"UNKNOWN/INVALID",
-	"UNKNOWN/INVALID",
-	"SVID2",
-	"EVV",
-	"UNKNOWN/INVALID",
-	"UNKNOWN/INVALID",
-	"UNKNOWN/INVALID",
-	"UNKNOWN/INVALID",
-	"UNKNOWN/INVALID",
-	"UNKNOWN/INVALID",
-	"UNKNOWN/INVALID",
-	"PWRBOOST_LEAKAGE_LUT",
-	"HIGH_STATE_LEAKAGE_LUT",
-	"HIGH1_STATE_LEAKAGE_LUT",
-};
-
-// My personal favorite VO mode is this one, INIT_REGULATOR.
-// It sends arbitrary data over I2C to a slave device on the
-// bus. Its intention is to be used to configure the registers
-// of a VRM controller residing on one of the GPU I2C busses.
-// Keep in mind, however, that the I2C device in question
-// need not be a VRM controller at all - this should work
-// with any I2C device. It consists of an eight-byte header,
-// followed by a variable number of address/value pairs,
-// where address is the register number, and value is the
-// value to write to it.
- 
-// Its header begins with a regulator ID (I believe 0xFF is
-// "any regulator"), followed by the I2C line that the device
-// resides on, then the address of the slave device, then a
-// field named "ControlOffset" which I have no idea what it
-// is for, and VoltageControlFlag, which specifies the I2C
-// write format used. The value zero is most common, meaning
-// that a SMBus write byte command is used. If nonzero, it
-// MAY instead uses an SMBus write word command. TODO: Confirm.
-typedef struct
-{
-	uint8_t RegulatorID;
-	uint8_t I2CLine;
-	uint8_t I2CAddress;
-	uint8_t ControlOffset;
-	uint8_t VoltageControlFlag;
-	uint8_t Reserved[3];
-} VOModeInitRegulator;
+// The constants, and the mode header structs, come from the schema
+// in voschema.h.
+
+#define VO_TYPE_ENUM(Name, Value, DisplayName)		VOLTAGE_TYPE_##Name = Value,
+#define VO_MODE_ENUM(Name, Value, DisplayName)		VOLTAGE_MODE_##Name = Value,
+
+enum { VO_TYPE_LIST(VO_TYPE_ENUM) };
+enum { VO_MODE_LIST(VO_MODE_ENUM) };
+
+#undef VO_TYPE_ENUM
+#undef VO_MODE_ENUM
 
 typedef struct
 {
@@ -150,15 +44,6 @@ typedef struct
 	uint16_t VoltageValue;
 } VOGPIOLUTEntry;
 
-typedef struct
-{
-	uint8_t VoltageGPIOCntlID;
-	uint8_t GPIOEntryNum;
-	uint8_t PhaseDelay;
-	uint8_t Reserved;
-	uint32_t GPIOMaskValue;
-} VOModeGPIOLUT;
-
 //	LoadLineSlopeTrim
 // 		- 000: Remove all LL droop from output
 //		- 001: Initial LL slope -40%
@@ -179,25 +64,20 @@ typedef struct
 	uint16_t Unused : 1;
 } SVILLPSI;
 
-typedef struct
-{
-	union
-	{
-		uint16_t Value;
-		SVILLPSI Info;
-	} LoadLinePSI;
-	uint8_t SVDGPIOID;
-	uint8_t SVCGPIOID;
-	uint32_t Reserved;
-} VOModeSVID2;
-/*
 typedef union
 {
-	VOModeGPIOLUT AsType0;
-	VOModeInitRegulator AsType3;
-	VOModeSVID2 AsType7;
-} VOModeHdr;
-*/
+	uint16_t Value;
+	SVILLPSI Info;
+} VOLoadLinePSI;
+
+#define VO_HDR_FIELD_DECL(CType, Name, JSONKey, TextFormat, TextArgs, RawValue)		CType Name;
+#define VO_HDR_PAD_DECL(CType, Name, Count)											CType Name[Count];
+#define VO_HDR_STRUCT_DECL(Mode, Member, StructName, Fields, DataKind, DataFits) \
+	typedef struct { Fields(VO_HDR_FIELD_DECL, VO_HDR_PAD_DECL) } StructName;
+
+VO_MODE_HDR_LIST(VO_HDR_STRUCT_DECL)
+
+#define VO_HDR_UNION_MEMBER(Mode, Member, StructName, Fields, DataKind, DataFits)	StructName Member;
 
 typedef struct
 {
@@ -207,15 +87,29 @@ typedef struct
 	uint16_t VOSize;
 	union
 	{
-		VOModeGPIOLUT AsType0;
-		VOModeInitRegulator AsType3;
-		VOModeSVID2 AsType7;
+		VO_MODE_HDR_LIST(VO_HDR_UNION_MEMBER)
 	};
 } VoltageObject;
 
-// The VO and VOData members should point INTO the VBIOS buffer
+// Every VO has at least the VO header; modes with a mode header
+// (see VO_MODE_HDR_LIST) need all of VoltageObject, but the others,
+// such as EVV and merged rail VOs, may be as short as 8 bytes.
+#define VO_HEADER_SIZE					4
+
+// At most 0xFFFF bytes of table, and every VO is at least its header.
+#define VOI_MAX_VOS						((0x10000 / VO_HEADER_SIZE) + 1)
+
+#undef VO_HDR_FIELD_DECL
+#undef VO_HDR_PAD_DECL
+#undef VO_HDR_STRUCT_DECL
+#undef VO_HDR_UNION_MEMBER
+
+// The VO and VOData members should point INTO the VBIOS buffer.
+// Index is the VO's position in the table, which with a mode or
+// filter given to CreateVOList() is not its position in the list.
 typedef struct VOListNode_s
 {
+	uint16_t Index;
 	uint32_t VODataLen;
 	uint8_t *VOData;
 	VoltageObject *VO;
@@ -226,7 +120,39 @@ typedef struct VOListNode_s
 
 #pragma pack(pop)
 
-uint16_t CreateVOList(VOListNode **OutputList, uint8_t *VOITableBase, uint8_t DesiredVOMode);
+// Compiled VO filter expression, see filter.h
+typedef struct VOFilter_s VOFilter;
+
+// Called for each VO found by WalkVOTable(), see voi.c
+typedef bool (*VOVisitFn)(VoltageObject *VO, uint8_t *VOData, uint32_t VODataLen, uint16_t Index, void *Ctx);
+
+// Walks the VOs of a VOI table laid out as one format revision has
+// it, see WalkVOTable().
+typedef int32_t (*VOTableWalkFn)(uint8_t *VOITableBase, uint8_t DesiredVOMode, const VOFilter *Filter, VOVisitFn Visit, void *Ctx);
+
+// A VOI table format revision this tool can parse, and its walker.
+// Only a change of format revision changes the layout; a new content
+// revision of a known format is, by ATOM's own rule, still parsed as
+// that format is (see ATOM_COMMON_TABLE_HEADER.)
+typedef struct
+{
+	uint8_t FormatRevision;
+	const char *Layout;
+	VOTableWalkFn Walk;
+} VOIParser;
+
+const VOIParser *FindVOIParser(uint8_t FormatRevision);
+int32_t WalkVOTable(uint8_t *VOITableBase, uint8_t DesiredVOMode, const VOFilter *Filter, VOVisitFn Visit, void *Ctx);
+uint16_t CreateVOList(VOListNode **OutputList, uint8_t *VOITableBase, uint8_t DesiredVOMode, const VOFilter *Filter);
 uint16_t SerializeVO(void *OutBuf, const VOListNode *Node, uint32_t OutBufSize);
 void DumpVOList(VOListNode *VOList);
+void DumpVOListJSON(VOListNode *VOList, const char *ROMName);
+bool ValidateVO(const VoltageObject *VO);
+bool VoltageModeHasHeader(uint8_t VOMode);
+void PrintJSONString(const char *Str);
+
+const char *VoltageTypeName(uint8_t VOType);
+const char *VoltageModeName(uint8_t VOMode);
+bool VoltageTypeFromName(const char *Name, uint8_t *VOType);
+bool VoltageModeFromName(const char *Name, uint8_t *VOMode);
 void FreeVOList(VOListNode *List);
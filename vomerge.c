@@ -0,0 +1,592 @@
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "vbios-tables.h"
+#include "wolfvoitool.h"
+#include "vbios.h"
+#include "voi.h"
+#include "reloc.h"
+#include "plan.h"
+#include "smbus.h"
+#include "vomerge.h"
+
+// A VO, and which of the VOs alike (see VOIMergeAlike()) it is.
+typedef struct
+{
+	VoltageObject *VO;
+	uint8_t *Data;
+	uint32_t DataLen;
+	uint16_t Index;
+	uint16_t Ordinal;
+} VOIMergeVO;
+
+typedef struct
+{
+	const char *Name;
+	uint8_t *Image;
+	VBIOSInfo Info;
+	uint32_t Count;
+	VOIMergeVO *VOs;
+} VOIMergeROM;
+
+// A register write, and which of the writes to its register it is.
+typedef struct
+{
+	uint8_t Reg;
+	uint16_t Ordinal;
+	uint16_t Value;
+} VOIMergeWrite;
+
+typedef struct
+{
+	const char *Where;
+	uint32_t ConflictCount;
+	uint32_t RegMergeCount;
+} VOIMergeCtx;
+
+// Whether two VOs are the same VO, going by what they are: VOs of
+// the same type and mode are, and INIT_REGULATOR VOs must also
+// program the same device.
+static bool VOIMergeAlike(const VoltageObject *A, const VoltageObject *B)
+{
+	if((A->VOType != B->VOType) || (A->VOMode != B->VOMode)) return(false);
+	if(A->VOMode != VOLTAGE_MODE_INIT_REGULATOR) return(true);
+
+	return((A->AsType3.I2CLine == B->AsType3.I2CLine) && (A->AsType3.I2CAddress == B->AsType3.I2CAddress));
+}
+
+static bool VOIMergeCollectVisit(VoltageObject *VO, uint8_t *VOData, uint32_t VODataLen, uint16_t Index, void *Ctx)
+{
+	VOIMergeROM *ROM = (VOIMergeROM *)Ctx;
+	VOIMergeVO *Out = ROM->VOs + ROM->Count;
+
+	Out->VO = VO;
+	Out->Data = VOData;
+	Out->DataLen = VODataLen;
+	Out->Index = Index;
+	Out->Ordinal = 0;
+
+	for(uint32_t i = 0; i < ROM->Count; ++i)
+	{
+		if(VOIMergeAlike(ROM->VOs[i].VO, VO)) Out->Ordinal++;
+	}
+
+	ROM->Count++;
+	return(true);
+}
+
+static bool VOIMergeLoad(VOIMergeROM *ROM)
+{
+	size_t Size;
+
+	ROM->Image = (uint8_t *)malloc(AMD_VBIOS_MAX_SIZE);
+	ROM->VOs = (VOIMergeVO *)malloc(sizeof(VOIMergeVO) * VOI_MAX_VOS);
+	ROM->Count = 0;
+
+	if(!ROM->Image || !ROM->VOs)
+	{
+		printf("Out of memory.\n");
+		return(false);
+	}
+
+	if(!(Size = ReadVBIOSFile(ROM->Image, ROM->Name, AMD_VBIOS_MAX_SIZE)) || !VBIOSLocateVOI(&ROM->Info, ROM->Image, Size))
+	{
+		printf("Unable to use %s in a merge.\n", ROM->Name);
+		return(false);
+	}
+
+	if(WalkVOTable(ROM->Image + ROM->Info.VOITblOffset, 0xFF, NULL, VOIMergeCollectVisit, ROM) < 0)
+	{
+		printf("VOI table in %s is malformed.\n", ROM->Name);
+		return(false);
+	}
+
+	return(true);
+}
+
+static VOIMergeVO *VOIMergeFind(const VOIMergeROM *ROM, const VOIMergeVO *VO)
+{
+	for(uint32_t i = 0; i < ROM->Count; ++i)
+	{
+		if((ROM->VOs[i].Ordinal == VO->Ordinal) && VOIMergeAlike(ROM->VOs[i].VO, VO->VO)) return(ROM->VOs + i);
+	}
+
+	return(NULL);
+}
+
+// The VO header, mode header and data lie one after another in the
+// image, so VOs may be compared whole.
+static bool VOIMergeSame(const VOIMergeVO *A, const VOIMergeVO *B)
+{
+	return((A->VO->VOSize == B->VO->VOSize) && !memcmp(A->VO, B->VO, A->VO->VOSize));
+}
+
+static bool VOIMergeSameData(const VOIMergeVO *A, const VOIMergeVO *B)
+{
+	return((A->DataLen == B->DataLen) && !memcmp(A->Data, B->Data, A->DataLen));
+}
+
+static void VOIMergeDescribe(char *Buf, size_t BufLen, const VOIMergeVO *VO)
+{
+	int Len = snprintf(Buf, BufLen, "%s %s VO", VoltageTypeName(VO->VO->VOType), VoltageModeName(VO->VO->VOMode));
+
+	if(VO->VO->VOMode == VOLTAGE_MODE_INIT_REGULATOR)
+		Len += snprintf(Buf + Len, BufLen - Len, " for I2C line %d, address 0x%02X", VO->VO->AsType3.I2CLine, VO->VO->AsType3.I2CAddress);
+
+	if(VO->Ordinal) snprintf(Buf + Len, BufLen - Len, " (#%d)", VO->Ordinal + 1);
+}
+
+static uint32_t VOIMergeRawValue(const void *Value, size_t Len)
+{
+	uint32_t Raw = 0;
+
+	memcpy(&Raw, Value, Len);
+	return(Raw);
+}
+
+// Out holds theirs, and is left holding it on a conflict.
+static void VOIMergeValue(void *Out, const void *Base, const void *Ours, const void *Theirs, size_t Len, const char *Name, VOIMergeCtx *Ctx)
+{
+	if(!memcmp(Ours, Base, Len) || !memcmp(Ours, Theirs, Len)) return;
+
+	if(!memcmp(Theirs, Base, Len))
+	{
+		memcpy(Out, Ours, Len);
+		return;
+	}
+
+	if(Len <= sizeof(uint32_t))
+		printf("Conflict in the %s: %s is 0x%X in the base ROM, 0x%X in ours and 0x%X in theirs.\n", Ctx->Where, Name,
+			VOIMergeRawValue(Base, Len), VOIMergeRawValue(Ours, Len), VOIMergeRawValue(Theirs, Len));
+	else printf("Conflict in the %s: its %s was changed in both ours and theirs, differently.\n", Ctx->Where, Name);
+
+	Ctx->ConflictCount++;
+}
+
+// Per-mode mode header merges, generated from the mode header fields
+// in voschema.h; reserved padding is kept as theirs has it.
+
+#define VOIMERGE_FIELD(CType, Name, JSONKey, TextFormat, TextArgs, RawValue) \
+	VOIMergeValue(&OutHdr->Name, &BaseHdr->Name, &OursHdr->Name, &TheirsHdr->Name, sizeof(CType), JSONKey, Ctx);
+#define VOIMERGE_SKIP_PAD(CType, Name, Count)
+
+#define VOIMERGE_MODE_HDR(Mode, Member, StructName, Fields, DataKind, DataFits) \
+static void VOIMergeHdr_##Mode(VoltageObject *Out, const VoltageObject *Base, const VoltageObject *Ours, const VoltageObject *Theirs, VOIMergeCtx *Ctx) \
+{ \
+	StructName *OutHdr = &Out->Member; \
+	const StructName *BaseHdr = &Base->Member, *OursHdr = &Ours->Member, *TheirsHdr = &Theirs->Member; \
+	Fields(VOIMERGE_FIELD, VOIMERGE_SKIP_PAD) \
+}
+
+VO_MODE_HDR_LIST(VOIMERGE_MODE_HDR)
+
+#define VOIMERGE_HDR_CASE(Mode, Member, StructName, Fields, DataKind, DataFits) \
+	case VOLTAGE_MODE_##Mode: VOIMergeHdr_##Mode(Out, Base, Ours, Theirs, Ctx); break;
+
+// A mode with no known header has its header merged whole.
+static void VOIMergeHdr(VoltageObject *Out, const VoltageObject *Base, const VoltageObject *Ours, const VoltageObject *Theirs, VOIMergeCtx *Ctx)
+{
+	const size_t HdrOffset = offsetof(VoltageObject, AsType0);
+
+	switch(Out->VOMode)
+	{
+		VO_MODE_HDR_LIST(VOIMERGE_HDR_CASE)
+		default:
+			VOIMergeValue(((uint8_t *)Out) + HdrOffset, ((const uint8_t *)Base) + HdrOffset, ((const uint8_t *)Ours) + HdrOffset,
+				((const uint8_t *)Theirs) + HdrOffset, sizeof(VoltageObject) - HdrOffset, "mode header", Ctx);
+	}
+}
+
+static bool VOIMergeDecode(const VOIMergeVO *VO, VOIMergeWrite **Out, uint32_t *Count, const char **Error)
+{
+	SMBusWrite *Writes;
+
+	if(!SMBusDecodeVO(VO->VO, VO->Data, VO->DataLen, &Writes, Count, Error)) return(false);
+
+	if(!(*Out = (VOIMergeWrite *)malloc(sizeof(VOIMergeWrite) * (*Count + 1))))
+	{
+		*Error = "out of memory";
+		free(Writes);
+		return(false);
+	}
+
+	for(uint32_t w = 0; w < *Count; ++w)
+	{
+		(*Out)[w].Reg = Writes[w].Reg;
+		(*Out)[w].Value = Writes[w].Value;
+		(*Out)[w].Ordinal = 0;
+
+		for(uint32_t p = 0; p < w; ++p)
+		{
+			if(Writes[p].Reg == Writes[w].Reg) (*Out)[w].Ordinal++;
+		}
+	}
+
+	free(Writes);
+	return(true);
+}
+
+static int32_t VOIMergeFindWrite(const VOIMergeWrite *Writes, uint32_t Count, const VOIMergeWrite *Write)
+{
+	for(uint32_t w = 0; w < Count; ++w)
+	{
+		if((Writes[w].Reg == Write->Reg) && (Writes[w].Ordinal == Write->Ordinal)) return(w);
+	}
+
+	return(-1);
+}
+
+// Merges the write lists of an INIT_REGULATOR VO that both sides
+// changed, register by register, into a new list in OutData. The
+// merged writes are in theirs' order, with those only ours added
+// placed after the write they follow in ours. Whatever follows the
+// terminator in theirs is kept. Returns false if the lists cannot be
+// merged at all, which is a conflict.
+static bool VOIMergeWrites(const VOIMergeVO *Base, const VOIMergeVO *Ours, const VOIMergeVO *Theirs, uint8_t **OutData, uint32_t *OutLen, VOIMergeCtx *Ctx)
+{
+	VOIMergeWrite *BaseW = NULL, *OursW = NULL, *TheirsW = NULL, *Out = NULL;
+	uint32_t BaseCount, OursCount, TheirsCount, OutCount = 0, TailLen;
+	const char *Error = NULL;
+	bool Ret = false;
+
+	*OutData = NULL;
+
+	if(!VOIMergeDecode(Base, &BaseW, &BaseCount, &Error) || !VOIMergeDecode(Ours, &OursW, &OursCount, &Error) || !VOIMergeDecode(Theirs, &TheirsW, &TheirsCount, &Error))
+	{
+		printf("Conflict in the %s: its data was changed in both ours and theirs, and cannot be merged register by register (%s).\n", Ctx->Where, Error);
+		Ctx->ConflictCount++;
+		goto out;
+	}
+
+	if(!(Out = (VOIMergeWrite *)malloc(sizeof(VOIMergeWrite) * (TheirsCount + OursCount + 1))))
+	{
+		printf("Out of memory.\n");
+		Ctx->ConflictCount++;
+		goto out;
+	}
+
+	for(uint32_t t = 0; t < TheirsCount; ++t)
+	{
+		int32_t b = VOIMergeFindWrite(BaseW, BaseCount, TheirsW + t);
+		int32_t o = VOIMergeFindWrite(OursW, OursCount, TheirsW + t);
+
+		Out[OutCount] = TheirsW[t];
+
+		if((b >= 0) && (o >= 0))
+		{
+			if((OursW[o].Value != BaseW[b].Value) && (TheirsW[t].Value == BaseW[b].Value)) Out[OutCount].Value = OursW[o].Value;
+			else if((OursW[o].Value != BaseW[b].Value) && (OursW[o].Value != TheirsW[t].Value))
+			{
+				printf("Conflict in the %s: register 0x%02X is written 0x%X in the base ROM, 0x%X in ours and 0x%X in theirs.\n",
+					Ctx->Where, TheirsW[t].Reg, BaseW[b].Value, OursW[o].Value, TheirsW[t].Value);
+				Ctx->ConflictCount++;
+			}
+		}
+		else if(b >= 0)
+		{
+			// Removed in ours.
+			if(TheirsW[t].Value == BaseW[b].Value) continue;
+
+			printf("Conflict in the %s: the write to register 0x%02X was removed in ours, but changed in theirs.\n", Ctx->Where, TheirsW[t].Reg);
+			Ctx->ConflictCount++;
+		}
+		else if((o >= 0) && (OursW[o].Value != TheirsW[t].Value))
+		{
+			printf("Conflict in the %s: register 0x%02X was added as 0x%X in ours, and as 0x%X in theirs.\n", Ctx->Where, TheirsW[t].Reg, OursW[o].Value, TheirsW[t].Value);
+			Ctx->ConflictCount++;
+		}
+
+		OutCount++;
+	}
+
+	for(uint32_t b = 0; b < BaseCount; ++b)
+	{
+		int32_t o = VOIMergeFindWrite(OursW, OursCount, BaseW + b);
+
+		if((VOIMergeFindWrite(TheirsW, TheirsCount, BaseW + b) < 0) && (o >= 0) && (OursW[o].Value != BaseW[b].Value))
+		{
+			printf("Conflict in the %s: the write to register 0x%02X was removed in theirs, but changed in ours.\n", Ctx->Where, BaseW[b].Reg);
+			Ctx->ConflictCount++;
+		}
+	}
+
+	for(uint32_t o = 0; o < OursCount; ++o)
+	{
+		uint32_t Pos = 0;
+
+		if((VOIMergeFindWrite(BaseW, BaseCount, OursW + o) >= 0) || (VOIMergeFindWrite(TheirsW, TheirsCount, OursW + o) >= 0)) continue;
+
+		for(int32_t p = o - 1; p >= 0; --p)
+		{
+			int32_t Prev = VOIMergeFindWrite(Out, OutCount, OursW + p);
+
+			if(Prev >= 0)
+			{
+				Pos = Prev + 1;
+				break;
+			}
+		}
+
+		memmove(Out + Pos + 1, Out + Pos, sizeof(VOIMergeWrite) * (OutCount - Pos));
+		Out[Pos] = OursW[o];
+		OutCount++;
+	}
+
+	// Every write takes four bytes, and the terminator two.
+	TailLen = Theirs->DataLen - ((TheirsCount << 2) + sizeof(uint16_t));
+	*OutLen = (OutCount << 2) + sizeof(uint16_t) + TailLen;
+
+	if(!(*OutData = (uint8_t *)malloc(*OutLen)))
+	{
+		printf("Out of memory.\n");
+		Ctx->ConflictCount++;
+		goto out;
+	}
+
+	for(uint32_t w = 0; w < OutCount; ++w)
+	{
+		uint16_t Reg = Out[w].Reg;
+
+		memcpy(*OutData + (w << 2), &Reg, sizeof(uint16_t));
+		memcpy(*OutData + (w << 2) + sizeof(uint16_t), &Out[w].Value, sizeof(uint16_t));
+	}
+
+	(*OutData)[OutCount << 2] = 0xFF;
+	(*OutData)[(OutCount << 2) + 1] = 0x00;
+	memcpy(*OutData + (OutCount << 2) + sizeof(uint16_t), Theirs->Data + Theirs->DataLen - TailLen, TailLen);
+
+	Ret = true;
+
+out:
+	free(BaseW);
+	free(OursW);
+	free(TheirsW);
+	free(Out);
+	return(Ret);
+}
+
+// Merges a VO all three ROMs have. If the result differs from
+// theirs, Edit is filled in to make it, and true returned.
+static bool VOIMergeVOs(VOEdit *Edit, const VOIMergeVO *Base, const VOIMergeVO *Ours, const VOIMergeVO *Theirs, VOIMergeCtx *Ctx)
+{
+	VoltageObject Out = *Theirs->VO;
+	const VOIMergeVO *DataFrom = Theirs;
+	uint8_t *Data = NULL;
+	uint32_t DataLen;
+	bool RegMerged = false;
+
+	if(VOIMergeSame(Ours, Base) || VOIMergeSame(Ours, Theirs)) return(false);
+
+	// A VO too short for a mode header (see VO_HEADER_SIZE) has no
+	// fields to merge, and is not one the editor can change anyway.
+	if((Base->VO->VOSize < sizeof(VoltageObject)) || (Ours->VO->VOSize < sizeof(VoltageObject)) || (Theirs->VO->VOSize < sizeof(VoltageObject)))
+	{
+		if(VOIMergeSame(Theirs, Base)) printf("The %s needs changing, but only INIT_REGULATOR VOs can be.\n", Ctx->Where);
+		else printf("Conflict in the %s: it was changed in both ours and theirs, differently.\n", Ctx->Where);
+
+		Ctx->ConflictCount++;
+		return(false);
+	}
+
+	VOIMergeHdr(&Out, Base->VO, Ours->VO, Theirs->VO, Ctx);
+
+	if(VOIMergeSameData(Theirs, Base) || VOIMergeSameData(Ours, Theirs)) DataFrom = Ours;
+	else if(!VOIMergeSameData(Ours, Base))
+	{
+		if(Out.VOMode == VOLTAGE_MODE_INIT_REGULATOR)
+		{
+			if(!VOIMergeWrites(Base, Ours, Theirs, &Data, &DataLen, Ctx)) return(false);
+			RegMerged = true;
+		}
+		else
+		{
+			printf("Conflict in the %s: its data was changed in both ours and theirs, differently.\n", Ctx->Where);
+			Ctx->ConflictCount++;
+			return(false);
+		}
+	}
+
+	if(!Data)
+	{
+		DataLen = DataFrom->DataLen;
+
+		if(DataLen && !(Data = (uint8_t *)malloc(DataLen)))
+		{
+			printf("Out of memory.\n");
+			Ctx->ConflictCount++;
+			return(false);
+		}
+
+		memcpy(Data, DataFrom->Data, DataLen);
+	}
+
+	Out.VOSize = sizeof(VoltageObject) + DataLen;
+
+	if(!memcmp(&Out, Theirs->VO, sizeof(VoltageObject)) && (DataLen == Theirs->DataLen) && !memcmp(Data, Theirs->Data, DataLen))
+	{
+		free(Data);
+		return(false);
+	}
+
+	memset(Edit, 0x00, sizeof(VOEdit));
+	Edit->Index = Theirs->Index;
+	Edit->SetMask = VOEDIT_SET_HDR | VOEDIT_SET_DATA;
+	Edit->Hdr = Out;
+	Edit->Data = Data;
+	Edit->DataLen = DataLen;
+
+	if(RegMerged) Ctx->RegMergeCount++;
+	return(true);
+}
+
+// Only INIT_REGULATOR VOs can be serialized, so only they can be
+// changed or added; anything else the merge needs is reported.
+static bool VOIMergeCanEdit(const VOEdit *Edit, uint32_t EditCount, VOIMergeCtx *Ctx)
+{
+	if(Edit->Hdr.VOMode != VOLTAGE_MODE_INIT_REGULATOR)
+	{
+		printf("The %s needs changing, but only INIT_REGULATOR VOs can be.\n", Ctx->Where);
+		Ctx->ConflictCount++;
+		return(false);
+	}
+
+	if(EditCount == VBIOS_PLAN_MAX_EDITS)
+	{
+		printf("The merge changes more than %d VOs, starting with the %s.\n", VBIOS_PLAN_MAX_EDITS, Ctx->Where);
+		Ctx->ConflictCount++;
+		return(false);
+	}
+
+	return(true);
+}
+
+// Merges the changes from BaseName to OursName into TheirsName, and
+// writes the result to OutName, if there were no conflicts.
+bool VOIMerge3(const char *BaseName, const char *OursName, const char *TheirsName, const char *OutName, uint8_t Strategy)
+{
+	VOIMergeROM ROMs[3] = { { .Name = BaseName }, { .Name = OursName }, { .Name = TheirsName } };
+	VOIMergeROM *Base = ROMs, *Ours = ROMs + 1, *Theirs = ROMs + 2;
+	VOEdit Edits[VBIOS_PLAN_MAX_EDITS];
+	uint32_t EditCount = 0, ChangeCount = 0;
+	char Where[128];
+	VOIMergeCtx Ctx = { Where, 0, 0 };
+	VBIOSPlan *Plan = NULL;
+	bool Ret = false;
+
+	for(int r = 0; r < 3; ++r)
+	{
+		if(!VOIMergeLoad(ROMs + r)) goto out;
+	}
+
+	for(uint32_t t = 0; t < Theirs->Count; ++t)
+	{
+		VOIMergeVO *TheirsVO = Theirs->VOs + t;
+		VOIMergeVO *BaseVO = VOIMergeFind(Base, TheirsVO), *OursVO = VOIMergeFind(Ours, TheirsVO);
+
+		VOIMergeDescribe(Where, sizeof(Where), TheirsVO);
+
+		if(BaseVO && OursVO)
+		{
+			if(!VOIMergeVOs(Edits + EditCount, BaseVO, OursVO, TheirsVO, &Ctx)) continue;
+
+			if(VOIMergeCanEdit(Edits + EditCount, EditCount, &Ctx)) EditCount++;
+			else FreeVOEdit(Edits + EditCount);
+		}
+		else if(BaseVO)
+		{
+			if(VOIMergeSame(TheirsVO, BaseVO)) printf("The %s was removed in ours, but a merge cannot remove VOs.\n", Where);
+			else printf("Conflict in the %s: it was removed in ours, but changed in theirs.\n", Where);
+
+			Ctx.ConflictCount++;
+		}
+		else if(OursVO && !VOIMergeSame(OursVO, TheirsVO))
+		{
+			printf("Conflict in the %s: it was added in both ours and theirs, differently.\n", Where);
+			Ctx.ConflictCount++;
+		}
+	}
+
+	ChangeCount = EditCount;
+
+	for(uint32_t b = 0; b < Base->Count; ++b)
+	{
+		VOIMergeVO *OursVO = VOIMergeFind(Ours, Base->VOs + b);
+
+		if(!VOIMergeFind(Theirs, Base->VOs + b) && OursVO && !VOIMergeSame(OursVO, Base->VOs + b))
+		{
+			VOIMergeDescribe(Where, sizeof(Where), Base->VOs + b);
+			printf("Conflict in the %s: it was removed in theirs, but changed in ours.\n", Where);
+			Ctx.ConflictCount++;
+		}
+	}
+
+	// VOs only ours added go at the end of theirs, in ours' order.
+	for(uint32_t o = 0; o < Ours->Count; ++o)
+	{
+		VOIMergeVO *OursVO = Ours->VOs + o;
+
+		if(VOIMergeFind(Base, OursVO) || VOIMergeFind(Theirs, OursVO)) continue;
+
+		VOIMergeDescribe(Where, sizeof(Where), OursVO);
+
+		memset(Edits + EditCount, 0x00, sizeof(VOEdit));
+		Edits[EditCount].Index = VOEDIT_APPEND;
+		Edits[EditCount].SetMask = VOEDIT_SET_HDR | VOEDIT_SET_DATA;
+		Edits[EditCount].Hdr = *OursVO->VO;
+
+		if(!VOIMergeCanEdit(Edits + EditCount, EditCount, &Ctx)) continue;
+
+		if(OursVO->DataLen && !(Edits[EditCount].Data = (uint8_t *)malloc(OursVO->DataLen)))
+		{
+			printf("Out of memory.\n");
+			goto out;
+		}
+
+		memcpy(Edits[EditCount].Data, OursVO->Data, OursVO->DataLen);
+		Edits[EditCount++].DataLen = OursVO->DataLen;
+	}
+
+	if(Ctx.ConflictCount)
+	{
+		printf("%u conflicts merging %s into %s; nothing was written.\n", Ctx.ConflictCount, OursName, TheirsName);
+		goto out;
+	}
+
+	if(EditCount)
+	{
+		if(!(Plan = (VBIOSPlan *)malloc(sizeof(VBIOSPlan))))
+		{
+			printf("Out of memory.\n");
+			goto out;
+		}
+
+		if(!VBIOSPlanEdits(Plan, &Theirs->Info, Edits, EditCount, Strategy))
+		{
+			printf("The merge cannot be made in %s: %s.\n", TheirsName, Plan->Error);
+			goto out;
+		}
+
+		if(!VBIOSApplyVOEdits(&Theirs->Info, Edits, EditCount, Strategy)) goto out;
+	}
+
+	if(!WriteVBIOSFile(OutName, Theirs->Image, Theirs->Info.Size)) goto out;
+
+	printf("Merged %s into %s as %s: %u VOs changed (%u register by register) and %u added.\n", OursName, TheirsName, OutName, ChangeCount, Ctx.RegMergeCount, EditCount - ChangeCount);
+	Ret = true;
+
+out:
+	for(uint32_t i = 0; i < EditCount; ++i) FreeVOEdit(Edits + i);
+
+	for(int r = 0; r < 3; ++r)
+	{
+		free(ROMs[r].Image);
+		free(ROMs[r].VOs);
+	}
+
+	free(Plan);
+	return(Ret);
+}
@@ -0,0 +1,28 @@
+// Copyright 2022 Wolf9466/Wolf0/OhGodAPet
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// A three-way merge of VOI tables, for carrying customizations made
+// to one stock ROM (base -> ours) over to the vendor's next stock ROM
+// (theirs), as a version control system merges text.
+//
+// VOs are aligned by what they are, not where they sit: their type
+// and mode, and for INIT_REGULATOR VOs the I2C line and address of
+// the device they program, with VOs alike in all of those matched in
+// table order. Matched VOs are merged field by field, using the mode
+// header fields in voschema.h, and the write lists of INIT_REGULATOR
+// VOs register by register, again matched by register and order.
+// A field or register is only a conflict when ours and theirs both
+// changed it, differently; VOs and registers added on one side are
+// kept, and removed on one side are dropped, unless the other side
+// changed them.
+//
+// The result is made on a copy of theirs through the relocation
+// engine, as edits by the editor are, so only INIT_REGULATOR VOs can
+// be changed or added; a merge that needs anything else changed, or
+// a VO removed, is reported, as a conflict is, and nothing written.
+
+bool VOIMerge3(const char *BaseName, const char *OursName, const char *TheirsName, const char *OutName, uint8_t Strategy);
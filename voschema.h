@@ -0,0 +1,118 @@
+// Copyright 2022 Wolf9466/Wolf0/OhGodAPet
+
+#pragma once
+
+// The single description of every voltage type, voltage mode and
+// mode header this tool knows about. Everything else - the type and
+// mode constants, the mode header structs, the name lookups, and the
+// per-mode text, JSON, encode and validate functions in voi.c - is
+// generated from the lists below, so adding a mode means adding one
+// entry to VO_MODE_LIST, and (if it has a header) one to
+// VO_MODE_HDR_LIST along with its field list.
+
+// Known voltage types
+// X(Name, Value, DisplayName)
+#define VO_TYPE_LIST(X) \
+	X(VDDC,						0x01,	"VDDC") \
+	X(MVDDC,					0x02,	"MVDDC") \
+	X(MVDDQ,					0x03,	"MVDDQ") \
+	X(VDDCI,					0x04,	"VDDCI") \
+	X(VDDGFX,					0x05,	"VDDGFX") \
+	X(PCC,						0x06,	"PCC") \
+	X(MVPP,						0x07,	"MVPP") \
+	X(LEDDPM,					0x08,	"LEDDPM") \
+	X(PCC_MVDD,					0x09,	"PCC_MVDD") \
+	X(PCIE_VDDC,				0x0A,	"PCIE_VDDC") \
+	X(PCIE_VDDR,				0x0B,	"PCIE_VDDR") \
+	X(GENERIC_I2C_1,			0x11,	"VOLTAGE_TYPE_GENERIC_I2C_1") \
+	X(GENERIC_I2C_2,			0x12,	"VOLTAGE_TYPE_GENERIC_I2C_2") \
+	X(GENERIC_I2C_3,			0x13,	"VOLTAGE_TYPE_GENERIC_I2C_3") \
+	X(GENERIC_I2C_4,			0x14,	"VOLTAGE_TYPE_GENERIC_I2C_4") \
+	X(GENERIC_I2C_5,			0x15,	"VOLTAGE_TYPE_GENERIC_I2C_5") \
+	X(GENERIC_I2C_6,			0x16,	"VOLTAGE_TYPE_GENERIC_I2C_6") \
+	X(GENERIC_I2C_7,			0x17,	"VOLTAGE_TYPE_GENERIC_I2C_7") \
+	X(GENERIC_I2C_8,			0x18,	"VOLTAGE_TYPE_GENERIC_I2C_8") \
+	X(GENERIC_I2C_9,			0x19,	"VOLTAGE_TYPE_GENERIC_I2C_9") \
+	X(GENERIC_I2C_10,			0x1A,	"VOLTAGE_TYPE_GENERIC_I2C_10")
+
+// Known voltage modes
+// X(Name, Value, DisplayName)
+#define VO_MODE_LIST(X) \
+	X(GPIO_LUT,					0x00,	"GPIO_LUT") \
+	X(INIT_REGULATOR,			0x03,	"INIT_REGULATOR") \
+	X(VOLTAGE_PHASE,			0x04,	"VOLTAGE_PHASE") \
+	X(SVID2,					0x07,	"SVID2") \
+	X(EVV,						0x08,	"EVV") \
+	X(PWRBOOST_LEAKAGE_LUT,		0x10,	"PWRBOOST_LEAKAGE_LUT") \
+	X(HIGH_STATE_LEAKAGE_LUT,	0x11,	"HIGH_STATE_LEAKAGE_LUT") \
+	X(HIGH1_STATE_LEAKAGE_LUT,	0x12,	"HIGH1_STATE_LEAKAGE_LUT")
+
+// Modes with a known mode header. Every mode header is eight bytes,
+// following the four-byte VO header; the data follows the mode header.
+// M(Mode, UnionMember, StructName, FieldList, DataKind, DataFits)
+//
+// DataKind is HEX (the data is dumped as hex) or NONE (it is not.)
+// DataFits is the name of a macro telling, from the mode header and
+// the length of the data, whether a VO of this mode carries all of
+// the data its header says it does.
+#define VO_MODE_HDR_LIST(M) \
+	M(GPIO_LUT,			AsType0,	VOModeGPIOLUT,			VO_GPIO_LUT_FIELDS,			NONE,	VO_GPIO_LUT_DATA_FITS) \
+	M(INIT_REGULATOR,	AsType3,	VOModeInitRegulator,	VO_INIT_REGULATOR_FIELDS,	HEX,	VO_ANY_DATA_FITS) \
+	M(SVID2,			AsType7,	VOModeSVID2,			VO_SVID2_FIELDS,			NONE,	VO_ANY_DATA_FITS)
+
+// Mode header fields, in order. F is a field, P is reserved padding.
+// F(CType, Name, JSONKey, TextFormat, TextArgs, RawValue)
+// P(CType, Name, Count)
+//
+// TextFormat is the printf format for the field in the text dump,
+// and TextArgs the name of a macro turning the field into its
+// arguments. RawValue does the same for the integer used in JSON.
+
+#define VO_ARG(v)					(v)
+#define VO_ARG_ENTRY_BITS(v)		((v) ? 16 : 8)
+#define VO_ARG_LLPSI(v)				(v).Value, (v).Info.OffsetTrim, (v).Info.LoadLineSlopeTrim, (v).Info.PSI1, (v).Info.PSI0_EN, (v).Info.PSI0_VID
+#define VO_RAW(v)					(v)
+#define VO_RAW_LLPSI(v)				((v).Value)
+
+#define VO_ANY_DATA_FITS(Hdr, DataLen)			true
+#define VO_GPIO_LUT_DATA_FITS(Hdr, DataLen)		((DataLen) >= ((Hdr)->GPIOEntryNum * sizeof(VOGPIOLUTEntry)))
+
+#define VO_GPIO_LUT_FIELDS(F, P) \
+	F(uint8_t,		VoltageGPIOCntlID,	"gpio_cntl_id",		"\tVoltage GPIO Control ID: 0x%02X\n",	VO_ARG,	VO_RAW) \
+	F(uint8_t,		GPIOEntryNum,		"gpio_entry_num",	"\tGPIO Entry Number: 0x%02X\n",		VO_ARG,	VO_RAW) \
+	F(uint8_t,		PhaseDelay,			"phase_delay",		"\tPhase Delay: 0x%02X\n",				VO_ARG,	VO_RAW) \
+	P(uint8_t,		Reserved,			1) \
+	F(uint32_t,		GPIOMaskValue,		"gpio_mask",		"\tGPIO Mask Value: 0x%08X\n",			VO_ARG,	VO_RAW)
+
+// My personal favorite VO mode is INIT_REGULATOR.
+// It sends arbitrary data over I2C to a slave device on the
+// bus. Its intention is to be used to configure the registers
+// of a VRM controller residing on one of the GPU I2C busses.
+// Keep in mind, however, that the I2C device in question
+// need not be a VRM controller at all - this should work
+// with any I2C device. It consists of an eight-byte header,
+// followed by a variable number of address/value pairs,
+// where address is the register number, and value is the
+// value to write to it.
+ 
+// Its header begins with a regulator ID (I believe 0xFF is
+// "any regulator"), followed by the I2C line that the device
+// resides on, then the address of the slave device, then a
+// field named "ControlOffset" which I have no idea what it
+// is for, and VoltageControlFlag, which specifies the I2C
+// write format used. The value zero is most common, meaning
+// that a SMBus write byte command is used. If nonzero, it
+// MAY instead uses an SMBus write word command. TODO: Confirm.
+#define VO_INIT_REGULATOR_FIELDS(F, P) \
+	F(uint8_t,		RegulatorID,		"regulator_id",		"\tRegulatorID = %d\n",					VO_ARG,				VO_RAW) \
+	F(uint8_t,		I2CLine,			"i2c_line",			"\tI2CLine = %d\n",						VO_ARG,				VO_RAW) \
+	F(uint8_t,		I2CAddress,			"i2c_address",		"\tI2CAddress = %d\n",					VO_ARG,				VO_RAW) \
+	F(uint8_t,		ControlOffset,		"control_offset",	"\tControlOffset = %d\n",				VO_ARG,				VO_RAW) \
+	F(uint8_t,		VoltageControlFlag,	"control_flag",		"\tVoltage entries are %d-bit.\n",		VO_ARG_ENTRY_BITS,	VO_RAW) \
+	P(uint8_t,		Reserved,			3)
+
+#define VO_SVID2_FIELDS(F, P) \
+	F(VOLoadLinePSI,	LoadLinePSI,	"loadline_psi",		"\tLoadLinePSI = 0x%04X\n\t\tOffsetTrim = %d\n\t\tLoadLineSlopeTrim = %d\n\t\tPSI1: %d\n\t\tPSI0_EN: %d\n\t\tPSI0_VID: %d\n",	VO_ARG_LLPSI,	VO_RAW_LLPSI) \
+	F(uint8_t,		SVDGPIOID,			"svd_gpio_id",		"\tSVD GPIO ID: %d\n",					VO_ARG,				VO_RAW) \
+	F(uint8_t,		SVCGPIOID,			"svc_gpio_id",		"\tSVC GPIO ID: %d\n",					VO_ARG,				VO_RAW) \
+	P(uint32_t,		Reserved,			1)
@@ -0,0 +1,166 @@
+#include <stdio.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/inotify.h>
+
+#include "wolfvoitool.h"
+#include "watch.h"
+
+#define ROMWATCH_EVENTS			(IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF)
+
+bool ROMWatchInit(ROMWatch *Watch, const char *Dir)
+{
+	memset(Watch, 0x00, sizeof(ROMWatch));
+	
+	Watch->Fd = inotify_init1(IN_CLOEXEC);
+	
+	if(Watch->Fd < 0)
+	{
+		printf("Unable to set up inotify (%s).\n", strerror(errno));
+		return(false);
+	}
+	
+	if(inotify_add_watch(Watch->Fd, Dir, ROMWATCH_EVENTS | IN_ONLYDIR) < 0)
+	{
+		printf("Unable to watch %s (%s).\n", Dir, strerror(errno));
+		close(Watch->Fd);
+		return(false);
+	}
+	
+	if(!(Watch->Dir = strdup(Dir)))
+	{
+		printf("Out of memory.\n");
+		close(Watch->Fd);
+		return(false);
+	}
+	
+	return(true);
+}
+
+void ROMWatchFree(ROMWatch *Watch)
+{
+	for(uint32_t i = 0; i < Watch->OwnWriteCount; ++i) free(Watch->OwnWrites[i]);
+	
+	free(Watch->OwnWrites);
+	free(Watch->Dir);
+	close(Watch->Fd);
+}
+
+bool ROMWatchNoteWrite(ROMWatch *Watch, const char *Path)
+{
+	return(AddROMFile(&Watch->OwnWrites, &Watch->OwnWriteCount, Path));
+}
+
+// Returns true, and forgets the write, if Path was just rewritten
+// by the tool itself.
+static bool ROMWatchIsOwnWrite(ROMWatch *Watch, const char *Path)
+{
+	for(uint32_t i = 0; i < Watch->OwnWriteCount; ++i)
+	{
+		if(!strcmp(Watch->OwnWrites[i], Path))
+		{
+			free(Watch->OwnWrites[i]);
+			Watch->OwnWrites[i] = Watch->OwnWrites[--Watch->OwnWriteCount];
+			return(true);
+		}
+	}
+	
+	return(false);
+}
+
+// A ROM written twice before it is processed is only processed once.
+static bool ROMWatchAdd(ROMWatch *Watch, char ***ROMFiles, uint32_t *ROMFileCount, const char *Name)
+{
+	char Path[4096];
+	
+	if(Name[0] == '.') return(true);
+	
+	snprintf(Path, sizeof(Path), "%s/%s", Watch->Dir, Name);
+	
+	if(ROMWatchIsOwnWrite(Watch, Path)) return(true);
+	
+	for(uint32_t i = 0; i < *ROMFileCount; ++i)
+		if(!strcmp((*ROMFiles)[i], Path)) return(true);
+	
+	return(AddROMFile(ROMFiles, ROMFileCount, Path));
+}
+
+// When the kernel's event queue overflows, there is no telling
+// what was missed, so everything in the directory is picked up.
+static bool ROMWatchRescan(ROMWatch *Watch, char ***ROMFiles, uint32_t *ROMFileCount)
+{
+	DIR *Dir = opendir(Watch->Dir);
+	struct dirent *Ent;
+	bool Ok = true;
+	
+	printf("Events were lost; rescanning %s.\n", Watch->Dir);
+	
+	if(!Dir)
+	{
+		printf("Unable to open %s (%s).\n", Watch->Dir, strerror(errno));
+		return(false);
+	}
+	
+	while(Ok && (Ent = readdir(Dir)))
+	{
+		if((Ent->d_type == DT_REG) || (Ent->d_type == DT_UNKNOWN)) Ok = ROMWatchAdd(Watch, ROMFiles, ROMFileCount, Ent->d_name);
+	}
+	
+	closedir(Dir);
+	return(Ok);
+}
+
+// Blocks until at least one ROM has arrived, then returns every
+// ROM that has arrived so far as a list of paths, to be freed by
+// the caller. Returns false once the directory can no longer be
+// watched.
+bool ROMWatchWait(ROMWatch *Watch, char ***ROMFiles, uint32_t *ROMFileCount)
+{
+	uint8_t Buf[16384] __attribute__((aligned(__alignof__(struct inotify_event))));
+	struct pollfd PollFd = { .fd = Watch->Fd, .events = POLLIN };
+	
+	*ROMFiles = NULL;
+	*ROMFileCount = 0;
+	
+	do
+	{
+		ssize_t Len = read(Watch->Fd, Buf, sizeof(Buf));
+		bool Rescan = false;
+		
+		if(Len < 0)
+		{
+			if(errno == EINTR) continue;
+			
+			printf("Reading inotify events failed (%s).\n", strerror(errno));
+			return(false);
+		}
+		
+		for(ssize_t Pos = 0; Pos < Len; )
+		{
+			struct inotify_event *Event = (struct inotify_event *)(Buf + Pos);
+			
+			Pos += sizeof(struct inotify_event) + Event->len;
+			
+			if(Event->mask & IN_Q_OVERFLOW) Rescan = true;
+			else if(Event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED))
+			{
+				printf("%s is no longer being watched.\n", Watch->Dir);
+				return(false);
+			}
+			else if(Event->len && !ROMWatchAdd(Watch, ROMFiles, ROMFileCount, Event->name)) return(false);
+		}
+		
+		if(Rescan && !ROMWatchRescan(Watch, ROMFiles, ROMFileCount)) return(false);
+		
+		// Take whatever else has arrived in the meantime, so that a
+		// burst of ROMs is processed as one batch.
+	} while(!*ROMFileCount || (poll(&PollFd, 1, 0) > 0));
+	
+	return(true);
+}
@@ -0,0 +1,31 @@
+// Copyright 2022 Wolf9466/Wolf0/OhGodAPet
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Watches a spool directory for ROMs, using inotify, so that each
+// one is processed once as it arrives rather than by rescanning
+// everything on a timer. A ROM is picked up when a writer closes
+// it or when it is renamed into the directory, which covers both
+// writing in place and the usual write-then-rename drop. Hidden
+// files (those beginning with '.') are ignored, as such drops
+// commonly stage their temporary files under them.
+//
+// The tool's own atomic rewrites of a ROM would otherwise show up
+// as new arrivals; ROMWatchNoteWrite marks the next event for a
+// path as one to be skipped.
+
+typedef struct
+{
+	int Fd;
+	char *Dir;
+	char **OwnWrites;
+	uint32_t OwnWriteCount;
+} ROMWatch;
+
+bool ROMWatchInit(ROMWatch *Watch, const char *Dir);
+bool ROMWatchWait(ROMWatch *Watch, char ***ROMFiles, uint32_t *ROMFileCount);
+bool ROMWatchNoteWrite(ROMWatch *Watch, const char *Path);
+void ROMWatchFree(ROMWatch *Watch);
@@ -5,16 +5,40 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <unistd.h>
+#include <pthread.h>
 
 #include "vbios-tables.h"
 #include "wolfvoitool.h"
 #include "voi.h"
+#include "vbios.h"
+#include "filter.h"
+#include "export.h"
+#include "reloc.h"
+#include "journal.h"
+#include "plan.h"
+#include "archive.h"
+#include "patch.h"
+#include "romio.h"
+#include "watch.h"
+#include "smbus.h"
+#include "i2c.h"
+#include "stats.h"
+#include "queue.h"
+#include "shard.h"
+#include "sha256.h"
+#include "checkpoint.h"
+#include "freespace.h"
+#include "tarscan.h"
+#include "pcirom.h"
+#include "vomerge.h"
+#include "smbusopt.h"
 
 // Parameter len is bytes in rawstr, therefore, asciistr must have
 // at least (len << 1) + 1 bytes allocated, the last for the NULL
 void BinaryToASCIIHex(char *restrict asciistr, const void *restrict rawstr, size_t len)
 {
-	for(int i = 0, j = 0; i < len; ++i)
+	for(size_t i = 0, j = 0; i < len; ++i)
 	{
 		asciistr[j++] = "0123456789abcdef"[((uint8_t *)rawstr)[i] >> 4];
 		asciistr[j++] = "0123456789abcdef"[((uint8_t *)rawstr)[i] & 0x0F];
@@ -29,7 +53,7 @@ void BinaryToASCIIHex(char *restrict asciistr, const void *restrict rawstr, size
 // Returns length of rawstr in bytes
 int ASCIIHexToBinary(void *restrict rawstr, const char *restrict asciistr, size_t len)
 {
-	for(int i = 0, j = 0; i < len; ++i)
+	for(size_t i = 0, j = 0; i < len; ++i)
 	{
 		char tmp = asciistr[i];
 		if(tmp < 'A') tmp -= '0';
@@ -101,11 +125,147 @@ size_t WriteVBIOSFile(const char *FileName, void *VBIOSData, size_t VBIOSSize)
 
 void usage(char *self)
 {
-	printf("Usage: %s <-f | --file> [-e | --edit]\n", self);
+	printf("Usage: %s <-f | --file <rom>>... [-b | --batch <list>] [options]\n", self);
+	printf("\t-e | --edit\t\t\tEdit the INIT_REGULATOR VOs of a single ROM\n");
+	printf("\t-F | --filter <expr>\t\tOnly select VOs matching expr\n");
+	printf("\t-j | --json\t\t\tDump VOs as JSON lines\n");
+	printf("\t-x | --export <file>\t\tWrite all selected VOs to a columnar file\n");
+	printf("\t--export-format <native | arrow>\n");
+	printf("\t-p | --plan <edit>\t\tReport what an edit would do to each ROM, as JSON\n");
+	printf("\t--archive-create <file>\t\tStore the first ROM, and the rest as deltas of it\n");
+	printf("\t--archive-list <file>\t\tList the variants in an archive\n");
+	printf("\t--archive-extract <file>\tRebuild the variants in an archive\n");
+	printf("\t--variant <name>\t\tOnly extract the named variant\n");
+	printf("\t-o | --output-dir <dir>\t\tWhere to extract variants to\n");
+	printf("\t--patch-out <file>\t\tWrite the edits as a patch instead of to the ROM\n");
+	printf("\t--reloc <shift | move>\t\tMake room for a growing VOI table by shifting, or by moving it\n");
+	printf("\t--apply-patch <file>\t\tApply a patch to each ROM, in place\n");
+	printf("\t-S | --simulate\t\t\tReplay INIT_REGULATOR writes onto simulated devices\n");
+	printf("\t--sim-model <generic | pmbus>\tHow simulated devices take writes\n");
+	printf("\t--optimize\t\t\tReport the INIT_REGULATOR writes that can be dropped, and the bus time saved\n");
+	printf("\t--optimize-write\t\tDrop them, rewriting each ROM in place\n");
+	printf("\t--pci\t\t\t\tCapture the ROM of every GPU installed, through sysfs\n");
+	printf("\t--sysfs-root <dir>\t\tWhere sysfs is, for --pci (default /sys)\n");
+	printf("\t--free-space\t\t\tMap the free space in each ROM, and how far its VOs may grow\n");
+	printf("\t-s | --stats\t\t\tReport statistics over the VOs of every ROM\n");
+	printf("\t--stats-in <file>\t\tMerge in statistics saved by an earlier run\n");
+	printf("\t--stats-out <file>\t\tSave the statistics, to be merged later\n");
+	printf("\t--jobs <n>\t\t\tHow many threads gather statistics or decompress archives\n");
+	printf("\t--i2c-apply <edit>\t\tSend an edited VO's writes to the device, live\n");
+	printf("\t--i2c-bus <bus>\t\t\tThe bus to send them on: /dev/i2c-N, N or fake:<file>\n");
+	printf("\t--no-verify\t\t\tDo not read back the registers written\n");
+	printf("\t--shard <i/N>\t\t\tOnly process shard i of N of the ROMs given\n");
+	printf("\t-m | --merge <file>\t\tMerge the JSON or statistics output of shards\n");
+	printf("\t--merge3 <base> <ours> <theirs> <out>\n");
+	printf("\t\t\t\t\tCarry the VOI changes from base to ours over to theirs\n");
+	printf("\t--merge3-list <file>\t\tDo each merge listed, as base ours theirs out, one per line\n");
+	printf("\t--checkpoint <file>\t\tJournal finished ROMs, so a restarted run skips them\n");
+	printf("\t-q | --queue <manifest>\t\tClaim and process ROMs from a manifest shared by many workers\n");
+	printf("\t-w | --watch <dir>\t\tProcess ROMs as they arrive in dir\n");
+	printf("\t--io <auto | uring | threads>\tHow to read and write ROMs in bulk\n");
+	printf("\t--io-depth <n>\t\t\tHow many ROMs to keep in flight at once\n");
+	printf("\t--mem-budget <MB>\t\tCap the memory held for ROM images\n");
+	printf("Filter expressions select VOs by header fields, for example:\n");
+	printf("\t--filter 'type==VDDC && mode==INIT_REGULATOR && i2caddr==96'\n");
+	printf("Edits are <index | append>[,field=value...][:hex payload], for example:\n");
+	printf("\t--plan 'append,i2cline=150,i2caddr=0x10:8d10ff00'\n");
+	printf("A batch list file holds one ROM path per line.\n");
+	printf("ROMs may also be read, but not written, straight out of .tar, .tar.xz or .tar.zst archives.\n");
 	exit(1);
 }
 
-#define NEXT_ARG_CHECK(arg) do { if(i == (argc - 1)) { printf("Argument \"%s\" requires a parameter.\n", arg); if(VBIOSImg) free(VBIOSImg); return(-1); } } while(0)
+// Adds a ROM file name to the list of inputs. Names are always
+// copied, so that the list may be freed uniformly.
+bool AddROMFile(char ***ROMFiles, uint32_t *ROMFileCount, const char *FileName)
+{
+	char **NewList = (char **)realloc(*ROMFiles, sizeof(char *) * (*ROMFileCount + 1));
+	
+	if(!NewList) return(false);
+	
+	*ROMFiles = NewList;
+	
+	if(!(NewList[*ROMFileCount] = strdup(FileName))) return(false);
+	
+	(*ROMFileCount)++;
+	return(true);
+}
+
+// Reads a batch list - one ROM path per line, with blank lines and
+// lines beginning with '#' ignored. A list name of "-" is stdin.
+bool ReadROMList(char ***ROMFiles, uint32_t *ROMFileCount, const char *ListFileName)
+{
+	FILE *ListFile = (strcmp(ListFileName, "-") ? fopen(ListFileName, "r") : stdin);
+	char *Line = NULL;
+	size_t LineCap = 0;
+	ssize_t LineLen;
+	bool Ok = true;
+	
+	if(!ListFile)
+	{
+		printf("Unable to open %s (does it exist?)\n", ListFileName);
+		return(false);
+	}
+	
+	while(Ok && ((LineLen = getline(&Line, &LineCap, ListFile)) >= 0))
+	{
+		while(LineLen && ((Line[LineLen - 1] == '\n') || (Line[LineLen - 1] == '\r'))) Line[--LineLen] = 0x00;
+		
+		if(!LineLen || (Line[0] == '#')) continue;
+		
+		Ok = AddROMFile(ROMFiles, ROMFileCount, Line);
+	}
+	
+	free(Line);
+	if(ListFile != stdin) fclose(ListFile);
+	
+	return(Ok);
+}
+
+// Reads a merge list - one merge per line, as the four ROM paths
+// --merge3 takes, separated by spaces or tabs, with blank lines and
+// lines beginning with '#' ignored. A list name of "-" is stdin.
+bool ReadMergeList(char ***MergeNames, uint32_t *MergeNameCount, const char *ListFileName)
+{
+	FILE *ListFile = (strcmp(ListFileName, "-") ? fopen(ListFileName, "r") : stdin);
+	char *Line = NULL;
+	size_t LineCap = 0;
+	uint32_t LineNum = 0;
+	bool Ok = true;
+	
+	if(!ListFile)
+	{
+		printf("Unable to open %s (does it exist?)\n", ListFileName);
+		return(false);
+	}
+	
+	while(Ok && (getline(&Line, &LineCap, ListFile) >= 0))
+	{
+		char *Names[4], *Extra, *SavePtr;
+		
+		LineNum++;
+		
+		if(!(Names[0] = strtok_r(Line, " \t\r\n", &SavePtr)) || (Names[0][0] == '#')) continue;
+		
+		for(int n = 1; n < 4; ++n) Names[n] = strtok_r(NULL, " \t\r\n", &SavePtr);
+		Extra = strtok_r(NULL, " \t\r\n", &SavePtr);
+		
+		if(!Names[3] || Extra)
+		{
+			printf("Line %u of %s is not a merge; expected base, ours, theirs and out.\n", LineNum, ListFileName);
+			Ok = false;
+			break;
+		}
+		
+		for(int n = 0; Ok && (n < 4); ++n) Ok = AddROMFile(MergeNames, MergeNameCount, Names[n]);
+	}
+	
+	free(Line);
+	if(ListFile != stdin) fclose(ListFile);
+	
+	return(Ok);
+}
+
+#define NEXT_ARG_CHECK(arg) do { if(i == (argc - 1)) { printf("Argument \"%s\" requires a parameter.\n", arg); return(-1); } } while(0)
 
 #define WOLFVOITOOL_MAX_EDTIOR_INPUT_LEN			128
 
@@ -118,10 +278,6 @@ void EditorPrepInput(char *Input)
 }
 
 
-#define VBIOS_GET_PADDING_END(Image)		((uint32_t)((((uint8_t *)(Image))[0x02])) * 512UL)
-#define VBIOS_OFFSET(Image, OffsetValue)	(((uint8_t *)Image) + (OffsetValue))
-#define VBIOS_GET_ROM_HDR_OFFSET(Image)		(*((uint16_t *)(VBIOS_OFFSET((Image), OFFSET_TO_POINTER_TO_ATOM_ROM_HEADER))))
-
 
 int32_t PromptForVOEntry(VOListNode *DefaultTemplate)
 {
@@ -331,80 +487,65 @@ int32_t PromptForVOEntry(VOListNode *DefaultTemplate)
 	return(0);
 }
 
-// Beginning at the padding (UEFI image start minus the modification size),
-// copy all bytes up by ModLength bytes, creating empty space at the
-// offset specified by ModificationOffset that is ModLength bytes in size.
-// Does NOT fix ANY length/size entries!
-void PrepareROMForInsertionMod(void *VBIOSImage, size_t PadOffset, size_t ModificationOffset, int32_t ModLength)
-{
-	uint8_t *ModPosition = ((uint8_t *)VBIOSImage) + ModificationOffset;
-	
-	memmove(ModPosition + ModLength, ModPosition, PadOffset - ModificationOffset);
-}
+#if 1
 
-// Detects the amount of useless filler bytes at the end of the legacy
-// ROM image. 
-uint32_t VBIOSGetPaddingLength(void *VBIOSImage)
+// Since an edit moves every VO after it, the VO pointers in the list
+// are stale afterward - rebuild it from the (modified) image.
+void EditorRefreshVOList(VBIOSInfo *Info, VOListNode **NodeList, const VOFilter *Filter)
 {
-	uint32_t PaddingLen = 0;
-	
-	// Find the UEFI VBIOS image, then walk backward until you
-	// find a byte that is not 0xFF Remember the EndOffset would
-	// point to the first byte of the UEFI image if we didn't
-	// subtract one.
-	for(uint32_t EndOffset = (((uint8_t *)VBIOSImage)[0x03] << 9) - 1; ((uint8_t *)VBIOSImage)[EndOffset - PaddingLen] == 0xFF; PaddingLen++);
-
-	return(PaddingLen);
+	FreeVOList(*NodeList);
+	CreateVOList(NodeList, Info->Image + Info->VOITblOffset, VOLTAGE_MODE_INIT_REGULATOR, Filter);
 }
 
-
-void FixTableOffsets(void *VBIOSImage, ATOM_ROM_HEADER *VBIOSROMHdr, uint32_t ChangeStartOffset, int32_t ChangeSize)
+// With the move strategy, the VOI table may be moved into the
+// padding before a VO grows by Growth bytes, which is journaled
+// as an edit of its own. Offset, if given, is an offset into the
+// VOI table, and is updated to match.
+bool EditorPrepareGrowth(VBIOSInfo *Info, uint8_t Strategy, int32_t Growth, VBIOSJournal *Journal, uint32_t *Offset)
 {
-	uint16_t *VBIOSTableEntry;
-	uint32_t DataTableSize, CommandTableSize;
-	ATOM_MASTER_DATA_TABLE *MasterDataTable = (ATOM_MASTER_DATA_TABLE *)(VBIOS_OFFSET(VBIOSImage, VBIOSROMHdr->usMasterDataTableOffset));
-	ATOM_MASTER_COMMAND_TABLE *MasterCommandTable = (ATOM_MASTER_COMMAND_TABLE *)(VBIOS_OFFSET(VBIOSImage, VBIOSROMHdr->usMasterCommandTableOffset));
-
-	// Since every entry is two bytes, size divided by 2 is all entries
-	DataTableSize = MasterDataTable->sHeader.usStructureSize;
-	CommandTableSize = MasterCommandTable->sHeader.usStructureSize;
-
-	VBIOSTableEntry = (uint16_t *)(&MasterDataTable->ListOfDataTables);
-	for(int i = 0; i < (DataTableSize >> 1); ++i) VBIOSTableEntry[i] += ((VBIOSTableEntry[i] > ChangeStartOffset) ?  ChangeSize : 0);
-
-	VBIOSTableEntry = (uint16_t *)(&MasterCommandTable->ListOfCommandTables);
-	for(int i = 0; i < (CommandTableSize >> 1); ++i) VBIOSTableEntry[i] += ((VBIOSTableEntry[i] > ChangeStartOffset) ?  ChangeSize : 0);
+	const uint32_t OldVOIOffset = Info->VOITblOffset;
+	VBIOSDelta Delta;
+	bool Moved;
+	
+	if(Growth <= 0) return(true);
+	
+	if(!VBIOSPrepareVOIGrowth(Info, Strategy, Info->VOIHdr->usStructureSize + Growth, &Delta, &Moved)) return(false);
+	
+	if(Moved)
+	{
+		JournalRecord(Journal, &Delta);
+		if(Offset) *Offset += Info->VOITblOffset - OldVOIOffset;
+		
+		printf("Moved the VOI table from 0x%X to 0x%X.\n", OldVOIOffset, Info->VOITblOffset);
+	}
+	
+	return(true);
 }
 
-#if 1
-
-void EditorMenu(VOListNode *NodeList, void *VBIOSImg)
+// Every edit made is recorded in Journal, which the caller owns.
+void EditorMenu(VBIOSInfo *Info, VOListNode **NodeList, const VOFilter *Filter, uint8_t Strategy, VBIOSJournal *Journal)
 {
-	uint8_t *VBIOSImgBase = (uint8_t *)VBIOSImg;
-	
 	// Outermost loop of editor menu. Offers the choices to
-	// add an entry, edit an existing entry, or quit.
+	// add an entry, edit an existing entry, undo or redo an
+	// edit, or quit.
 	do
 	{
 		char InputStr[WOLFVOITOOL_MAX_EDTIOR_INPUT_LEN + 1];
-		uint8_t I2CInfoTmpBuf[1024];
+		VBIOSDelta Delta;
 
-		printf("\nPress 'e' to edit an entry, 'a' to add one, or 'q' to quit: ");
+		printf("\nPress 'e' to edit an entry, 'a' to add one, 'u' to undo, 'r' to redo, or 'q' to quit: ");
 
 		fflush(stdin);
-		fgets(InputStr, WOLFVOITOOL_MAX_EDTIOR_INPUT_LEN, stdin);
+		if(!fgets(InputStr, WOLFVOITOOL_MAX_EDTIOR_INPUT_LEN, stdin)) break;
 
 		EditorPrepInput(InputStr);
 		
-		VOListNode *CurNode = NodeList;
-		ATOM_ROM_HEADER *ROMHdr = (ATOM_ROM_HEADER *)(VBIOSImg + *((uint16_t *)(VBIOSImgBase + OFFSET_TO_POINTER_TO_ATOM_ROM_HEADER)));
-		const uint32_t VOITblOffset = ((ATOM_MASTER_DATA_TABLE *)(VBIOSImg + ROMHdr->usMasterDataTableOffset))->ListOfDataTables.VoltageObjectInfo;
-		ATOM_COMMON_TABLE_HEADER *VOIHdr = (ATOM_COMMON_TABLE_HEADER *)(VBIOSImg + VOITblOffset);
+		VOListNode *CurNode = *NodeList;
 
 		// Option 'E' - editing an existing VO.
 		if(!strcmp(InputStr, "E\n"))
 		{
-			if(!NodeList)
+			if(!*NodeList)
 			{
 				printf("No supported entries to edit!\n");
 				continue;
@@ -419,7 +560,7 @@ void EditorMenu(VOListNode *NodeList, void *VBIOSImg)
 				
 				printf("Enter index of entry to edit, or 'q' to return to the main menu: ");
 
-				fgets(InputStr, WOLFVOITOOL_MAX_EDTIOR_INPUT_LEN, stdin);
+				if(!fgets(InputStr, WOLFVOITOOL_MAX_EDTIOR_INPUT_LEN, stdin)) break;
 
 				EditorPrepInput(InputStr);
 				
@@ -442,9 +583,9 @@ void EditorMenu(VOListNode *NodeList, void *VBIOSImg)
 				// Loop over entries in the VO list until we either
 				// find the one the user wanted, or we reach the end.
 				
-				CurNode = NodeList;
+				CurNode = *NodeList;
 				
-				for(int idx = 0; (idx < SelectedIdx) && CurNode; ++idx, CurNode = CurNode->next);
+				for(uint32_t idx = 0; (idx < SelectedIdx) && CurNode; ++idx, CurNode = CurNode->next);
 				
 				// We reached the end before finding the requested
 				// entry in the list. Ask again.
@@ -454,99 +595,80 @@ void EditorMenu(VOListNode *NodeList, void *VBIOSImg)
 					continue;
 				}
 				
-				// Note that the PromptForVOEntry() function modifies the node
-				// that was passed to it as a template.
-				uint16_t OldVOSize = CurNode->VO->VOSize;
-				PromptForVOEntry(CurNode);
-				
-				ssize_t SizeDiff = CurNode->VO->VOSize - OldVOSize;
-				const uint32_t VBIOSPadLen = VBIOSGetPaddingLength(VBIOSImgBase);
-				
-				if(SizeDiff > VBIOSPadLen) abort();
-				
 				// Remember that the VO pointer within the node actually
-				// points inside our VBIOS image. Get the offset of our
-				// target VO - we will shift everything past that point,
-				// including the old VO data, forward by ModLen bytes.
-				size_t ModOffset = ((uint8_t *)CurNode->VO) - VBIOSImgBase;
+				// points inside our VBIOS image. The PromptForVOEntry()
+				// function modifies the node that was passed to it as a
+				// template, so give it a copy of the VO header to modify;
+				// the image is only touched by the relocation engine.
+				VoltageObject *OrigVO = CurNode->VO, EditVO = *CurNode->VO;
+				uint32_t ModOffset = ((uint8_t *)OrigVO) - Info->Image;
 				
-				// This shifts everything from our VO onward forward
-				// or backward by SizeDiff bytes. It lops off the last
-				// SizeDiff bytes from the end of the legacy ROM, in
-				// the case that SizeDiff is positive! These bytes are
-				// taken from the legacy VBIOS padding area - just
-				// ensure you have enough padding bytes!
-				PrepareROMForInsertionMod(VBIOSImgBase, VBIOS_GET_PADDING_END(VBIOSImgBase) - SizeDiff, ModOffset, SizeDiff);
-				
-				// Insert the entire new VO, now that there is room.
-				SerializeVO(CurNode->VO, CurNode, CurNode->VO->VOSize);
+				CurNode->VO = &EditVO;
+				PromptForVOEntry(CurNode);
 				
-				// Correct length of entire VOI table header
-				VOIHdr->usStructureSize += SizeDiff;
+				// This replaces the old VO with the new one, shifting
+				// everything after it forward or backward as needed,
+				// and growing the legacy image if the padding runs out.
+				// The old VO is left where it was by a move, so the
+				// node's data is still good.
+				if(!EditorPrepareGrowth(Info, Strategy, (int32_t)EditVO.VOSize - OrigVO->VOSize, Journal, &ModOffset) || !VBIOSReplaceVO(Info, ModOffset, OrigVO->VOSize, CurNode, &Delta))
+					printf("Unable to apply the edit; the image is unchanged.\n");
+				else
+					JournalRecord(Journal, &Delta);
 				
-				// Correct all table offsets for tables (data and command) which were affected
-				FixTableOffsets(VBIOSImg, ROMHdr, ModOffset, SizeDiff);
+				CurNode->VO = OrigVO;
+				EditorRefreshVOList(Info, NodeList, Filter);
 			} while(0);
 		}
 		// Option 'A' - append to VO list
 		else if(!strcmp(InputStr, "A\n"))
 		{
-			VOListNode *NewNode, *TempNode;
-			
-			// Two extra bytes for the 0xFF 0x00 default I2C data
-			//VOIEntry *NewEntry = (VOIEntry *)calloc(1, sizeof(VOIEntry) + 2);
-			//VoltageObject *NewVO = (VoltageObject *)calloc(1, sizeof(VoltageObject) + 2);
-			
-			// Walk the list until we get to the end. WARNING: assumes
-			// that NodeList is not NULL!
-			for(CurNode = NodeList; CurNode->next; CurNode = CurNode->next);
+			VOListNode TempNode = { 0 };
+			VoltageObject VO = { 0 };
 			
-			// Add a node to the list, and fill in a few sane defaults.
-			TempNode = (VOListNode *)calloc(1, sizeof(VOListNode));
-			VoltageObject *VO = (VoltageObject *)calloc(1, sizeof(VoltageObject));
-						
-			// Fields not set have been zeroed during allocation
-			TempNode->VO->VOType = VOLTAGE_TYPE_VDDC;
-			TempNode->VO->VOMode = VOLTAGE_MODE_INIT_REGULATOR;
-			TempNode->VO->VOSize = sizeof(VoltageObject) + 2;
+			// Fill in a few sane defaults. Fields not set have been zeroed.
+			TempNode.VO = &VO;
+			TempNode.VO->VOType = VOLTAGE_TYPE_VDDC;
+			TempNode.VO->VOMode = VOLTAGE_MODE_INIT_REGULATOR;
+			TempNode.VO->VOSize = sizeof(VoltageObject) + 2;
 			
-			TempNode->VO->AsType3.RegulatorID = 0x08;
-			TempNode->VO->AsType3.I2CLine = 150;
-			TempNode->VO->AsType3.I2CAddress = 0x10;
+			TempNode.VO->AsType3.RegulatorID = 0x08;
+			TempNode.VO->AsType3.I2CLine = 150;
+			TempNode.VO->AsType3.I2CAddress = 0x10;
 			
 			// Set the data portion to the terminator (0xFF00)
-			TempNode->VOData = (uint8_t *)malloc(sizeof(uint8_t) * 2);
-			TempNode->VODataLen = 2;
-			((uint8_t *)TempNode->VOData)[0] = 0xFF;
-			((uint8_t *)TempNode->VOData)[1] = 0x00;
+			TempNode.VOData = (uint8_t *)malloc(sizeof(uint8_t) * 2);
+			TempNode.VODataLen = 2;
+			((uint8_t *)TempNode.VOData)[0] = 0xFF;
+			((uint8_t *)TempNode.VOData)[1] = 0x00;
 
 			// In this case, since there is no object being replaced,
 			// the entire object is going to have to be inserted. This
 			// is performed in PromptForVOEntry() - the template entry
 			// it is passed gets filled with user input.
-			PromptForVOEntry(TempNode);
-			
-			// Since we are inserting an entire VO, the size difference is
-			// simply the size of the VO itself.
-			ssize_t SizeDiff = TempNode->VO->VOSize;
-			const uint32_t VBIOSPadLen = VBIOSGetPaddingLength(VBIOSImgBase);
-			
-			// Our modification offset is the very end of VOI.
-			size_t ModOffset = VOIHdr->usStructureSize + VOITblOffset;
-			
-			if(SizeDiff > VBIOSPadLen) abort();
-			
-			// Make some space at the end of the VOI table.
-			PrepareROMForInsertionMod(VBIOSImgBase, VBIOS_GET_PADDING_END(VBIOSImgBase) - SizeDiff, ModOffset, SizeDiff);
+			PromptForVOEntry(&TempNode);
 			
-			// Insert the new VO.
-			SerializeVO(VBIOSImgBase + ModOffset, TempNode, TempNode->VO->VOSize);
+			// Our modification offset is the very end of VOI, and
+			// there are no old bytes to replace.
+			if(!EditorPrepareGrowth(Info, Strategy, TempNode.VO->VOSize, Journal, NULL) || !VBIOSReplaceVO(Info, Info->VOITblOffset + Info->VOIHdr->usStructureSize, 0, &TempNode, &Delta))
+				printf("Unable to add the entry; the image is unchanged.\n");
+			else
+				JournalRecord(Journal, &Delta);
 			
-			// Correct all table offsets for tables (data and command) which were affected
-			FixTableOffsets(VBIOSImg, ROMHdr, ModOffset, SizeDiff);
-			
-			// Correct length of entire VOI table header
-			VOIHdr->usStructureSize += SizeDiff;
+			free(TempNode.VOData);
+			EditorRefreshVOList(Info, NodeList, Filter);
+		}
+		// Options 'U' and 'R' - step back or forward through the
+		// edits made so far.
+		else if(!strcmp(InputStr, "U\n"))
+		{
+			if(JournalUndo(Journal, Info)) printf("Undid edit %d of %d.\n", Journal->Pos + 1, Journal->Count);
+			EditorRefreshVOList(Info, NodeList, Filter);
+		}
+		else if(!strcmp(InputStr, "R\n"))
+		{
+			if(JournalRedo(Journal, Info)) printf("Redid edit %d of %d.\n", Journal->Pos, Journal->Count);
+			EditorRefreshVOList(Info, NodeList, Filter);
 		}
 		else if(!strcmp(InputStr, "Q\n"))
 		{
@@ -559,109 +681,1292 @@ void EditorMenu(VOListNode *NodeList, void *VBIOSImg)
 
 #endif
 
-int main(int argc, char **argv)
+// What a checkpointed run knows of each ROM until it is done.
+typedef struct
+{
+	bool Ok;
+	uint8_t InHash[SHA256_DIGEST_LEN];
+	uint8_t OutHash[SHA256_DIGEST_LEN];
+} BatchCheckpoint;
+
+// Everything the bulk modes need to process one ROM, as the I/O
+// engine hands them over.
+typedef struct
+{
+	char **ROMFiles;
+	uint32_t ROMFileCount;
+	const VOFilter *Filter;
+	VOIExport *Export;
+	const char *PatchInName;
+	const VOEdit *PlanEdits;
+	uint32_t PlanEditCount;
+	uint8_t RelocStrategy;
+	bool JSONOutput;
+	bool Simulate;
+	const SMBusSimModel *SimModel;
+	bool Optimize;
+	bool OptimizeWrite;
+	bool FreeSpace;
+	ROMWatch *Watch;
+	bool ShowNames;
+	Checkpoint *CP;
+	BatchCheckpoint *CPStates;
+	int Ret;
+} BatchState;
+
+// Processes one ROM's image, however it was read. Returns the size
+// of the image to write back, if it was changed.
+size_t ProcessBatchImage(BatchState *Batch, const char *ROMName, uint8_t *VBIOSImg, size_t VBIOSSize)
 {
-	uint8_t *VBIOSImg = NULL;
-	uint32_t VOITblOffset;
-	uint16_t VOCount;
-	size_t VBIOSSize;
-	char *VBIOSFileName;
-	uint32_t OrigUEFIVBIOSLen, OrigLegacyVBIOSLen;
 	VOListNode *VOList;
-	ATOM_ROM_HEADER *ROMHdr;
-	ATOM_COMMON_TABLE_HEADER *VOIHdr;
-	bool Editing = false;
-	
-	fprintf(stderr, "wolfvoitool v%s by Wolf9466 (aka Wolf0/OhGodAPet)\n", WOLFVOITOOL_VERSION_STR);
-	fprintf(stderr, "Donation address (BTC): 1WoLFumNUvjCgaCyjFzvFrbGfDddYrKNR\n");
+	VBIOSInfo Info;
 	
-	if(argc < 2) usage(argv[0]);
+	if(!VBIOSImg || !VBIOSLocateVOI(&Info, VBIOSImg, VBIOSSize))
+	{
+		if(Batch->PlanEditCount) VBIOSPrintPlanError(ROMName, "unable to read the ROM or locate its VOI table");
+		else printf("Skipping %s.\n", ROMName);
+		Batch->Ret = -1;
+		return(0);
+	}
 	
-	for(int i = 1; i < argc; ++i)
+	// Each ROM is patched in place, provided it is exactly
+	// the one the patch was made for.
+	if(Batch->PatchInName)
 	{
-		if(!strcmp(argv[i], "-f") || !strcmp(argv[i], "--file"))
+		if(VOIPatchApply(Batch->PatchInName, VBIOSImg, &VBIOSSize))
 		{
-			NEXT_ARG_CHECK(argv[i]);
-			
-			VBIOSFileName = argv[++i];
-			VBIOSImg = (uint8_t *)malloc(sizeof(uint8_t) * AMD_VBIOS_MAX_SIZE);
-			
-			VBIOSSize = ReadVBIOSFile(VBIOSImg, VBIOSFileName, AMD_VBIOS_MAX_SIZE);
-			
-			if(!VBIOSSize)
+			// Rewriting a watched ROM must not make it look new.
+			if(Batch->Watch && !ROMWatchNoteWrite(Batch->Watch, ROMName))
 			{
-				free(VBIOSImg);
-				return(-1);
+				printf("Out of memory.\n");
+				Batch->Ret = -1;
+				return(0);
 			}
 			
-			// Record the sizes of both VBIOS images for later.
-			OrigLegacyVBIOSLen = ((uint8_t *)VBIOSImg)[0x03] << 9;
-			OrigUEFIVBIOSLen = VBIOSSize - OrigLegacyVBIOSLen;
+			printf("Patched %s.\n", ROMName);
+			return(VBIOSSize);
 		}
-		else if(!strcmp(argv[i], "-e") || !strcmp(argv[i], "--edit"))
+		
+		printf("Skipping %s.\n", ROMName);
+		Batch->Ret = -1;
+		return(0);
+	}
+	
+	// Planning only reads the tables, and reports what the
+	// edits would do to each ROM as one line of JSON.
+	if(Batch->PlanEditCount)
+	{
+		VBIOSPlan Plan;
+		
+		if(!VBIOSPlanEdits(&Plan, &Info, Batch->PlanEdits, Batch->PlanEditCount, Batch->RelocStrategy)) Batch->Ret = -1;
+		
+		VBIOSPrintPlan(&Plan, &Info, ROMName);
+		return(0);
+	}
+	
+	// Exporting feeds the table walk straight into the columns;
+	// nothing is dumped or copied into VO lists.
+	if(Batch->Export)
+	{
+		if(VOIExportAddROM(Batch->Export, ROMName, VBIOSImg + Info.VOITblOffset, Batch->Filter) < 0)
 		{
-			Editing = true;
+			printf("VOI table in %s is malformed, skipping it.\n", ROMName);
+			Batch->Ret = -1;
+		}
+		
+		return(0);
+	}
+	
+	// Optimizing replays the INIT_REGULATOR writes as simulating
+	// does, and reports which can be dropped; when writing, they are
+	// dropped, and the ROM written back.
+	if(Batch->Optimize)
+	{
+		SMBusOpt Opt;
+		size_t NewSize = 0;
+		
+		if(!Batch->JSONOutput && ((Batch->ROMFileCount > 1) || Batch->ShowNames)) printf("\n%s:\n", ROMName);
+		
+		if(!SMBusOptimize(&Opt, &Info, Batch->SimModel))
+		{
+			printf("VOI table in %s is malformed, skipping it.\n", ROMName);
+			Batch->Ret = -1;
+			return(0);
+		}
+		
+		SMBusOptPrint(&Opt, ROMName, Batch->JSONOutput);
+		
+		if(Batch->OptimizeWrite && Opt.EditCount)
+		{
+			if(!VBIOSApplyVOEdits(&Info, Opt.Edits, Opt.EditCount, Batch->RelocStrategy))
+			{
+				printf("Unable to optimize %s.\n", ROMName);
+				Batch->Ret = -1;
+			}
+			else if(Batch->Watch && !ROMWatchNoteWrite(Batch->Watch, ROMName))
+			{
+				printf("Out of memory.\n");
+				Batch->Ret = -1;
+			}
+			else NewSize = Info.Size;
+		}
+		
+		SMBusOptFree(&Opt);
+		return(NewSize);
+	}
+	
+	// Simulating replays the INIT_REGULATOR writes onto models of
+	// the devices they address, and reports what they were left as.
+	if(Batch->Simulate)
+	{
+		SMBusSim Sim;
+		
+		if(!Batch->JSONOutput && ((Batch->ROMFileCount > 1) || Batch->ShowNames)) printf("\n%s:\n", ROMName);
+		
+		SMBusSimInit(&Sim, Batch->SimModel);
+		
+		if(SMBusSimRunTable(&Sim, VBIOSImg + Info.VOITblOffset, Batch->Filter)) SMBusSimPrint(&Sim, ROMName, Batch->JSONOutput);
+		else
+		{
+			printf("VOI table in %s is malformed, skipping it.\n", ROMName);
+			Batch->Ret = -1;
 		}
+		
+		SMBusSimFree(&Sim);
+		return(0);
+	}
+	
+	// Mapping free space reports how much room each ROM has for
+	// its VOs to grow into, without looking at the VOs at all.
+	if(Batch->FreeSpace)
+	{
+		VBIOSFreeMap Map;
+		
+		if(!Batch->JSONOutput && ((Batch->ROMFileCount > 1) || Batch->ShowNames)) printf("\n%s:\n", ROMName);
+		
+		if(VBIOSMapFreeSpace(&Map, &Info)) VBIOSPrintFreeMap(&Map, ROMName, Batch->JSONOutput);
 		else
 		{
-			printf("Unknown parameter \"%s\".\n", argv[i]);
-			if(VBIOSImg) free(VBIOSImg);
-			usage(argv[0]);
+			printf("Skipping %s.\n", ROMName);
+			Batch->Ret = -1;
 		}
+		
+		return(0);
+	}
+	
+	CreateVOList(&VOList, VBIOSImg + Info.VOITblOffset, 0xFF, Batch->Filter);
+	
+	if(Batch->JSONOutput) DumpVOListJSON(VOList, ROMName);
+	else
+	{
+		if((Batch->ROMFileCount > 1) || Batch->ShowNames) printf("\n%s:\n", ROMName);
+		
+		VBIOSDumpROMChain(&Info.Chain);
+		printf("VOI Table Format Revision 0x%02X, Content Revision 0x%02X.\n", Info.VOIHdr->ucTableFormatRevision, Info.VOIHdr->ucTableContentRevision);
+		DumpVOList(VOList);
 	}
 	
-	ROMHdr = (ATOM_ROM_HEADER *)(VBIOSImg + *((uint16_t *)(VBIOSImg + OFFSET_TO_POINTER_TO_ATOM_ROM_HEADER)));
-	VOITblOffset = ((ATOM_MASTER_DATA_TABLE *)(VBIOSImg + ROMHdr->usMasterDataTableOffset))->ListOfDataTables.VoltageObjectInfo;
+	FreeVOList(VOList);
+	return(0);
+}
+
+// Called by the I/O engine as each ROM's read completes.
+size_t ProcessBatchROM(void *Ctx, uint32_t r, uint8_t *VBIOSImg, size_t VBIOSSize)
+{
+	BatchState *Batch = (BatchState *)Ctx;
+	
+	return(ProcessBatchImage(Batch, Batch->ROMFiles[r], VBIOSImg, VBIOSSize));
+}
 
-	VOIHdr = (ATOM_COMMON_TABLE_HEADER *)(VBIOSImg + VOITblOffset);
+// Called with each ROM found in a tar archive or captured from a
+// PCI device. Neither can be written back, so whatever is returned
+// is ignored.
+bool ProcessScannedROM(void *Ctx, const char *ROMName, uint8_t *VBIOSImg, size_t VBIOSSize)
+{
+	ProcessBatchImage((BatchState *)Ctx, ROMName, VBIOSImg, VBIOSSize);
+	return(true);
+}
 
-	printf("VOI Table Format Revision 0x%02X, Content Revision 0x%02X.\n", VOIHdr->ucTableFormatRevision, VOIHdr->ucTableContentRevision);
+// Processes a ROM as ProcessBatchROM() does, for a checkpointed
+// run: its hashes are taken before and after, and a change is
+// journaled before it is written back.
+size_t CheckpointBatchROM(void *Ctx, uint32_t r, uint8_t *VBIOSImg, size_t VBIOSSize)
+{
+	BatchState *Batch = (BatchState *)Ctx;
+	BatchCheckpoint *State = Batch->CPStates + r;
+	int PrevRet = Batch->Ret;
+	size_t Len;
 	
-	// If the user wants to modify the VOI table, then only show
-	// entries which we support editing (which is only those with
-	// mode INIT_REGULATOR at the moment.) Otherwise, display all
-	// VOI entries.
-	if(Editing) VOCount = CreateVOList(&VOList, VBIOSImg + VOITblOffset, VOLTAGE_MODE_INIT_REGULATOR);
-	else VOCount = CreateVOList(&VOList, VBIOSImg + VOITblOffset, 0xFF);
+	if(VBIOSImg) SHA256(State->InHash, VBIOSImg, VBIOSSize);
 	
-	DumpVOList(VOList);
+	Batch->Ret = 0;
+	Len = ProcessBatchROM(Ctx, r, VBIOSImg, VBIOSSize);
+	State->Ok = VBIOSImg && !Batch->Ret;
+	if(PrevRet) Batch->Ret = PrevRet;
 	
-	if(Editing)
+	if(!Len)
 	{
-		
-		EditorMenu(VOList, VBIOSImg);
-		
-		// We need the length of the total image, because we
-		// did not track how much the VBIOS may have changed
-		// in size. As such, take the current length of the
-		// legacy image (this value is in byte at offset 0x03,
-		// in 512-byte units), and subtract the original UEFI
-		// VBIOS length.
-		// Because we know we never edit the UEFI VBIOS, its
-		// size MUST have remained the same, and if we added
-		// blocks to the legacy image, this will be reflected
-		// in the length byte.
+		memcpy(State->OutHash, State->InHash, SHA256_DIGEST_LEN);
+		return(0);
+	}
 	
-		uint32_t NewImgLen = (((uint8_t *)VBIOSImg)[0x03] << 9) + OrigUEFIVBIOSLen;
-		
-		// Sanity check
-		if(NewImgLen > AMD_VBIOS_MAX_SIZE)
+	SHA256(State->OutHash, VBIOSImg, Len);
+	
+	if(!CheckpointWriteAhead(Batch->CP, Batch->ROMFiles[r], State->InHash, State->OutHash))
+	{
+		State->Ok = false;
+		Batch->Ret = -1;
+		return(0);
+	}
+	
+	return(Len);
+}
+
+// Called by the I/O engine once a ROM is finished with. Only ROMs
+// processed without error are recorded as done; the rest are tried
+// again when the run is.
+void CheckpointBatchDone(void *Ctx, uint32_t r, bool Ok)
+{
+	BatchState *Batch = (BatchState *)Ctx;
+	BatchCheckpoint *State = Batch->CPStates + r;
+	
+	if(Ok && State->Ok && !CheckpointDone(Batch->CP, Batch->ROMFiles[r], State->InHash, State->OutHash)) Batch->Ret = -1;
+}
+
+// Processes ROMs as they arrive in Dir, in batches of however many
+// have arrived since the last, for as long as Dir can be watched.
+// Rewritten ROMs are replaced atomically, so that nothing reading
+// the spool ever sees one half written.
+int WatchROMDir(const char *Dir, BatchState *Batch, ROMIOConfig *IOConfig)
+{
+	ROMWatch Watch;
+	char **ROMFiles;
+	uint32_t ROMFileCount;
+	bool Ok;
+	
+	if(!ROMWatchInit(&Watch, Dir)) return(-1);
+	
+	Batch->Watch = &Watch;
+	Batch->ShowNames = true;
+	IOConfig->Flags |= ROMIO_FLAG_ATOMIC_WRITES;
+	
+	fprintf(stderr, "Watching %s for ROMs.\n", Dir);
+	
+	do
+	{
+		if((Ok = ROMWatchWait(&Watch, &ROMFiles, &ROMFileCount)))
 		{
-			printf("VBIOS metadata is badly fucked.\n");
-			free(VBIOSImg);
-			return(-1);
+			Batch->ROMFiles = ROMFiles;
+			Batch->ROMFileCount = ROMFileCount;
+			
+			if(!ROMIORun(IOConfig, ROMFiles, ROMFileCount, ProcessBatchROM, Batch)) Batch->Ret = -1;
+			
+			// Whatever is reading the results should get them now,
+			// not whenever the buffer next fills.
+			fflush(stdout);
 		}
 		
-		WriteVBIOSFile(VBIOSFileName, VBIOSImg, NewImgLen);
+		for(uint32_t r = 0; r < ROMFileCount; ++r) free(ROMFiles[r]);
+		free(ROMFiles);
+	} while(Ok);
+	
+	Batch->Watch = NULL;
+	ROMWatchFree(&Watch);
+	
+	return(-1);
+}
+
+// Works through a manifest shared with other workers, a few ROMs
+// at a time, for as long as any are left unclaimed (see queue.h).
+int QueueROMs(const char *ManifestName, BatchState *Batch, ROMIOConfig *IOConfig)
+{
+	ROMQueue Queue;
+	int32_t Claimed;
+	
+	if(!ROMQueueOpen(&Queue, ManifestName)) return(-1);
+	
+	Batch->ShowNames = true;
+	
+	while((Claimed = ROMQueueClaim(&Queue, IOConfig->Depth)) > 0)
+	{
+		Batch->ROMFiles = Queue.HeldNames;
+		Batch->ROMFileCount = Claimed;
+		
+		if(!ROMIORun(IOConfig, Queue.HeldNames, Claimed, ProcessBatchROM, Batch)) Batch->Ret = -1;
+		
+		fflush(stdout);
+		
+		if(!ROMQueueFinish(&Queue)) Claimed = -1;
+		if(Claimed < 0) break;
 	}
 	
-	FreeVOList(VOList);
+	if(Claimed < 0) Batch->Ret = -1;
 	
-	free(VBIOSImg);
+	ROMQueueFree(&Queue);
+	return(Batch->Ret);
+}
+
+// One thread's share of a statistics run. Each job runs its own I/O
+// engine over its own slice of the ROMs, into its own statistics,
+// so the jobs share nothing until they are merged.
+typedef struct
+{
+	pthread_t Thread;
+	bool Started;
+	bool Ok;
+	char **ROMFiles;
+	uint32_t ROMFileCount;
+	const VOFilter *Filter;
+	ROMIOConfig IOConfig;
+	VBIOSBufPool BufPool;
+	VOIStats Stats;
+} StatsJob;
+
+// Called by a job's I/O engine, on the job's own thread.
+size_t StatsBatchROM(void *Ctx, uint32_t r, uint8_t *VBIOSImg, size_t VBIOSSize)
+{
+	StatsJob *Job = (StatsJob *)Ctx;
+	VBIOSInfo Info;
+	
+	if(!VBIOSImg || !VBIOSLocateVOI(&Info, VBIOSImg, VBIOSSize))
+	{
+		printf("Skipping %s.\n", Job->ROMFiles[r]);
+		Job->Stats.BadROMCount++;
+		return(0);
+	}
+	
+	if(!VOIStatsAddROM(&Job->Stats, Job->ROMFiles[r], VBIOSImg + Info.VOITblOffset, Job->Filter)) Job->Ok = false;
 	
 	return(0);
 }
 
+void *StatsJobThread(void *Arg)
+{
+	StatsJob *Job = (StatsJob *)Arg;
+	
+	if(!ROMIORun(&Job->IOConfig, Job->ROMFiles, Job->ROMFileCount, StatsBatchROM, Job)) Job->Ok = false;
+	
+	return(NULL);
+}
+
+// Gathers statistics over the ROMs with up to JobCount threads, and
+// merges them into Stats. The memory budget, if any, is split evenly
+// between the jobs; the I/O depth is per job. There are never more
+// jobs than shares of the budget that each hold the largest ROM.
+int StatsROMs(char **ROMFiles, uint32_t ROMFileCount, const VOFilter *Filter, const ROMIOConfig *IOConfig, size_t MemBudget, uint32_t JobCount, VOIStats *Stats)
+{
+	StatsJob *Jobs;
+	int Ret = 0;
+	
+	if(JobCount > ROMFileCount) JobCount = ROMFileCount;
+	if(MemBudget && (JobCount > (MemBudget / AMD_VBIOS_MAX_SIZE))) JobCount = (MemBudget < AMD_VBIOS_MAX_SIZE) ? 1 : (MemBudget / AMD_VBIOS_MAX_SIZE);
+	if(!JobCount) return(0);
+	
+	if(!(Jobs = (StatsJob *)calloc(JobCount, sizeof(StatsJob))))
+	{
+		printf("Out of memory.\n");
+		return(-1);
+	}
+	
+	for(uint32_t j = 0; j < JobCount; ++j)
+	{
+		uint32_t Start = ((uint64_t)ROMFileCount * j) / JobCount;
+		uint32_t End = ((uint64_t)ROMFileCount * (j + 1)) / JobCount;
+		
+		Jobs[j].Ok = true;
+		Jobs[j].ROMFiles = ROMFiles + Start;
+		Jobs[j].ROMFileCount = End - Start;
+		Jobs[j].Filter = Filter;
+		Jobs[j].IOConfig = *IOConfig;
+		Jobs[j].IOConfig.Pool = &Jobs[j].BufPool;
+		
+		VBIOSBufPoolInit(&Jobs[j].BufPool, MemBudget / JobCount);
+		VOIStatsInit(&Jobs[j].Stats);
+	}
+	
+	// A job whose thread cannot be started runs here instead.
+	for(uint32_t j = 0; j < JobCount; ++j)
+	{
+		if(!(Jobs[j].Started = !pthread_create(&Jobs[j].Thread, NULL, StatsJobThread, Jobs + j))) StatsJobThread(Jobs + j);
+	}
+	
+	for(uint32_t j = 0; j < JobCount; ++j)
+	{
+		if(Jobs[j].Started) pthread_join(Jobs[j].Thread, NULL);
+		
+		if(!Jobs[j].Ok || !VOIStatsMerge(Stats, &Jobs[j].Stats)) Ret = -1;
+		
+		VOIStatsFree(&Jobs[j].Stats);
+		VBIOSBufPoolFree(&Jobs[j].BufPool);
+	}
+	
+	free(Jobs);
+	return(Ret);
+}
+
+// Statistics over the ROMs in tar archives or captured from PCI
+// devices, which are handed over one at a time, on the main thread,
+// straight into the totals.
+typedef struct
+{
+	const VOFilter *Filter;
+	VOIStats *Stats;
+	bool Ok;
+} StatsScanJob;
+
+bool StatsScannedROM(void *Ctx, const char *ROMName, uint8_t *VBIOSImg, size_t VBIOSSize)
+{
+	StatsScanJob *Job = (StatsScanJob *)Ctx;
+	VBIOSInfo Info;
 	
+	if(!VBIOSLocateVOI(&Info, VBIOSImg, VBIOSSize))
+	{
+		printf("Skipping %s.\n", ROMName);
+		Job->Stats->BadROMCount++;
+		return(true);
+	}
+	
+	if(!VOIStatsAddROM(Job->Stats, ROMName, VBIOSImg + Info.VOITblOffset, Job->Filter)) Job->Ok = false;
+	
+	return(true);
+}
+
+// Moves the tar archives among the ROMs given into a list of their
+// own; they are scanned through, rather than read whole.
+bool SplitROMTars(char **ROMFiles, uint32_t *ROMFileCount, char ***TarFiles, uint32_t *TarFileCount)
+{
+	uint32_t Kept = 0;
+	bool Ok = true;
 	
+	for(uint32_t r = 0; r < *ROMFileCount; ++r)
+	{
+		if(!IsROMTarName(ROMFiles[r])) ROMFiles[Kept++] = ROMFiles[r];
+		else
+		{
+			if(Ok) Ok = AddROMFile(TarFiles, TarFileCount, ROMFiles[r]);
+			free(ROMFiles[r]);
+		}
+	}
 	
+	*ROMFileCount = Kept;
+	return(Ok);
+}
+
+// The editor works on a single ROM, interactively, so it has no
+// use for batched I/O; the ROM is read and written directly.
+int EditROM(const char *ROMName, const VOFilter *Filter, const char *PatchOutName, uint8_t Strategy)
+{
+	uint8_t *VBIOSImg, *BaseImg = NULL;
+	size_t VBIOSSize;
+	VOListNode *VOList;
+	VBIOSInfo Info;
+	VBIOSJournal Journal;
+	int LockFd, Ret = 0;
+	
+	VBIOSImg = (uint8_t *)malloc(sizeof(uint8_t) * AMD_VBIOS_MAX_SIZE);
+	
+	if(!VBIOSImg)
+	{
+		printf("Out of memory.\n");
+		return(-1);
+	}
+	
+	// The ROM stays locked for the whole session, so that nothing
+	// else patching it can change it underneath the editor.
+	if(((LockFd = ROMIOLockFile(ROMName, false)) < 0) && (errno == EWOULDBLOCK))
+	{
+		printf("Waiting for %s, which is locked by another process.\n", ROMName);
+		LockFd = ROMIOLockFile(ROMName, true);
+	}
+	
+	VBIOSSize = ReadVBIOSFile(VBIOSImg, ROMName, AMD_VBIOS_MAX_SIZE);
+	
+	if(!VBIOSSize || !VBIOSLocateVOI(&Info, VBIOSImg, VBIOSSize))
+	{
+		printf("Skipping %s.\n", ROMName);
+		if(LockFd >= 0) close(LockFd);
+		free(VBIOSImg);
+		return(-1);
+	}
+	
+	VBIOSDumpROMChain(&Info.Chain);
+	printf("VOI Table Format Revision 0x%02X, Content Revision 0x%02X.\n", Info.VOIHdr->ucTableFormatRevision, Info.VOIHdr->ucTableContentRevision);
+	
+	// Only show entries which we support editing (which is only
+	// those with mode INIT_REGULATOR at the moment.)
+	CreateVOList(&VOList, VBIOSImg + Info.VOITblOffset, VOLTAGE_MODE_INIT_REGULATOR, Filter);
+	DumpVOList(VOList);
+	
+	// The untouched image is needed to generate a patch.
+	if(PatchOutName && (BaseImg = (uint8_t *)malloc(VBIOSSize))) memcpy(BaseImg, VBIOSImg, VBIOSSize);
+	
+	JournalInit(&Journal);
+	EditorMenu(&Info, &VOList, Filter, Strategy, &Journal);
+	
+	// The relocation engine keeps Info.Size up to date when
+	// it grows the legacy image, moving the UEFI image and
+	// anything else after it along.
+	uint32_t NewImgLen = Info.Size;
+	
+	// Sanity check
+	if(NewImgLen > AMD_VBIOS_MAX_SIZE)
+	{
+		printf("VBIOS metadata is badly fucked.\n");
+		Ret = -1;
+	}
+	else if(PatchOutName)
+	{
+		// The ROM itself is left alone; only the patch is written.
+		if(!BaseImg || !VOIPatchWrite(PatchOutName, BaseImg, VBIOSSize, &Info, &Journal)) Ret = -1;
+	}
+	else if(!WriteVBIOSFile(ROMName, VBIOSImg, NewImgLen)) Ret = -1;
+	
+	if(LockFd >= 0) close(LockFd);
+	
+	JournalFree(&Journal);
+	FreeVOList(VOList);
+	free(BaseImg);
+	free(VBIOSImg);
+	
+	return(Ret);
+}
+
+// Sends the writes of each edited VO - the VO as it would be after
+// the edit, so a sequence can be tried before it is flashed - to the
+// bus given. The ROM itself is only read.
+int I2CApplyROM(const char *ROMName, const VOEdit *Edits, uint32_t EditCount, const char *BusName, bool Verify)
+{
+	uint8_t *VBIOSImg;
+	size_t VBIOSSize;
+	VBIOSInfo Info;
+	I2CTransport Xport;
+	int Ret = 0;
+	
+	VBIOSImg = (uint8_t *)malloc(sizeof(uint8_t) * AMD_VBIOS_MAX_SIZE);
+	
+	if(!VBIOSImg)
+	{
+		printf("Out of memory.\n");
+		return(-1);
+	}
+	
+	VBIOSSize = ReadVBIOSFile(VBIOSImg, ROMName, AMD_VBIOS_MAX_SIZE);
+	
+	if(!VBIOSSize || !VBIOSLocateVOI(&Info, VBIOSImg, VBIOSSize))
+	{
+		printf("Skipping %s.\n", ROMName);
+		free(VBIOSImg);
+		return(-1);
+	}
+	
+	if(!I2CTransportOpen(&Xport, BusName))
+	{
+		free(VBIOSImg);
+		return(-1);
+	}
+	
+	for(uint32_t i = 0; i < EditCount; ++i)
+	{
+		VoltageObject *OrigVO = NULL, NewVO;
+		VOListNode NewNode;
+		
+		if(Edits[i].Index != VOEDIT_APPEND)
+		{
+			if(!(OrigVO = VOEditFindVO(&Info, Edits[i].Index)))
+			{
+				printf("VO %d does not exist.\n", Edits[i].Index);
+				Ret = -1;
+				break;
+			}
+			
+			VOEditBuildNode(Edits + i, OrigVO, ((uint8_t *)OrigVO) + sizeof(VoltageObject), OrigVO->VOSize - sizeof(VoltageObject), &NewVO, &NewNode);
+		}
+		else VOEditBuildNode(Edits + i, NULL, NULL, 0, &NewVO, &NewNode);
+		
+		if(NewVO.VOMode != VOLTAGE_MODE_INIT_REGULATOR)
+		{
+			printf("VO %d has mode %s, and has no writes to send.\n", Edits[i].Index, VoltageModeName(NewVO.VOMode));
+			Ret = -1;
+			break;
+		}
+		
+		if(Edits[i].Index == VOEDIT_APPEND) printf("Appended VO:\n");
+		else printf("VO %d:\n", Edits[i].Index);
+		
+		if(!I2CApplyVO(&Xport, &NewVO, NewNode.VOData, NewNode.VODataLen, Verify))
+		{
+			Ret = -1;
+			break;
+		}
+	}
+	
+	I2CTransportClose(&Xport);
+	free(VBIOSImg);
+	
+	return(Ret);
+}
+
+int main(int argc, char **argv)
+{
+	char **ROMFiles = NULL, *ExportFileName = NULL;
+	char *ArchiveName = NULL, *VariantName = NULL, *OutDir = ".";
+	char *PatchOutName = NULL, *PatchInName = NULL, *WatchDir = NULL;
+	char *QueueName = NULL, *I2CBusName = NULL, *StatsOutName = NULL, **StatsInNames = NULL;
+	char **MergeNames = NULL, **Merge3Names = NULL, *CheckpointName = NULL, **TarFiles = NULL, *SysfsRoot = PCIROM_DEFAULT_SYSFS_ROOT;
+	Checkpoint CP;
+	ROMShardSpec ShardSpec = { 0, 0 };
+	uint8_t ArchiveMode = 0;
+	uint32_t ROMFileCount = 0, TarFileCount = 0;
+	VOFilter Filter = { 0 };
+	VOIExport Export;
+	uint8_t ExportFormat = VOIEXPORT_FORMAT_NATIVE, RelocStrategy = VBIOS_RELOC_SHIFT;
+	VOEdit PlanEdits[VBIOS_PLAN_MAX_EDITS];
+	VOEdit I2CEdits[VBIOS_PLAN_MAX_EDITS];
+	uint32_t PlanEditCount = 0, I2CEditCount = 0, StatsInCount = 0, JobCount = 0, MergeCount = 0, Merge3NameCount = 0;
+	bool Editing = false, JSONOutput = false, Simulate = false, I2CVerify = true, Stats = false, FreeSpace = false, PCICapture = false;
+	bool Optimize = false, OptimizeWrite = false;
+	const SMBusSimModel *SimModel = NULL;
+	ROMIOConfig IOConfig = { ROMIO_BACKEND_AUTO, ROMIO_DEFAULT_DEPTH, 0, NULL, NULL };
+	VBIOSBufPool BufPool;
+	size_t MemBudget = 0;
+	int Ret = 0;
+	
+	fprintf(stderr, "wolfvoitool v%s by Wolf9466 (aka Wolf0/OhGodAPet)\n", WOLFVOITOOL_VERSION_STR);
+	fprintf(stderr, "Donation address (BTC): 1WoLFumNUvjCgaCyjFzvFrbGfDddYrKNR\n");
+	
+	if(argc < 2) usage(argv[0]);
+	
+	for(int i = 1; i < argc; ++i)
+	{
+		if(!strcmp(argv[i], "-f") || !strcmp(argv[i], "--file"))
+		{
+			NEXT_ARG_CHECK(argv[i]);
+			
+			if(!AddROMFile(&ROMFiles, &ROMFileCount, argv[++i])) return(-1);
+		}
+		else if(!strcmp(argv[i], "-b") || !strcmp(argv[i], "--batch"))
+		{
+			NEXT_ARG_CHECK(argv[i]);
+			
+			if(!ReadROMList(&ROMFiles, &ROMFileCount, argv[++i])) return(-1);
+		}
+		else if(!strcmp(argv[i], "-e") || !strcmp(argv[i], "--edit"))
+		{
+			Editing = true;
+		}
+		else if(!strcmp(argv[i], "-j") || !strcmp(argv[i], "--json"))
+		{
+			JSONOutput = true;
+		}
+		else if(!strcmp(argv[i], "-F") || !strcmp(argv[i], "--filter"))
+		{
+			NEXT_ARG_CHECK(argv[i]);
+			
+			if(!CompileVOFilter(&Filter, argv[++i])) return(-1);
+		}
+		else if(!strcmp(argv[i], "-x") || !strcmp(argv[i], "--export"))
+		{
+			NEXT_ARG_CHECK(argv[i]);
+			
+			ExportFileName = argv[++i];
+		}
+		else if(!strcmp(argv[i], "--export-format"))
+		{
+			NEXT_ARG_CHECK(argv[i]);
+			
+			++i;
+			
+			if(!strcmp(argv[i], "native")) ExportFormat = VOIEXPORT_FORMAT_NATIVE;
+			else if(!strcmp(argv[i], "arrow")) ExportFormat = VOIEXPORT_FORMAT_ARROW;
+			else
+			{
+				printf("Unknown export format \"%s\".\n", argv[i]);
+				return(-1);
+			}
+		}
+		else if(!strcmp(argv[i], "--archive-create") || !strcmp(argv[i], "--archive-list") || !strcmp(argv[i], "--archive-extract"))
+		{
+			NEXT_ARG_CHECK(argv[i]);
+			
+			// 'c', 'l' or 'e'
+			ArchiveMode = argv[i][10];
+			ArchiveName = argv[++i];
+		}
+		else if(!strcmp(argv[i], "--variant"))
+		{
+			NEXT_ARG_CHECK(argv[i]);
+			
+			VariantName = argv[++i];
+		}
+		else if(!strcmp(argv[i], "-o") || !strcmp(argv[i], "--output-dir"))
+		{
+			NEXT_ARG_CHECK(argv[i]);
+			
+			OutDir = argv[++i];
+		}
+		else if(!strcmp(argv[i], "--patch-out"))
+		{
+			NEXT_ARG_CHECK(argv[i]);
+			
+			PatchOutName = argv[++i];
+		}
+		else if(!strcmp(argv[i], "--reloc"))
+		{
+			NEXT_ARG_CHECK(argv[i]);
+			
+			++i;
+			
+			if(!strcmp(argv[i], "shift")) RelocStrategy = VBIOS_RELOC_SHIFT;
+			else if(!strcmp(argv[i], "move")) RelocStrategy = VBIOS_RELOC_MOVE;
+			else
+			{
+				printf("Unknown relocation strategy \"%s\".\n", argv[i]);
+				return(-1);
+			}
+		}
+		else if(!strcmp(argv[i], "--apply-patch"))
+		{
+			NEXT_ARG_CHECK(argv[i]);
+			
+			PatchInName = argv[++i];
+		}
+		else if(!strcmp(argv[i], "-w") || !strcmp(argv[i], "--watch"))
+		{
+			NEXT_ARG_CHECK(argv[i]);
+			
+			WatchDir = argv[++i];
+		}
+		else if(!strcmp(argv[i], "--shard"))
+		{
+			NEXT_ARG_CHECK(argv[i]);
+			
+			if(!ParseShardSpec(&ShardSpec, argv[++i])) return(-1);
+		}
+		else if(!strcmp(argv[i], "-m") || !strcmp(argv[i], "--merge"))
+		{
+			NEXT_ARG_CHECK(argv[i]);
+			
+			if(!AddROMFile(&MergeNames, &MergeCount, argv[++i])) return(-1);
+		}
+		else if(!strcmp(argv[i], "--merge3"))
+		{
+			if(i > (argc - 5))
+			{
+				printf("Argument \"%s\" requires four parameters.\n", argv[i]);
+				return(-1);
+			}
+			
+			for(int n = 0; n < 4; ++n)
+			{
+				if(!AddROMFile(&Merge3Names, &Merge3NameCount, argv[++i])) return(-1);
+			}
+		}
+		else if(!strcmp(argv[i], "--merge3-list"))
+		{
+			NEXT_ARG_CHECK(argv[i]);
+			
+			if(!ReadMergeList(&Merge3Names, &Merge3NameCount, argv[++i])) return(-1);
+		}
+		else if(!strcmp(argv[i], "--checkpoint"))
+		{
+			NEXT_ARG_CHECK(argv[i]);
+			
+			CheckpointName = argv[++i];
+		}
+		else if(!strcmp(argv[i], "-q") || !strcmp(argv[i], "--queue"))
+		{
+			NEXT_ARG_CHECK(argv[i]);
+			
+			QueueName = argv[++i];
+		}
+		else if(!strcmp(argv[i], "--io"))
+		{
+			NEXT_ARG_CHECK(argv[i]);
+			
+			++i;
+			
+			if(!strcmp(argv[i], "auto")) IOConfig.Backend = ROMIO_BACKEND_AUTO;
+			else if(!strcmp(argv[i], "uring")) IOConfig.Backend = ROMIO_BACKEND_URING;
+			else if(!strcmp(argv[i], "threads")) IOConfig.Backend = ROMIO_BACKEND_THREADS;
+			else
+			{
+				printf("Unknown I/O backend \"%s\".\n", argv[i]);
+				return(-1);
+			}
+		}
+		else if(!strcmp(argv[i], "--io-depth"))
+		{
+			NEXT_ARG_CHECK(argv[i]);
+			
+			IOConfig.Depth = strtoul(argv[++i], NULL, 0);
+			
+			if(!IOConfig.Depth || (IOConfig.Depth > ROMIO_MAX_DEPTH))
+			{
+				printf("The I/O depth must be between 1 and %d.\n", ROMIO_MAX_DEPTH);
+				return(-1);
+			}
+		}
+		else if(!strcmp(argv[i], "-S") || !strcmp(argv[i], "--simulate"))
+		{
+			Simulate = true;
+		}
+		else if(!strcmp(argv[i], "--pci"))
+		{
+			PCICapture = true;
+		}
+		else if(!strcmp(argv[i], "--sysfs-root"))
+		{
+			NEXT_ARG_CHECK(argv[i]);
+			
+			SysfsRoot = argv[++i];
+			PCICapture = true;
+		}
+		else if(!strcmp(argv[i], "--optimize"))
+		{
+			Optimize = true;
+		}
+		else if(!strcmp(argv[i], "--optimize-write"))
+		{
+			Optimize = OptimizeWrite = true;
+		}
+		else if(!strcmp(argv[i], "--free-space"))
+		{
+			FreeSpace = true;
+		}
+		else if(!strcmp(argv[i], "--sim-model"))
+		{
+			NEXT_ARG_CHECK(argv[i]);
+			
+			if(!(SimModel = SMBusSimFindModel(argv[++i])))
+			{
+				printf("Unknown device model \"%s\".\n", argv[i]);
+				return(-1);
+			}
+		}
+		else if(!strcmp(argv[i], "--mem-budget"))
+		{
+			NEXT_ARG_CHECK(argv[i]);
+			
+			MemBudget = (size_t)strtoul(argv[++i], NULL, 0) << 20;
+			
+			if(!MemBudget)
+			{
+				printf("The memory budget must be at least 1 MB.\n");
+				return(-1);
+			}
+		}
+		else if(!strcmp(argv[i], "-p") || !strcmp(argv[i], "--plan"))
+		{
+			NEXT_ARG_CHECK(argv[i]);
+			
+			if(PlanEditCount == VBIOS_PLAN_MAX_EDITS)
+			{
+				printf("At most %d edits may be planned at once.\n", VBIOS_PLAN_MAX_EDITS);
+				return(-1);
+			}
+			
+			if(!ParseVOEdit(PlanEdits + PlanEditCount, argv[++i])) return(-1);
+			
+			PlanEditCount++;
+		}
+		else if(!strcmp(argv[i], "-s") || !strcmp(argv[i], "--stats"))
+		{
+			Stats = true;
+		}
+		else if(!strcmp(argv[i], "--stats-in"))
+		{
+			NEXT_ARG_CHECK(argv[i]);
+			
+			if(!AddROMFile(&StatsInNames, &StatsInCount, argv[++i])) return(-1);
+		}
+		else if(!strcmp(argv[i], "--stats-out"))
+		{
+			NEXT_ARG_CHECK(argv[i]);
+			
+			StatsOutName = argv[++i];
+		}
+		else if(!strcmp(argv[i], "--jobs"))
+		{
+			NEXT_ARG_CHECK(argv[i]);
+			
+			JobCount = strtoul(argv[++i], NULL, 0);
+			
+			if(!JobCount || (JobCount > ROMIO_MAX_DEPTH))
+			{
+				printf("The number of jobs must be between 1 and %d.\n", ROMIO_MAX_DEPTH);
+				return(-1);
+			}
+		}
+		else if(!strcmp(argv[i], "--i2c-apply"))
+		{
+			NEXT_ARG_CHECK(argv[i]);
+			
+			if(I2CEditCount == VBIOS_PLAN_MAX_EDITS)
+			{
+				printf("At most %d edits may be applied at once.\n", VBIOS_PLAN_MAX_EDITS);
+				return(-1);
+			}
+			
+			if(!ParseVOEdit(I2CEdits + I2CEditCount, argv[++i])) return(-1);
+			
+			I2CEditCount++;
+		}
+		else if(!strcmp(argv[i], "--i2c-bus"))
+		{
+			NEXT_ARG_CHECK(argv[i]);
+			
+			I2CBusName = argv[++i];
+		}
+		else if(!strcmp(argv[i], "--no-verify"))
+		{
+			I2CVerify = false;
+		}
+		else
+		{
+			printf("Unknown parameter \"%s\".\n", argv[i]);
+			usage(argv[0]);
+		}
+	}
+	
+	// Listing and extracting archives need no ROMs; creating one
+	// stores the first ROM given in full and the rest as variants.
+	if((ArchiveMode == 'l') || (ArchiveMode == 'e'))
+	{
+		if(ArchiveMode == 'l') Ret = VOIArchiveList(ArchiveName) ? 0 : -1;
+		else Ret = VOIArchiveExtract(ArchiveName, VariantName, OutDir) ? 0 : -1;
+		
+		for(uint32_t r = 0; r < ROMFileCount; ++r) free(ROMFiles[r]);
+		free(ROMFiles);
+		return(Ret);
+	}
+	
+	// A three-way merge writes a new ROM per merge, and stands alone.
+	// Every merge is tried, even after one fails.
+	if(Merge3NameCount)
+	{
+		if(ROMFileCount || PCICapture || WatchDir || QueueName || Editing || ExportFileName || ArchiveMode || PlanEditCount || PatchInName || Simulate || Optimize || FreeSpace || I2CEditCount || MergeCount || Stats || StatsInCount || StatsOutName || CheckpointName || ShardSpec.ShardCount)
+		{
+			printf("Three-way merging cannot be combined with ROMs or other modes.\n");
+			return(-1);
+		}
+		
+		for(uint32_t m = 0; m < Merge3NameCount; m += 4)
+		{
+			if(!VOIMerge3(Merge3Names[m], Merge3Names[m + 1], Merge3Names[m + 2], Merge3Names[m + 3], RelocStrategy)) Ret = -1;
+		}
+		
+		for(uint32_t m = 0; m < Merge3NameCount; ++m) free(Merge3Names[m]);
+		free(Merge3Names);
+		return(Ret);
+	}
+	
+	// Merging sorts together the records from earlier runs, or adds
+	// up their statistics, exactly as --stats-in does.
+	if(MergeCount)
+	{
+		uint32_t StatsFileCount = 0;
+		bool IsStats;
+		
+		if(ROMFileCount || PCICapture || WatchDir || QueueName || Editing || ExportFileName || ArchiveMode || PlanEditCount || PatchInName || Simulate || Optimize || FreeSpace || I2CEditCount)
+		{
+			printf("Merging cannot be combined with ROMs or other modes.\n");
+			return(-1);
+		}
+		
+		for(uint32_t m = 0; m < MergeCount; ++m)
+		{
+			if(!IsStatsFile(MergeNames[m], &IsStats)) return(-1);
+			if(IsStats) StatsFileCount++;
+		}
+		
+		if(StatsFileCount && (StatsFileCount != MergeCount))
+		{
+			printf("Statistics and records cannot be merged together.\n");
+			return(-1);
+		}
+		
+		if(!StatsFileCount)
+		{
+			Ret = MergeRecordFiles(MergeNames, MergeCount) ? 0 : -1;
+			
+			for(uint32_t m = 0; m < MergeCount; ++m) free(MergeNames[m]);
+			free(MergeNames);
+			return(Ret);
+		}
+		
+		for(uint32_t m = 0; m < MergeCount; ++m)
+		{
+			if(!AddROMFile(&StatsInNames, &StatsInCount, MergeNames[m])) return(-1);
+		}
+	}
+	
+	// Saved statistics may be merged without gathering any more.
+	if(StatsInCount || StatsOutName) Stats = true;
+	
+	if(!ROMFileCount && !PCICapture && !WatchDir && !StatsInCount && !QueueName) usage(argv[0]);
+	
+	// A shard may well end up with no ROMs at all; that is not an
+	// error, just an empty result.
+	if(ShardSpec.ShardCount)
+	{
+		if(WatchDir || QueueName || Editing || ArchiveMode || I2CEditCount)
+		{
+			printf("Sharding cannot be combined with watching, queues, editing, archiving or applying over I2C.\n");
+			return(-1);
+		}
+		
+		ApplyShardSpec(&ShardSpec, ROMFiles, &ROMFileCount);
+	}
+	
+	// Tar archives are sharded as any other input is, whole.
+	if(!SplitROMTars(ROMFiles, &ROMFileCount, &TarFiles, &TarFileCount)) return(-1);
+	
+	if(TarFileCount && (Editing || PatchInName || OptimizeWrite || CheckpointName || WatchDir || QueueName || ArchiveMode || I2CEditCount))
+	{
+		printf("ROMs in tar archives can only be read, so they cannot be edited, patched, optimized in place, checkpointed, watched, queued, archived or applied over I2C.\n");
+		return(-1);
+	}
+	
+	if(PCICapture && (Editing || PatchInName || OptimizeWrite || CheckpointName || WatchDir || QueueName || ArchiveMode || I2CEditCount || ShardSpec.ShardCount))
+	{
+		printf("ROMs captured from PCI devices can only be read, so they cannot be edited, patched, optimized in place, checkpointed, watched, queued, archived, sharded or applied over I2C.\n");
+		return(-1);
+	}
+	
+	if(ArchiveMode == 'c')
+	{
+		Ret = VOIArchiveCreate(ArchiveName, ROMFiles, ROMFileCount) ? 0 : -1;
+		
+		for(uint32_t r = 0; r < ROMFileCount; ++r) free(ROMFiles[r]);
+		free(ROMFiles);
+		return(Ret);
+	}
+	
+	if(Editing && ((ROMFileCount > 1) || ExportFileName))
+	{
+		printf("Editing works on exactly one ROM, and cannot be combined with exporting.\n");
+		return(-1);
+	}
+	
+	if(WatchDir && (Editing || ExportFileName || ArchiveMode))
+	{
+		printf("Watching cannot be combined with editing, exporting or archiving.\n");
+		return(-1);
+	}
+	
+	if(Simulate && (Editing || ExportFileName || PlanEditCount || PatchInName))
+	{
+		printf("Simulating cannot be combined with editing, exporting, planning or patching.\n");
+		return(-1);
+	}
+	
+	if(FreeSpace && (Editing || ExportFileName || PlanEditCount || PatchInName || Simulate))
+	{
+		printf("Mapping free space cannot be combined with editing, exporting, planning, patching or simulating.\n");
+		return(-1);
+	}
+	
+	if(Optimize && (Editing || ExportFileName || PlanEditCount || PatchInName || Simulate || FreeSpace))
+	{
+		printf("Optimizing cannot be combined with editing, exporting, planning, patching, simulating or mapping free space.\n");
+		return(-1);
+	}
+	
+	if(PlanEditCount && (Editing || ExportFileName))
+	{
+		printf("Planning cannot be combined with editing or exporting.\n");
+		return(-1);
+	}
+	
+	if(PatchOutName && !Editing)
+	{
+		printf("A patch can only be written from an editing session.\n");
+		return(-1);
+	}
+	
+	if(PatchInName && (Editing || ExportFileName || PlanEditCount))
+	{
+		printf("Applying a patch cannot be combined with other modes.\n");
+		return(-1);
+	}
+	
+	if(CheckpointName && (WatchDir || QueueName || Editing || ExportFileName || ArchiveMode || Stats || I2CEditCount))
+	{
+		printf("Checkpointing cannot be combined with watching, queues, editing, exporting, archiving, statistics or applying over I2C.\n");
+		return(-1);
+	}
+	
+	if(QueueName && (ROMFileCount || WatchDir || Editing || ExportFileName || ArchiveMode))
+	{
+		printf("Working from a queue cannot be combined with other ROMs, watching, editing, exporting or archiving.\n");
+		return(-1);
+	}
+	
+	if(Stats && (QueueName || WatchDir || Editing || ExportFileName || PlanEditCount || PatchInName || Simulate || Optimize || FreeSpace || I2CEditCount))
+	{
+		printf("Gathering statistics cannot be combined with other modes.\n");
+		return(-1);
+	}
+	
+	if(I2CEditCount && (!I2CBusName || (ROMFileCount > 1) || QueueName || WatchDir || Editing || ExportFileName || PlanEditCount || PatchInName || Simulate || Optimize || FreeSpace))
+	{
+		printf("Applying over I2C needs a bus, works on exactly one ROM, and cannot be combined with other modes.\n");
+		return(-1);
+	}
+	
+	if(ExportFileName && !VOIExportInit(&Export))
+	{
+		printf("Out of memory.\n");
+		return(-1);
+	}
+	
+	// One job per CPU, unless told otherwise; the jobs gather
+	// statistics, or decompress archives.
+	if(!JobCount)
+	{
+		long CPUCount = sysconf(_SC_NPROCESSORS_ONLN);
+		
+		JobCount = (CPUCount < 1) ? 1 : ((CPUCount > ROMIO_MAX_DEPTH) ? ROMIO_MAX_DEPTH : CPUCount);
+	}
+	
+	if(Editing) Ret = EditROM(ROMFiles[0], &Filter, PatchOutName, RelocStrategy);
+	else if(I2CEditCount) Ret = I2CApplyROM(ROMFiles[0], I2CEdits, I2CEditCount, I2CBusName, I2CVerify);
+	else if(Stats)
+	{
+		VOIStats Totals;
+		
+		VOIStatsInit(&Totals);
+		
+		for(uint32_t s = 0; s < StatsInCount; ++s)
+		{
+			if(!VOIStatsLoad(&Totals, StatsInNames[s])) Ret = -1;
+		}
+		
+		if(!Ret && StatsROMs(ROMFiles, ROMFileCount, &Filter, &IOConfig, MemBudget, JobCount, &Totals)) Ret = -1;
+		
+		for(uint32_t t = 0; !Ret && (t < TarFileCount); ++t)
+		{
+			StatsScanJob Job = { &Filter, &Totals, true };
+			
+			if(!ROMTarScan(TarFiles[t], JobCount, StatsScannedROM, &Job) || !Job.Ok) Ret = -1;
+		}
+		
+		if(!Ret && PCICapture)
+		{
+			StatsScanJob Job = { &Filter, &Totals, true };
+			
+			if(!PCIROMCapture(SysfsRoot, StatsScannedROM, &Job) || !Job.Ok) Ret = -1;
+		}
+		
+		if(!Ret)
+		{
+			VOIStatsPrint(&Totals, JSONOutput);
+			
+			if(StatsOutName && !VOIStatsSave(&Totals, StatsOutName)) Ret = -1;
+		}
+		
+		VOIStatsFree(&Totals);
+	}
+	else
+	{
+		BatchState Batch = { 0 };
+		
+		Batch.ROMFiles = ROMFiles;
+		Batch.ROMFileCount = ROMFileCount;
+		Batch.Filter = &Filter;
+		Batch.Export = (ExportFileName) ? &Export : NULL;
+		Batch.PatchInName = PatchInName;
+		Batch.PlanEdits = PlanEdits;
+		Batch.PlanEditCount = PlanEditCount;
+		Batch.RelocStrategy = RelocStrategy;
+		Batch.JSONOutput = JSONOutput;
+		Batch.Simulate = Simulate;
+		Batch.SimModel = SimModel;
+		Batch.Optimize = Optimize;
+		Batch.OptimizeWrite = OptimizeWrite;
+		Batch.FreeSpace = FreeSpace;
+		Batch.ShowNames = TarFileCount || PCICapture;
+		
+		// One pool of image buffers serves the whole run. Patching
+		// may grow an image, so it needs buffers of the largest size,
+		// and each ROM is locked until it has been written back, as
+		// it is when optimizing in place.
+		VBIOSBufPoolInit(&BufPool, MemBudget);
+		
+		IOConfig.Pool = &BufPool;
+		if(PatchInName || OptimizeWrite) IOConfig.Flags |= ROMIO_FLAG_FULL_BUFFERS | ROMIO_FLAG_LOCK;
+		
+		// A checkpointed run leaves out whatever an earlier one got
+		// done. Its writes must be atomic, so that a ROM it dies while
+		// writing is either the old image or the new one.
+		if(CheckpointName)
+		{
+			if(!CheckpointOpen(&CP, CheckpointName)) return(-1);
+			
+			if(!CheckpointFilter(&CP, ROMFiles, &ROMFileCount) || !(Batch.CPStates = (BatchCheckpoint *)calloc(ROMFileCount + 1, sizeof(BatchCheckpoint))))
+			{
+				CheckpointClose(&CP);
+				return(-1);
+			}
+			
+			Batch.ROMFileCount = ROMFileCount;
+			Batch.CP = &CP;
+			IOConfig.Flags |= ROMIO_FLAG_ATOMIC_WRITES;
+			IOConfig.Done = CheckpointBatchDone;
+		}
+		
+		if(ROMFileCount && !ROMIORun(&IOConfig, ROMFiles, ROMFileCount, (CheckpointName) ? CheckpointBatchROM : ProcessBatchROM, &Batch)) Batch.Ret = -1;
+		
+		if(CheckpointName)
+		{
+			if(!CheckpointClose(&CP)) Batch.Ret = -1;
+			free(Batch.CPStates);
+		}
+		
+		for(uint32_t t = 0; t < TarFileCount; ++t)
+		{
+			if(!ROMTarScan(TarFiles[t], JobCount, ProcessScannedROM, &Batch)) Batch.Ret = -1;
+		}
+		
+		if(PCICapture && !PCIROMCapture(SysfsRoot, ProcessScannedROM, &Batch)) Batch.Ret = -1;
+		
+		if(QueueName) Batch.Ret = QueueROMs(QueueName, &Batch, &IOConfig);
+		
+		// Any ROMs given outright are processed before watching.
+		if(WatchDir)
+		{
+			fflush(stdout);
+			Batch.Ret = WatchROMDir(WatchDir, &Batch, &IOConfig);
+		}
+		
+		VBIOSBufPoolFree(&BufPool);
+		
+		Ret = Batch.Ret;
+	}
+	
+	if(ExportFileName)
+	{
+		if(VOIExportWrite(&Export, ExportFileName, ExportFormat))
+			printf("Exported %llu VOs from %u ROMs to %s.\n", (unsigned long long)Export.RowCount, Export.ROMCount, ExportFileName);
+		else Ret = -1;
+		
+		VOIExportFree(&Export);
+	}
+	
+	for(uint32_t r = 0; r < ROMFileCount; ++r) free(ROMFiles[r]);
+	free(ROMFiles);
+	
+	for(uint32_t t = 0; t < TarFileCount; ++t) free(TarFiles[t]);
+	free(TarFiles);
+	
+	for(uint32_t i = 0; i < PlanEditCount; ++i) FreeVOEdit(PlanEdits + i);
+	for(uint32_t i = 0; i < I2CEditCount; ++i) FreeVOEdit(I2CEdits + i);
+	
+	for(uint32_t s = 0; s < StatsInCount; ++s) free(StatsInNames[s]);
+	free(StatsInNames);
+	
+	for(uint32_t m = 0; m < MergeCount; ++m) free(MergeNames[m]);
+	free(MergeNames);
+	
+	return(Ret);
+}
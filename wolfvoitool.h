@@ -5,3 +5,13 @@
 #define WOLFVOITOOL_VERSION 		0.70
 #define WOLFVOITOOL_VERSION_STR		"0.70"
 
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+size_t ReadVBIOSFile(void *VBIOSOut, const char *FileName, size_t BufSize);
+size_t WriteVBIOSFile(const char *FileName, void *VBIOSData, size_t VBIOSSize);
+bool AddROMFile(char ***ROMFiles, uint32_t *ROMFileCount, const char *FileName);
+bool ReadROMList(char ***ROMFiles, uint32_t *ROMFileCount, const char *ListFileName);
+bool ReadMergeList(char ***MergeNames, uint32_t *MergeNameCount, const char *ListFileName);